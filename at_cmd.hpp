@@ -8,18 +8,16 @@
 #define AT_CMD_HPP
 
 #include "FreeRTOS.h"
+#include "at_channel.hpp"
 #include "at_cmd_def.hpp"
 #include "at_cmd_handler.hpp"
 
-//! Determines how to terminate the prompted message (for AT commands which demand a message after receiving '>')
-enum class at_prompt_end_policy
-{
-    //! Terminate with CTRL-Z character
-    ctrl_z,
+//! A single command of the batch sent with at_send_batch().
+using at_batch_entry = at_basic_batch_entry<at_cmd>;
 
-    //! Terminate normally with CRLF after sending the whole message.
-    crlf
-};
+//! The counters of the default channel. \see at_get_stats()
+using at_stats =
+    at_basic_stats<to_u_type(at_cmd::number_of_commands), to_u_type(at_unsolicited_msg::number_of_msgs)>;
 
 /**
  * \brief Send WRITE(SET) AT command and get the payload of the response.
@@ -31,32 +29,186 @@ enum class at_prompt_end_policy
  * The payload of the command is the part after '=' character, e.g. when write AT command like that
  * "AT+MAKAPAKA=FUNNY HUEHUE" is sent then the payload is "FUNNY HUEHUE".
  *
+ * The command times out also when its response stops in the middle for longer than the inter-line limit of its timeout
+ * profile (see AT_COMMANDS_TIMEOUT_PROFILES). The timed out command is withdrawn at once, along with the line being
+ * received, so the next queued command is sent right away.
+ *
  * \param[in] command           The command to be sent.
  * \param[in] payload           The payload of the write AT command.
  * \param[out] response_payload The payload of the received response.
- * \param[in] ticks_to_wait     Max number of ticks this call can block the caller task.
+ * \param[in] ticks_to_wait     Max number of ticks this call can block the caller task. at_profile_timeout takes it
+ *                              from the timeout profile of the command.
+ * \param[in] priority          Commands with a higher priority overtake the queued ones. \see at_priority
  * \returns result of the operation. \see at_err
  */
-at_err at_send(at_cmd command, std::string &&payload, TickType_t ticks_to_wait, std::string &response_payload);
+at_err at_send(at_cmd command,
+               at_string &&payload,
+               TickType_t ticks_to_wait,
+               at_string &response_payload,
+               at_priority priority = at_priority::normal);
 
 //! Overload of at_send() when you don't need the response's payload for WRITE command types.
-at_err at_send(at_cmd command, std::string &&payload, TickType_t ticks_to_wait);
+at_err
+at_send(at_cmd command, at_string &&payload, TickType_t ticks_to_wait, at_priority priority = at_priority::normal);
 
 /**
  * \brief Send EXEC, READ or TEST AT command and get the payload of the response.
  *
  * This function can't be called for the WRITE(SET) command. \see Other overloads of at_send().
  *
+ * The queries listed in AT_COMMANDS_CACHE_PROFILES are answered from the cache, when their response is fresh.
+ *
  * \param[in] command           The command to be sent.
  * \param[in] command_type      The type of the command (at_cmd_type::exec, at_cmd_type::read or at_cmd_type::test).
  * \param[in] ticks_to_wait     Max number of ticks this call can block the caller task.
  * \param[out] response_payload The payload of the received response.
+ * \param[in] priority          Commands with a higher priority overtake the queued ones. \see at_priority
  * \returns result of the operation. \see at_err
  */
-at_err at_send(at_cmd command, at_cmd_type command_type, TickType_t ticks_to_wait, std::string &response_payload);
+at_err at_send(at_cmd command,
+               at_cmd_type command_type,
+               TickType_t ticks_to_wait,
+               at_string &response_payload,
+               at_priority priority = at_priority::normal);
 
 //! Overload of at_send() when you don't need the response's payload.
-at_err at_send(at_cmd command, at_cmd_type command_type, TickType_t ticks_to_wait);
+at_err at_send(at_cmd command,
+               at_cmd_type command_type,
+               TickType_t ticks_to_wait,
+               at_priority priority = at_priority::normal);
+
+/**
+ * \brief Overloads of at_send() which return the lines of the response, so they are visited one by one without
+ *        splitting the payload on CRLF.
+ *
+ * The lines are recorded while they arrive, into the buffer reserved for the size listed in AT_COMMANDS_RESPONSE_SIZES.
+ * The buffer of response_lines is kept for the next command, so pass the same list to avoid allocations. The query
+ * is sent on its own, neither served from the cache (AT_COMMANDS_CACHE_PROFILES) nor shared with its other issuers.
+ */
+at_err at_send(at_cmd command,
+               at_string &&payload,
+               TickType_t ticks_to_wait,
+               at_line_list &response_lines,
+               at_priority priority = at_priority::normal);
+at_err at_send(at_cmd command,
+               at_cmd_type command_type,
+               TickType_t ticks_to_wait,
+               at_line_list &response_lines,
+               at_priority priority = at_priority::normal);
+
+//! The typed values of the payload of the command, which schema is listed in AT_COMMANDS_PAYLOAD_SCHEMAS.
+template <at_cmd Command> using at_payload_values = at_cmd_handler::payload_values<Command>;
+
+/**
+ * \brief Send a WRITE command and parse the payload of its response into the values of the schema of the command.
+ *
+ * E.g. with at_cmd_schema<at_cmd::first, int, int> listed in AT_COMMANDS_PAYLOAD_SCHEMAS, the response
+ * "+FIRST: 0,1" gives {0, 1}. The payload is parsed in a single pass, without building any intermediate strings.
+ *
+ * \param[in] payload           The payload of the write AT command.
+ * \param[in] ticks_to_wait     Max number of ticks this call can block the caller task.
+ * \param[out] values           The values of the fields of the payload. The string fields view the payload, which
+ *                              isn't kept, so use unquoted_string or quoted_string only with the handlers.
+ * \param[in] priority          Commands with a higher priority overtake the queued ones. \see at_priority
+ * \returns result of the operation, at_err::invalid_payload when the payload doesn't match the schema.
+ */
+template <at_cmd Command>
+at_err at_send_typed(at_string &&payload,
+                     TickType_t ticks_to_wait,
+                     at_payload_values<Command> &values,
+                     at_priority priority = at_priority::normal);
+
+//! Overload of at_send_typed() for EXEC, READ or TEST AT command.
+template <at_cmd Command>
+at_err at_send_typed(at_cmd_type command_type,
+                     TickType_t ticks_to_wait,
+                     at_payload_values<Command> &values,
+                     at_priority priority = at_priority::normal);
+
+/**
+ * \brief Send a WRITE command which payload is formatted from the typed arguments, with the signature of the command
+ *        listed in AT_COMMANDS_WRITE_SIGNATURES.
+ *
+ * E.g. with at_cmd_args<at_cmd::qiopen, int, int, quoted_string, quoted_string, int, int, int>,
+ * at_send_write<at_cmd::qiopen>(ticks, 1, 0, "TCP", ip, 80, 0, 1) sends AT+QIOPEN=1,0,"TCP","1.2.3.4",80,0,1.
+ * The number and the types of the arguments are checked at compile time. The payload is built in a single string,
+ * sized up front, without any intermediate strings.
+ *
+ * \param[in] ticks_to_wait     Max number of ticks this call can block the caller task.
+ * \param[out] response_payload The payload of the response, like for at_send().
+ * \param[in] args              The arguments: integers, enums (sent as their underlying values) or strings.
+ * \returns result of the operation. \see at_err
+ */
+template <at_cmd Command, typename... Args>
+at_err at_send_write(TickType_t ticks_to_wait, at_string &response_payload, const Args &... args);
+
+//! Overload of at_send_write() when you don't need the response's payload.
+template <at_cmd Command, typename... Args> at_err at_send_write(TickType_t ticks_to_wait, const Args &... args);
+
+/**
+ * \brief Overloads of at_send_write() which send the command with the priority. \see at_priority
+ *
+ * The priority comes first, as nothing can follow the arguments of the command.
+ */
+template <at_cmd Command, typename... Args>
+at_err at_send_write(at_priority priority, TickType_t ticks_to_wait, at_string &response_payload, const Args &... args);
+template <at_cmd Command, typename... Args>
+at_err at_send_write(at_priority priority, TickType_t ticks_to_wait, const Args &... args);
+
+/**
+ * \brief Send a WRITE command and pass the payload of the response to the sink, line by line, as it arrives.
+ *
+ * Meant for the large responses (e.g. AT+QHTTPREAD, AT+QFREAD), which would otherwise be accumulated as a whole:
+ * only a single line is held at once. The sink is invoked from the task which receives the responses, without any
+ * lock, so the other tasks keep issuing the commands meanwhile. It must not wait for the response to any command,
+ * as no response is received till it returns. The line is valid only during the call.
+ *
+ * \param[in] command       The command to be sent.
+ * \param[in] payload       The payload of the write AT command.
+ * \param[in] ticks_to_wait Max number of ticks this call can block the caller task.
+ * \param[in] sink          Invoked for each line of the payload of the response, including the error information.
+ * \returns result of the operation. \see at_err
+ */
+at_err at_send_streamed(at_cmd command, at_string &&payload, TickType_t ticks_to_wait, at_payload_sink sink);
+
+//! Overload of at_send_streamed() for EXEC, READ or TEST AT command.
+at_err at_send_streamed(at_cmd command, at_cmd_type command_type, TickType_t ticks_to_wait, at_payload_sink sink);
+
+/**
+ * \brief Send a WRITE command whose response carries raw binary data, e.g. AT+QIRD or AT+QFREAD.
+ *
+ * The data follows the line which starts with binary.header and tells the number of the bytes, e.g.
+ * "+QIRD: 1460\r\n". The data is copied by the RX interrupt directly to binary.data, without looking for the line
+ * terminators, so any byte value may be received. Then the rest of the response is handled as usual.
+ *
+ * \param[in] command           The command to be sent.
+ * \param[in] payload           The payload of the write AT command.
+ * \param[in] ticks_to_wait     Max number of ticks this call can block the caller task.
+ * \param[in,out] binary        The buffer for the data. The bytes which don't fit into its capacity are discarded.
+ * \param[out] response_payload The payload of the received response, including the header line.
+ * \returns result of the operation. \see at_err
+ */
+at_err at_send_binary_read(at_cmd command,
+                           at_string &&payload,
+                           TickType_t ticks_to_wait,
+                           at_binary_rx &binary,
+                           at_string &response_payload);
+
+/**
+ * \brief Send a sequence of AT commands as a single transaction, e.g. the configuration of the device at boot.
+ *
+ * The commands are sent back to back by the task which receives the responses: the next one is sent as soon as the
+ * final result code of the previous one arrives and the caller is woken up only once, when the batch is done. The
+ * result and the response payload of each command are stored in its entry.
+ *
+ * \param[in,out] entries   The commands to be sent, in order.
+ * \param[in] entries_num   The number of the entries.
+ * \param[in] policy        Whether to send the rest of the commands after a command has failed.
+ * \param[in] ticks_to_wait Max number of ticks this call can block the caller task, for the whole batch.
+ * \returns at_err::ok when all the commands succeeded, at_err::timeout when the batch hasn't been done on time,
+ *          otherwise the result of the first failed command.
+ */
+at_err at_send_batch(at_batch_entry *entries, size_t entries_num, at_batch_policy policy, TickType_t ticks_to_wait);
 
 /**
  * \brief Send a WRITE command which needs also a second message after receiving the prompt character ('>')
@@ -69,15 +221,129 @@ at_err at_send(at_cmd command, at_cmd_type command_type, TickType_t ticks_to_wai
  * \returns result of the operation. \see at_err
  */
 at_err at_send_prompted(at_cmd command,
-                        std::string payload,
-                        std::string prompt_message,
+                        at_string payload,
+                        at_string prompt_message,
+                        at_prompt_end_policy policy,
+                        TickType_t ticks_to_wait);
+
+/**
+ * \brief Overload which transmits the prompted message straight from the buffer of the caller, without any copy.
+ *
+ * Suits the big messages, e.g. the data sent through a socket. The buffer is only referenced, so it must stay
+ * untouched until this function returns. When the command is done or times out before the whole message is
+ * transmitted, then the rest of the message is dropped, so the buffer is never read after the return.
+ *
+ * \param[in] prompt_data   The message sent after receiving the prompt character.
+ * \param[in] prompt_len    The length of the message.
+ */
+at_err at_send_prompted(at_cmd command,
+                        at_string payload,
+                        const char *prompt_data,
+                        size_t prompt_len,
                         at_prompt_end_policy policy,
                         TickType_t ticks_to_wait);
 
+/**
+ * \brief Send a packet of data through a socket, e.g. with AT+QISEND=<id>,<len> or AT+CIPSEND=<id>,<len>, without
+ *        waiting for its acknowledgement.
+ *
+ * The packet is queued and the call returns at once, unless stream.max_packets_in_flight packets or
+ * stream.max_bytes_in_flight bytes already await their acknowledgements, in that case the oldest one is awaited
+ * first. The command is completed by the line which matches stream.ack or stream.failure, or by "ERROR". A failed
+ * packet is reported by the next call on the stream (at_send_data() or at_flush_data()), which doesn't send anything
+ * then.
+ *
+ * The data is transmitted straight from the buffer of the caller, so the buffer must stay untouched until the packet
+ * is acknowledged: it can be reused after stream.max_packets_in_flight more packets have been sent, so that many
+ * buffers plus one can be used in turn, and all of them after at_flush_data() has returned.
+ *
+ * \param[in] stream         The state and the profile of the stream. Must be used by a single task.
+ * \param[in] command        The command which sends the data.
+ * \param[in] payload        The payload of the command, e.g. "0,1460". Its length must match len.
+ * \param[in] data           The data sent after receiving the prompt character.
+ * \param[in] len            The length of the data.
+ * \param[in] ticks_to_wait  Max number of ticks this call can block the caller task.
+ * \returns at_err::ok when the packet is queued, at_err::timeout when the window hasn't moved on time or the failure
+ *          of a previous packet.
+ */
+at_err at_send_data(at_data_stream &stream,
+                    at_cmd command,
+                    at_string &&payload,
+                    const char *data,
+                    size_t len,
+                    TickType_t ticks_to_wait);
+
+/**
+ * \brief Wait until all the packets of the stream are acknowledged.
+ *
+ * When the ticks are up, then the packets which still wait are withdrawn, so none of the buffers is read anymore.
+ *
+ * \returns at_err::ok when all of them have been acknowledged, at_err::timeout or the first failure otherwise.
+ */
+at_err at_flush_data(at_data_stream &stream, TickType_t ticks_to_wait);
+
+/**
+ * \brief Send an AT command without blocking the caller and get notified when its final result code is received.
+ *
+ * The command is queued like the ones sent with at_send(). The completion is invoked from the task which receives
+ * the responses, so it can't use any blocking OS function, but it is allowed to issue another command
+ * asynchronously. The slot of the completed command is free by then, so that command is queued even when the queue has
+ * been full.
+ *
+ * There is no timeout for an asynchronous command; use at_abort_async() if the response doesn't come on time.
+ *
+ * \param[in] command       The command to be sent.
+ * \param[in] command_type  The type of the command.
+ * \param[in] payload       The payload of the write AT command. Shall be empty for the other command types.
+ * \param[in] completion    Invoked with the result and the response payload when the command is done.
+ * \param[in] priority      Commands with a higher priority overtake the queued ones. \see at_priority
+ * \returns handle of the command, which is invalid when the queue of the commands is full.
+ */
+at_async_handle at_send_async(at_cmd command,
+                              at_cmd_type command_type,
+                              at_string &&payload,
+                              at_async_completion completion,
+                              at_priority priority = at_priority::normal);
+
+/**
+ * \brief Overload of at_send_async() which sets the flag when the command is done.
+ *
+ * The flag is reset when the command is issued. After the flag has been set, get the result with
+ * at_get_async_result(). The flag must be valid until then.
+ */
+at_async_handle at_send_async(at_cmd command,
+                              at_cmd_type command_type,
+                              at_string &&payload,
+                              os_flag &done_flag,
+                              at_priority priority = at_priority::normal);
+
+/**
+ * \brief Get the result of the command sent with the flag overload of at_send_async().
+ *
+ * \returns at_err::handling_cmd when the command isn't done yet, at_err::unknown when the handle is invalid or
+ *          the result has already been taken. Otherwise the result of the command, in that case the handle becomes
+ *          invalid.
+ */
+at_err at_get_async_result(at_async_handle handle, at_string &response_payload);
+
+/**
+ * \brief Withdraw the command sent with at_send_async(). The completion won't be invoked and the flag won't be set.
+ *
+ * \returns false when the command is already done or the handle is invalid.
+ */
+bool at_abort_async(at_async_handle handle);
+
 /**
  * \brief Register a handler for the specific unsolicited command.
  *
- * The handler is invoked when the unsolicited command arrives. The handler can't use any blocking OS function.
+ * The handler is invoked when the unsolicited command arrives. An immediate handler can't use any blocking OS
+ * function, as it's invoked by the task which parses the responses. A deferred handler is invoked by a separate task
+ * (when AT_CMD_HANDLER_URC_QUEUE_LEN isn't zero), so it may take long, e.g. log over another port, without delaying
+ * the responses to the commands.
+ *
+ * The handlers are linked only by the task which parses the responses, so the unsolicited commands are handled
+ * without the lock of the commands. When called by another task, the registration is queued within a short critical
+ * section and the token is returned at once; the handler takes effect from the next line which that task parses.
  *
  * \param[in] command   The unsolicited command for which the handler will be invoked.
  * \param[in] handler   The handler takes as a parameter the response payload as an rvalue. It returns true when it
@@ -85,12 +351,210 @@ at_err at_send_prompted(at_cmd command,
  *                      times should the handler be called on the unsolicited command arrival. When one wants to
  *                      keep the unsolicited handler be called to the end of the world then the handler shall always
  *                      return false. If one wants to implement a one shot handler then this function shall return
- *                      true on the first invocation.
+ *                      true on the first invocation. The handler is held in place, so its captures must fit into
+ *                      AT_CMD_HANDLER_CALLBACK_STORAGE_SIZE bytes, what is checked at compile time.
+ * \param[in] dispatch  Tells whether the handler is invoked immediately or deferred, see at_dispatch.
+ * \return The token which identifies the handler for at_unregister_unsolicited_handler(). It converts to false when
+ *         AT_CMD_HANDLER_MAX_UNSOLICITED_HANDLERS handlers are already registered.
  */
-void at_register_unsolicited_handler(at_cmd command,
-                                     std::function<bool(std::unique_ptr<std::string> response_payload)> handler);
+at_handler_token at_register_unsolicited_handler(at_cmd command,
+                                                 at_unsolicited_cmd_handler handler,
+                                                 at_dispatch dispatch = at_dispatch::immediate);
 
 //! Second overload which accepts unsolicited messages instead of commands (e.g. "RING", "NO CARRIER")
-void at_register_unsolicited_handler(at_unsolicited_msg unsolicited_msg, std::function<bool(void)> handler);
+at_handler_token at_register_unsolicited_handler(at_unsolicited_msg unsolicited_msg,
+                                                 at_unsolicited_msg_handler handler,
+                                                 at_dispatch dispatch = at_dispatch::immediate);
+
+/**
+ * \brief Register a handler which gets the typed values of the payload of the unsolicited command, parsed with the
+ *        schema of the command listed in AT_COMMANDS_PAYLOAD_SCHEMAS.
+ *
+ * E.g. for at_cmd_schema<at_cmd::first, int, int> the handler is bool(int, int). It returns true when it shall be
+ * removed, like the handler of at_register_unsolicited_handler(). The payloads which don't match the schema are
+ * ignored. The string fields view the payload, so they are valid only during the call.
+ *
+ * For the handlers known at build time, at_typed_static_handler() parses the payload in place, without copying it.
+ */
+template <at_cmd Command, typename Handler>
+at_handler_token at_register_typed_handler(Handler &&handler, at_dispatch dispatch = at_dispatch::immediate);
+
+/**
+ * \brief Removes the handler registered with at_register_unsolicited_handler(), so it's never invoked again. Takes
+ *        constant time and never waits.
+ *
+ * May be called from within any unsolicited handler, also the one being removed. An invocation in progress, e.g. of
+ * a deferred handler, isn't interrupted. The captures are released by the task which parses the responses, soon
+ * after the call, or after that invocation returns.
+ *
+ * \return False when the handler has been removed already, e.g. because it returned true.
+ */
+bool at_unregister_unsolicited_handler(at_handler_token token);
+
+/**
+ * \brief Blocks the calling task until the unsolicited command arrives, e.g. "+CEREG: 1" when the modem registers.
+ *
+ * Replaces polling with ask_fun_return_true(): the task sleeps until the receiver task notifies it about the arrival,
+ * so it doesn't wake up in between and there is no added latency. Only the arrivals after the call count. The
+ * handlers of the command are invoked as usual.
+ *
+ * The wait uses the task notification of the calling task, so the task mustn't wait on its notification meanwhile.
+ * Can't be called from an unsolicited handler, nor before the scheduler is started.
+ *
+ * \param[in] command       The awaited unsolicited command.
+ * \param[in] ticks_to_wait How long to wait for the command.
+ * \param[in] predicate     When set, then only the command which payload satisfies it ends the wait, e.g. the one
+ *                          which payload starts with "1" for "+CEREG: 1". It's invoked by the receiver task, on the
+ *                          payload in place.
+ * \param[out] payload      When set, then the payload of the command which ended the wait is copied here.
+ * \return False on timeout.
+ */
+bool at_wait_for_unsolicited(at_cmd command,
+                             TickType_t ticks_to_wait,
+                             at_payload_predicate predicate = {},
+                             at_string *payload = nullptr);
+
+//! Second overload which awaits an unsolicited message instead of a command (e.g. "RING", "NO CARRIER")
+bool at_wait_for_unsolicited(at_unsolicited_msg unsolicited_msg, TickType_t ticks_to_wait);
+
+/**
+ * \brief Drop the cached responses to the queries of the command, listed in AT_COMMANDS_CACHE_PROFILES.
+ *
+ * The queries are answered from the cache for their time to live and an unsolicited occurrence of the command (e.g.
+ * "+CREG: 5") drops them by itself. Call it when the state behind the query changes otherwise, e.g. after a write
+ * command. A query being sent meanwhile isn't cached.
+ */
+void at_invalidate_cached_responses(at_cmd command);
+
+/**
+ * \brief Get the numbers of the received lines dropped so far.
+ *
+ * Useful for sizing AT_CMD_HANDLER_RX_BUFLEN and AT_CMD_HANDLER_RX_LINES_NUM from field data. The counters only grow
+ * and may wrap around.
+ */
+at_rx_drop_stats at_get_rx_drop_stats();
+
+#if INCLUDE_uxTaskGetStackHighWaterMark == 1
+/**
+ * \brief Get the least free space, in words, which the stacks of the receiver task and the task of the deferred
+ *        handlers have ever had.
+ *
+ * Useful for sizing AT_CMD_HANDLER_RX_TASK_STACK_DEPTH and AT_CMD_HANDLER_URC_TASK_STACK_DEPTH from field data, once
+ * the unsolicited handlers have been exercised. Needs INCLUDE_uxTaskGetStackHighWaterMark in FreeRTOSConfig.h.
+ */
+at_stack_high_water_marks at_get_stack_high_water_marks();
+#endif /* INCLUDE_uxTaskGetStackHighWaterMark == 1 */
+
+#ifdef AT_CMD_HANDLER_LATENCY_STATS
+/**
+ * \brief Get the histogram of the latencies of the phase of the command. \see at_latency_phase
+ *
+ * The latencies are expressed in the units of hw_at_get_timestamp(). A command is recorded when its final result code
+ * arrives, so the commands which timed out are not included.
+ */
+const at_latency_histogram &at_get_latency_histogram(at_cmd command, at_latency_phase phase);
+
+void at_reset_latency_stats();
+
+/**
+ * \brief Print all the non-empty histograms, one line per each phase of each command.
+ *
+ * The line looks like: "AT+QIOPEN total: n=3 max=1234 b10=2 b11=1", where "bN" is the number of the latencies from the
+ * range [2^N, 2^(N+1)). The line is passed without the newline character.
+ */
+void at_dump_latency_stats(void (*print_line)(const char *line));
+#endif /* AT_CMD_HANDLER_LATENCY_STATS */
+
+#ifdef AT_CMD_HANDLER_STATS
+/**
+ * \brief Get the counters of the traffic, of the commands and of their results, e.g. to see why the throughput drops
+ *        in the field or to compare two configurations.
+ *
+ * It doesn't take any lock, so it can be called from any task, at any time. The counters only grow and may wrap
+ * around, so compare two snapshots, e.g. taken a minute apart. Each counter is read on its own, so the snapshot isn't
+ * consistent across the counters, e.g. a command may be counted as issued before its result is counted.
+ */
+at_stats at_get_stats();
+
+/**
+ * \brief Print the counters, a line per the non-zero command or unsolicited message.
+ *
+ * The lines look like: "rx=120 tx=48 lines=10 dropped=0 peak_rx=36 throttles=0 mux_waits=1 mux_ticks=2 mux_max=2",
+ * "results: ok=3 timeout=1" (named with at_err_to_string()), "AT+QGPS: issued=2 urcs=1" and "RDY: urcs=1".
+ * The line is passed without the newline character.
+ */
+void at_dump_stats(void (*print_line)(const char *line));
+#endif /* AT_CMD_HANDLER_STATS */
+
+#ifdef AT_CMD_HANDLER_CAPTURE_LEN
+/**
+ * \brief Pass the captured traffic of the port, the oldest record first, in at most two calls of write().
+ *
+ * The data is a sequence of the records: the timestamp from hw_at_get_timestamp() (four bytes), the number of the
+ * bytes (two bytes), the direction (one byte, 0 for RX, 1 for TX), all little endian, followed by the bytes. Store it
+ * as it is and read it with at_read_capture_record(), e.g. to replay a field session against the handler. The traffic
+ * which passes while it's exported isn't captured.
+ */
+void at_export_capture(void (*write)(const char *data, size_t len));
+
+void at_clear_capture();
+#endif /* AT_CMD_HANDLER_CAPTURE_LEN */
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF TEMPLATES
+// --------------------------------------------------------------------------------------------------------------------
+template <at_cmd Command>
+at_err at_send_typed(at_string &&payload,
+                     TickType_t ticks_to_wait,
+                     at_payload_values<Command> &values,
+                     at_priority priority)
+{
+    at_string pload;
+    auto res = at_send(Command, std::move(payload), ticks_to_wait, pload, priority);
+    return at_cmd_handler::parse_response<Command>(res, pload, values);
+}
+
+template <at_cmd Command>
+at_err at_send_typed(at_cmd_type command_type,
+                     TickType_t ticks_to_wait,
+                     at_payload_values<Command> &values,
+                     at_priority priority)
+{
+    at_string pload;
+    auto res = at_send(Command, command_type, ticks_to_wait, pload, priority);
+    return at_cmd_handler::parse_response<Command>(res, pload, values);
+}
+
+template <at_cmd Command, typename... Args>
+at_err at_send_write(TickType_t ticks_to_wait, at_string &response_payload, const Args &... args)
+{
+    return at_send_write<Command>(at_priority::normal, ticks_to_wait, response_payload, args...);
+}
+
+template <at_cmd Command, typename... Args> at_err at_send_write(TickType_t ticks_to_wait, const Args &... args)
+{
+    return at_send_write<Command>(at_priority::normal, ticks_to_wait, args...);
+}
+
+template <at_cmd Command, typename... Args>
+at_err at_send_write(at_priority priority, TickType_t ticks_to_wait, at_string &response_payload, const Args &... args)
+{
+    return at_send(
+        Command, at_cmd_handler::format_write_args<Command>(args...), ticks_to_wait, response_payload, priority);
+}
+
+template <at_cmd Command, typename... Args>
+at_err at_send_write(at_priority priority, TickType_t ticks_to_wait, const Args &... args)
+{
+    at_string dummy_pload;
+    return at_send_write<Command>(priority, ticks_to_wait, dummy_pload, args...);
+}
+
+template <at_cmd Command, typename Handler>
+at_handler_token at_register_typed_handler(Handler &&handler, at_dispatch dispatch)
+{
+    return at_register_unsolicited_handler(
+        Command, at_cmd_handler::make_typed_handler<Command>(std::forward<Handler>(handler)), dispatch);
+}
 
 #endif /* AT_CMD_HPP */
@@ -0,0 +1,168 @@
+/**
+ * @file	at_args.hpp
+ * @brief	Defines the signatures of the write commands, which format the typed arguments into the payload.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef AT_ARGS_HPP
+#define AT_ARGS_HPP
+
+#include "at_schema.hpp"
+#include <cstddef>
+#include <string_view>
+#include <type_traits>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS OF STRUCTURES, DATA TYPES, ...
+// --------------------------------------------------------------------------------------------------------------------
+
+/**
+ * \brief Formats a single argument of the parameter of the type T: tells which arguments it accepts, how many
+ *        characters the argument takes and writes them.
+ *
+ * Supports the integral types, the enums (formatted as their underlying values), quoted_string and unquoted_string,
+ * which accept anything convertible to std::string_view.
+ */
+template <typename T, typename = void> struct at_arg;
+
+template <typename T> struct at_arg<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+{
+    template <typename Arg>
+    static constexpr bool accepts = std::is_integral_v<Arg> && !std::is_same_v<Arg, bool> && !std::is_same_v<Arg, char>;
+
+    static constexpr size_t length(T value) noexcept
+    {
+        size_t len = value < 0 ? 2 : 1;
+        for (auto m = magnitude(value); m >= 10; m /= 10)
+            ++len;
+        return len;
+    }
+
+    //! Writes length() characters of the value to dst. Returns the end of the written characters.
+    static char *write(char *dst, T value) noexcept
+    {
+        auto dst_end = dst + length(value);
+        auto digit = dst_end;
+        auto m = magnitude(value);
+        do
+        {
+            *--digit = static_cast<char>('0' + m % 10);
+            m /= 10;
+        } while (m != 0);
+        if (value < 0)
+            *dst = '-';
+        return dst_end;
+    }
+
+  private:
+    using magnitude_type = std::make_unsigned_t<T>;
+
+    static constexpr magnitude_type magnitude(T value) noexcept
+    {
+        // The magnitude of the lowest value doesn't fit into T, so it's negated as unsigned.
+        return value < 0 ? static_cast<magnitude_type>(0 - static_cast<magnitude_type>(value))
+                         : static_cast<magnitude_type>(value);
+    }
+};
+
+template <typename T> struct at_arg<T, std::enable_if_t<std::is_enum_v<T>>>
+{
+    template <typename Arg> static constexpr bool accepts = std::is_same_v<Arg, T>;
+
+    using underlying = at_arg<std::underlying_type_t<T>>;
+
+    static constexpr size_t length(T value) noexcept
+    {
+        return underlying::length(static_cast<std::underlying_type_t<T>>(value));
+    }
+
+    static char *write(char *dst, T value) noexcept
+    {
+        return underlying::write(dst, static_cast<std::underlying_type_t<T>>(value));
+    }
+};
+
+template <> struct at_arg<unquoted_string>
+{
+    template <typename Arg> static constexpr bool accepts = std::is_convertible_v<const Arg &, std::string_view>;
+
+    static constexpr size_t length(std::string_view value) noexcept
+    {
+        return value.length();
+    }
+
+    static char *write(char *dst, std::string_view value) noexcept
+    {
+        return dst + value.copy(dst, value.length());
+    }
+};
+
+template <> struct at_arg<quoted_string>
+{
+    template <typename Arg> static constexpr bool accepts = at_arg<unquoted_string>::accepts<Arg>;
+
+    static constexpr size_t length(std::string_view value) noexcept
+    {
+        return value.length() + 2;
+    }
+
+    static char *write(char *dst, std::string_view value) noexcept
+    {
+        *dst++ = '"';
+        dst = at_arg<unquoted_string>::write(dst, value);
+        *dst++ = '"';
+        return dst;
+    }
+};
+
+/**
+ * \brief The signature of the write command: the types of its comma-separated parameters, e.g.
+ *        at_cmd_args<cmd::qiopen, int, int, quoted_string, quoted_string, int, int, int> for
+ *        AT+QIOPEN=1,0,"TCP","1.2.3.4",80,0,1.
+ *
+ * The command set lists the signatures as a tuple type named write_signatures. The arguments are validated against
+ * the signature at compile time and formatted into a string which is sized up front, so it's allocated at most once,
+ * without any intermediate strings.
+ */
+template <auto Command, typename... Params> struct at_cmd_args
+{
+    static_assert(sizeof...(Params) > 0, "The signature must have at least one parameter");
+
+    static constexpr auto command = Command;
+
+    //! Tells whether the arguments match the parameters, by their number and their types.
+    template <typename... Args> static constexpr bool is_valid = []() {
+        if constexpr (sizeof...(Args) != sizeof...(Params))
+            return false;
+        else
+            return (at_arg<Params>::template accepts<std::decay_t<Args>> && ...);
+    }();
+
+    //! Formats the arguments into a new String, e.g. at_string.
+    template <typename String, typename... Args> static String format(const Args &... args);
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PUBLIC MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <auto Command, typename... Params>
+template <typename String, typename... Args>
+String at_cmd_args<Command, Params...>::format(const Args &... args)
+{
+    static_assert(sizeof...(Args) == sizeof...(Params), "The number of the arguments doesn't match the signature");
+    static_assert((at_arg<Params>::template accepts<std::decay_t<Args>> && ...),
+                  "The type of an argument doesn't match the signature");
+
+    // Measure first, so the string is sized once, and then write the arguments in place.
+    size_t len = sizeof...(Params) - 1;
+    ((len += at_arg<Params>::length(args)), ...);
+
+    String s;
+    s.resize(len);
+    auto dst = s.data();
+    auto is_first = true;
+    ((dst = at_arg<Params>::write(is_first ? dst : (*dst = ',', dst + 1), args), is_first = false), ...);
+    return s;
+}
+
+#endif /* AT_ARGS_HPP */
@@ -0,0 +1,249 @@
+/**
+ * @file	at_capture.hpp
+ * @brief	Defines a ring which records the traffic of a port, so it can be exported and replayed later.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef AT_CAPTURE_HPP
+#define AT_CAPTURE_HPP
+
+#include "cyclic_buf.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS OF STRUCTURES, DATA TYPES, ...
+// --------------------------------------------------------------------------------------------------------------------
+
+enum class at_capture_direction : uint8_t
+{
+    //! Received from the device.
+    rx,
+
+    //! Transmitted to the device.
+    tx
+};
+
+//! A chunk of the traffic, which has been passed through the port in a single direction.
+struct at_capture_record
+{
+    at_capture_direction direction;
+
+    //! When the first byte of the chunk has been passed, in the units of the timestamps of the port.
+    uint32_t timestamp;
+
+    std::string_view bytes;
+};
+
+/**
+ * \brief Records the traffic of a port, in the RAM of the fixed size N, which must be a power of two. When there is no
+ *        space for the new bytes, then the oldest records are overwritten, so the latest traffic is always kept.
+ *
+ * The bytes passed in the same direction are appended to the same record, until end_record() is called (e.g. at the
+ * end of each received line or transmitted command) or the direction changes. Each record takes seven bytes more than
+ * its bytes: the timestamp (four bytes), the number of the bytes (two bytes) and the direction (one byte), all little
+ * endian. The records are held in that format, so they are exported as they are (\see at_read_capture_record()).
+ *
+ * This is not thread safe.
+ */
+template <size_t N> class at_capture_ring
+{
+    static_assert(is_power_of_two(N), "The size of the capture must be a power of two");
+
+  public:
+    static constexpr size_t header_len = 7;
+
+    static_assert(N > header_len, "The capture must fit at least a single record");
+
+    void append(at_capture_direction direction, uint32_t timestamp, const char *bytes, size_t num) noexcept;
+
+    //! Makes the next appended bytes start a new record.
+    void end_record() noexcept;
+
+    /**
+     * Passes the records to the sink, the oldest first, as at most two contiguous blocks: sink(const char *data,
+     * size_t len). The records mustn't be appended meanwhile.
+     */
+    template <typename Sink> void export_to(Sink &&sink) const;
+
+    //! The number of the bytes which export_to() passes.
+    size_t size() const noexcept;
+
+    //! The number of the records which have been overwritten by the newer ones.
+    unsigned get_num_overwritten() const noexcept;
+
+    void clear() noexcept;
+
+  private:
+    //! A record is limited, so it never takes the whole ring.
+    static constexpr size_t max_record_len = std::min<size_t>(UINT16_MAX, N / 2 - header_len);
+
+    static constexpr size_t mask = N - 1;
+
+    std::array<char, N> m_buf;
+
+    //! The counters of the bytes: the beginning of the oldest record and the end of the newest one. They only grow.
+    size_t m_tail = 0;
+    size_t m_head = 0;
+
+    //! The beginning of the record which the bytes are appended to.
+    size_t m_open_record = 0;
+    bool m_is_record_open = false;
+    at_capture_direction m_open_direction = at_capture_direction::rx;
+    size_t m_open_len = 0;
+
+    unsigned m_num_overwritten = 0;
+
+    void begin_record(at_capture_direction direction, uint32_t timestamp) noexcept;
+    void make_space(size_t len) noexcept;
+    void write(size_t pos, const char *bytes, size_t num) noexcept;
+    void write_len(size_t record, size_t len) noexcept;
+    char read(size_t pos) const noexcept;
+};
+
+/**
+ * \brief Reads the oldest record of the exported capture and removes it from the capture.
+ *
+ * The bytes of the record view the capture. Returns false when there is no whole record anymore.
+ */
+inline bool at_read_capture_record(std::string_view &capture, at_capture_record &record) noexcept;
+
+//! Used instead of at_capture_ring when the traffic isn't captured.
+struct at_no_capture
+{
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PUBLIC FUNCTIONS AND MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <size_t N>
+void at_capture_ring<N>::append(at_capture_direction direction,
+                                uint32_t timestamp,
+                                const char *bytes,
+                                size_t num) noexcept
+{
+    while (num > 0)
+    {
+        if (!m_is_record_open || m_open_direction != direction || m_open_len == max_record_len)
+            begin_record(direction, timestamp);
+
+        auto len = std::min(num, max_record_len - m_open_len);
+        make_space(len);
+        write(m_head, bytes, len);
+        m_head += len;
+        m_open_len += len;
+        write_len(m_open_record, m_open_len);
+        bytes += len;
+        num -= len;
+    }
+}
+
+template <size_t N> void at_capture_ring<N>::end_record() noexcept
+{
+    m_is_record_open = false;
+}
+
+template <size_t N> template <typename Sink> void at_capture_ring<N>::export_to(Sink &&sink) const
+{
+    if (m_head == m_tail)
+        return;
+
+    auto beg = m_tail & mask;
+    auto len = size();
+    auto len_to_end = std::min(len, N - beg);
+    sink(m_buf.data() + beg, len_to_end);
+    if (len_to_end < len)
+        sink(m_buf.data(), len - len_to_end);
+}
+
+template <size_t N> size_t at_capture_ring<N>::size() const noexcept
+{
+    return m_head - m_tail;
+}
+
+template <size_t N> unsigned at_capture_ring<N>::get_num_overwritten() const noexcept
+{
+    return m_num_overwritten;
+}
+
+template <size_t N> void at_capture_ring<N>::clear() noexcept
+{
+    m_tail = m_head;
+    m_is_record_open = false;
+    m_num_overwritten = 0;
+}
+
+inline bool at_read_capture_record(std::string_view &capture, at_capture_record &record) noexcept
+{
+    constexpr size_t header_len = 7;
+    if (capture.length() < header_len)
+        return false;
+
+    auto byte = [&capture](size_t i) { return static_cast<uint32_t>(static_cast<unsigned char>(capture[i])); };
+    auto len = static_cast<size_t>(byte(4) | byte(5) << 8);
+    if (capture.length() < header_len + len)
+        return false;
+
+    record.timestamp = byte(0) | byte(1) << 8 | byte(2) << 16 | byte(3) << 24;
+    record.direction = static_cast<at_capture_direction>(capture[6]);
+    record.bytes = capture.substr(header_len, len);
+    capture.remove_prefix(header_len + len);
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <size_t N> void at_capture_ring<N>::begin_record(at_capture_direction direction, uint32_t timestamp) noexcept
+{
+    make_space(header_len);
+    const char header[header_len]{static_cast<char>(timestamp),
+                                  static_cast<char>(timestamp >> 8),
+                                  static_cast<char>(timestamp >> 16),
+                                  static_cast<char>(timestamp >> 24),
+                                  0,
+                                  0,
+                                  static_cast<char>(direction)};
+    write(m_head, header, header_len);
+    m_open_record = m_head;
+    m_head += header_len;
+    m_is_record_open = true;
+    m_open_direction = direction;
+    m_open_len = 0;
+}
+
+template <size_t N> void at_capture_ring<N>::make_space(size_t len) noexcept
+{
+    // The open record is never overwritten, as it's limited to the half of the ring.
+    while (N - size() < len)
+    {
+        auto record_len = static_cast<size_t>(static_cast<unsigned char>(read(m_tail + 4)))
+                          | static_cast<size_t>(static_cast<unsigned char>(read(m_tail + 5))) << 8;
+        m_tail += header_len + record_len;
+        m_num_overwritten++;
+    }
+}
+
+template <size_t N> void at_capture_ring<N>::write(size_t pos, const char *bytes, size_t num) noexcept
+{
+    auto beg = pos & mask;
+    auto num_to_end = std::min(num, N - beg);
+    std::copy(bytes, bytes + num_to_end, m_buf.data() + beg);
+    std::copy(bytes + num_to_end, bytes + num, m_buf.data());
+}
+
+template <size_t N> void at_capture_ring<N>::write_len(size_t record, size_t len) noexcept
+{
+    const char len_bytes[2]{static_cast<char>(len), static_cast<char>(len >> 8)};
+    write(record + 4, len_bytes, 2);
+}
+
+template <size_t N> char at_capture_ring<N>::read(size_t pos) const noexcept
+{
+    return m_buf[pos & mask];
+}
+
+#endif /* AT_CAPTURE_HPP */
@@ -0,0 +1,3197 @@
+/**
+ * @file	at_channel.hpp
+ * @brief	Defines the template of the whole AT commands handling stack for a single serial port.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef AT_CHANNEL_HPP
+#define AT_CHANNEL_HPP
+
+#include "FreeRTOS.h"
+#include "at_capture.hpp"
+#include "at_cmd_handler_impl.hpp"
+#include "at_latency_stats.hpp"
+#include "at_os_objects.hpp"
+#include "at_response_cache.hpp"
+#include "at_stats.hpp"
+#include "os.h"
+#include "os_flag.hpp"
+#include "queue.h"
+#include "request_queue.hpp"
+#include "semphr.h"
+#include "string_buf_rx.hpp"
+#include "string_buf_tx.hpp"
+#include "task.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS OF STRUCTURES, DATA TYPES, ...
+// --------------------------------------------------------------------------------------------------------------------
+
+//! Determines how to terminate the prompted message (for AT commands which demand a message after receiving '>')
+enum class at_prompt_end_policy
+{
+    //! Terminate with CTRL-Z character
+    ctrl_z,
+
+    //! Terminate normally with CRLF after sending the whole message.
+    crlf,
+
+    //! Send nothing after the message, for the commands which are given its length, e.g. AT+QISEND=<id>,<len>.
+    none
+};
+
+/**
+ * The priority of a command. A queued command with a higher priority is sent before the queued ones with a lower
+ * priority, but a command is overtaken a limited number of times (AT_CMD_HANDLER_MAX_OVERTAKES), so the commands
+ * with a lower priority aren't starved.
+ */
+enum class at_priority
+{
+    //! E.g. the bulk data transfers.
+    normal,
+
+    //! E.g. the power management commands. One slot of the queue is reserved for them, so they never wait for a free
+    //! slot behind the commands with the normal priority.
+    urgent
+};
+
+/**
+ * Pass it as ticks_to_wait to wait as long as the timeout profile of the command tells, e.g. 180 s for "AT+COPS=?".
+ * \see at_timeout_profile
+ */
+constexpr TickType_t at_profile_timeout = portMAX_DELAY - 1;
+
+//! The least free space, in words, which the stacks of the tasks of the channel have ever had.
+struct at_stack_high_water_marks
+{
+    UBaseType_t rx_task;
+
+    //! Zero when there is no task for the deferred handlers.
+    UBaseType_t urc_task;
+};
+
+//! Identifies a command issued with at_send_async().
+struct at_async_handle
+{
+    //! Not meaningful for the user; zero means that the command couldn't be issued.
+    unsigned id = 0;
+
+    bool is_valid() const
+    {
+        return id != 0;
+    }
+};
+
+//! The numbers of the received lines which have been dropped, because there was no space for them.
+struct at_rx_drop_stats
+{
+    //! Dropped because the RX buffer (AT_CMD_HANDLER_RX_BUFLEN) had no space for the characters.
+    unsigned on_buffer_overflow;
+
+    //! Dropped because AT_CMD_HANDLER_RX_LINES_NUM - 1 lines were already waiting for the handling.
+    unsigned on_lines_overflow;
+
+    //! The unsolicited commands and messages dropped because AT_CMD_HANDLER_URC_QUEUE_LEN ones awaited their deferred
+    //! handlers.
+    unsigned on_urc_queue_overflow;
+
+    //! The characters, not the lines, dropped because the RX stream (AT_CMD_HANDLER_RX_STREAM_LEN) was full.
+    unsigned on_rx_stream_overflow;
+};
+
+//! Invoked when an asynchronous command is done. Takes the result of the command and the payload of the response.
+using at_async_completion = std::function<void(at_err result, at_string &&response_payload)>;
+
+//! The buffer for the raw bytes of the response which follow a header with their number. \see at_send_binary_read()
+struct at_binary_rx
+{
+    /**
+     * The beginning of the line which carries the number of the bytes, e.g. "+QIRD" for "+QIRD: 1460" or "CONNECT"
+     * for "CONNECT 1024". Must be valid until the command is done.
+     */
+    std::string_view header;
+    char *data = nullptr;
+    size_t capacity = 0;
+
+    //! Set when the command is done: the number of the bytes stored in data.
+    size_t received_len = 0;
+};
+
+/**
+ * \brief The packets sent through a socket by a single task, e.g. with AT+QISEND=<id>,<len> or AT+CIPSEND=<id>,<len>.
+ *        \see at_send_data()
+ *
+ * The device takes the next command only after it has acknowledged the data of the previous one, so the packets are
+ * queued up to the window and each one is transmitted by the receiver task as soon as the previous one is
+ * acknowledged, instead of after a round trip to the issuer. The fields of the profile may be changed only while no
+ * packet is in flight.
+ */
+struct at_data_stream
+{
+    //! The line which acknowledges a packet, matched at its beginning or at its end, e.g. "SEND OK" (also for
+    //! "0, SEND OK"), "+QISEND:" or "DATA ACCEPT:". It completes the command, as no "OK" follows.
+    std::string_view ack = "SEND OK";
+
+    //! The line which rejects a packet, matched the same way. Empty when the device reports only "ERROR".
+    std::string_view failure = "SEND FAIL";
+
+    at_prompt_end_policy policy = at_prompt_end_policy::none;
+
+    //! How many packets may await their acknowledgements at once, at most Config::cmd_queue_len.
+    size_t max_packets_in_flight = 1;
+
+    //! How many bytes may await their acknowledgements at once, e.g. the send buffer of the device. Zero means no
+    //! limit. A bigger packet is sent alone.
+    size_t max_bytes_in_flight = 0;
+
+    // The state of the stream, maintained by the channel.
+    unsigned sent_num = 0;
+    unsigned collected_num = 0;
+    size_t bytes_in_flight = 0;
+
+    //! The first failure of the collected packets, reported by the next call.
+    at_err error = at_err::ok;
+};
+
+//! Determines what to do with the rest of a batch, when one of its commands fails. \see at_send_batch()
+enum class at_batch_policy
+{
+    stop_on_error,
+    continue_on_error
+};
+
+//! A single command of a batch, along with its outcome. \see at_send_batch()
+template <typename Cmd> struct at_basic_batch_entry
+{
+    Cmd command;
+    at_cmd_type command_type;
+
+    //! The payload of the write AT command. Shall be empty for the other command types.
+    at_string payload;
+
+    //! Set when the command is done. at_err::unknown means that the command hasn't been sent.
+    at_err result = at_err::unknown;
+    at_string response_payload;
+};
+
+//! Consumes the payload of a response line by line, as the lines arrive. \see at_send_streamed()
+using at_payload_sink = std::function<void(std::string_view line)>;
+
+namespace jungles {
+
+/**
+ * \brief Defines all the members of the Config of at_channel, for a plain channel: no optional feature is enabled.
+ *
+ * A Config derives from it and overrides only the members which differ, e.g.:
+ *
+ *     struct gnss_config : at_channel_default_config
+ *     {
+ *         static constexpr size_t rx_buf_len = 128;
+ *         static constexpr const char *rx_task_name = "gnss_rx";
+ *     };
+ */
+struct at_channel_default_config
+{
+    static constexpr size_t rx_buf_len = 256;
+    static constexpr size_t rx_lines_num = 16;
+    static constexpr size_t cmd_queue_len = 4;
+    static constexpr unsigned max_overtakes = 4;
+    static constexpr bool is_tx_dma = false;
+    static constexpr bool is_no_newline_after_prompt = false;
+    static constexpr bool is_prompt_from_isr = false;
+    static constexpr bool is_latency_stats = false;
+    static constexpr bool is_single_flight = false;
+    static constexpr bool is_echo_suppressed = false;
+    static constexpr size_t rx_rts_high_watermark = 0;
+    static constexpr size_t rx_rts_low_watermark = 0;
+    static constexpr TickType_t tx_gather_ticks = 0;
+    static constexpr bool is_wake_line = false;
+    static constexpr bool is_stats = false;
+    static constexpr size_t capture_len = 0;
+    static constexpr size_t rx_stream_len = 0;
+    static constexpr size_t rx_stream_trigger_level = 0;
+    static constexpr const char *rx_task_name = "at_rx";
+    static constexpr configSTACK_DEPTH_TYPE rx_task_stack_depth = 1024;
+    static constexpr UBaseType_t rx_task_priority = 1;
+    static constexpr UBaseType_t rx_task_core_affinity = at_no_core_affinity;
+    static constexpr size_t urc_queue_len = 0;
+    static constexpr const char *urc_task_name = "at_urc";
+    static constexpr configSTACK_DEPTH_TYPE urc_task_stack_depth = 1024;
+    static constexpr UBaseType_t urc_task_priority = 1;
+    static constexpr UBaseType_t urc_task_core_affinity = at_no_core_affinity;
+};
+
+/**
+ * \brief The whole stack which handles AT commands on a single serial port: the RX and TX buffers, the queue of the
+ *        commands and the task which receives the responses.
+ *
+ * Each port (e.g. one for a cellular modem and one for a GNSS module) gets its own instance with its own CommandSet
+ * (\see at_cmd_handler). The instances don't share any state, so they don't block each other.
+ *
+ * The Hal must provide the static functions which drive the port:
+ *  - void enable_rx_it(), called from the receiver task when it starts,
+ *  - void enable_tx_it() and void disable_tx_it(), for the byte by byte transmission from the TX interrupt,
+ *  - void send_byte(char c), called from the TX interrupt,
+ *  - void send_block(const char *data, size_t len), needed only when Config::is_tx_dma is set,
+ *  - uint32_t get_timestamp(), needed only when Config::is_latency_stats is set or Config::capture_len isn't zero.
+ *    It's called also from the interrupts. Any unit can be used, e.g. microseconds from a free-running timer,
+ *  - void assert_rts() and void release_rts(), needed only when Config::rx_rts_high_watermark isn't zero. The RTS
+ *    line is released (the device shall stop sending) from the RX interrupt and asserted again by the receiver task,
+ *    within a critical section, and when the task starts,
+ *  - void wake_device() and void allow_device_sleep(), needed only when Config::is_wake_line is set. The device is
+ *    woken up (e.g. with its DTR or wake-up pin) before a command is transmitted while it sleeps and let sleep again
+ *    after the final result code of the last queued command. Both are called by a task, with the mutex of the channel
+ *    taken, so wake_device() shall return as soon as the device may receive,
+ *
+ * The Config must provide the static constexpr members below. It may derive from at_channel_default_config, which
+ * defines all of them, and override only the ones it needs:
+ *  - size_t rx_buf_len and size_t rx_lines_num, which size the RX buffer (\see string_buf_rx). Both must be powers of
+ *    two, and the buffer holds at most one less of the characters and of the lines,
+ *  - size_t cmd_queue_len, the number of the commands which can be queued at once, besides the slot reserved for the
+ *    urgent commands,
+ *  - unsigned max_overtakes, how many times a queued command may be overtaken by the commands with a higher priority,
+ *  - bool is_tx_dma, set to transmit whole blocks with Hal::send_block(),
+ *  - bool is_no_newline_after_prompt, set when the device doesn't send a newline after the prompt character,
+ *  - bool is_prompt_from_isr, set to transmit the prompted message right from the RX interrupt which receives the
+ *    prompt character. Needs is_no_newline_after_prompt, as then the prompt is recognised by the RX buffer,
+ *  - bool is_latency_stats, set to measure the latencies of the phases of the commands (\see at_latency_phase),
+ *  - bool is_single_flight, set to send the EXEC, READ and TEST commands issued by multiple tasks at once only once:
+ *    the issuers which come while the command is queued or in flight get a copy of its result and payload,
+ *  - bool is_echo_suppressed, set when the device may echo what it receives (e.g. in ATE1, after its reset): the RX
+ *    buffer matches the received characters against the transmitted command or message and discards the echo, so it
+ *    never reaches the receiver task. Otherwise only the lines which start with "AT" are discarded as the echoes,
+ *    while e.g. the echo of a prompted message would be taken for the payload,
+ *  - size_t rx_rts_high_watermark and size_t rx_rts_low_watermark, the numbers of the characters held by the RX
+ *    buffer at which the device is stopped with RTS and let go again, once the receiver task has handled the lines.
+ *    The device is stopped only while there is a whole line to handle, so a line longer than the high watermark
+ *    doesn't stop it for good. Leave room above the high watermark for the characters which the device sends before
+ *    it reacts to RTS. Zero high watermark means that there is no flow control,
+ *  - TickType_t tx_gather_ticks, how long the commands with the normal priority are held, when the first of them comes
+ *    while the device sleeps, so all the commands issued meanwhile are transmitted within a single wake cycle. An
+ *    urgent command, or the queue getting full, transmits the held ones right away. The window counts towards
+ *    ticks_to_wait of the issuers. Zero means that the commands are transmitted as they come,
+ *  - bool is_wake_line, set to wake the device up with Hal::wake_device() before each wake cycle and let it sleep with
+ *    Hal::allow_device_sleep() after it,
+ *  - bool is_stats, set to count the traffic, the commands and their results (\see at_stats),
+ *  - size_t capture_len, the size of the ring which records the latest traffic of the port, in both directions, with
+ *    the timestamps (\see at_capture_ring). It must be a power of two; zero means that the traffic isn't captured,
+ *  - size_t rx_stream_len and size_t rx_stream_trigger_level. When rx_stream_len isn't zero, the RX interrupt only
+ *    copies the received characters to a FreeRTOS stream buffer of that size, and the receiver task splits them into
+ *    the lines in bulk, so neither the terminators nor the echoes are matched within the interrupt. The task is woken
+ *    by each chunk passed to it_handle_bytes_rx(), by it_handle_byte_rx() on a newline (or the prompt character, with
+ *    is_no_newline_after_prompt) and whenever trigger_level characters await. The characters which don't fit are
+ *    dropped. Neither RTS flow control nor is_prompt_from_isr can be used then. The traffic is captured by the task,
+ *  - const char *rx_task_name, configSTACK_DEPTH_TYPE rx_task_stack_depth, UBaseType_t rx_task_priority and
+ *    UBaseType_t rx_task_core_affinity, the mask of the cores which may run the task on a FreeRTOS SMP build (with
+ *    configUSE_CORE_AFFINITY set) or at_no_core_affinity. It's ignored by the single core builds,
+ *  - size_t urc_queue_len, the number of the unsolicited commands and messages which can await their deferred
+ *    handlers (\see at_dispatch). Zero means that there is no task for the deferred handlers,
+ *  - const char *urc_task_name, configSTACK_DEPTH_TYPE urc_task_stack_depth, UBaseType_t urc_task_priority and
+ *    UBaseType_t urc_task_core_affinity, used only when urc_queue_len isn't zero.
+ *
+ * The interrupt handlers of the port shall call the it_handle_*() methods.
+ */
+template <typename CommandSet, typename Hal, typename Config> class at_channel
+{
+    static_assert(is_power_of_two(Config::rx_buf_len) && Config::rx_buf_len > 1,
+                  "Config::rx_buf_len must be a power of two");
+    static_assert(is_power_of_two(Config::rx_lines_num) && Config::rx_lines_num > 1,
+                  "Config::rx_lines_num must be a power of two");
+    static_assert(!Config::is_prompt_from_isr || Config::is_no_newline_after_prompt,
+                  "The prompt is recognised within the interrupt only when it isn't followed by a newline");
+    static_assert(Config::rx_rts_high_watermark == 0
+                      || (Config::rx_rts_low_watermark < Config::rx_rts_high_watermark
+                          && Config::rx_rts_high_watermark < Config::rx_buf_len),
+                  "The watermarks must lie within the RX buffer, the low one below the high one");
+    static_assert(Config::rx_stream_len == 0
+                      || (Config::rx_rts_high_watermark == 0 && !Config::is_prompt_from_isr
+                          && Config::rx_stream_trigger_level > 0
+                          && Config::rx_stream_trigger_level <= Config::rx_stream_len),
+                  "The RX stream excludes the work within the RX interrupt and triggers within its size");
+
+  public:
+    using cmd_handler_type = at_cmd_handler<CommandSet>;
+    using cmd = typename cmd_handler_type::cmd;
+    using unsolicited_msg = typename cmd_handler_type::unsolicited_msg;
+    using batch_entry = at_basic_batch_entry<cmd>;
+    template <cmd Command> using payload_values = typename cmd_handler_type::template payload_values<Command>;
+    using stats_snapshot =
+        at_basic_stats<to_u_type(cmd::number_of_commands), to_u_type(unsolicited_msg::number_of_msgs)>;
+
+    at_channel() = default;
+    at_channel(const at_channel &) = delete;
+    at_channel &operator=(const at_channel &) = delete;
+
+    //! Creates the receiver task and the OS objects. Must be called before any command is sent.
+    void init();
+    void deinit();
+
+    /**
+     * \brief Creates the OS objects without the receiver task: the lines are handled by the task of the started
+     *        dispatcher instead, which serves multiple channels. \see at_rx_dispatcher
+     *
+     * Then the Config::rx_task_* members are ignored and deinit() must be given the same dispatcher. With
+     * configSUPPORT_STATIC_ALLOCATION set the channel still holds the stack of its receiver task, unless
+     * rx_task_stack_depth is zero.
+     */
+    template <typename Dispatcher> void init(Dispatcher &dispatcher);
+    template <typename Dispatcher> void deinit(Dispatcher &dispatcher);
+
+    //! \see at_send()
+    at_err send(cmd command,
+                at_string &&payload,
+                TickType_t ticks_to_wait,
+                at_string &response_payload,
+                at_priority priority = at_priority::normal);
+    at_err
+    send(cmd command, at_string &&payload, TickType_t ticks_to_wait, at_priority priority = at_priority::normal);
+    at_err send(cmd command,
+                at_cmd_type command_type,
+                TickType_t ticks_to_wait,
+                at_string &response_payload,
+                at_priority priority = at_priority::normal);
+    at_err
+    send(cmd command, at_cmd_type command_type, TickType_t ticks_to_wait, at_priority priority = at_priority::normal);
+    at_err send(cmd command,
+                at_string &&payload,
+                TickType_t ticks_to_wait,
+                at_line_list &response_lines,
+                at_priority priority = at_priority::normal);
+    at_err send(cmd command,
+                at_cmd_type command_type,
+                TickType_t ticks_to_wait,
+                at_line_list &response_lines,
+                at_priority priority = at_priority::normal);
+
+    //! \see at_send_typed()
+    template <cmd Command>
+    at_err send_typed(at_string &&payload,
+                      TickType_t ticks_to_wait,
+                      payload_values<Command> &values,
+                      at_priority priority = at_priority::normal);
+    template <cmd Command>
+    at_err send_typed(at_cmd_type command_type,
+                      TickType_t ticks_to_wait,
+                      payload_values<Command> &values,
+                      at_priority priority = at_priority::normal);
+
+    //! \see at_send_write()
+    template <cmd Command, typename... Args>
+    at_err send_write(TickType_t ticks_to_wait, at_string &response_payload, const Args &... args);
+    template <cmd Command, typename... Args> at_err send_write(TickType_t ticks_to_wait, const Args &... args);
+    template <cmd Command, typename... Args>
+    at_err
+    send_write(at_priority priority, TickType_t ticks_to_wait, at_string &response_payload, const Args &... args);
+    template <cmd Command, typename... Args>
+    at_err send_write(at_priority priority, TickType_t ticks_to_wait, const Args &... args);
+
+    //! \see at_send_streamed()
+    at_err send_streamed(cmd command, at_string &&payload, TickType_t ticks_to_wait, at_payload_sink sink);
+    at_err send_streamed(cmd command, at_cmd_type command_type, TickType_t ticks_to_wait, at_payload_sink sink);
+
+    //! \see at_send_binary_read()
+    at_err send_binary_read(cmd command,
+                            at_string &&payload,
+                            TickType_t ticks_to_wait,
+                            at_binary_rx &binary,
+                            at_string &response_payload);
+
+    //! \see at_send_batch()
+    at_err send_batch(batch_entry *entries, size_t entries_num, at_batch_policy policy, TickType_t ticks_to_wait);
+
+    //! \see at_send_prompted()
+    at_err send_prompted(cmd command,
+                         at_string payload,
+                         at_string prompt_message,
+                         at_prompt_end_policy policy,
+                         TickType_t ticks_to_wait);
+    at_err send_prompted(cmd command,
+                         at_string payload,
+                         const char *prompt_data,
+                         size_t prompt_len,
+                         at_prompt_end_policy policy,
+                         TickType_t ticks_to_wait);
+
+    //! \see at_send_data()
+    at_err send_data(at_data_stream &stream,
+                     cmd command,
+                     at_string &&payload,
+                     const char *data,
+                     size_t len,
+                     TickType_t ticks_to_wait);
+
+    //! \see at_flush_data()
+    at_err flush_data(at_data_stream &stream, TickType_t ticks_to_wait);
+
+    //! \see at_send_async()
+    at_async_handle send_async(cmd command,
+                               at_cmd_type command_type,
+                               at_string &&payload,
+                               at_async_completion completion,
+                               at_priority priority = at_priority::normal);
+    at_async_handle send_async(cmd command,
+                               at_cmd_type command_type,
+                               at_string &&payload,
+                               os_flag &done_flag,
+                               at_priority priority = at_priority::normal);
+
+    //! \see at_get_async_result()
+    at_err get_async_result(at_async_handle handle, at_string &response_payload);
+
+    //! \see at_abort_async()
+    bool abort_async(at_async_handle handle);
+
+    //! \see at_register_unsolicited_handler()
+    at_handler_token register_unsolicited_handler(cmd command,
+                                                  at_unsolicited_cmd_handler handler,
+                                                  at_dispatch dispatch = at_dispatch::immediate);
+    at_handler_token register_unsolicited_handler(unsolicited_msg message,
+                                                  at_unsolicited_msg_handler handler,
+                                                  at_dispatch dispatch = at_dispatch::immediate);
+
+    //! \see at_register_typed_handler()
+    template <cmd Command, typename Handler>
+    at_handler_token register_typed_handler(Handler &&handler, at_dispatch dispatch = at_dispatch::immediate);
+
+    //! \see at_unregister_unsolicited_handler()
+    bool unregister_unsolicited_handler(at_handler_token token);
+
+    //! \see at_wait_for_unsolicited()
+    bool wait_for_unsolicited(cmd command,
+                              TickType_t ticks_to_wait,
+                              at_payload_predicate predicate = {},
+                              at_string *payload = nullptr);
+    bool wait_for_unsolicited(unsolicited_msg message, TickType_t ticks_to_wait);
+
+    //! \see at_invalidate_cached_responses()
+    void invalidate_cached_responses(cmd command);
+
+    //! \see at_get_rx_drop_stats()
+    at_rx_drop_stats get_rx_drop_stats();
+
+    //! \see at_get_stack_high_water_marks()
+    at_stack_high_water_marks get_stack_high_water_marks() const;
+
+    //! \see at_get_latency_histogram()
+    const at_latency_histogram &get_latency_histogram(cmd command, at_latency_phase phase) const;
+
+    //! \see at_reset_latency_stats()
+    void reset_latency_stats();
+
+    //! \see at_dump_latency_stats()
+    void dump_latency_stats(void (*print_line)(const char *line)) const;
+
+    //! \see at_get_stats()
+    stats_snapshot get_stats() const;
+
+    //! \see at_dump_stats()
+    void dump_stats(void (*print_line)(const char *line)) const;
+
+    //! \see at_export_capture()
+    void export_capture(void (*write)(const char *data, size_t len));
+
+    //! \see at_clear_capture()
+    void clear_capture();
+
+    // ----------------------------------------------------------------------------------------------------------------
+    // The interrupt handlers
+    // ----------------------------------------------------------------------------------------------------------------
+    //! Call it from the RX interrupt for each received byte.
+    void it_handle_byte_rx(char c);
+
+    //! Call it from the RX interrupt which receives multiple bytes at once, e.g. on the DMA/idle-line interrupt.
+    void it_handle_bytes_rx(const char *bytes, size_t num);
+
+    //! Call it from the TX interrupt, when the next byte can be sent.
+    void it_handle_byte_tx();
+
+    //! Call it from the interrupt which notifies the end of the transmission started by Hal::send_block().
+    void it_handle_block_tx_done();
+
+    // The interface of the shared receiver task, used by at_rx_dispatcher.
+
+    /**
+     * \brief Handles at most max_lines_num of the received lines. is_drained is cleared when some lines are left.
+     * \returns how long the task may sleep before it shall call this again, even when no line arrives.
+     */
+    TickType_t handle_received_lines(unsigned max_lines_num, bool &is_drained);
+
+  private:
+    // ----------------------------------------------------------------------------------------------------------------
+    // Private types
+    // ----------------------------------------------------------------------------------------------------------------
+    struct prompt_msg
+    {
+        at_prompt_end_policy policy;
+        at_string prompt_message;
+
+        //! When set, then the message is transmitted straight from the buffer of the issuer, instead of prompt_message.
+        std::string_view borrowed_message;
+        bool is_borrowed = false;
+        bool valid = false;
+
+        void set(at_prompt_end_policy prompt_end_policy, at_string &&message)
+        {
+            policy = prompt_end_policy;
+            prompt_message = std::move(message);
+            valid = true;
+        }
+
+        void set_borrowed(at_prompt_end_policy prompt_end_policy, std::string_view message)
+        {
+            policy = prompt_end_policy;
+            borrowed_message = message;
+            is_borrowed = true;
+            valid = true;
+        }
+    };
+
+    //! The optional parts of a request.
+    struct request_options
+    {
+        //! When set, then each line of the payload is passed to it instead of being accumulated.
+        at_payload_sink sink;
+
+        //! When set, then the RX buffer is switched into the binary mode for the response.
+        at_binary_rx *binary = nullptr;
+
+        //! When set, then the request stands for all the commands of the batch, which are sent one after another.
+        batch_entry *batch = nullptr;
+        size_t batch_len = 0;
+        at_batch_policy batch_policy = at_batch_policy::stop_on_error;
+
+        at_priority priority = at_priority::normal;
+
+        //! When set, then the request is a packet of the stream, completed by its acknowledgement and collected by
+        //! the issuer of the stream, in the order of data_seq.
+        at_data_stream *data_stream = nullptr;
+        unsigned data_seq = 0;
+
+        //! Set when the request occupies the slot reserved for the urgent commands.
+        bool is_reserved_slot = false;
+    };
+
+    //! A single command queued for transmission. Carries everything needed to complete it and to wake up its issuer.
+    struct request
+    {
+        cmd command = cmd::none;
+        //! Refers to the prefix generated at compile time.
+        std::string_view prefix;
+        at_string payload;
+        prompt_msg prompt;
+
+        //! The payload of the response is accumulated directly here, by the receiver task, along with the places of
+        //! its lines.
+        at_line_list response_payload;
+        at_err result = at_err::unknown;
+
+        request_options options;
+
+        //! The index of the entry of the batch in flight.
+        size_t batch_idx = 0;
+
+        //! The number of the lines received while the request is in flight, so its issuer can tell a stalled response.
+        unsigned lines_num = 0;
+        bool is_done = false;
+
+        //! Set when the command hasn't fit into the TX buffer, so the receiver task fails it with at_err::tx_overflow.
+        bool is_tx_overflowed = false;
+
+        //! Set by the receiver task while it passes a line to the sink without the lock, as the issuer owns the sink.
+        //! The issuer, which returns meanwhile, sets is_sink_awaited and awaits the end of the call on done_sem.
+        bool is_sink_running = false;
+        bool is_sink_awaited = false;
+
+        //! Identifies the request for at_async_handle. Zero when the slot is free.
+        unsigned id = 0;
+
+        //! Given by the receiver task when the final result code arrives. Only the issuer of the request waits on it.
+        SemaphoreHandle_t done_sem = nullptr;
+        at_semaphore_memory done_sem_memory;
+
+        //! When set, then the request has been issued asynchronously and the issuer doesn't wait on done_sem.
+        bool is_async = false;
+
+        //! Invoked by the receiver task on completion of an asynchronous request, if set.
+        at_async_completion completion;
+
+        //! Set by the receiver task on completion of an asynchronous request, if given.
+        os_flag *done_flag = nullptr;
+
+        //! Used only when the latencies are measured.
+        uint32_t enqueued_timestamp = 0;
+        uint32_t tx_started_timestamp = 0;
+    };
+
+    //! The completion of an asynchronous request, taken under m_requests_mux and invoked once it has been released.
+    struct pending_completion
+    {
+        request *req = nullptr;
+        at_async_completion completion;
+        at_err result = at_err::unknown;
+        at_string response_payload;
+    };
+
+    using latency_stats_type = std::conditional_t<Config::is_latency_stats,
+                                                  at_latency_stats<to_u_type(cmd::number_of_commands)>,
+                                                  at_no_latency_stats>;
+
+    using stats_type = std::conditional_t<Config::is_stats,
+                                          at_stats_counters<to_u_type(cmd::number_of_commands),
+                                                   to_u_type(unsolicited_msg::number_of_msgs)>,
+                                          at_no_stats>;
+
+    //! Takes m_requests_mux for the scope. Counts the waits for it, when Config::is_stats is set.
+    class requests_guard
+    {
+      public:
+        explicit requests_guard(at_channel &channel) noexcept;
+        requests_guard(const requests_guard &) = delete;
+        requests_guard &operator=(const requests_guard &) = delete;
+        ~requests_guard();
+
+      private:
+        at_channel &m_channel;
+    };
+
+    using capture_type = std::conditional_t<(Config::capture_len > 0),
+                                            at_capture_ring<Config::capture_len>,
+                                            at_no_capture>;
+
+    //! An unsolicited command or message passed to the URC task. It's copied byte by byte by the OS queue.
+    struct deferred_urc
+    {
+        at_handler_token token;
+
+        //! Owned by the queue, released from at_payload_ptr. Null for an unsolicited message and a coalesced handler.
+        at_string *payload;
+    };
+
+    static constexpr bool is_urc_task = Config::urc_queue_len > 0;
+
+    static constexpr bool is_rx_flow_control = Config::rx_rts_high_watermark > 0;
+
+    static constexpr bool is_rx_stream = Config::rx_stream_len > 0;
+
+    //! How many characters the receiver task takes from the RX stream at once.
+    static constexpr size_t rx_stream_chunk_len = 32;
+
+    static constexpr bool is_tx_gathered = Config::tx_gather_ticks > 0;
+
+    //! A task blocked in wait_for_unsolicited(). Lies on the stack of the task, linked into the list of the waiters.
+    struct unsolicited_waiter
+    {
+        //! unsolicited_msg::none when a command is awaited, cmd::none when a message is awaited.
+        cmd command = cmd::none;
+        unsolicited_msg message = unsolicited_msg::none;
+
+        const at_payload_predicate *predicate = nullptr;
+        at_string *payload = nullptr;
+        TaskHandle_t task = nullptr;
+
+        //! Set by the receiver task, which unlinks the waiter then.
+        bool is_matched = false;
+        unsolicited_waiter *next = nullptr;
+    };
+
+    using response_cache_type = at_response_cache<cmd, std::size(cmd_handler_type::cache_profiles), at_string>;
+
+    static constexpr bool is_response_cache = std::size(cmd_handler_type::cache_profiles) > 0;
+
+    //! A task which awaits the response to the query sent by another task. Lies on the stack of the task.
+    struct flight_waiter
+    {
+        at_string *payload = nullptr;
+        at_err result = at_err::timeout;
+        TaskHandle_t task = nullptr;
+
+        //! Set by the sender of the query, which unlinks the waiter then.
+        bool is_done = false;
+        flight_waiter *next = nullptr;
+    };
+
+    //! A query sent by a task, which the other issuers of the same query await. Lies on the stack of the sender.
+    struct flight
+    {
+        cmd command = cmd::none;
+        at_cmd_type command_type = at_cmd_type::exec;
+        flight_waiter *waiters = nullptr;
+        flight *next = nullptr;
+    };
+
+    static constexpr std::string_view crlf_str{"\r\n"};
+    static constexpr std::string_view ctrl_z_str{"\x1A"};
+
+    /**
+     * A single transmission consists of at most 4 segments: the prefix, the payload, the suffix and CRLF. There is
+     * space for two transmissions, because a withdrawn command may be still being transmitted when the next one
+     * starts. The prompted message, which the RX interrupt pushes behind its command, takes 3 of them.
+     */
+    static constexpr size_t command_segments_num = 4;
+    static constexpr size_t prompt_segments_num = 3;
+    static constexpr size_t tx_segments_num = 8;
+    static_assert(tx_segments_num >= command_segments_num + prompt_segments_num,
+                  "The prompted message must fit into the TX buffer behind its command");
+
+    //! The bound of the wait for the block in progress, when the borrowed transmission is stopped. It's far more than
+    //! the transmission of any block takes, so it only passes when the UART is stuck.
+    static constexpr TickType_t tx_block_done_ticks = pdMS_TO_TICKS(1000);
+
+    // ----------------------------------------------------------------------------------------------------------------
+    // Private variables
+    // ----------------------------------------------------------------------------------------------------------------
+    cmd_handler_type m_cmd_handler;
+
+    //! When the device doesn't send a newline after the prompt character, then a single '>' is a whole line.
+    std::conditional_t<Config::is_no_newline_after_prompt,
+                       string_buf_rx<Config::rx_buf_len, Config::rx_lines_num, '>'>,
+                       string_buf_rx<Config::rx_buf_len, Config::rx_lines_num>>
+        m_rx_buf;
+    string_buf_tx<tx_segments_num, at_string> m_tx_buf;
+
+    //! Set while a block is being transmitted. Modified only within a critical section or the TX done interrupt.
+    volatile bool m_is_tx_block_in_progress = false;
+
+    //! Set while a task awaits the end of the block in progress, which the TX done interrupt signals with
+    //! m_tx_block_done_sem. Modified only within a critical section or the TX done interrupt.
+    volatile bool m_is_awaiting_tx_block_done = false;
+    SemaphoreHandle_t m_tx_block_done_sem = nullptr;
+    at_semaphore_memory m_tx_block_done_sem_memory;
+
+    //! Set when the TX buffer may reference the message of the request in flight. Guarded by m_requests_mux.
+    bool m_is_tx_borrowed = false;
+
+    //! A hint for the receiver task that the request in flight hasn't fit into the TX buffer. Set with m_requests_mux
+    //! taken, cleared by the receiver task.
+    volatile bool m_is_tx_overflowed = false;
+
+    /*
+     * The prompted message of the request in flight, waiting for the prompt character, when Config::is_prompt_from_isr
+     * is set. The RX interrupt clears the flag when it starts the transmission; the tasks clear it only within
+     * a critical section.
+     */
+    volatile bool m_is_prompt_armed = false;
+    std::string_view m_armed_prompt_message;
+    std::string_view m_armed_prompt_suffix;
+    std::string_view m_armed_prompt_newline;
+
+    TaskHandle_t m_rx_task_handle = nullptr;
+    at_task_memory<Config::rx_task_stack_depth> m_rx_task_memory;
+
+    //! The bit of the notification of the dispatcher which takes the lines of this channel. Zero when the channel has
+    //! its own receiver task, which is notified with vTaskNotifyGiveFromISR().
+    uint32_t m_rx_notify_bit = 0;
+
+    //! Invokes the deferred unsolicited handlers, when Config::urc_queue_len isn't zero.
+    TaskHandle_t m_urc_task_handle = nullptr;
+    QueueHandle_t m_urc_queue = nullptr;
+    at_task_memory<(Config::urc_queue_len != 0 ? Config::urc_task_stack_depth : 0)> m_urc_task_memory;
+    at_queue_memory<Config::urc_queue_len, sizeof(deferred_urc)> m_urc_queue_memory;
+
+    //! Modified only by the receiver task.
+    unsigned m_num_dropped_on_urc_queue_overflow = 0;
+
+    //! Written by the RX interrupt and read by the receiver task, when Config::rx_stream_len isn't zero.
+    StreamBufferHandle_t m_rx_stream = nullptr;
+    at_stream_buffer_memory<Config::rx_stream_len> m_rx_stream_memory;
+
+    //! Modified only by the RX interrupt.
+    unsigned m_num_dropped_on_rx_stream_overflow = 0;
+
+    //! The tasks blocked in wait_for_unsolicited(). Guarded by m_requests_mux; the receiver task reads it without
+    //! the mutex only to skip taking it when nobody waits.
+    unsolicited_waiter *volatile m_waiters = nullptr;
+
+    /*
+     * The command in flight and whether it streams the data, so the receiver task tells the unsolicited lines without
+     * taking m_requests_mux. Written with m_requests_mux taken, before the command is transmitted, so they are never
+     * older than the line which responds to it.
+     */
+    volatile cmd m_awaited_command = cmd::none;
+    volatile bool m_is_data_stream_in_flight = false;
+
+    //! The line passed to the sink of the request in flight. Touched only by the receiver task, so its buffer is
+    //! exchanged with the one of the response and no line is allocated.
+    at_string m_sink_line;
+
+    /**
+     * The commands waiting for the transmission. The front one is the command in flight, i.e. being transmitted or
+     * awaiting its final result code.
+     */
+    request_queue<request, Config::cmd_queue_len + 1> m_requests;
+
+    /**
+     * Used to guard access to the queue of the requests, to the TX buffer, to the cache of the responses and to the
+     * waiters of the unsolicited commands. The receiver task takes it only for the lines which may be a part of the
+     * response to the command in flight, and for the unsolicited ones only while a task waits for them. The command
+     * handler isn't guarded, as the other tasks (un)register the handlers within a critical section, which the
+     * receiver task applies at the next line, see at_cmd_handler::set_lock().
+     */
+    SemaphoreHandle_t m_requests_mux = nullptr;
+    at_semaphore_memory m_requests_mux_memory;
+
+    //! Counts the free slots in the queue of the requests, so the issuers may block when the queue is full.
+    SemaphoreHandle_t m_free_requests_sem = nullptr;
+    at_semaphore_memory m_free_requests_sem_memory;
+
+    //! Given when the slot reserved for the urgent commands is free.
+    SemaphoreHandle_t m_urgent_slot_sem = nullptr;
+    at_semaphore_memory m_urgent_slot_sem_memory;
+
+    //! Used to generate identifiers of the requests.
+    unsigned m_last_request_id = 0;
+
+    latency_stats_type m_latency_stats;
+
+    stats_type m_stats;
+
+    //! Appended by the interrupts, unless it's being exported.
+    capture_type m_capture;
+    volatile bool m_is_capture_paused = false;
+
+    //! Set while RTS is released. Modified only within a critical section or the RX interrupt.
+    volatile bool m_is_rx_throttled = false;
+
+    //! Set from the transmission of a command while the device sleeps till the final result code of the last queued
+    //! command. Guarded by m_requests_mux.
+    bool m_is_device_awake = false;
+
+    //! Set while the queued commands are held for Config::tx_gather_ticks since m_gathering_start, all but the first
+    //! within the queue, so the front one isn't in flight then. Guarded by m_requests_mux.
+    bool m_is_gathering = false;
+    TickType_t m_gathering_start = 0;
+
+    response_cache_type m_response_cache{std::data(cmd_handler_type::cache_profiles)};
+
+    //! The queries awaited by more than their senders: the cached ones and all of them when Config::is_single_flight
+    //! is set. Guarded by m_requests_mux.
+    flight *m_flights = nullptr;
+
+    /*
+     * The points in time of the command in flight, which are taken within the interrupts. Each one is taken once
+     * the flag is set and the flag is cleared then. The first received byte is awaited after the transmission
+     * completes, so the echo of the command doesn't count as the response.
+     */
+    volatile bool m_is_awaiting_tx_completion = false;
+    volatile bool m_is_awaiting_first_rx_byte = false;
+    volatile uint32_t m_tx_completed_timestamp = 0;
+    volatile uint32_t m_first_rx_byte_timestamp = 0;
+
+    // ----------------------------------------------------------------------------------------------------------------
+    // Private methods
+    // ----------------------------------------------------------------------------------------------------------------
+    void create_os_objects();
+    void delete_os_objects();
+    static void rx_task(void *self);
+    void handle_received_lines();
+    void notify_rx_task();
+    void notify_rx_task_from_isr();
+    static void urc_task(void *self);
+    void handle_deferred_urcs();
+    bool defer_urc(at_handler_token token, at_payload_ptr payload);
+    void notify_waiters(cmd command, unsolicited_msg message, const line_view &payload);
+    bool wait_for(unsolicited_waiter &waiter, TickType_t ticks_to_wait);
+    void handle_received_response(line_view response, size_t colon_pos);
+    void finish_request_in_flight(request &req, at_err result, pending_completion &pending);
+    void invoke_completion(pending_completion &pending);
+    void invoke_sink(request &req);
+    void fail_overflowed_request();
+    std::pair<request *, unsigned> enqueue_request(cmd command,
+                                                   std::string_view prefix,
+                                                   at_string &&payload,
+                                                   prompt_msg &&prompt,
+                                                   bool is_async = false,
+                                                   at_async_completion &&completion = {},
+                                                   os_flag *done_flag = nullptr,
+                                                   request_options &&options = {});
+    bool take_free_slot(request_options &options, TickType_t ticks_to_wait);
+    void await_request(request &req, TickType_t ticks_to_wait, TickType_t inter_line_ticks);
+    void release_request(request &req);
+    void take_response_payload(request &req, at_string &response_payload);
+    void take_response_payload(request &req, at_line_list &response_lines);
+    request *find_data_packet(const at_data_stream &stream, unsigned seq);
+    at_err collect_data_packet(at_data_stream &stream, TickType_t ticks_to_wait);
+    void withdraw_data_packets(at_data_stream &stream);
+    static at_err match_data_ack(const at_data_stream &stream, const line_view &response);
+    request *find_request(at_async_handle handle);
+    at_async_handle send_async(cmd command,
+                               at_cmd_type command_type,
+                               at_string &&payload,
+                               at_async_completion &&completion,
+                               os_flag *done_flag,
+                               at_priority priority);
+    template <typename Payload>
+    at_err send_and_get_response(cmd command,
+                                 Payload &response_payload,
+                                 TickType_t ticks_to_wait,
+                                 std::string_view prefix,
+                                 at_string &&payload = {},
+                                 prompt_msg &&prompt = {},
+                                 request_options &&options = {});
+    request *get_request_in_flight();
+    void schedule_request(request &req);
+    TickType_t transmit_gathered_requests_when_due();
+    void transmit_request(request &req);
+    void transmit_next_request();
+    void withdraw_request(request &req);
+    void finish_binary_rx(request &req);
+    bool start_next_batch_entry(request &req, at_err result);
+    void complete_request(request &req, at_err result);
+    bool transmit_command(std::string_view prefix,
+                          at_string &&payload,
+                          std::string_view suffix = {},
+                          std::string_view newline = crlf_str);
+    bool push_command(std::string_view prefix,
+                      at_string &&payload,
+                      std::string_view suffix = {},
+                      std::string_view newline = crlf_str);
+    static std::string_view get_prompt_suffix(at_prompt_end_policy policy);
+    static std::string_view get_prompt_newline(at_prompt_end_policy policy);
+    void start_transmission();
+    void transmit_next_block();
+    bool handle_prompt_request(request &req);
+    void arm_prompt(request &req);
+    bool disarm_prompt();
+    void expect_echo(std::string_view first = {}, std::string_view second = {}, std::string_view third = {});
+    void on_rx_string_ends();
+    void stop_borrowed_transmission();
+    void on_tx_completed();
+    void on_rx_bytes();
+    void stream_received_bytes(const char *bytes, size_t num, bool is_task_woken);
+    void fetch_rx_stream();
+    void capture(at_capture_direction direction, const char *bytes, size_t num, bool is_record_end = false);
+    void throttle_rx_if_full();
+    void unthrottle_rx_if_drained();
+    void record_latency(const request &req);
+    at_err send_shared(int cache_slot,
+                       cmd command,
+                       at_cmd_type command_type,
+                       TickType_t ticks_to_wait,
+                       at_string &response_payload,
+                       at_priority priority);
+    at_err await_flight(flight &f, flight_waiter &waiter, TickType_t ticks_to_wait);
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PUBLIC MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <typename CommandSet, typename Hal, typename Config> void at_channel<CommandSet, Hal, Config>::init()
+{
+    create_os_objects();
+    m_rx_task_handle = at_create_task(rx_task,
+                                      Config::rx_task_name,
+                                      m_rx_task_memory,
+                                      this,
+                                      Config::rx_task_priority,
+                                      Config::rx_task_core_affinity);
+}
+
+template <typename CommandSet, typename Hal, typename Config> void at_channel<CommandSet, Hal, Config>::deinit()
+{
+    configASSERT(m_rx_notify_bit == 0);
+    vTaskDelete(m_rx_task_handle);
+    m_rx_task_handle = nullptr;
+    delete_os_objects();
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+template <typename Dispatcher>
+void at_channel<CommandSet, Hal, Config>::init(Dispatcher &dispatcher)
+{
+    create_os_objects();
+    m_rx_task_handle = dispatcher.get_task_handle();
+    m_rx_notify_bit = dispatcher.attach(*this);
+    configASSERT(m_rx_notify_bit != 0);
+    // What the own receiver task would do when it starts.
+    if constexpr (is_rx_flow_control)
+        Hal::assert_rts();
+    Hal::enable_rx_it();
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+template <typename Dispatcher>
+void at_channel<CommandSet, Hal, Config>::deinit(Dispatcher &dispatcher)
+{
+    dispatcher.detach(m_rx_notify_bit);
+    m_rx_notify_bit = 0;
+    m_rx_task_handle = nullptr;
+    delete_os_objects();
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::create_os_objects()
+{
+    // The echoes would be ignored by the command handler anyway, so they don't even wake up the receiver task.
+    m_rx_buf.discard_strings_starting_with(cmd_handler_type::get_discardable_echo_prefix());
+    m_requests_mux = at_create_mutex(m_requests_mux_memory);
+    m_free_requests_sem =
+        at_create_counting_semaphore(Config::cmd_queue_len, Config::cmd_queue_len, m_free_requests_sem_memory);
+    m_urgent_slot_sem = at_create_counting_semaphore(1, 1, m_urgent_slot_sem_memory);
+    if constexpr (Config::is_tx_dma)
+        m_tx_block_done_sem = at_create_binary_semaphore(m_tx_block_done_sem_memory);
+    for (auto &req : m_requests.slots())
+        req.done_sem = at_create_binary_semaphore(req.done_sem_memory);
+    if constexpr (is_rx_stream)
+        m_rx_stream = at_create_stream_buffer(Config::rx_stream_trigger_level, m_rx_stream_memory);
+    m_cmd_handler.set_unsolicited_observer([this](cmd command, unsolicited_msg message, const line_view &payload) {
+        // Invoked by the receiver task without any lock. It's the only task which invalidates the cached responses
+        // without the mutex.
+        if constexpr (is_response_cache)
+            m_response_cache.invalidate_without_lock(command);
+        if constexpr (Config::is_stats)
+        {
+            if (message == unsolicited_msg::none)
+                m_stats.count_urc_cmd(to_u_type(command));
+            else
+                m_stats.count_urc_msg(to_u_type(message));
+        }
+        notify_waiters(command, message, payload);
+    });
+    // The other tasks (un)register the handlers while the receiver task parses the lines.
+    m_cmd_handler.set_lock([] { taskENTER_CRITICAL(); }, [] { taskEXIT_CRITICAL(); });
+
+    if constexpr (is_urc_task)
+    {
+        m_urc_queue = at_create_queue(m_urc_queue_memory);
+        m_urc_task_handle = at_create_task(urc_task,
+                                           Config::urc_task_name,
+                                           m_urc_task_memory,
+                                           this,
+                                           Config::urc_task_priority,
+                                           Config::urc_task_core_affinity);
+        m_cmd_handler.set_deferred_dispatcher(
+            [this](at_handler_token token, at_payload_ptr payload) { return defer_urc(token, std::move(payload)); });
+    }
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::delete_os_objects()
+{
+    vSemaphoreDelete(m_requests_mux);
+    vSemaphoreDelete(m_free_requests_sem);
+    vSemaphoreDelete(m_urgent_slot_sem);
+    if constexpr (Config::is_tx_dma)
+        vSemaphoreDelete(m_tx_block_done_sem);
+    for (auto &req : m_requests.slots())
+        vSemaphoreDelete(req.done_sem);
+    if constexpr (is_rx_stream)
+        vStreamBufferDelete(m_rx_stream);
+
+    if constexpr (is_urc_task)
+    {
+        vTaskDelete(m_urc_task_handle);
+        deferred_urc urc;
+        while (xQueueReceive(m_urc_queue, &urc, 0) == pdTRUE)
+            at_payload_ptr{urc.payload};
+        vQueueDelete(m_urc_queue);
+    }
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_err at_channel<CommandSet, Hal, Config>::send(cmd command,
+                                                 at_string &&payload,
+                                                 TickType_t ticks_to_wait,
+                                                 at_string &response_payload,
+                                                 at_priority priority)
+{
+    auto command_prefix = cmd_handler_type::get_cmd_prefix(command, at_cmd_type::write);
+    request_options options;
+    options.priority = priority;
+    return send_and_get_response(
+        command, response_payload, ticks_to_wait, command_prefix, std::move(payload), {}, std::move(options));
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_err at_channel<CommandSet, Hal, Config>::send(cmd command,
+                                                 at_string &&payload,
+                                                 TickType_t ticks_to_wait,
+                                                 at_priority priority)
+{
+    at_string dummy_pload;
+    return send(command, std::move(payload), ticks_to_wait, dummy_pload, priority);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_err at_channel<CommandSet, Hal, Config>::send(cmd command,
+                                                 at_cmd_type command_type,
+                                                 TickType_t ticks_to_wait,
+                                                 at_string &response_payload,
+                                                 at_priority priority)
+{
+    int cache_slot = -1;
+    if constexpr (is_response_cache)
+        cache_slot = m_response_cache.find(command, command_type);
+    if (cache_slot >= 0 || (Config::is_single_flight && command_type != at_cmd_type::write))
+        return send_shared(cache_slot, command, command_type, ticks_to_wait, response_payload, priority);
+
+    auto command_prefix = cmd_handler_type::get_cmd_prefix(command, command_type);
+    request_options options;
+    options.priority = priority;
+    return send_and_get_response(command, response_payload, ticks_to_wait, command_prefix, {}, {}, std::move(options));
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_err at_channel<CommandSet, Hal, Config>::send(cmd command,
+                                                 at_cmd_type command_type,
+                                                 TickType_t ticks_to_wait,
+                                                 at_priority priority)
+{
+    at_string dummy_pload;
+    return send(command, command_type, ticks_to_wait, dummy_pload, priority);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_err at_channel<CommandSet, Hal, Config>::send(cmd command,
+                                                 at_string &&payload,
+                                                 TickType_t ticks_to_wait,
+                                                 at_line_list &response_lines,
+                                                 at_priority priority)
+{
+    auto command_prefix = cmd_handler_type::get_cmd_prefix(command, at_cmd_type::write);
+    request_options options;
+    options.priority = priority;
+    return send_and_get_response(
+        command, response_lines, ticks_to_wait, command_prefix, std::move(payload), {}, std::move(options));
+}
+
+//! The lines are taken straight from the response, so the query is neither cached nor shared with its other issuers.
+template <typename CommandSet, typename Hal, typename Config>
+at_err at_channel<CommandSet, Hal, Config>::send(cmd command,
+                                                 at_cmd_type command_type,
+                                                 TickType_t ticks_to_wait,
+                                                 at_line_list &response_lines,
+                                                 at_priority priority)
+{
+    auto command_prefix = cmd_handler_type::get_cmd_prefix(command, command_type);
+    request_options options;
+    options.priority = priority;
+    return send_and_get_response(command, response_lines, ticks_to_wait, command_prefix, {}, {}, std::move(options));
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+template <typename at_channel<CommandSet, Hal, Config>::cmd Command>
+at_err at_channel<CommandSet, Hal, Config>::send_typed(at_string &&payload,
+                                                       TickType_t ticks_to_wait,
+                                                       payload_values<Command> &values,
+                                                       at_priority priority)
+{
+    at_string pload;
+    auto res = send(Command, std::move(payload), ticks_to_wait, pload, priority);
+    return cmd_handler_type::template parse_response<Command>(res, pload, values);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+template <typename at_channel<CommandSet, Hal, Config>::cmd Command>
+at_err at_channel<CommandSet, Hal, Config>::send_typed(at_cmd_type command_type,
+                                                       TickType_t ticks_to_wait,
+                                                       payload_values<Command> &values,
+                                                       at_priority priority)
+{
+    at_string pload;
+    auto res = send(Command, command_type, ticks_to_wait, pload, priority);
+    return cmd_handler_type::template parse_response<Command>(res, pload, values);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+template <typename at_channel<CommandSet, Hal, Config>::cmd Command, typename... Args>
+at_err at_channel<CommandSet, Hal, Config>::send_write(TickType_t ticks_to_wait,
+                                                       at_string &response_payload,
+                                                       const Args &... args)
+{
+    return send_write<Command>(at_priority::normal, ticks_to_wait, response_payload, args...);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+template <typename at_channel<CommandSet, Hal, Config>::cmd Command, typename... Args>
+at_err at_channel<CommandSet, Hal, Config>::send_write(TickType_t ticks_to_wait, const Args &... args)
+{
+    return send_write<Command>(at_priority::normal, ticks_to_wait, args...);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+template <typename at_channel<CommandSet, Hal, Config>::cmd Command, typename... Args>
+at_err at_channel<CommandSet, Hal, Config>::send_write(at_priority priority,
+                                                       TickType_t ticks_to_wait,
+                                                       at_string &response_payload,
+                                                       const Args &... args)
+{
+    return send(Command,
+                cmd_handler_type::template format_write_args<Command>(args...),
+                ticks_to_wait,
+                response_payload,
+                priority);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+template <typename at_channel<CommandSet, Hal, Config>::cmd Command, typename... Args>
+at_err at_channel<CommandSet, Hal, Config>::send_write(at_priority priority,
+                                                       TickType_t ticks_to_wait,
+                                                       const Args &... args)
+{
+    at_string dummy_pload;
+    return send_write<Command>(priority, ticks_to_wait, dummy_pload, args...);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_err at_channel<CommandSet, Hal, Config>::send_streamed(cmd command,
+                                                          at_string &&payload,
+                                                          TickType_t ticks_to_wait,
+                                                          at_payload_sink sink)
+{
+    at_string dummy_pload;
+    auto command_prefix = cmd_handler_type::get_cmd_prefix(command, at_cmd_type::write);
+    request_options options;
+    options.sink = std::move(sink);
+    return send_and_get_response(
+        command, dummy_pload, ticks_to_wait, command_prefix, std::move(payload), {}, std::move(options));
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_err at_channel<CommandSet, Hal, Config>::send_streamed(cmd command,
+                                                          at_cmd_type command_type,
+                                                          TickType_t ticks_to_wait,
+                                                          at_payload_sink sink)
+{
+    at_string dummy_pload;
+    auto command_prefix = cmd_handler_type::get_cmd_prefix(command, command_type);
+    request_options options;
+    options.sink = std::move(sink);
+    return send_and_get_response(command, dummy_pload, ticks_to_wait, command_prefix, {}, {}, std::move(options));
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_err at_channel<CommandSet, Hal, Config>::send_binary_read(cmd command,
+                                                             at_string &&payload,
+                                                             TickType_t ticks_to_wait,
+                                                             at_binary_rx &binary,
+                                                             at_string &response_payload)
+{
+    binary.received_len = 0;
+    auto command_prefix = cmd_handler_type::get_cmd_prefix(command, at_cmd_type::write);
+    request_options options;
+    options.binary = &binary;
+    return send_and_get_response(
+        command, response_payload, ticks_to_wait, command_prefix, std::move(payload), {}, std::move(options));
+}
+
+/**
+ * The whole batch occupies a single slot of the queue. The receiver task sends the next command as soon as the final
+ * result code of the previous one arrives, so the caller is woken up only once, when the whole batch is done.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+at_err at_channel<CommandSet, Hal, Config>::send_batch(batch_entry *entries,
+                                                       size_t entries_num,
+                                                       at_batch_policy policy,
+                                                       TickType_t ticks_to_wait)
+{
+    if (entries_num == 0)
+        return at_err::ok;
+
+    for (size_t i = 0; i < entries_num; ++i)
+    {
+        entries[i].result = at_err::unknown;
+        entries[i].response_payload.clear();
+    }
+
+    at_string dummy_pload;
+    auto &first = entries[0];
+    auto command_prefix = cmd_handler_type::get_cmd_prefix(first.command, first.command_type);
+    request_options options;
+    options.batch = entries;
+    options.batch_len = entries_num;
+    options.batch_policy = policy;
+    auto result = send_and_get_response(
+        first.command, dummy_pload, ticks_to_wait, command_prefix, std::move(first.payload), {}, std::move(options));
+    if (result == at_err::timeout)
+        return result;
+
+    for (size_t i = 0; i < entries_num; ++i)
+        if (entries[i].result != at_err::ok)
+            return entries[i].result;
+    return at_err::ok;
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_err at_channel<CommandSet, Hal, Config>::send_prompted(cmd command,
+                                                          at_string payload,
+                                                          at_string prompt_message,
+                                                          at_prompt_end_policy policy,
+                                                          TickType_t ticks_to_wait)
+{
+    at_string dummy_pload;
+    auto command_prefix = cmd_handler_type::get_cmd_prefix(command, at_cmd_type::write);
+    prompt_msg prompt;
+    prompt.set(policy, std::move(prompt_message));
+    return send_and_get_response(
+        command, dummy_pload, ticks_to_wait, command_prefix, std::move(payload), std::move(prompt));
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_err at_channel<CommandSet, Hal, Config>::send_prompted(cmd command,
+                                                          at_string payload,
+                                                          const char *prompt_data,
+                                                          size_t prompt_len,
+                                                          at_prompt_end_policy policy,
+                                                          TickType_t ticks_to_wait)
+{
+    at_string dummy_pload;
+    auto command_prefix = cmd_handler_type::get_cmd_prefix(command, at_cmd_type::write);
+    prompt_msg prompt;
+    prompt.set_borrowed(policy, {prompt_data, prompt_len});
+    return send_and_get_response(
+        command, dummy_pload, ticks_to_wait, command_prefix, std::move(payload), std::move(prompt));
+}
+
+/**
+ * Waits only while the window of the stream is full, for the oldest packet. The packet is queued like any other
+ * command, so the commands of the other tasks are sent in between the packets.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+at_err at_channel<CommandSet, Hal, Config>::send_data(at_data_stream &stream,
+                                                      cmd command,
+                                                      at_string &&payload,
+                                                      const char *data,
+                                                      size_t len,
+                                                      TickType_t ticks_to_wait)
+{
+    TimeOut_t timeout;
+    vTaskSetTimeOutState(&timeout);
+
+    auto max_packets_num = std::clamp<size_t>(stream.max_packets_in_flight, 1, Config::cmd_queue_len);
+    for (;;)
+    {
+        auto packets_num = stream.sent_num - stream.collected_num;
+        auto is_bytes_window_full = stream.max_bytes_in_flight > 0 && packets_num > 0
+                                    && stream.bytes_in_flight + len > stream.max_bytes_in_flight;
+        if (packets_num < max_packets_num && !is_bytes_window_full)
+            break;
+        if (collect_data_packet(stream, ticks_to_wait) == at_err::timeout)
+            return at_err::timeout;
+        if (xTaskCheckForTimeOut(&timeout, &ticks_to_wait) == pdTRUE)
+            ticks_to_wait = 0;
+    }
+    if (stream.error != at_err::ok)
+        return std::exchange(stream.error, at_err::ok);
+
+    request_options options;
+    options.data_stream = &stream;
+    options.data_seq = stream.sent_num;
+    if (!take_free_slot(options, ticks_to_wait))
+        return at_err::timeout;
+
+    prompt_msg prompt;
+    prompt.set_borrowed(stream.policy, {data, len});
+    enqueue_request(command,
+                    cmd_handler_type::get_cmd_prefix(command, at_cmd_type::write),
+                    std::move(payload),
+                    std::move(prompt),
+                    false,
+                    {},
+                    nullptr,
+                    std::move(options));
+    ++stream.sent_num;
+    stream.bytes_in_flight += len;
+    return at_err::ok;
+}
+
+/**
+ * When the packets aren't acknowledged on time, then they are withdrawn, so none of the buffers of the stream is read
+ * after the return.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+at_err at_channel<CommandSet, Hal, Config>::flush_data(at_data_stream &stream, TickType_t ticks_to_wait)
+{
+    TimeOut_t timeout;
+    vTaskSetTimeOutState(&timeout);
+
+    while (stream.collected_num != stream.sent_num)
+    {
+        if (collect_data_packet(stream, ticks_to_wait) == at_err::timeout)
+        {
+            withdraw_data_packets(stream);
+            return at_err::timeout;
+        }
+        if (xTaskCheckForTimeOut(&timeout, &ticks_to_wait) == pdTRUE)
+            ticks_to_wait = 0;
+    }
+    return std::exchange(stream.error, at_err::ok);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_async_handle at_channel<CommandSet, Hal, Config>::send_async(cmd command,
+                                                                at_cmd_type command_type,
+                                                                at_string &&payload,
+                                                                at_async_completion completion,
+                                                                at_priority priority)
+{
+    return send_async(command, command_type, std::move(payload), std::move(completion), nullptr, priority);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_async_handle at_channel<CommandSet, Hal, Config>::send_async(cmd command,
+                                                                at_cmd_type command_type,
+                                                                at_string &&payload,
+                                                                os_flag &done_flag,
+                                                                at_priority priority)
+{
+    return send_async(command, command_type, std::move(payload), {}, &done_flag, priority);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_err at_channel<CommandSet, Hal, Config>::get_async_result(at_async_handle handle, at_string &response_payload)
+{
+    request *req;
+    at_err result;
+    {
+        requests_guard guard(*this);
+        req = find_request(handle);
+        // Requests with the completion callback are released after the callback is invoked.
+        if (!req || req->completion)
+            return at_err::unknown;
+        if (!req->is_done)
+            return at_err::handling_cmd;
+        take_response_payload(*req, response_payload);
+        result = req->result;
+    }
+    release_request(*req);
+    return result;
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+bool at_channel<CommandSet, Hal, Config>::abort_async(at_async_handle handle)
+{
+    request *req;
+    {
+        requests_guard guard(*this);
+        req = find_request(handle);
+        if (!req || req->is_done)
+            return false;
+        withdraw_request(*req);
+    }
+    release_request(*req);
+    return true;
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_handler_token at_channel<CommandSet, Hal, Config>::register_unsolicited_handler(cmd command,
+                                                                                    at_unsolicited_cmd_handler handler,
+                                                                                    at_dispatch dispatch)
+{
+    return m_cmd_handler.register_unsolicited_handler(command, std::move(handler), dispatch);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_handler_token at_channel<CommandSet, Hal, Config>::register_unsolicited_handler(unsolicited_msg message,
+                                                                                    at_unsolicited_msg_handler handler,
+                                                                                    at_dispatch dispatch)
+{
+    return m_cmd_handler.register_unsolicited_handler(message, std::move(handler), dispatch);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+template <typename at_channel<CommandSet, Hal, Config>::cmd Command, typename Handler>
+at_handler_token at_channel<CommandSet, Hal, Config>::register_typed_handler(Handler &&handler, at_dispatch dispatch)
+{
+    return register_unsolicited_handler(
+        Command, cmd_handler_type::template make_typed_handler<Command>(std::forward<Handler>(handler)), dispatch);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+bool at_channel<CommandSet, Hal, Config>::unregister_unsolicited_handler(at_handler_token token)
+{
+    auto is_unregistered = m_cmd_handler.unregister_unsolicited_handler(token);
+    // The receiver task releases the captures of the handler, so it's woken up, not to wait for the next line.
+    if (is_unregistered && m_rx_task_handle && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING
+        && xTaskGetCurrentTaskHandle() != m_rx_task_handle)
+        notify_rx_task();
+    return is_unregistered;
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+bool at_channel<CommandSet, Hal, Config>::wait_for_unsolicited(cmd command,
+                                                               TickType_t ticks_to_wait,
+                                                               at_payload_predicate predicate,
+                                                               at_string *payload)
+{
+    unsolicited_waiter waiter;
+    waiter.command = command;
+    waiter.predicate = &predicate;
+    waiter.payload = payload;
+    return wait_for(waiter, ticks_to_wait);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+bool at_channel<CommandSet, Hal, Config>::wait_for_unsolicited(unsolicited_msg message, TickType_t ticks_to_wait)
+{
+    unsolicited_waiter waiter;
+    waiter.message = message;
+    return wait_for(waiter, ticks_to_wait);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::invalidate_cached_responses(cmd command)
+{
+    requests_guard guard(*this);
+    m_response_cache.invalidate(command);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_rx_drop_stats at_channel<CommandSet, Hal, Config>::get_rx_drop_stats()
+{
+    return {m_rx_buf.get_num_dropped_on_buffer_overflow(),
+            m_rx_buf.get_num_dropped_on_strings_overflow(),
+            m_num_dropped_on_urc_queue_overflow,
+            m_num_dropped_on_rx_stream_overflow};
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+typename at_channel<CommandSet, Hal, Config>::stats_snapshot at_channel<CommandSet, Hal, Config>::get_stats() const
+{
+    static_assert(Config::is_stats, "The channel isn't counted");
+    auto lines_dropped = m_rx_buf.get_num_dropped_on_buffer_overflow()
+                         + m_rx_buf.get_num_dropped_on_strings_overflow() + m_num_dropped_on_urc_queue_overflow;
+    return m_stats.snapshot(lines_dropped, m_rx_buf.get_peak_num_chars());
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::dump_stats(void (*print_line)(const char *line)) const
+{
+    auto s = get_stats();
+    char line[256];
+    std::snprintf(line,
+                  sizeof(line),
+                  "rx=%lu tx=%lu lines=%lu dropped=%lu peak_rx=%lu throttles=%lu wakes=%lu "
+                  "mux_waits=%lu mux_ticks=%lu mux_max=%lu",
+                  static_cast<unsigned long>(s.rx_bytes),
+                  static_cast<unsigned long>(s.tx_bytes),
+                  static_cast<unsigned long>(s.lines_parsed),
+                  static_cast<unsigned long>(s.lines_dropped),
+                  static_cast<unsigned long>(s.peak_rx_chars),
+                  static_cast<unsigned long>(s.rx_throttles),
+                  static_cast<unsigned long>(s.wake_cycles),
+                  static_cast<unsigned long>(s.mux_contentions),
+                  static_cast<unsigned long>(s.mux_wait_ticks),
+                  static_cast<unsigned long>(s.mux_max_wait_ticks));
+    print_line(line);
+
+    // E.g. "results: ok=12 timeout=1", see at_dump_stats().
+    int len = std::snprintf(line, sizeof(line), "results:");
+    for (size_t e = 0; e < s.results.size(); ++e)
+        if (s.results[e] != 0 && len > 0 && static_cast<size_t>(len) < sizeof(line))
+            len += std::snprintf(line + len,
+                                 sizeof(line) - len,
+                                 " %s=%lu",
+                                 at_err_to_string(static_cast<at_err>(e)),
+                                 static_cast<unsigned long>(s.results[e]));
+    print_line(line);
+
+    for (size_t c = 0; c < s.commands_issued.size(); ++c)
+    {
+        if (s.commands_issued[c] == 0 && s.urcs_per_cmd[c] == 0)
+            continue;
+        auto prefix = cmd_handler_type::get_cmd_prefix(static_cast<cmd>(c), at_cmd_type::exec);
+        std::snprintf(line,
+                      sizeof(line),
+                      "%.*s: issued=%lu urcs=%lu",
+                      static_cast<int>(prefix.length()),
+                      prefix.data(),
+                      static_cast<unsigned long>(s.commands_issued[c]),
+                      static_cast<unsigned long>(s.urcs_per_cmd[c]));
+        print_line(line);
+    }
+
+    for (size_t m = 0; m < s.urcs_per_msg.size(); ++m)
+    {
+        if (s.urcs_per_msg[m] == 0)
+            continue;
+        auto msg = CommandSet::unsolicited_msg_strs[m];
+        std::snprintf(line,
+                      sizeof(line),
+                      "%.*s: urcs=%lu",
+                      static_cast<int>(msg.length()),
+                      msg.data(),
+                      static_cast<unsigned long>(s.urcs_per_msg[m]));
+        print_line(line);
+    }
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_stack_high_water_marks at_channel<CommandSet, Hal, Config>::get_stack_high_water_marks() const
+{
+    static_assert(INCLUDE_uxTaskGetStackHighWaterMark == 1, "Needs uxTaskGetStackHighWaterMark");
+    return {uxTaskGetStackHighWaterMark(m_rx_task_handle),
+            is_urc_task ? uxTaskGetStackHighWaterMark(m_urc_task_handle) : 0};
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+const at_latency_histogram &at_channel<CommandSet, Hal, Config>::get_latency_histogram(cmd command,
+                                                                                        at_latency_phase phase) const
+{
+    static_assert(Config::is_latency_stats, "The latencies aren't measured");
+    return m_latency_stats.get(to_u_type(command), phase);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::reset_latency_stats()
+{
+    static_assert(Config::is_latency_stats, "The latencies aren't measured");
+    m_latency_stats.reset();
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::dump_latency_stats(void (*print_line)(const char *line)) const
+{
+    static_assert(Config::is_latency_stats, "The latencies aren't measured");
+
+    constexpr auto cmds_num{to_u_type(cmd::number_of_commands)};
+    constexpr auto phases_num{to_u_type(at_latency_phase::number_of_phases)};
+    for (std::remove_const_t<decltype(cmds_num)> c = 0; c < cmds_num; ++c)
+    {
+        auto command{static_cast<cmd>(c)};
+        for (std::remove_const_t<decltype(phases_num)> p = 0; p < phases_num; ++p)
+        {
+            auto phase{static_cast<at_latency_phase>(p)};
+            const auto &h = m_latency_stats.get(c, phase);
+            if (h.total_count() == 0)
+                continue;
+
+            // E.g. "AT+QIOPEN total: n=3 max=1234 b10=2 b11=1", see at_dump_latency_stats().
+            char line[32 + 12 * at_latency_histogram::buckets_num];
+            auto prefix = cmd_handler_type::get_cmd_prefix(command, at_cmd_type::exec);
+            int len = std::snprintf(line,
+                                    sizeof(line),
+                                    "%.*s %s: n=%lu max=%lu",
+                                    static_cast<int>(prefix.length()),
+                                    prefix.data(),
+                                    at_latency_phase_to_string(phase),
+                                    static_cast<unsigned long>(h.total_count()),
+                                    static_cast<unsigned long>(h.max));
+            for (size_t b = 0; b < h.counts.size(); ++b)
+                if (h.counts[b] != 0 && len > 0 && static_cast<size_t>(len) < sizeof(line))
+                    len += std::snprintf(line + len,
+                                         sizeof(line) - len,
+                                         " b%u=%lu",
+                                         static_cast<unsigned>(b),
+                                         static_cast<unsigned long>(h.counts[b]));
+            print_line(line);
+        }
+    }
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::export_capture(void (*write)(const char *data, size_t len))
+{
+    static_assert(Config::capture_len > 0, "The traffic isn't captured");
+
+    // Once the flag is set within the critical section, no interrupt is in the middle of appending anymore. The
+    // traffic which passes meanwhile isn't captured.
+    taskENTER_CRITICAL();
+    m_is_capture_paused = true;
+    taskEXIT_CRITICAL();
+
+    m_capture.export_to(write);
+
+    taskENTER_CRITICAL();
+    m_is_capture_paused = false;
+    taskEXIT_CRITICAL();
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::clear_capture()
+{
+    static_assert(Config::capture_len > 0, "The traffic isn't captured");
+
+    taskENTER_CRITICAL();
+    m_capture.clear();
+    taskEXIT_CRITICAL();
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::it_handle_byte_rx(char c)
+{
+    on_rx_bytes();
+
+    // Notify the receiver task on the command end.
+    if constexpr (Config::is_stats)
+        m_stats.count_rx_bytes(1);
+    if constexpr (is_rx_stream)
+    {
+        stream_received_bytes(&c, 1, c == '\n' || (Config::is_no_newline_after_prompt && c == '>'));
+        return;
+    }
+    auto is_string_end = m_rx_buf.push_byte_and_is_string_end(c);
+    capture(at_capture_direction::rx, &c, 1, is_string_end);
+    throttle_rx_if_full();
+    if (is_string_end)
+        on_rx_string_ends();
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::it_handle_bytes_rx(const char *bytes, size_t num)
+{
+    on_rx_bytes();
+
+    // Notify the receiver task once per chunk, no matter how many commands have been terminated within it.
+    if constexpr (Config::is_stats)
+        m_stats.count_rx_bytes(num);
+    if constexpr (is_rx_stream)
+    {
+        // A chunk usually ends with a pause in the traffic, so its lines are handled right away.
+        stream_received_bytes(bytes, num, true);
+        return;
+    }
+    auto num_string_ends = m_rx_buf.push_bytes_and_count_string_ends(bytes, num);
+    capture(at_capture_direction::rx, bytes, num, num_string_ends > 0);
+    throttle_rx_if_full();
+    if (num_string_ends > 0)
+        on_rx_string_ends();
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::it_handle_byte_tx()
+{
+    if (m_tx_buf.is_empty())
+    {
+        Hal::disable_tx_it();
+        on_tx_completed();
+    }
+    else
+    {
+        auto c = m_tx_buf.pop_byte();
+        if constexpr (Config::is_stats)
+            m_stats.count_tx_bytes(1);
+        capture(at_capture_direction::tx, &c, 1);
+        Hal::send_byte(c);
+    }
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::it_handle_block_tx_done()
+{
+    m_tx_buf.pop_segment();
+    transmit_next_block();
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+TickType_t at_channel<CommandSet, Hal, Config>::handle_received_lines(unsigned max_lines_num, bool &is_drained)
+{
+    // The handlers unregistered by the other tasks are released even when no line arrives.
+    m_cmd_handler.apply_registrations();
+    // The next request, started by the failed one, may not fit either.
+    while (m_is_tx_overflowed)
+        fail_overflowed_request();
+
+    for (; max_lines_num != 0; --max_lines_num)
+    {
+        if constexpr (is_rx_stream)
+            if (m_rx_buf.is_empty())
+                fetch_rx_stream();
+        if (m_rx_buf.is_empty())
+            break;
+
+        // The response is parsed in place and its space in the buffer is released after it has been handled.
+        auto response = m_rx_buf.peek_string();
+        if (!response.empty())
+            handle_received_response(response, m_rx_buf.peek_colon_pos());
+        m_rx_buf.release_string();
+        unthrottle_rx_if_drained();
+    }
+    is_drained = m_rx_buf.is_empty();
+    if constexpr (is_rx_stream)
+        is_drained = is_drained && xStreamBufferIsEmpty(m_rx_stream) == pdTRUE;
+    // The task sleeps no longer than till the end of the window of the held commands, if any.
+    return transmit_gathered_requests_when_due();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::rx_task(void *self)
+{
+    if constexpr (is_rx_flow_control)
+        Hal::assert_rts();
+    Hal::enable_rx_it();
+    static_cast<at_channel *>(self)->handle_received_lines();
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::handle_received_lines()
+{
+    TickType_t ticks_to_wait = portMAX_DELAY;
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, ticks_to_wait);
+        // A single notification may stand for multiple strings (e.g. when a whole chunk has been pushed at once),
+        // so drain the buffer completely.
+        bool is_drained;
+        ticks_to_wait = handle_received_lines(std::numeric_limits<unsigned>::max(), is_drained);
+    }
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::notify_rx_task()
+{
+    if (m_rx_notify_bit == 0)
+        xTaskNotifyGive(m_rx_task_handle);
+    else
+        xTaskNotify(m_rx_task_handle, m_rx_notify_bit, eSetBits);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::notify_rx_task_from_isr()
+{
+    if (m_rx_notify_bit == 0)
+    {
+        notify_from_isr(m_rx_task_handle);
+        return;
+    }
+    BaseType_t higher_prior_task_woken = pdFALSE;
+    xTaskNotifyFromISR(m_rx_task_handle, m_rx_notify_bit, eSetBits, &higher_prior_task_woken);
+    portEND_SWITCHING_ISR(higher_prior_task_woken);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::urc_task(void *self)
+{
+    static_cast<at_channel *>(self)->handle_deferred_urcs();
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::handle_deferred_urcs()
+{
+    for (;;)
+    {
+        deferred_urc urc;
+        xQueueReceive(m_urc_queue, &urc, portMAX_DELAY);
+        at_payload_ptr payload{urc.payload};
+
+        // The handler is pinned in its record, so the receiver task keeps parsing the responses meanwhile.
+        m_cmd_handler.invoke_deferred_handler(urc.token, std::move(payload));
+    }
+}
+
+//! Called by the receiver task.
+template <typename CommandSet, typename Hal, typename Config>
+bool at_channel<CommandSet, Hal, Config>::defer_urc(at_handler_token token, at_payload_ptr payload)
+{
+    deferred_urc urc{token, payload.get()};
+    if (xQueueSend(m_urc_queue, &urc, 0) != pdTRUE)
+    {
+        m_num_dropped_on_urc_queue_overflow++;
+        return false;
+    }
+    payload.release();
+    return true;
+}
+
+//! Called by the receiver task for each unsolicited command and message.
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::notify_waiters(cmd command,
+                                                         unsolicited_msg message,
+                                                         const line_view &payload)
+{
+    // The waiter is linked before it blocks, so the unsolicited lines take the mutex only while a task waits.
+    if (!m_waiters)
+        return;
+
+    requests_guard guard(*this);
+    for (auto link = &m_waiters; *link;)
+    {
+        auto &waiter = **link;
+        if (waiter.command != command || waiter.message != message
+            || (waiter.predicate && *waiter.predicate && !(*waiter.predicate)(payload)))
+        {
+            link = &waiter.next;
+            continue;
+        }
+
+        if (waiter.payload)
+        {
+            waiter.payload->clear();
+            payload.append_to(*waiter.payload);
+        }
+        // The waiter may leave its stack frame only after it takes the mutex, so it's touched safely till the end.
+        waiter.is_matched = true;
+        *link = waiter.next;
+        xTaskNotifyGive(waiter.task);
+    }
+}
+
+/**
+ * The task sleeps on its notification until the receiver task matches the waiter or the time is up. Any other
+ * notification only makes the task check the waiter and sleep again for the remaining time.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+bool at_channel<CommandSet, Hal, Config>::wait_for(unsolicited_waiter &waiter, TickType_t ticks_to_wait)
+{
+    waiter.task = xTaskGetCurrentTaskHandle();
+    {
+        requests_guard guard(*this);
+        waiter.next = m_waiters;
+        m_waiters = &waiter;
+    }
+
+    TimeOut_t timeout;
+    vTaskSetTimeOutState(&timeout);
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, ticks_to_wait);
+
+        requests_guard guard(*this);
+        if (waiter.is_matched)
+        {
+            // The match may have happened after the timeout has woken the task, so clear its notification.
+            ulTaskNotifyTake(pdTRUE, 0);
+            return true;
+        }
+        if (xTaskCheckForTimeOut(&timeout, &ticks_to_wait) == pdTRUE)
+        {
+            auto link = &m_waiters;
+            while (*link != &waiter)
+                link = &(*link)->next;
+            *link = waiter.next;
+            return false;
+        }
+    }
+}
+
+/**
+ * The line is classified without any lock. Only the one which may be a part of the response to the command in flight
+ * takes m_requests_mux; the unsolicited one is passed to the handlers right away, as only the receiver task touches
+ * them.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::handle_received_response(line_view response, size_t colon_pos)
+{
+    if constexpr (Config::is_stats)
+        m_stats.count_line();
+    auto cls = cmd_handler_type::classify_response(response, colon_pos);
+    if (!m_is_data_stream_in_flight && !cmd_handler_type::is_part_of_response(cls, m_awaited_command))
+    {
+        m_cmd_handler.handle_unsolicited_response(response, cls);
+        return;
+    }
+
+    pending_completion pending;
+    auto is_unsolicited = false;
+    request *sink_req = nullptr;
+    {
+        requests_guard guard(*this);
+        auto req = get_request_in_flight();
+
+        // The acknowledgement of a packet isn't a result code, so it's recognised before the line is parsed.
+        auto res = req && req->options.data_stream ? match_data_ack(*req->options.data_stream, response)
+                                                   : at_err::unknown;
+        if (res == at_err::unknown)
+        {
+            // The command may have ended since the snapshot has been read.
+            is_unsolicited = !req || !cmd_handler_type::is_part_of_response(cls, req->command);
+            if (!is_unsolicited)
+                res = cmd_handler_type::take_response_line(response, cls, req->command, req->response_payload);
+        }
+
+        if (!is_unsolicited)
+        {
+            req->lines_num++;
+
+            // The line is consumed right away, so the payload never holds more than a single line. The sink is
+            // invoked once the lock is released, so the other tasks aren't blocked by it.
+            if (req->options.sink && !req->response_payload.empty())
+            {
+                req->response_payload.swap_joined(m_sink_line);
+                req->is_sink_running = true;
+                sink_req = req;
+            }
+
+            // The device awaits the message which can't be transmitted, so the command ends right here.
+            if (res == at_err::prompt_request && !handle_prompt_request(*req))
+                res = at_err::tx_overflow;
+            if (is_final_result_code(res) || res == at_err::tx_overflow)
+                finish_request_in_flight(*req, res, pending);
+        }
+    }
+
+    if (sink_req)
+        invoke_sink(*sink_req);
+    if (is_unsolicited)
+        m_cmd_handler.handle_unsolicited_response(response, cls);
+    invoke_completion(pending);
+}
+
+/**
+ * Called by the receiver task without the lock. The request may end meanwhile, but its slot isn't released till its
+ * issuer is told that the call is over.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::invoke_sink(request &req)
+{
+    req.options.sink(m_sink_line);
+
+    requests_guard guard(*this);
+    req.is_sink_running = false;
+    if (req.is_sink_awaited)
+        xSemaphoreGive(req.done_sem);
+}
+
+/**
+ * Must be called with m_requests_mux taken, when the final result of the request in flight is known. The completion,
+ * if any, is taken into pending, to be invoked by invoke_completion() once the lock has been released.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::finish_request_in_flight(request &req,
+                                                                   at_err result,
+                                                                   pending_completion &pending)
+{
+    if constexpr (Config::is_stats)
+        m_stats.count_result(result);
+    record_latency(req);
+    // The next command of the batch takes the place of this one, without waking up the issuer.
+    if (start_next_batch_entry(req, result))
+        return;
+    complete_request(req, result);
+    if (req.completion)
+    {
+        // Taken while the lock is held, as get_async_result() and abort_async() look at the slot meanwhile; without
+        // the id they don't find it anymore.
+        pending.req = &req;
+        pending.completion = std::move(req.completion);
+        pending.result = req.result;
+        pending.response_payload = req.response_payload.release_joined();
+        req.id = 0;
+    }
+    // The slot for the next command is free immediately after the final result code has arrived.
+    transmit_next_request();
+}
+
+/**
+ * The callback is invoked without any lock taken, so it may issue another command on its own. The request is released
+ * beforehand, so that command finds the slot of this one free, even when the queue has been full.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::invoke_completion(pending_completion &pending)
+{
+    if (!pending.req)
+        return;
+    release_request(*pending.req);
+    pending.completion(pending.result, std::move(pending.response_payload));
+}
+
+//! Called by the receiver task, when the request in flight hasn't fit into the TX buffer.
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::fail_overflowed_request()
+{
+    pending_completion pending;
+    {
+        requests_guard guard(*this);
+        m_is_tx_overflowed = false;
+        // The request may have been withdrawn meanwhile, by its issuer on timeout.
+        auto req = get_request_in_flight();
+        if (req && req->is_tx_overflowed)
+        {
+            req->is_tx_overflowed = false;
+            finish_request_in_flight(*req, at_err::tx_overflow, pending);
+        }
+    }
+
+    invoke_completion(pending);
+}
+
+/**
+ * Returns the cached payload when it's fresh (unless cache_slot is -1). Otherwise the first issuer of the query sends
+ * it and the ones which come meanwhile await its response, so the query is transmitted once, no matter how many tasks
+ * issue it. The waiters get the result of the sender, also when it has timed out.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+at_err at_channel<CommandSet, Hal, Config>::send_shared(int cache_slot,
+                                                        cmd command,
+                                                        at_cmd_type command_type,
+                                                        TickType_t ticks_to_wait,
+                                                        at_string &response_payload,
+                                                        at_priority priority)
+{
+    flight own;
+    flight *joined = nullptr;
+    flight_waiter waiter;
+    {
+        requests_guard guard(*this);
+        if constexpr (is_response_cache)
+            if (cache_slot >= 0)
+            {
+                auto slot = static_cast<size_t>(cache_slot);
+                auto ttl = pdMS_TO_TICKS(m_response_cache.get_ttl_ms(slot));
+                if (m_response_cache.get(slot, xTaskGetTickCount(), ttl, response_payload))
+                    return at_err::ok;
+            }
+
+        joined = m_flights;
+        while (joined && (joined->command != command || joined->command_type != command_type))
+            joined = joined->next;
+        if (joined)
+        {
+            waiter.payload = &response_payload;
+            waiter.task = xTaskGetCurrentTaskHandle();
+            waiter.next = joined->waiters;
+            joined->waiters = &waiter;
+        }
+        else
+        {
+            own.command = command;
+            own.command_type = command_type;
+            own.next = m_flights;
+            m_flights = &own;
+            if constexpr (is_response_cache)
+                if (cache_slot >= 0)
+                    m_response_cache.begin_fill(static_cast<size_t>(cache_slot));
+        }
+    }
+    if (joined)
+        return await_flight(*joined, waiter, ticks_to_wait);
+
+    auto command_prefix = cmd_handler_type::get_cmd_prefix(command, command_type);
+    request_options options;
+    options.priority = priority;
+    auto result =
+        send_and_get_response(command, response_payload, ticks_to_wait, command_prefix, {}, {}, std::move(options));
+
+    requests_guard guard(*this);
+    if constexpr (is_response_cache)
+        if (cache_slot >= 0)
+            m_response_cache.end_fill(static_cast<size_t>(cache_slot), xTaskGetTickCount(), result, response_payload);
+
+    auto link = &m_flights;
+    while (*link != &own)
+        link = &(*link)->next;
+    *link = own.next;
+
+    // The waiters may leave their stack frames only after they take the mutex, so they're touched safely till the end.
+    for (auto w = own.waiters; w; w = w->next)
+    {
+        *w->payload = response_payload;
+        w->result = result;
+        w->is_done = true;
+        xTaskNotifyGive(w->task);
+    }
+    return result;
+}
+
+//! The same as wait_for(), but the waiter is woken by the sender of the query. The flight lasts till it's done.
+template <typename CommandSet, typename Hal, typename Config>
+at_err at_channel<CommandSet, Hal, Config>::await_flight(flight &f, flight_waiter &waiter, TickType_t ticks_to_wait)
+{
+    TimeOut_t timeout;
+    vTaskSetTimeOutState(&timeout);
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, ticks_to_wait);
+
+        requests_guard guard(*this);
+        if (waiter.is_done)
+        {
+            ulTaskNotifyTake(pdTRUE, 0);
+            return waiter.result;
+        }
+        if (xTaskCheckForTimeOut(&timeout, &ticks_to_wait) == pdTRUE)
+        {
+            auto link = &f.waiters;
+            while (*link != &waiter)
+                link = &(*link)->next;
+            *link = waiter.next;
+            return at_err::timeout;
+        }
+    }
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+template <typename Payload>
+at_err at_channel<CommandSet, Hal, Config>::send_and_get_response(cmd command,
+                                                                  Payload &response_payload,
+                                                                  TickType_t ticks_to_wait,
+                                                                  std::string_view prefix,
+                                                                  at_string &&payload,
+                                                                  prompt_msg &&prompt,
+                                                                  request_options &&options)
+{
+    auto profile = cmd_handler_type::get_timeout_profile(command);
+    // The profile tells how long the command lasts once it's transmitted, so the window for which it may be held is
+    // added.
+    if (ticks_to_wait == at_profile_timeout)
+        ticks_to_wait = pdMS_TO_TICKS(profile.total_ms) + Config::tx_gather_ticks;
+
+    TimeOut_t timeout;
+    vTaskSetTimeOutState(&timeout);
+
+    // Wait for a free slot when the queue is full.
+    if (!take_free_slot(options, ticks_to_wait))
+        return at_err::timeout;
+    // The time spent on waiting for the slot is included in the time of waiting for the response.
+    if (xTaskCheckForTimeOut(&timeout, &ticks_to_wait) == pdTRUE)
+        ticks_to_wait = 0;
+
+    auto req =
+        enqueue_request(command, prefix, std::move(payload), std::move(prompt), false, {}, nullptr, std::move(options))
+            .first;
+
+    await_request(*req, ticks_to_wait, pdMS_TO_TICKS(profile.inter_line_ms));
+
+    at_err result = at_err::timeout;
+    auto is_sink_running = false;
+    {
+        requests_guard guard(*this);
+        if (req->is_done)
+        {
+            // The request might have been completed right after the timeout, so consume the notification.
+            xSemaphoreTake(req->done_sem, 0);
+            take_response_payload(*req, response_payload);
+            result = req->result;
+        }
+        else
+        {
+            if constexpr (Config::is_stats)
+                m_stats.count_result(at_err::timeout);
+            withdraw_request(*req);
+        }
+
+        // The sink of the issuer may be being invoked with the last line, so the issuer doesn't return before.
+        is_sink_running = req->is_sink_running;
+        req->is_sink_awaited = is_sink_running;
+    }
+    if (is_sink_running)
+        xSemaphoreTake(req->done_sem, portMAX_DELAY);
+    release_request(*req);
+
+    return result;
+}
+
+/**
+ * Returns when the request is done or when it has timed out: either the ticks are up or no line of the response has
+ * arrived for inter_line_ticks since the previous one. Zero inter_line_ticks means that there is no such limit.
+ * Only the issuer of the request is woken up when it's done, so the issuer wakes up meanwhile only to check the lines.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::await_request(request &req,
+                                                        TickType_t ticks_to_wait,
+                                                        TickType_t inter_line_ticks)
+{
+    if (inter_line_ticks == 0)
+    {
+        xSemaphoreTake(req.done_sem, ticks_to_wait);
+        return;
+    }
+
+    TimeOut_t timeout;
+    vTaskSetTimeOutState(&timeout);
+    unsigned seen_lines_num = 0;
+    for (;;)
+    {
+        if (xSemaphoreTake(req.done_sem, std::min(ticks_to_wait, inter_line_ticks)) == pdTRUE)
+            return;
+        if (xTaskCheckForTimeOut(&timeout, &ticks_to_wait) == pdTRUE)
+            return;
+
+        // The silence counts only after the first line, while the request is in flight, not while it's queued.
+        requests_guard guard(*this);
+        if (req.lines_num != 0 && req.lines_num == seen_lines_num && m_requests.front() == &req)
+            return;
+        seen_lines_num = req.lines_num;
+    }
+}
+
+/**
+ * A free slot must be reserved with take_free_slot() before calling this. Returns the request along with its
+ * identifier, because an asynchronous request may be completed and released before the caller accesses it.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+std::pair<typename at_channel<CommandSet, Hal, Config>::request *, unsigned>
+at_channel<CommandSet, Hal, Config>::enqueue_request(cmd command,
+                                                     std::string_view prefix,
+                                                     at_string &&payload,
+                                                     prompt_msg &&prompt,
+                                                     bool is_async,
+                                                     at_async_completion &&completion,
+                                                     os_flag *done_flag,
+                                                     request_options &&options)
+{
+    requests_guard guard(*this);
+    auto req = m_requests.acquire();
+    req->command = command;
+    req->prefix = prefix;
+    req->payload = std::move(payload);
+    req->prompt = std::move(prompt);
+    req->response_payload.clear();
+    req->response_payload.reserve(cmd_handler_type::get_response_size(command));
+    req->result = at_err::unknown;
+    req->is_done = false;
+    req->is_async = is_async;
+    req->completion = std::move(completion);
+    req->done_flag = done_flag;
+    req->options = std::move(options);
+    req->batch_idx = 0;
+    req->lines_num = 0;
+    req->is_sink_running = false;
+    req->is_sink_awaited = false;
+    if constexpr (Config::is_latency_stats)
+        req->enqueued_timestamp = Hal::get_timestamp();
+    // Zero is reserved for the free slots and the invalid handles.
+    if (++m_last_request_id == 0)
+        ++m_last_request_id;
+    req->id = m_last_request_id;
+    m_requests.push(req, to_u_type(req->options.priority), Config::max_overtakes);
+    schedule_request(*req);
+
+    return {req, req->id};
+}
+
+/**
+ * The urgent requests take the reserved slot only when all the other slots are taken, so the slot stays available for
+ * the next urgent request.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+bool at_channel<CommandSet, Hal, Config>::take_free_slot(request_options &options, TickType_t ticks_to_wait)
+{
+    options.is_reserved_slot = false;
+    if (options.priority == at_priority::normal)
+        return xSemaphoreTake(m_free_requests_sem, ticks_to_wait) == pdTRUE;
+
+    if (xSemaphoreTake(m_free_requests_sem, 0) == pdTRUE)
+        return true;
+    options.is_reserved_slot = true;
+    return xSemaphoreTake(m_urgent_slot_sem, ticks_to_wait) == pdTRUE;
+}
+
+//! The request must have been removed from the queue before calling this.
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::release_request(request &req)
+{
+    bool is_reserved_slot;
+    {
+        requests_guard guard(*this);
+        is_reserved_slot = req.options.is_reserved_slot;
+        req.id = 0;
+        req.is_async = false;
+        req.is_tx_overflowed = false;
+        req.completion = nullptr;
+        req.done_flag = nullptr;
+        req.options = {};
+        m_requests.release(&req);
+    }
+    xSemaphoreGive(is_reserved_slot ? m_urgent_slot_sem : m_free_requests_sem);
+}
+
+/**
+ * Must be called with m_requests_mux taken. The strings are swapped rather than moved, so the slot keeps the capacity
+ * of the caller's string: the long responses (e.g. on AT+CMGL) aren't reallocated line by line for every request.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::take_response_payload(request &req, at_string &response_payload)
+{
+    req.response_payload.swap_joined(response_payload);
+}
+
+//! Must be called with m_requests_mux taken. Like the other overload, the slot keeps the buffer of the caller's list.
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::take_response_payload(request &req, at_line_list &response_lines)
+{
+    response_lines.swap(req.response_payload);
+    req.response_payload.clear();
+}
+
+//! Must be called with m_requests_mux taken.
+template <typename CommandSet, typename Hal, typename Config>
+typename at_channel<CommandSet, Hal, Config>::request *
+at_channel<CommandSet, Hal, Config>::find_data_packet(const at_data_stream &stream, unsigned seq)
+{
+    for (auto &req : m_requests.slots())
+        if (req.id != 0 && req.options.data_stream == &stream && req.options.data_seq == seq)
+            return &req;
+    return nullptr;
+}
+
+/**
+ * Waits for the oldest packet of the stream and releases its slot. The packets are completed in the order they have
+ * been queued, so the window moves by one packet. On timeout the packet is left in flight.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+at_err at_channel<CommandSet, Hal, Config>::collect_data_packet(at_data_stream &stream, TickType_t ticks_to_wait)
+{
+    request *req;
+    {
+        requests_guard guard(*this);
+        req = find_data_packet(stream, stream.collected_num);
+    }
+    // Each packet sent and not collected yet holds its slot, unless the stream is used by another channel.
+    configASSERT(req);
+    xSemaphoreTake(req->done_sem, ticks_to_wait);
+
+    at_err result;
+    {
+        requests_guard guard(*this);
+        if (!req->is_done)
+            return at_err::timeout;
+        // The packet might have been acknowledged right after the timeout, so consume the notification.
+        xSemaphoreTake(req->done_sem, 0);
+        result = req->result;
+    }
+    stream.bytes_in_flight -= req->prompt.borrowed_message.size();
+    release_request(*req);
+
+    ++stream.collected_num;
+    if (result != at_err::ok && stream.error == at_err::ok)
+        stream.error = result;
+    return at_err::ok;
+}
+
+/**
+ * The newest packets are withdrawn first, so the next packet of the stream isn't started when the one in flight is
+ * withdrawn.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::withdraw_data_packets(at_data_stream &stream)
+{
+    std::array<request *, Config::cmd_queue_len> packets{};
+    auto packets_num = stream.sent_num - stream.collected_num;
+    {
+        requests_guard guard(*this);
+        for (auto i = packets_num; i-- > 0;)
+        {
+            auto req = find_data_packet(stream, stream.collected_num + i);
+            configASSERT(req);
+            if (req->is_done)
+                xSemaphoreTake(req->done_sem, 0);
+            else
+            {
+                if constexpr (Config::is_stats)
+                    m_stats.count_result(at_err::timeout);
+                withdraw_request(*req);
+            }
+            packets[i] = req;
+        }
+    }
+    for (size_t i = 0; i < packets_num; ++i)
+        release_request(*packets[i]);
+
+    stream.collected_num = stream.sent_num;
+    stream.bytes_in_flight = 0;
+}
+
+//! Returns at_err::unknown when the line is neither the acknowledgement nor the rejection of a packet of the stream.
+template <typename CommandSet, typename Hal, typename Config>
+at_err at_channel<CommandSet, Hal, Config>::match_data_ack(const at_data_stream &stream, const line_view &response)
+{
+    auto is_matched = [&response](std::string_view token) {
+        return !token.empty() && token.length() <= response.length()
+               && (response.starts_with(token) || response.contains_at(response.length() - token.length(), token));
+    };
+    if (is_matched(stream.ack))
+        return at_err::ok;
+    if (is_matched(stream.failure))
+        return at_err::error;
+    return at_err::unknown;
+}
+
+//! Must be called with m_requests_mux taken.
+template <typename CommandSet, typename Hal, typename Config>
+typename at_channel<CommandSet, Hal, Config>::request *
+at_channel<CommandSet, Hal, Config>::find_request(at_async_handle handle)
+{
+    if (!handle.is_valid())
+        return nullptr;
+
+    for (auto &req : m_requests.slots())
+        if (req.id == handle.id && req.is_async)
+            return &req;
+    return nullptr;
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_async_handle at_channel<CommandSet, Hal, Config>::send_async(cmd command,
+                                                                at_cmd_type command_type,
+                                                                at_string &&payload,
+                                                                at_async_completion &&completion,
+                                                                os_flag *done_flag,
+                                                                at_priority priority)
+{
+    request_options options;
+    options.priority = priority;
+
+    // Never block the caller, even when the queue is full.
+    if (!take_free_slot(options, 0))
+        return {};
+
+    if (done_flag)
+        done_flag->reset();
+
+    auto command_prefix = cmd_handler_type::get_cmd_prefix(command, command_type);
+    auto id = enqueue_request(command,
+                              command_prefix,
+                              std::move(payload),
+                              {},
+                              true,
+                              std::move(completion),
+                              done_flag,
+                              std::move(options))
+                  .second;
+    return {id};
+}
+
+//! Must be called with m_requests_mux taken. Returns nullptr also while the queued commands are held.
+template <typename CommandSet, typename Hal, typename Config>
+typename at_channel<CommandSet, Hal, Config>::request *at_channel<CommandSet, Hal, Config>::get_request_in_flight()
+{
+    return m_is_gathering ? nullptr : m_requests.front();
+}
+
+/**
+ * Must be called with m_requests_mux taken, for the request just queued. A command with the normal priority which
+ * comes while the device sleeps starts the window of Config::tx_gather_ticks, which the receiver task awaits.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::schedule_request(request &req)
+{
+    if constexpr (is_tx_gathered)
+    {
+        if (m_is_gathering)
+        {
+            // Neither the urgent command nor the issuers which would wait for a free slot wait for the window.
+            // The held commands go first then, as the front of the queue is never overtaken.
+            if (req.options.priority == at_priority::urgent || m_requests.size() >= Config::cmd_queue_len)
+            {
+                m_is_gathering = false;
+                transmit_next_request();
+            }
+            return;
+        }
+        if (!m_is_device_awake && req.options.priority == at_priority::normal)
+        {
+            m_is_gathering = true;
+            m_gathering_start = xTaskGetTickCount();
+            notify_rx_task();
+            return;
+        }
+    }
+
+    // When no other command is in flight then send this one straight away. Otherwise it will be sent by the
+    // receiver task, once the final result code of the previous command arrives.
+    if (m_requests.front() == &req)
+        transmit_request(req);
+}
+
+//! Called by the receiver task. Returns how long the task may sleep before the window of the held commands ends.
+template <typename CommandSet, typename Hal, typename Config>
+TickType_t at_channel<CommandSet, Hal, Config>::transmit_gathered_requests_when_due()
+{
+    if constexpr (!is_tx_gathered)
+        return portMAX_DELAY;
+    else
+    {
+        requests_guard guard(*this);
+        if (!m_is_gathering)
+            return portMAX_DELAY;
+
+        auto elapsed = static_cast<TickType_t>(xTaskGetTickCount() - m_gathering_start);
+        if (elapsed < Config::tx_gather_ticks)
+            return Config::tx_gather_ticks - elapsed;
+
+        m_is_gathering = false;
+        transmit_next_request();
+        return portMAX_DELAY;
+    }
+}
+
+//! Must be called with m_requests_mux taken.
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::transmit_request(request &req)
+{
+    if (!m_is_device_awake)
+    {
+        m_is_device_awake = true;
+        if constexpr (Config::is_wake_line)
+            Hal::wake_device();
+        if constexpr (Config::is_stats)
+            m_stats.count_wake_cycle();
+    }
+    if constexpr (Config::is_stats)
+        m_stats.count_issued(to_u_type(req.command));
+    // Published before the transmission, because the response may follow immediately.
+    m_awaited_command = req.command;
+    m_is_data_stream_in_flight = req.options.data_stream != nullptr;
+    if constexpr (Config::is_latency_stats)
+    {
+        // The flags are set before the transmission starts, because it may complete immediately.
+        m_is_awaiting_first_rx_byte = false;
+        m_is_awaiting_tx_completion = true;
+        req.tx_started_timestamp = Hal::get_timestamp();
+    }
+    // Nothing is transmitted then, so the receiver task fails the request rather than awaiting its response.
+    if (!push_command(req.prefix, std::move(req.payload)))
+    {
+        req.is_tx_overflowed = true;
+        m_is_tx_overflowed = true;
+        notify_rx_task();
+        return;
+    }
+    // Armed before the transmission, because the response may follow immediately.
+    if (auto binary = req.options.binary)
+        m_rx_buf.arm_binary_mode(binary->header, binary->data, binary->capacity);
+    // Armed before the transmission, because the prompt may follow immediately.
+    if constexpr (Config::is_prompt_from_isr)
+        arm_prompt(req);
+    start_transmission();
+}
+
+//! Must be called with m_requests_mux taken.
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::transmit_next_request()
+{
+    if (auto next = m_requests.front())
+        transmit_request(*next);
+    else if (m_is_device_awake)
+    {
+        // The final result code of the last queued command has arrived, which ends the wake cycle.
+        m_is_device_awake = false;
+        if constexpr (Config::is_wake_line)
+            Hal::allow_device_sleep();
+    }
+}
+
+/**
+ * Must be called with m_requests_mux taken. When the request is in flight then the next one is started, so a command
+ * which is never responded doesn't block the whole queue.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::withdraw_request(request &req)
+{
+    auto was_in_flight = get_request_in_flight() == &req;
+    m_requests.remove(&req);
+    if constexpr (is_tx_gathered)
+        if (m_requests.is_empty())
+            m_is_gathering = false;
+    if (was_in_flight)
+    {
+        finish_binary_rx(req);
+        stop_borrowed_transmission();
+        m_awaited_command = cmd::none;
+        m_is_data_stream_in_flight = false;
+        // The rest of the line being received belongs to the withdrawn command, not to the next one.
+        taskENTER_CRITICAL();
+        m_rx_buf.discard_current_string();
+        taskEXIT_CRITICAL();
+        transmit_next_request();
+    }
+}
+
+//! Must be called with m_requests_mux taken, for the request in flight.
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::finish_binary_rx(request &req)
+{
+    if (!req.options.binary)
+        return;
+
+    // The RX interrupt mustn't write to the buffer of the issuer anymore, once the issuer may have returned.
+    taskENTER_CRITICAL();
+    req.options.binary->received_len = m_rx_buf.disarm_binary_mode();
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * Must be called with m_requests_mux taken, for the request in flight, when its final result code has arrived.
+ * Returns false when the request isn't a batch or the batch is done.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+bool at_channel<CommandSet, Hal, Config>::start_next_batch_entry(request &req, at_err result)
+{
+    auto &opts = req.options;
+    if (!opts.batch)
+        return false;
+
+    auto &done = opts.batch[req.batch_idx];
+    done.result = result;
+    take_response_payload(req, done.response_payload);
+
+    auto is_stopped = result != at_err::ok && opts.batch_policy == at_batch_policy::stop_on_error;
+    if (is_stopped || ++req.batch_idx == opts.batch_len)
+        return false;
+
+    auto &next = opts.batch[req.batch_idx];
+    req.command = next.command;
+    req.prefix = cmd_handler_type::get_cmd_prefix(next.command, next.command_type);
+    req.payload = std::move(next.payload);
+    if constexpr (Config::is_latency_stats)
+        req.enqueued_timestamp = Hal::get_timestamp();
+    transmit_request(req);
+    return true;
+}
+
+//! Must be called with m_requests_mux taken. Removes the request from the queue and wakes up its issuer.
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::complete_request(request &req, at_err result)
+{
+    finish_binary_rx(req);
+    stop_borrowed_transmission();
+    m_awaited_command = cmd::none;
+    m_is_data_stream_in_flight = false;
+    req.result = result;
+    req.is_done = true;
+    m_requests.remove(&req);
+    if (!req.is_async)
+        xSemaphoreGive(req.done_sem);
+    else if (req.done_flag)
+        req.done_flag->set();
+}
+
+/**
+ * The payload is moved into the TX buffer without copying. The prefix, the suffix and CRLF are referenced as they are
+ * static, so the transmission doesn't allocate any memory. Returns false when the command doesn't fit into the TX
+ * buffer, so nothing is transmitted.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+bool at_channel<CommandSet, Hal, Config>::transmit_command(std::string_view prefix,
+                                                           at_string &&payload,
+                                                           std::string_view suffix,
+                                                           std::string_view newline)
+{
+    if (!push_command(prefix, std::move(payload), suffix, newline))
+        return false;
+    start_transmission();
+    return true;
+}
+
+//! Returns false when the command doesn't fit into the TX buffer, in which case nothing is pushed.
+template <typename CommandSet, typename Hal, typename Config>
+bool at_channel<CommandSet, Hal, Config>::push_command(std::string_view prefix,
+                                                       at_string &&payload,
+                                                       std::string_view suffix,
+                                                       std::string_view newline)
+{
+    // The echo refers to the cleaned characters.
+    expect_echo();
+
+    // Clean the buffer before transmission
+    m_tx_buf.clean();
+
+    // A part of a command is never transmitted, e.g. when the withdrawn one is still in the buffer.
+    if (m_tx_buf.get_free_segments_num() < command_segments_num)
+        return false;
+
+    m_tx_buf.push_static(prefix);
+    auto is_payload = !payload.empty();
+    m_tx_buf.push_string(std::move(payload));
+    auto echoed_payload = is_payload ? m_tx_buf.get_last_pushed() : std::string_view{};
+    m_tx_buf.push_static(suffix);
+    m_tx_buf.push_static(newline);
+    expect_echo(prefix, echoed_payload, suffix);
+    return true;
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::start_transmission()
+{
+    if constexpr (Config::is_tx_dma)
+    {
+        // When a block is in progress then the following ones are started from the TX done interrupt. The critical
+        // section prevents from missing the moment when the interrupt finds out that there is nothing more to
+        // transmit.
+        taskENTER_CRITICAL();
+        if (!m_is_tx_block_in_progress)
+            transmit_next_block();
+        taskEXIT_CRITICAL();
+    }
+    else
+        Hal::enable_tx_it();
+}
+
+//! Called from the TX done interrupt or within a critical section.
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::transmit_next_block()
+{
+    if constexpr (Config::is_tx_dma)
+    {
+        auto block = m_tx_buf.peek_segment();
+        m_is_tx_block_in_progress = !block.empty();
+        if (m_is_tx_block_in_progress)
+        {
+            if constexpr (Config::is_stats)
+                m_stats.count_tx_bytes(block.length());
+            capture(at_capture_direction::tx, block.data(), block.length());
+            Hal::send_block(block.data(), block.length());
+        }
+        else
+        {
+            // Only the TX done interrupt ends the block which is awaited.
+            if (m_is_awaiting_tx_block_done)
+            {
+                m_is_awaiting_tx_block_done = false;
+                BaseType_t higher_prior_task_woken = pdFALSE;
+                xSemaphoreGiveFromISR(m_tx_block_done_sem, &higher_prior_task_woken);
+                portEND_SWITCHING_ISR(higher_prior_task_woken);
+            }
+            on_tx_completed();
+        }
+    }
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+std::string_view at_channel<CommandSet, Hal, Config>::get_prompt_suffix(at_prompt_end_policy policy)
+{
+    return policy == at_prompt_end_policy::ctrl_z ? ctrl_z_str : std::string_view{};
+}
+
+//! The message of the known length isn't terminated at all, as the device would take CRLF for the next command.
+template <typename CommandSet, typename Hal, typename Config>
+std::string_view at_channel<CommandSet, Hal, Config>::get_prompt_newline(at_prompt_end_policy policy)
+{
+    return policy == at_prompt_end_policy::none ? std::string_view{} : crlf_str;
+}
+
+//! Must be called with m_requests_mux taken. Returns false when the message doesn't fit into the TX buffer.
+template <typename CommandSet, typename Hal, typename Config>
+bool at_channel<CommandSet, Hal, Config>::handle_prompt_request(request &req)
+{
+    auto &prompt = req.prompt;
+    if (!prompt.valid)
+        return true;
+
+    auto suffix = get_prompt_suffix(prompt.policy);
+    auto newline = get_prompt_newline(prompt.policy);
+
+    // The RX interrupt has transmitted the message already, unless the prompt has been missed.
+    if constexpr (Config::is_prompt_from_isr)
+        if (!disarm_prompt())
+        {
+            prompt.valid = false;
+            return true;
+        }
+
+    prompt.valid = false;
+    if (!prompt.is_borrowed)
+        return transmit_command({}, std::move(prompt.prompt_message), suffix, newline);
+
+    // Referenced like the static segments, so the message isn't copied at all.
+    expect_echo();
+    m_tx_buf.clean();
+    if (m_tx_buf.get_free_segments_num() < prompt_segments_num)
+        return false;
+    m_tx_buf.push_static(prompt.borrowed_message);
+    m_tx_buf.push_static(suffix);
+    m_tx_buf.push_static(newline);
+    m_is_tx_borrowed = true;
+    expect_echo(prompt.borrowed_message, suffix);
+    start_transmission();
+    return true;
+}
+
+/**
+ * Must be called with m_requests_mux taken, after the command has been pushed to the TX buffer, so the interrupt
+ * pushes the message behind the command. The message is only
+ * referenced, as it stays within the request, so the interrupt doesn't touch any memory allocation.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::arm_prompt(request &req)
+{
+    auto &prompt = req.prompt;
+    if (!prompt.valid)
+        return;
+
+    m_armed_prompt_message = prompt.is_borrowed ? prompt.borrowed_message : std::string_view(prompt.prompt_message);
+    m_armed_prompt_suffix = get_prompt_suffix(prompt.policy);
+    m_armed_prompt_newline = get_prompt_newline(prompt.policy);
+    m_is_tx_borrowed = true;
+    taskENTER_CRITICAL();
+    m_is_prompt_armed = true;
+    taskEXIT_CRITICAL();
+}
+
+//! Returns true when the prompt has been still armed, i.e. the message hasn't been transmitted by the interrupt.
+template <typename CommandSet, typename Hal, typename Config>
+bool at_channel<CommandSet, Hal, Config>::disarm_prompt()
+{
+    taskENTER_CRITICAL();
+    auto was_armed = m_is_prompt_armed;
+    m_is_prompt_armed = false;
+    taskEXIT_CRITICAL();
+    return was_armed;
+}
+
+/**
+ * Replaces the echo which the RX interrupt discards. It's done within a critical section, as the interrupt matches the
+ * received characters against the echo.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::expect_echo(std::string_view first,
+                                                      std::string_view second,
+                                                      std::string_view third)
+{
+    if constexpr (Config::is_echo_suppressed)
+    {
+        taskENTER_CRITICAL();
+        m_rx_buf.expect_echo(first, second, third);
+        taskEXIT_CRITICAL();
+    }
+}
+
+//! Called from the RX interrupt, when at least one string has been terminated.
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::on_rx_string_ends()
+{
+    // The prompt is the only exceptional string. The TX buffer is idle meanwhile, as the command has been transmitted
+    // already, so the message is pushed without any lock. When it doesn't fit, then the prompt stays armed and the
+    // receiver task handles it, after cleaning the buffer.
+    if constexpr (Config::is_prompt_from_isr)
+        if (m_rx_buf.take_exceptional_string() && m_is_prompt_armed
+            && m_tx_buf.get_free_segments_num() >= prompt_segments_num)
+        {
+            m_is_prompt_armed = false;
+            m_tx_buf.push_static(m_armed_prompt_message);
+            m_tx_buf.push_static(m_armed_prompt_suffix);
+            m_tx_buf.push_static(m_armed_prompt_newline);
+            // This is the producer of the RX buffer, so it's safe to replace the echo right here.
+            if constexpr (Config::is_echo_suppressed)
+                m_rx_buf.expect_echo(m_armed_prompt_message, m_armed_prompt_suffix);
+            if constexpr (Config::is_tx_dma)
+            {
+                if (!m_is_tx_block_in_progress)
+                    transmit_next_block();
+            }
+            else
+                Hal::enable_tx_it();
+        }
+
+    notify_rx_task_from_isr();
+}
+
+/**
+ * Must be called with m_requests_mux taken, when the request in flight is done or withdrawn. The issuer may return
+ * right after, so its buffer mustn't be transmitted anymore: the rest of the transmission is dropped. A block which
+ * is being transmitted can't be stopped, so the task sleeps until the TX done interrupt signals its end, for at most
+ * tx_block_done_ticks.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::stop_borrowed_transmission()
+{
+    if (!m_is_tx_borrowed)
+        return;
+    m_is_tx_borrowed = false;
+    if constexpr (Config::is_prompt_from_isr)
+        disarm_prompt();
+    // The issuer may free the message, so its echo mustn't be matched anymore.
+    expect_echo();
+
+    taskENTER_CRITICAL();
+    m_tx_buf.pop_all();
+    taskEXIT_CRITICAL();
+
+    if constexpr (Config::is_tx_dma)
+    {
+        taskENTER_CRITICAL();
+        auto is_awaited = m_is_tx_block_in_progress;
+        m_is_awaiting_tx_block_done = is_awaited;
+        taskEXIT_CRITICAL();
+        if (!is_awaited || xSemaphoreTake(m_tx_block_done_sem, tx_block_done_ticks) == pdTRUE)
+            return;
+
+        // The interrupt may signal the end right after the timeout, so the next wait doesn't return on that.
+        taskENTER_CRITICAL();
+        m_is_awaiting_tx_block_done = false;
+        taskEXIT_CRITICAL();
+        xSemaphoreTake(m_tx_block_done_sem, 0);
+    }
+}
+
+//! Called from the TX interrupt or within a critical section, when there is nothing more to transmit.
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::on_tx_completed()
+{
+    // The next transmission starts a new record, even when nothing has been received meanwhile.
+    capture(at_capture_direction::tx, nullptr, 0, true);
+
+    if constexpr (Config::is_latency_stats)
+    {
+        if (!m_is_awaiting_tx_completion)
+            return;
+        m_tx_completed_timestamp = Hal::get_timestamp();
+        m_is_awaiting_tx_completion = false;
+        m_is_awaiting_first_rx_byte = true;
+    }
+}
+
+//! Called from the RX interrupt.
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::on_rx_bytes()
+{
+    if constexpr (Config::is_latency_stats)
+    {
+        if (!m_is_awaiting_first_rx_byte)
+            return;
+        m_first_rx_byte_timestamp = Hal::get_timestamp();
+        m_is_awaiting_first_rx_byte = false;
+    }
+}
+
+//! Called from the RX interrupt, when Config::rx_stream_len isn't zero.
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::stream_received_bytes(const char *bytes, size_t num, bool is_task_woken)
+{
+    // The receiver task doesn't block on the stream buffer, as it waits also for the issuers and the dispatcher, so
+    // the stream buffer never wakes it up by itself.
+    BaseType_t higher_prior_task_woken = pdFALSE;
+    auto num_sent = xStreamBufferSendFromISR(m_rx_stream, bytes, num, &higher_prior_task_woken);
+    m_num_dropped_on_rx_stream_overflow += num - num_sent;
+    // Woken once the trigger level is reached, not again for each of the characters which follow.
+    auto num_available = xStreamBufferBytesAvailable(m_rx_stream);
+    auto is_trigger_reached = num_available >= Config::rx_stream_trigger_level
+                              && num_available - num_sent < Config::rx_stream_trigger_level;
+    if (is_task_woken || is_trigger_reached)
+        notify_rx_task_from_isr();
+}
+
+/**
+ * Called by the receiver task, when the RX buffer has no line to handle. Passes the streamed characters to the RX
+ * buffer, till a line is terminated or the stream is empty.
+ */
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::fetch_rx_stream()
+{
+    std::array<char, rx_stream_chunk_len> chunk;
+    for (;;)
+    {
+        auto num = xStreamBufferReceive(m_rx_stream, chunk.data(), chunk.size(), 0);
+        if (num == 0)
+            return;
+        // The issuers change the state of the RX buffer within critical sections, relying on its producer not being
+        // preempted, like the interrupt. The interrupts are let run meanwhile, as they don't touch the RX buffer.
+        vTaskSuspendAll();
+        auto num_string_ends = m_rx_buf.push_bytes_and_count_string_ends(chunk.data(), num);
+        xTaskResumeAll();
+        capture(at_capture_direction::rx, chunk.data(), num, num_string_ends > 0);
+        if (num_string_ends > 0)
+            return;
+    }
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_channel<CommandSet, Hal, Config>::requests_guard::requests_guard(at_channel &channel) noexcept : m_channel(channel)
+{
+    if constexpr (Config::is_stats)
+    {
+        // The uncontended mutex is taken right away, without reading the time.
+        if (xSemaphoreTake(m_channel.m_requests_mux, 0) == pdTRUE)
+            return;
+        auto start = xTaskGetTickCount();
+        xSemaphoreTake(m_channel.m_requests_mux, portMAX_DELAY);
+        // Counted with the mutex taken, so the counters have a single writer.
+        m_channel.m_stats.count_mux_wait(static_cast<uint32_t>(xTaskGetTickCount() - start));
+    }
+    else
+        xSemaphoreTake(m_channel.m_requests_mux, portMAX_DELAY);
+}
+
+template <typename CommandSet, typename Hal, typename Config>
+at_channel<CommandSet, Hal, Config>::requests_guard::~requests_guard()
+{
+    xSemaphoreGive(m_channel.m_requests_mux);
+}
+
+//! Called from the interrupts or within a critical section. When is_record_end is set, the next bytes start a record.
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::capture(at_capture_direction direction,
+                                                  const char *bytes,
+                                                  size_t num,
+                                                  bool is_record_end)
+{
+    if constexpr (Config::capture_len > 0)
+    {
+        // The TX and the RX interrupts may preempt each other.
+        auto saved_interrupt_status = taskENTER_CRITICAL_FROM_ISR();
+        if (!m_is_capture_paused)
+        {
+            if (num > 0)
+                m_capture.append(direction, Hal::get_timestamp(), bytes, num);
+            if (is_record_end)
+                m_capture.end_record();
+        }
+        taskEXIT_CRITICAL_FROM_ISR(saved_interrupt_status);
+    }
+}
+
+//! Called from the RX interrupt, after the bytes have been pushed.
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::throttle_rx_if_full()
+{
+    if constexpr (is_rx_flow_control)
+    {
+        if (m_is_rx_throttled || m_rx_buf.get_num_chars() < Config::rx_rts_high_watermark)
+            return;
+
+        // The receiver task releases the lines within a critical section, so the state is consistent within it.
+        auto saved_interrupt_status = taskENTER_CRITICAL_FROM_ISR();
+        // The receiver task lets the device go only after releasing a line, so there must be one to release.
+        if (!m_is_rx_throttled && !m_rx_buf.is_empty())
+        {
+            m_is_rx_throttled = true;
+            Hal::release_rts();
+            if constexpr (Config::is_stats)
+                m_stats.count_rx_throttle();
+        }
+        taskEXIT_CRITICAL_FROM_ISR(saved_interrupt_status);
+    }
+}
+
+//! Called by the receiver task, after it has released a line.
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::unthrottle_rx_if_drained()
+{
+    if constexpr (is_rx_flow_control)
+    {
+        if (!m_is_rx_throttled)
+            return;
+
+        taskENTER_CRITICAL();
+        // The device is let go also when there is no line to handle anymore, while the line being received exceeds
+        // the low watermark.
+        if (m_rx_buf.get_num_chars() <= Config::rx_rts_low_watermark || m_rx_buf.is_empty())
+        {
+            m_is_rx_throttled = false;
+            Hal::assert_rts();
+        }
+        taskEXIT_CRITICAL();
+    }
+}
+
+//! Must be called with m_requests_mux taken, for the request in flight.
+template <typename CommandSet, typename Hal, typename Config>
+void at_channel<CommandSet, Hal, Config>::record_latency(const request &req)
+{
+    if constexpr (Config::is_latency_stats)
+    {
+        at_latency_timestamps t;
+        t.enqueued = req.enqueued_timestamp;
+        t.tx_started = req.tx_started_timestamp;
+        t.final_result_code = Hal::get_timestamp();
+
+        // The points which haven't been reached (e.g. the response has been parsed before the TX interrupt noticed
+        // the end of the transmission) are placed at the final result code, so their phases are zero.
+        taskENTER_CRITICAL();
+        t.tx_completed = m_is_awaiting_tx_completion ? t.final_result_code : m_tx_completed_timestamp;
+        t.first_rx_byte = m_is_awaiting_tx_completion || m_is_awaiting_first_rx_byte ? t.final_result_code
+                                                                                    : m_first_rx_byte_timestamp;
+        m_is_awaiting_tx_completion = false;
+        m_is_awaiting_first_rx_byte = false;
+        taskEXIT_CRITICAL();
+
+        m_latency_stats.record(to_u_type(req.command), t);
+    }
+}
+
+} // namespace jungles
+
+#endif /* AT_CHANNEL_HPP */
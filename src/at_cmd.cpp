@@ -5,89 +5,197 @@
  */
 #include "at_cmd.hpp"
 #include "FreeRTOS.h"
+#include "at_channel.hpp"
 #include "at_cmd_def.hpp"
 #include "at_cmd_handler.hpp"
 #include "hw_at.h"
-#include "neither/neither.hpp"
-#include "os.h"
-#include "os_lockguard.hpp"
-#include "os_queue.hpp"
-#include "semphr.h"
-#include "string_buf_rx.hpp"
-#include "string_buf_tx.hpp"
-#include "task.h"
 
 // --------------------------------------------------------------------------------------------------------------------
 // DEFINITIONS OF STRUCTURES, DATA TYPES, ...
 // --------------------------------------------------------------------------------------------------------------------
 
-#define CTRL_Z_STR "\x1A"
+#ifndef AT_CMD_HANDLER_RX_LINES_NUM
+#define AT_CMD_HANDLER_RX_LINES_NUM 16
+#endif /* AT_CMD_HANDLER_RX_LINES_NUM */
 
-struct at_work_result_struct
+#ifndef AT_CMD_HANDLER_CMD_QUEUE_LEN
+#define AT_CMD_HANDLER_CMD_QUEUE_LEN 4
+#endif /* AT_CMD_HANDLER_CMD_QUEUE_LEN */
+
+#ifndef AT_CMD_HANDLER_MAX_OVERTAKES
+#define AT_CMD_HANDLER_MAX_OVERTAKES 4
+#endif /* AT_CMD_HANDLER_MAX_OVERTAKES */
+
+#ifndef AT_CMD_HANDLER_URC_QUEUE_LEN
+#define AT_CMD_HANDLER_URC_QUEUE_LEN 0
+#endif /* AT_CMD_HANDLER_URC_QUEUE_LEN */
+
+#ifndef AT_CMD_HANDLER_RX_TASK_STACK_DEPTH
+#define AT_CMD_HANDLER_RX_TASK_STACK_DEPTH 1024
+#endif /* AT_CMD_HANDLER_RX_TASK_STACK_DEPTH */
+
+#ifndef AT_CMD_HANDLER_RX_TASK_PRIORITY
+#define AT_CMD_HANDLER_RX_TASK_PRIORITY 1
+#endif /* AT_CMD_HANDLER_RX_TASK_PRIORITY */
+
+#ifndef AT_CMD_HANDLER_RX_TASK_CORE_AFFINITY
+#define AT_CMD_HANDLER_RX_TASK_CORE_AFFINITY at_no_core_affinity
+#endif /* AT_CMD_HANDLER_RX_TASK_CORE_AFFINITY */
+
+#ifndef AT_CMD_HANDLER_URC_TASK_STACK_DEPTH
+#define AT_CMD_HANDLER_URC_TASK_STACK_DEPTH 1024
+#endif /* AT_CMD_HANDLER_URC_TASK_STACK_DEPTH */
+
+#ifndef AT_CMD_HANDLER_URC_TASK_PRIORITY
+#define AT_CMD_HANDLER_URC_TASK_PRIORITY 1
+#endif /* AT_CMD_HANDLER_URC_TASK_PRIORITY */
+
+#ifndef AT_CMD_HANDLER_URC_TASK_CORE_AFFINITY
+#define AT_CMD_HANDLER_URC_TASK_CORE_AFFINITY at_no_core_affinity
+#endif /* AT_CMD_HANDLER_URC_TASK_CORE_AFFINITY */
+
+//! Drives the port with the functions declared in hw_at.h.
+struct hw_at_hal
 {
-    at_cmd command;
-    at_err result;
-    std::string payload;
+    static void enable_rx_it()
+    {
+        hw_at_enable_rx_it();
+    }
 
-    at_work_result_struct(at_cmd command, at_err result, std::string &&payload)
-        : command(command), result(result), payload(std::move(payload))
+    static void enable_tx_it()
     {
+        hw_at_enable_tx_it();
     }
-};
 
-struct at_prompt_msg_struct
-{
-    at_prompt_end_policy policy;
-    std::string prompt_message;
-    bool valid = false;
+    static void disable_tx_it()
+    {
+        hw_at_disable_tx_it();
+    }
+
+    static void send_byte(char c)
+    {
+        hw_at_send_byte(c);
+    }
+
+#ifdef AT_CMD_HANDLER_TX_DMA
+    static void send_block(const char *data, size_t len)
+    {
+        hw_at_send_block(data, len);
+    }
+#endif /* AT_CMD_HANDLER_TX_DMA */
+
+#ifdef AT_CMD_HANDLER_RX_RTS_HIGH_WATERMARK
+    static void assert_rts()
+    {
+        hw_at_assert_rts();
+    }
+
+    static void release_rts()
+    {
+        hw_at_release_rts();
+    }
+#endif /* AT_CMD_HANDLER_RX_RTS_HIGH_WATERMARK */
+
+#ifdef AT_CMD_HANDLER_WAKE_LINE
+    static void wake_device()
+    {
+        hw_at_wake_device();
+    }
+
+    static void allow_device_sleep()
+    {
+        hw_at_allow_device_sleep();
+    }
+#endif /* AT_CMD_HANDLER_WAKE_LINE */
 
-    void set(at_prompt_end_policy prompt_end_policy, std::string &&message)
+#if defined(AT_CMD_HANDLER_LATENCY_STATS) || defined(AT_CMD_HANDLER_CAPTURE_LEN)
+    static uint32_t get_timestamp()
     {
-        policy = prompt_end_policy;
-        prompt_message = std::move(message);
-        valid = true;
+        return hw_at_get_timestamp();
     }
+#endif /* defined(AT_CMD_HANDLER_LATENCY_STATS) || defined(AT_CMD_HANDLER_CAPTURE_LEN) */
 };
 
-// --------------------------------------------------------------------------------------------------------------------
-// DECLARATION OF PRIVATE FUNCTIONS AND VARIABLES
-// --------------------------------------------------------------------------------------------------------------------
-static at_cmd_handler cmd_handler;
+// The RX buffer is a ring indexed with a mask, so it can't be of any other size.
+static_assert(is_power_of_two(AT_CMD_HANDLER_RX_BUFLEN) && AT_CMD_HANDLER_RX_BUFLEN > 1,
+              "AT_CMD_HANDLER_RX_BUFLEN must be a power of two");
+static_assert(is_power_of_two(AT_CMD_HANDLER_RX_LINES_NUM) && AT_CMD_HANDLER_RX_LINES_NUM > 1,
+              "AT_CMD_HANDLER_RX_LINES_NUM must be a power of two");
 
-constexpr size_t rx_buf_len = AT_CMD_HANDLER_RX_BUFLEN;
+//! The configuration taken from at_cmd_config.hpp. The features which it doesn't enable keep their defaults.
+struct at_default_channel_config : jungles::at_channel_default_config
+{
+    static constexpr size_t rx_buf_len = AT_CMD_HANDLER_RX_BUFLEN;
+    static constexpr size_t rx_lines_num = AT_CMD_HANDLER_RX_LINES_NUM;
+    static constexpr size_t cmd_queue_len = AT_CMD_HANDLER_CMD_QUEUE_LEN;
+    static constexpr unsigned max_overtakes = AT_CMD_HANDLER_MAX_OVERTAKES;
+
+#ifdef AT_CMD_HANDLER_TX_DMA
+    static constexpr bool is_tx_dma = true;
+#endif /* AT_CMD_HANDLER_TX_DMA */
 
 #ifdef AT_CMD_HANDLER_NO_NEWLINE_AFTER_PROMPT
-static string_buf_rx<rx_buf_len> rx_buf(">");
-#elif /* AT_CMD_HANDLER_NO_NEWLINE_AFTER_PROMPT */
-static string_buf_rx<rx_buf_len> rx_buf;
+    static constexpr bool is_no_newline_after_prompt = true;
 #endif /* AT_CMD_HANDLER_NO_NEWLINE_AFTER_PROMPT */
-static string_buf_tx tx_buf;
 
-static TaskHandle_t at_rx_task_handle;
+#ifdef AT_CMD_HANDLER_PROMPT_FROM_ISR
+    static constexpr bool is_prompt_from_isr = true;
+#endif /* AT_CMD_HANDLER_PROMPT_FROM_ISR */
+
+#ifdef AT_CMD_HANDLER_LATENCY_STATS
+    static constexpr bool is_latency_stats = true;
+#endif /* AT_CMD_HANDLER_LATENCY_STATS */
+
+#ifdef AT_CMD_HANDLER_SINGLE_FLIGHT
+    static constexpr bool is_single_flight = true;
+#endif /* AT_CMD_HANDLER_SINGLE_FLIGHT */
+
+#ifdef AT_CMD_HANDLER_ECHO_SUPPRESSION
+    static constexpr bool is_echo_suppressed = true;
+#endif /* AT_CMD_HANDLER_ECHO_SUPPRESSION */
 
-//! Used to handle a single command at once.
-static SemaphoreHandle_t at_mux;
+#ifdef AT_CMD_HANDLER_RX_RTS_HIGH_WATERMARK
+    static constexpr size_t rx_rts_high_watermark = AT_CMD_HANDLER_RX_RTS_HIGH_WATERMARK;
+    static constexpr size_t rx_rts_low_watermark = AT_CMD_HANDLER_RX_RTS_LOW_WATERMARK;
+#endif /* AT_CMD_HANDLER_RX_RTS_HIGH_WATERMARK */
 
-//! Used to guard acces to at_cmd_handler.
-static SemaphoreHandle_t at_cmd_handler_mux;
+#ifdef AT_CMD_HANDLER_TX_GATHER_MS
+    static constexpr TickType_t tx_gather_ticks = pdMS_TO_TICKS(AT_CMD_HANDLER_TX_GATHER_MS);
+#endif /* AT_CMD_HANDLER_TX_GATHER_MS */
 
-static os_queue<at_cmd, 1> at_depute_work_queue;
-static os_queue<at_work_result_struct, 1> at_work_result_queue;
+#ifdef AT_CMD_HANDLER_WAKE_LINE
+    static constexpr bool is_wake_line = true;
+#endif /* AT_CMD_HANDLER_WAKE_LINE */
 
-static at_prompt_msg_struct at_prompt_data;
+#ifdef AT_CMD_HANDLER_STATS
+    static constexpr bool is_stats = true;
+#endif /* AT_CMD_HANDLER_STATS */
 
-static void at_rx_task(void *);
+#ifdef AT_CMD_HANDLER_CAPTURE_LEN
+    static constexpr size_t capture_len = AT_CMD_HANDLER_CAPTURE_LEN;
+#endif /* AT_CMD_HANDLER_CAPTURE_LEN */
+
+#ifdef AT_CMD_HANDLER_RX_STREAM_LEN
+    static constexpr size_t rx_stream_len = AT_CMD_HANDLER_RX_STREAM_LEN;
+    static constexpr size_t rx_stream_trigger_level = AT_CMD_HANDLER_RX_STREAM_TRIGGER_LEVEL;
+#endif /* AT_CMD_HANDLER_RX_STREAM_LEN */
+
+    static constexpr configSTACK_DEPTH_TYPE rx_task_stack_depth = AT_CMD_HANDLER_RX_TASK_STACK_DEPTH;
+    static constexpr UBaseType_t rx_task_priority = AT_CMD_HANDLER_RX_TASK_PRIORITY;
+    static constexpr UBaseType_t rx_task_core_affinity = AT_CMD_HANDLER_RX_TASK_CORE_AFFINITY;
+
+    static constexpr size_t urc_queue_len = AT_CMD_HANDLER_URC_QUEUE_LEN;
+    static constexpr configSTACK_DEPTH_TYPE urc_task_stack_depth = AT_CMD_HANDLER_URC_TASK_STACK_DEPTH;
+    static constexpr UBaseType_t urc_task_priority = AT_CMD_HANDLER_URC_TASK_PRIORITY;
+    static constexpr UBaseType_t urc_task_core_affinity = AT_CMD_HANDLER_URC_TASK_CORE_AFFINITY;
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF PRIVATE FUNCTIONS AND VARIABLES
+// --------------------------------------------------------------------------------------------------------------------
 
-template <typename... TransmitCommandArgs>
-static at_err at_send_and_get_response(at_cmd command,
-                                       std::string &response_payload,
-                                       TickType_t ticks_to_wait,
-                                       TransmitCommandArgs... transmit_command_args);
-static void transmit_command(std::string &&prefix);
-static void transmit_command(std::string &&prefix, std::string &&payload);
-static void handle_received_response(std::unique_ptr<std::string> response);
-template <typename... T> static void register_unsolicited_handler(T &&... args);
-static void handle_prompt_request();
+//! The channel which serves the commands from at_cmd_config.hpp on the port driven with hw_at.h.
+static jungles::at_channel<at_default_cmd_set, hw_at_hal, at_default_channel_config> at_default_channel;
 
 // --------------------------------------------------------------------------------------------------------------------
 // DEFINITION OF PUBLIC FUNCTIONS AND VARIABLES
@@ -95,215 +203,258 @@ static void handle_prompt_request();
 extern "C" void init_at();
 void init_at()
 {
-    xTaskCreate(at_rx_task, "at_rx", 1024, NULL, 1, &at_rx_task_handle);
-    at_mux = xSemaphoreCreateMutex();
-    at_cmd_handler_mux = xSemaphoreCreateMutex();
+    at_default_channel.init();
 }
 
 extern "C" void deinit_at();
 void deinit_at()
 {
-    vTaskDelete(at_rx_task_handle);
-    vSemaphoreDelete(at_mux);
-    vSemaphoreDelete(at_cmd_handler_mux);
+    at_default_channel.deinit();
+}
+
+at_err at_send(at_cmd command,
+               at_string &&payload,
+               TickType_t ticks_to_wait,
+               at_string &response_payload,
+               at_priority priority)
+{
+    return at_default_channel.send(command, std::move(payload), ticks_to_wait, response_payload, priority);
+}
+
+at_err at_send(at_cmd command, at_string &&payload, TickType_t ticks_to_wait, at_priority priority)
+{
+    return at_default_channel.send(command, std::move(payload), ticks_to_wait, priority);
+}
+
+at_err at_send(at_cmd command,
+               at_cmd_type command_type,
+               TickType_t ticks_to_wait,
+               at_string &response_payload,
+               at_priority priority)
+{
+    return at_default_channel.send(command, command_type, ticks_to_wait, response_payload, priority);
+}
+
+at_err at_send(at_cmd command, at_cmd_type command_type, TickType_t ticks_to_wait, at_priority priority)
+{
+    return at_default_channel.send(command, command_type, ticks_to_wait, priority);
+}
+
+at_err at_send(at_cmd command,
+               at_string &&payload,
+               TickType_t ticks_to_wait,
+               at_line_list &response_lines,
+               at_priority priority)
+{
+    return at_default_channel.send(command, std::move(payload), ticks_to_wait, response_lines, priority);
+}
+
+at_err at_send(at_cmd command,
+               at_cmd_type command_type,
+               TickType_t ticks_to_wait,
+               at_line_list &response_lines,
+               at_priority priority)
+{
+    return at_default_channel.send(command, command_type, ticks_to_wait, response_lines, priority);
 }
 
-at_err at_send(at_cmd command, std::string &&payload, TickType_t ticks_to_wait, std::string &response_payload)
+at_err at_send_streamed(at_cmd command, at_string &&payload, TickType_t ticks_to_wait, at_payload_sink sink)
 {
-    auto command_prefix = at_cmd_handler::prepare_cmd_prefix_to_transmit(command, at_cmd_type::write);
-    return at_send_and_get_response(
-        command, response_payload, ticks_to_wait, std::move(command_prefix), std::move(payload));
+    return at_default_channel.send_streamed(command, std::move(payload), ticks_to_wait, std::move(sink));
 }
 
-at_err at_send(at_cmd command, std::string &&payload, TickType_t ticks_to_wait)
+at_err at_send_streamed(at_cmd command, at_cmd_type command_type, TickType_t ticks_to_wait, at_payload_sink sink)
 {
-    std::string dummy_pload;
-    auto command_prefix = at_cmd_handler::prepare_cmd_prefix_to_transmit(command, at_cmd_type::write);
-    return at_send_and_get_response(command, dummy_pload, ticks_to_wait, std::move(command_prefix), std::move(payload));
+    return at_default_channel.send_streamed(command, command_type, ticks_to_wait, std::move(sink));
 }
 
-at_err at_send(at_cmd command, at_cmd_type command_type, TickType_t ticks_to_wait, std::string &response_payload)
+at_err at_send_binary_read(at_cmd command,
+                           at_string &&payload,
+                           TickType_t ticks_to_wait,
+                           at_binary_rx &binary,
+                           at_string &response_payload)
 {
-    auto command_prefix = at_cmd_handler::prepare_cmd_prefix_to_transmit(command, command_type);
-    return at_send_and_get_response(command, response_payload, ticks_to_wait, std::move(command_prefix));
+    return at_default_channel.send_binary_read(command, std::move(payload), ticks_to_wait, binary, response_payload);
 }
 
-at_err at_send(at_cmd command, at_cmd_type command_type, TickType_t ticks_to_wait)
+at_err at_send_batch(at_batch_entry *entries, size_t entries_num, at_batch_policy policy, TickType_t ticks_to_wait)
 {
-    std::string dummy_pload;
-    auto command_prefix = at_cmd_handler::prepare_cmd_prefix_to_transmit(command, command_type);
-    return at_send_and_get_response(command, dummy_pload, ticks_to_wait, std::move(command_prefix));
+    return at_default_channel.send_batch(entries, entries_num, policy, ticks_to_wait);
 }
 
 at_err at_send_prompted(at_cmd command,
-                        std::string payload,
-                        std::string prompt_message,
+                        at_string payload,
+                        at_string prompt_message,
                         at_prompt_end_policy policy,
                         TickType_t ticks_to_wait)
 {
-    std::string dummy_pload;
-    auto command_prefix = at_cmd_handler::prepare_cmd_prefix_to_transmit(command, at_cmd_type::write);
-    at_prompt_data.set(policy, std::move(prompt_message));
-    return at_send_and_get_response(command, dummy_pload, ticks_to_wait, std::move(command_prefix), std::move(payload));
+    return at_default_channel.send_prompted(
+        command, std::move(payload), std::move(prompt_message), policy, ticks_to_wait);
 }
 
-void at_register_unsolicited_handler(at_cmd command,
-                                     std::function<bool(std::unique_ptr<std::string> response_payload)> handler)
+at_err at_send_prompted(at_cmd command,
+                        at_string payload,
+                        const char *prompt_data,
+                        size_t prompt_len,
+                        at_prompt_end_policy policy,
+                        TickType_t ticks_to_wait)
 {
-    register_unsolicited_handler(command, handler);
+    return at_default_channel.send_prompted(
+        command, std::move(payload), prompt_data, prompt_len, policy, ticks_to_wait);
 }
 
-void at_register_unsolicited_handler(at_unsolicited_msg unsolicited_msg, std::function<bool(void)> handler)
+at_err at_send_data(at_data_stream &stream,
+                    at_cmd command,
+                    at_string &&payload,
+                    const char *data,
+                    size_t len,
+                    TickType_t ticks_to_wait)
 {
-    register_unsolicited_handler(unsolicited_msg, handler);
+    return at_default_channel.send_data(stream, command, std::move(payload), data, len, ticks_to_wait);
 }
 
-extern "C" void it_handle_at_byte_rx(char c);
-void it_handle_at_byte_rx(char c)
+at_err at_flush_data(at_data_stream &stream, TickType_t ticks_to_wait)
 {
-    // Notify the receiver task on the command end.
-    if (rx_buf.push_byte_and_is_string_end(c))
-        notify_from_isr(at_rx_task_handle);
+    return at_default_channel.flush_data(stream, ticks_to_wait);
 }
 
-extern "C" void it_handle_at_byte_tx();
-void it_handle_at_byte_tx()
+at_async_handle at_send_async(at_cmd command,
+                              at_cmd_type command_type,
+                              at_string &&payload,
+                              at_async_completion completion,
+                              at_priority priority)
 {
-    if (tx_buf.is_empty())
-        hw_at_disable_tx_it();
-    else
-        hw_at_send_byte(tx_buf.pop_byte());
+    return at_default_channel.send_async(command, command_type, std::move(payload), std::move(completion), priority);
 }
 
-// --------------------------------------------------------------------------------------------------------------------
-// DEFINITION OF PRIVATE FUNCTIONS
-// --------------------------------------------------------------------------------------------------------------------
-static void at_rx_task(void *)
+at_async_handle at_send_async(
+    at_cmd command, at_cmd_type command_type, at_string &&payload, os_flag &done_flag, at_priority priority)
 {
-    hw_at_enable_rx_it();
-    for (;;)
-    {
-        auto notif_num = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-        while (notif_num--)
-        {
-            auto response = rx_buf.pop_string();
-            if (response->length() == 0)
-                continue;
-
-            handle_received_response(std::move(response));
-        }
-    }
+    return at_default_channel.send_async(command, command_type, std::move(payload), done_flag, priority);
 }
 
-static void handle_received_response(std::unique_ptr<std::string> response)
+at_err at_get_async_result(at_async_handle handle, at_string &response_payload)
 {
-    static std::string response_payload;
-    static at_cmd awaited_cmd = at_cmd::none;
+    return at_default_channel.get_async_result(handle, response_payload);
+}
 
-    neither::Either<at_cmd, bool> work_input = at_depute_work_queue.receive(0);
-    if (work_input.isLeft)
-    {
-        // If a new command is being awaited then this string must be cleared in case of that the previous
-        // command hasn't been handled on time.
-        response_payload.clear();
-        // The task which deputes handling a new command passes a command name as a work input.
-        awaited_cmd = work_input.leftValue;
-    }
+bool at_abort_async(at_async_handle handle)
+{
+    return at_default_channel.abort_async(handle);
+}
 
-    at_err res = at_err::unknown;
-    {
-        os_lockguard guard(at_cmd_handler_mux);
-        res = cmd_handler.handle_received_response(std::move(response), awaited_cmd, response_payload);
-    }
+at_handler_token at_register_unsolicited_handler(at_cmd command,
+                                                 at_unsolicited_cmd_handler handler,
+                                                 at_dispatch dispatch)
+{
+    return at_default_channel.register_unsolicited_handler(command, std::move(handler), dispatch);
+}
 
-    if (res == at_err::ok || res == at_err::error || res == at_err::cme_error)
-    {
-        // Pass the work result.
-        at_work_result_queue.overwrite(awaited_cmd, res, std::move(response_payload));
-        awaited_cmd = at_cmd::none;
-    }
-    else if (res == at_err::prompt_request)
-        handle_prompt_request();
+at_handler_token at_register_unsolicited_handler(at_unsolicited_msg unsolicited_msg,
+                                                 at_unsolicited_msg_handler handler,
+                                                 at_dispatch dispatch)
+{
+    return at_default_channel.register_unsolicited_handler(unsolicited_msg, std::move(handler), dispatch);
 }
 
-template <typename... TransmitCommandArgs>
-static at_err at_send_and_get_response(at_cmd command,
-                                       std::string &response_payload,
-                                       TickType_t ticks_to_wait,
-                                       TransmitCommandArgs... transmit_command_args)
+bool at_unregister_unsolicited_handler(at_handler_token token)
 {
-    // Only single command at a time can be handled so take this mutex.
-    os_lockguard guard(at_mux);
-    at_depute_work_queue.overwrite(command);
-    
-    // Clean the buffer before transmission
-    tx_buf.clean();
+    return at_default_channel.unregister_unsolicited_handler(token);
+}
 
-    transmit_command(std::forward<TransmitCommandArgs>(transmit_command_args)...);
+bool at_wait_for_unsolicited(at_cmd command,
+                             TickType_t ticks_to_wait,
+                             at_payload_predicate predicate,
+                             at_string *payload)
+{
+    return at_default_channel.wait_for_unsolicited(command, ticks_to_wait, std::move(predicate), payload);
+}
 
-    while (true)
-    {
-        auto work_output = at_work_result_queue.receive(ticks_to_wait);
-        if (work_output.isLeft)
-        {
-            auto p = work_output.leftValue;
-            if (p.command != command)
-            {
-                // When the received command is not the awaited command then wait for the other result.
-                continue;
-            }
-            else
-            {
-                response_payload = std::move(p.payload);
-                return p.result;
-            }
-        }
-        else
-        {
-            return at_err::timeout;
-        }
-    }
+bool at_wait_for_unsolicited(at_unsolicited_msg unsolicited_msg, TickType_t ticks_to_wait)
+{
+    return at_default_channel.wait_for_unsolicited(unsolicited_msg, ticks_to_wait);
 }
 
-static void transmit_command(std::string &&prefix)
+void at_invalidate_cached_responses(at_cmd command)
 {
-    prefix += "\r\n";
-    tx_buf.push_string(std::make_unique<std::string>(std::move(prefix)));
-    hw_at_enable_tx_it();
+    at_default_channel.invalidate_cached_responses(command);
 }
 
-static void transmit_command(std::string &&prefix, std::string &&payload)
+at_rx_drop_stats at_get_rx_drop_stats()
 {
-    tx_buf.push_string(std::make_unique<std::string>(std::move(prefix)));
-    tx_buf.push_string(std::make_unique<std::string>(std::move(payload)));
-    tx_buf.push_string(std::make_unique<std::string>("\r\n"));
-    hw_at_enable_tx_it();
+    return at_default_channel.get_rx_drop_stats();
 }
 
-template <typename... T> static void register_unsolicited_handler(T &&... args)
+#if INCLUDE_uxTaskGetStackHighWaterMark == 1
+at_stack_high_water_marks at_get_stack_high_water_marks()
 {
-    // We want to enable the registration of the unsolicited handlers before the scheduler is running but we can't
-    // use a mutex before the scheduler is running so this check is musthave.
-    if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
-    {
-        os_lockguard g(at_cmd_handler_mux);
-        cmd_handler.register_unsolicited_handler(std::forward<T>(args)...);
-    }
-    else
-        cmd_handler.register_unsolicited_handler(std::forward<T>(args)...);
+    return at_default_channel.get_stack_high_water_marks();
 }
+#endif /* INCLUDE_uxTaskGetStackHighWaterMark == 1 */
 
-static void handle_prompt_request()
+extern "C" void it_handle_at_byte_rx(char c);
+void it_handle_at_byte_rx(char c)
 {
-    if (!at_prompt_data.valid)
-        return;
+    at_default_channel.it_handle_byte_rx(c);
+}
 
-    std::string suffix;
-    if (at_prompt_data.policy == at_prompt_end_policy::ctrl_z)
-        suffix = CTRL_Z_STR "\r\n";
-    else if (at_prompt_data.policy == at_prompt_end_policy::crlf)
-        suffix = "\r\n";
+extern "C" void it_handle_at_bytes_rx(const char *bytes, size_t num);
+void it_handle_at_bytes_rx(const char *bytes, size_t num)
+{
+    at_default_channel.it_handle_bytes_rx(bytes, num);
+}
+
+extern "C" void it_handle_at_byte_tx();
+void it_handle_at_byte_tx()
+{
+    at_default_channel.it_handle_byte_tx();
+}
+
+#ifdef AT_CMD_HANDLER_LATENCY_STATS
+const at_latency_histogram &at_get_latency_histogram(at_cmd command, at_latency_phase phase)
+{
+    return at_default_channel.get_latency_histogram(command, phase);
+}
+
+void at_reset_latency_stats()
+{
+    at_default_channel.reset_latency_stats();
+}
 
-    transmit_command(std::move(at_prompt_data.prompt_message), std::move(suffix));
-    at_prompt_data.valid = false;
+void at_dump_latency_stats(void (*print_line)(const char *line))
+{
+    at_default_channel.dump_latency_stats(print_line);
+}
+#endif /* AT_CMD_HANDLER_LATENCY_STATS */
+
+#ifdef AT_CMD_HANDLER_STATS
+at_stats at_get_stats()
+{
+    return at_default_channel.get_stats();
+}
+
+void at_dump_stats(void (*print_line)(const char *line))
+{
+    at_default_channel.dump_stats(print_line);
+}
+#endif /* AT_CMD_HANDLER_STATS */
+
+#ifdef AT_CMD_HANDLER_CAPTURE_LEN
+void at_export_capture(void (*write)(const char *data, size_t len))
+{
+    at_default_channel.export_capture(write);
+}
+
+void at_clear_capture()
+{
+    at_default_channel.clear_capture();
+}
+#endif /* AT_CMD_HANDLER_CAPTURE_LEN */
+
+#ifdef AT_CMD_HANDLER_TX_DMA
+extern "C" void it_handle_at_block_tx_done();
+void it_handle_at_block_tx_done()
+{
+    at_default_channel.it_handle_block_tx_done();
 }
+#endif /* AT_CMD_HANDLER_TX_DMA */
@@ -7,8 +7,8 @@
 #ifndef AT_CMD_GEN_HPP
 #define AT_CMD_GEN_HPP
 
-#include "at_cmd_config.hpp"
 #include <array>
+#include <cstdint>
 #include <string_view>
 
 #define STRINGIFY(X...) #X
@@ -51,19 +51,30 @@ constexpr bool is_alnum(char c) noexcept
     return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
 }
 
+constexpr char to_upper(char c) noexcept
+{
+    return c >= 'a' && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : c;
+}
+
 template <std::size_t N> constexpr std::array<char, N> to_upper(const std::array<char, N> &in)
 {
     std::array<char, N> out = {};
     for (unsigned i = 0; i < N; i++)
-    {
-        char c = in[i];
-        if (c >= 'a' && c <= 'z')
-            c = c - 'a' + 'A';
-        out[i] = c;
-    }
+        out[i] = to_upper(in[i]);
     return out;
 }
 
+//! Compares the strings as they are, or regardless of the case of the letters.
+constexpr bool is_equal(std::string_view a, std::string_view b, bool is_case_folded) noexcept
+{
+    if (a.length() != b.length())
+        return false;
+    for (std::size_t i = 0; i < a.length(); ++i)
+        if (a[i] != b[i] && (!is_case_folded || to_upper(a[i]) != to_upper(b[i])))
+            return false;
+    return true;
+}
+
 template <std::size_t OutArrSize, std::size_t InArrSize>
 constexpr std::array<std::string_view, OutArrSize> make_array_with_at_commands(const std::array<char, InArrSize> &in)
 {
@@ -84,4 +95,268 @@ constexpr std::array<std::string_view, OutArrSize> make_array_with_at_commands(c
     return arr;
 }
 
+/**
+ * \brief Calculates the number of characters needed to hold the full prefixes of all the commands, of all the types.
+ *
+ * The full prefix is "AT", '+' for extended commands (those starting from first_extended_idx), the name and the suffix
+ * of the type of the command (e.g. "=?").
+ */
+template <std::size_t N, std::size_t TypesNum>
+constexpr std::size_t calc_cmd_prefixes_len(const std::array<std::string_view, N> &names,
+                                            std::size_t first_extended_idx,
+                                            const std::array<std::string_view, TypesNum> &type_suffixes) noexcept
+{
+    std::size_t len = 0;
+    for (std::size_t i = 0; i < N; ++i)
+        for (auto suffix : type_suffixes)
+            len += 2 + (i >= first_extended_idx ? 1 : 0) + names[i].length() + suffix.length();
+    return len;
+}
+
+//! Puts the full prefixes one after another, in the order of the names and then of the suffixes.
+template <std::size_t Len, std::size_t N, std::size_t TypesNum>
+constexpr std::array<char, Len> make_cmd_prefixes_chars(const std::array<std::string_view, N> &names,
+                                                        std::size_t first_extended_idx,
+                                                        const std::array<std::string_view, TypesNum> &type_suffixes)
+{
+    std::array<char, Len> chars = {};
+    std::size_t pos = 0;
+    auto append = [&chars, &pos](std::string_view s) {
+        for (auto c : s)
+            chars[pos++] = c;
+    };
+    for (std::size_t i = 0; i < N; ++i)
+    {
+        for (auto suffix : type_suffixes)
+        {
+            append("AT");
+            if (i >= first_extended_idx)
+                append("+");
+            append(names[i]);
+            append(suffix);
+        }
+    }
+    return chars;
+}
+
+/**
+ * \brief Makes views over the prefixes made with make_cmd_prefixes_chars(), indexed by the name and the type.
+ *
+ * The characters must have static storage duration, so the views can be used at compile time.
+ */
+template <std::size_t Len, std::size_t N, std::size_t TypesNum>
+constexpr std::array<std::array<std::string_view, TypesNum>, N>
+make_cmd_prefixes(const std::array<char, Len> &chars,
+                  const std::array<std::string_view, N> &names,
+                  std::size_t first_extended_idx,
+                  const std::array<std::string_view, TypesNum> &type_suffixes)
+{
+    std::array<std::array<std::string_view, TypesNum>, N> prefixes = {};
+    std::size_t pos = 0;
+    for (std::size_t i = 0; i < N; ++i)
+    {
+        for (std::size_t t = 0; t < TypesNum; ++t)
+        {
+            std::size_t len = 2 + (i >= first_extended_idx ? 1 : 0) + names[i].length() + type_suffixes[t].length();
+            prefixes[i][t] = std::string_view{chars.data() + pos, len};
+            pos += len;
+        }
+    }
+    return prefixes;
+}
+
+//! Makes an array of the names followed by the other names, e.g. to match both with a single trie.
+template <std::size_t N, typename... Names>
+constexpr std::array<std::string_view, N + sizeof...(Names)> append_names(const std::array<std::string_view, N> &names,
+                                                                          Names... other_names)
+{
+    std::array<std::string_view, N + sizeof...(Names)> out = {};
+    std::size_t pos = 0;
+    for (; pos < N; ++pos)
+        out[pos] = names[pos];
+    ((out[pos++] = other_names), ...);
+    return out;
+}
+
+/**
+ * \brief A node of the trie of names made with make_name_trie(), i.e. a decision on a single character of a name.
+ *
+ * The children of a node are placed one after another, sorted by their characters.
+ */
+struct name_trie_node
+{
+    char c;
+    unsigned char children_num;
+    unsigned short first_child;
+
+    //! The index of the name which ends at this node incremented by one; zero when no name ends here.
+    unsigned short name_idx;
+};
+
+//! The node at which each walk down the trie starts.
+constexpr unsigned short name_trie_root{0};
+
+//! The walk has gone off the trie: no name starts with the characters walked so far.
+constexpr unsigned short name_trie_miss{0xFFFF};
+
+/**
+ * \brief Counts the nodes of the trie of the names starting from first_idx: the root and a node for each distinct
+ *        prefix. The prefixes which differ only in the case of the letters are the same when is_case_folded is set.
+ */
+template <std::size_t N>
+constexpr std::size_t
+calc_name_trie_size(const std::array<std::string_view, N> &names, std::size_t first_idx, bool is_case_folded = false)
+{
+    std::size_t size = 1;
+    for (std::size_t i = first_idx; i < N; ++i)
+    {
+        for (std::size_t len = 1; len <= names[i].length(); ++len)
+        {
+            bool is_new_prefix = true;
+            for (std::size_t j = first_idx; j < i && is_new_prefix; ++j)
+                is_new_prefix = !is_equal(names[j].substr(0, len), names[i].substr(0, len), is_case_folded);
+            size += is_new_prefix ? 1 : 0;
+        }
+    }
+    return size;
+}
+
+/**
+ * \brief Makes the trie of the names starting from first_idx, which maps a name to its index in a single pass over the
+ *        name, with no hashing and no comparison of the whole name afterwards.
+ *
+ * The nodes are placed breadth first, so the children of each node are contiguous. The names must be distinct.
+ * When is_case_folded is set, the letters of the nodes are uppercase, so the walk shall fold the case of the
+ * characters with to_upper(). The size must be calculated with calc_name_trie_size() with the same is_case_folded.
+ */
+template <std::size_t Size, std::size_t N>
+constexpr std::array<name_trie_node, Size>
+make_name_trie(const std::array<std::string_view, N> &names, std::size_t first_idx, bool is_case_folded = false)
+{
+    static_assert(Size < name_trie_miss, "The nodes are indexed with unsigned short");
+
+    std::array<name_trie_node, Size> trie = {};
+    // The prefix which leads to a node is the beginning of any name passing through it, up to the depth of the node.
+    std::array<std::size_t, Size> passing_name = {};
+    std::array<std::size_t, Size> depth = {};
+    std::size_t nodes_num = 1;
+    for (std::size_t node = 0; node < nodes_num; ++node)
+    {
+        auto prefix = names[passing_name[node]].substr(0, depth[node]);
+        trie[node].first_child = static_cast<unsigned short>(nodes_num);
+        // Add the children in the order of their characters, each time taking the lowest character not added yet.
+        int last_c = -1;
+        for (;;)
+        {
+            int next_c = 256;
+            std::size_t next_name = 0;
+            for (std::size_t i = first_idx; i < N; ++i)
+            {
+                if (!is_equal(names[i].substr(0, depth[node]), prefix, is_case_folded))
+                    continue;
+                if (names[i].length() == depth[node])
+                {
+                    trie[node].name_idx = static_cast<unsigned short>(i + 1);
+                    continue;
+                }
+                auto name_c = names[i][depth[node]];
+                int c = static_cast<unsigned char>(is_case_folded ? to_upper(name_c) : name_c);
+                if (c > last_c && c < next_c)
+                {
+                    next_c = c;
+                    next_name = i;
+                }
+            }
+            if (next_c == 256)
+                break;
+            trie[nodes_num].c = static_cast<char>(next_c);
+            passing_name[nodes_num] = next_name;
+            depth[nodes_num] = depth[node] + 1;
+            ++nodes_num;
+            ++trie[node].children_num;
+            last_c = next_c;
+        }
+    }
+    return trie;
+}
+
+//! Walks from the node down the edge of the character. Once off the trie, the walk stays off it.
+template <std::size_t Size>
+constexpr unsigned short name_trie_step(const std::array<name_trie_node, Size> &trie, unsigned short node, char c)
+{
+    if (node == name_trie_miss)
+        return name_trie_miss;
+    unsigned first = trie[node].first_child;
+    for (unsigned child = first; child != first + trie[node].children_num; ++child)
+        if (trie[child].c == c)
+            return static_cast<unsigned short>(child);
+    return name_trie_miss;
+}
+
+//! \returns the index of the name which ends at the node, or N when no name ends there.
+template <std::size_t N, std::size_t Size>
+constexpr std::size_t name_trie_match(const std::array<name_trie_node, Size> &trie, unsigned short node)
+{
+    if (node == name_trie_miss || trie[node].name_idx == 0)
+        return N;
+    return trie[node].name_idx - 1;
+}
+
+/**
+ * \brief Makes a table which tells, by the first character of a string, which names may be a prefix of the string.
+ *
+ * Each entry is a bitmask; the bit n is set when the n-th name starts with the character.
+ */
+template <std::size_t N>
+constexpr std::array<uint64_t, 256> make_first_char_index(const std::array<std::string_view, N> &names)
+{
+    static_assert(N <= 64, "At most 64 names can be indexed by the first character");
+
+    std::array<uint64_t, 256> table = {};
+    for (std::size_t i = 0; i < N; ++i)
+        if (!names[i].empty())
+            table[static_cast<unsigned char>(names[i][0])] |= uint64_t{1} << i;
+    return table;
+}
+
+/**
+ * \brief Makes an array of the handlers indexed by their keys, from a table of entries with 'key' and 'handler'.
+ *
+ * The keys without an entry get a value-initialised handler, i.e. nullptr for a pointer to a function.
+ */
+template <std::size_t N, typename Entry, std::size_t M>
+constexpr auto make_static_handler_index(const std::array<Entry, M> &entries)
+{
+    std::array<decltype(Entry::handler), N> index = {};
+    for (std::size_t i = 0; i < M; ++i)
+        index[static_cast<std::size_t>(to_u_type(entries[i].key))] = entries[i].handler;
+    return index;
+}
+
+/**
+ * \brief Makes an array of the timeout profiles indexed by the commands, from a table of entries with 'command' and
+ *        'profile'. The table may be a plain array.
+ *
+ * The commands without an entry get the default profile.
+ */
+template <std::size_t N, typename Profile, typename Entries>
+constexpr auto make_timeout_profile_index(const Entries &entries, Profile default_profile)
+{
+    std::array<Profile, N> index = {};
+    for (auto &profile : index)
+        profile = default_profile;
+    for (const auto &entry : entries)
+        index[static_cast<std::size_t>(to_u_type(entry.command))] = entry.profile;
+    return index;
+}
+
+//! Makes an array of the sizes indexed by the commands, from a table of entries with 'command' and 'bytes'.
+template <std::size_t N, typename Entries> constexpr auto make_response_size_index(const Entries &entries)
+{
+    std::array<std::size_t, N> index = {};
+    for (const auto &entry : entries)
+        index[static_cast<std::size_t>(to_u_type(entry.command))] = entry.bytes;
+    return index;
+}
+
 #endif /* AT_CMD_GEN_HPP */
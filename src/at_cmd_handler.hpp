@@ -8,78 +8,64 @@
 #define AT_CMD_HANDLER_HPP
 
 #include "at_cmd_def.hpp"
-#include <functional>
-#include <list>
-#include <memory>
-#include <string>
+#include "at_cmd_gen.hpp"
+#include "at_cmd_handler_impl.hpp"
+#include <array>
+#include <string_view>
+#include <tuple>
 
-enum class at_cmd;
+#define AT_COMMANDS_ALL AT_COMMANDS_NOT_EXTENDED, AT_COMMANDS_EXTENDED
+#define AT_COMMANDS_ALL_STRING TO_STRING(AT_COMMANDS_ALL)
 
-enum class at_err
+/**
+ * \brief The command set defined with the macros from at_cmd_config.hpp, mapped by enum class at_cmd and
+ *        enum class at_unsolicited_msg.
+ */
+struct at_default_cmd_set
 {
-    ok,
-    error,
-    cme_error,
-    handling_cmd,
-    prompt_request,
-    unknown,
-    timeout
-};
+    using cmd = at_cmd;
+    using unsolicited_msg = at_unsolicited_msg;
 
-enum class at_cmd_type
-{
-    exec,
-    write,
-    read,
-    test
-};
+    //! The string with all the commands, e.g. "e, d, s0, first, second", as they are listed in the macros.
+    static constexpr std::array<char, sizeof(AT_COMMANDS_ALL_STRING)> cmds_all_str{AT_COMMANDS_ALL_STRING};
+    static constexpr auto cmds_all_uppercase{to_upper(cmds_all_str)};
 
-struct at_unsolicited_cmd_record
-{
-    std::function<bool(std::unique_ptr<std::string>)> handler;
-    at_cmd command;
+    //! The names of the commands in uppercase. The first one is empty, for the simplest 'AT' command.
+    static constexpr auto cmd_names{
+        make_array_with_at_commands<to_u_type(at_cmd::number_of_commands)>(cmds_all_uppercase)};
 
-    at_unsolicited_cmd_record(std::function<bool(std::unique_ptr<std::string>)> handler, at_cmd command)
-        : handler(handler), command(command)
-    {
-    }
-};
+    //! The simplest 'AT' command is followed by the not-extended commands.
+    static constexpr std::size_t first_extended_cmd_idx{count(TO_STRING(AT_COMMANDS_NOT_EXTENDED), ',') + 2};
 
-struct at_unsolicited_msg_record
-{
-    std::function<bool(void)> handler;
-    at_unsolicited_msg message;
+    static constexpr std::array<std::string_view, to_u_type(at_unsolicited_msg::number_of_msgs)> unsolicited_msg_strs{
+        AT_UNSOLICITED_MESSAGES};
 
-    at_unsolicited_msg_record(std::function<bool(void)> handler, at_unsolicited_msg message)
-        : handler(handler), message(message)
-    {
-    }
-};
+#ifdef AT_COMMANDS_TIMEOUT_PROFILES
+    static constexpr at_cmd_timeout<at_cmd> timeout_profiles[]{AT_COMMANDS_TIMEOUT_PROFILES};
+#endif /* AT_COMMANDS_TIMEOUT_PROFILES */
 
-/**
- * \brief Handles received AT commands' responses, handles unsolicited commands, composes commands to transmit.
- *
- * This is not thread safe. Each access to a non-static method must be thread safe between each other.
- */
-class at_cmd_handler
-{
-  public:
-    //! Returns a string with AT command prefix ready to be sent to a device which handles AT commands.
-    static std::string prepare_cmd_prefix_to_transmit(at_cmd command, at_cmd_type command_type);
-
-    at_err handle_received_response(std::unique_ptr<std::string> response,
-                                    at_cmd awaited_command,
-                                    std::string &response_payload);
-    void register_unsolicited_handler(at_cmd unsolicited_command,
-                                      std::function<bool(std::unique_ptr<std::string>)> handler);
-    void register_unsolicited_handler(at_unsolicited_msg unsolicited_msg, std::function<bool(void)> handler);
-
-  private:
-    std::list<at_unsolicited_cmd_record> unsolicited_cmd_handlers;
-    std::list<at_unsolicited_msg_record> unsolicited_msg_handlers;
-    void handle_unsolicited_cmd(std::unique_ptr<std::string> response);
+#ifdef AT_COMMANDS_RESPONSE_SIZES
+    static constexpr at_cmd_response_size<at_cmd> response_sizes[]{AT_COMMANDS_RESPONSE_SIZES};
+#endif /* AT_COMMANDS_RESPONSE_SIZES */
+
+#ifdef AT_COMMANDS_CACHE_PROFILES
+    static constexpr at_cmd_cache_ttl<at_cmd> cache_profiles[]{AT_COMMANDS_CACHE_PROFILES};
+#endif /* AT_COMMANDS_CACHE_PROFILES */
+
+#ifdef AT_COMMANDS_PAYLOAD_SCHEMAS
+    using payload_schemas = std::tuple<AT_COMMANDS_PAYLOAD_SCHEMAS>;
+#endif /* AT_COMMANDS_PAYLOAD_SCHEMAS */
+
+#ifdef AT_COMMANDS_WRITE_SIGNATURES
+    using write_signatures = std::tuple<AT_COMMANDS_WRITE_SIGNATURES>;
+#endif /* AT_COMMANDS_WRITE_SIGNATURES */
+
+#ifdef AT_COMMANDS_TOLERANT_MATCHING
+    static constexpr bool is_tolerant_matching{true};
+#endif /* AT_COMMANDS_TOLERANT_MATCHING */
 };
 
-const char *at_err_to_string(at_err e);
+//! The handler of the commands defined in at_cmd_config.hpp.
+using at_cmd_handler = jungles::at_cmd_handler<at_default_cmd_set>;
 
 #endif /* AT_CMD_HANDLER_HPP */
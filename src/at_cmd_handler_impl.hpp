@@ -1,5 +1,5 @@
 /**
- * @file	at_cmd_handler.h
+ * @file	at_cmd_handler_impl.hpp
  * @brief	Defines the template for creating AT commands and parsing received responses on AT commands.
  * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
  */
@@ -7,27 +7,60 @@
 #ifndef AT_CMD_HANDLER_IMPL_HPP
 #define AT_CMD_HANDLER_IMPL_HPP
 
+#include "at_args.hpp"
+#include "at_cmd_gen.hpp"
+#include "at_line_list.hpp"
+#include "at_pool.hpp"
+#include "at_schema.hpp"
+#include "handler_table.hpp"
+#include "inplace_function.hpp"
+#include "line_view.hpp"
 #include <array>
-#include <functional>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 
-namespace jungles {
+#ifndef AT_CMD_HANDLER_CALLBACK_STORAGE_SIZE
+#define AT_CMD_HANDLER_CALLBACK_STORAGE_SIZE 32
+#endif /* AT_CMD_HANDLER_CALLBACK_STORAGE_SIZE */
+
+#ifndef AT_CMD_HANDLER_MAX_UNSOLICITED_HANDLERS
+#define AT_CMD_HANDLER_MAX_UNSOLICITED_HANDLERS 16
+#endif /* AT_CMD_HANDLER_MAX_UNSOLICITED_HANDLERS */
+
+#ifndef AT_CMD_HANDLER_DEFAULT_TIMEOUT_MS
+#define AT_CMD_HANDLER_DEFAULT_TIMEOUT_MS 1000
+#endif /* AT_CMD_HANDLER_DEFAULT_TIMEOUT_MS */
 
 enum class at_err
 {
     ok,
     error,
     cme_error,
+    cms_error,
+    no_carrier,
+    busy,
+    no_answer,
+    connect,
     handling_cmd,
     prompt_request,
-    handled_unsolicited,
     unknown,
-    timeout
+    timeout,
+
+    //! The command succeeded but its payload doesn't match the schema of the command. \see at_schema
+    invalid_payload,
+
+    //! The command or its message didn't fit into the TX buffer, so it hasn't been transmitted.
+    tx_overflow
 };
 
+//! The number of the values of at_err.
+constexpr size_t at_err_num = static_cast<size_t>(at_err::tx_overflow) + 1;
+
 enum class at_cmd_type
 {
     exec,
@@ -36,333 +69,1091 @@ enum class at_cmd_type
     test
 };
 
-enum class at_handler_policy
+const char *at_err_to_string(at_err e);
+
+//! Tells whether the result ends handling of the command, e.g. at_err::ok or at_err::cme_error.
+bool is_final_result_code(at_err e);
+
+//! The handler of an unsolicited command. Its captures must fit into AT_CMD_HANDLER_CALLBACK_STORAGE_SIZE bytes.
+using at_unsolicited_cmd_handler = inplace_function<bool(at_payload_ptr), AT_CMD_HANDLER_CALLBACK_STORAGE_SIZE>;
+
+//! The handler of an unsolicited message. Its captures must fit into AT_CMD_HANDLER_CALLBACK_STORAGE_SIZE bytes.
+using at_unsolicited_msg_handler = inplace_function<bool(void), AT_CMD_HANDLER_CALLBACK_STORAGE_SIZE>;
+
+//! Tells where an unsolicited handler is invoked.
+enum class at_dispatch
 {
-    keep,
-    remove
+    //! Right away by the task which parses the responses. Suits the short handlers which need the lowest latency.
+    immediate,
+
+    /**
+     * Later by a separate task, which gets the payload through a queue, so a slow handler doesn't delay parsing of the
+     * responses. The handler is invoked immediately when there is no such task.
+     */
+    deferred,
+
+    /**
+     * Like deferred, but only the latest payload is kept, in a slot of the handler, until the handler gets it. The
+     * arrivals in the meantime replace the payload and don't wake the task again, so a flood of state reports (e.g.
+     * "+CSQ") ends up in a single invocation and doesn't take any more memory: the replaced payload is reused for the
+     * next arrival.
+     */
+    coalesced
 };
 
-template <typename E> constexpr static auto to_u_type(E e) noexcept
+/**
+ * \brief Identifies a registered unsolicited handler, so it can be unregistered. False when the handler couldn't
+ *        be registered.
+ */
+struct at_handler_token
 {
-    return static_cast<std::underlying_type_t<E>>(e);
-}
+    handler_token record;
+    bool is_msg_handler = false;
+
+    explicit operator bool() const noexcept
+    {
+        return static_cast<bool>(record);
+    }
+};
+
+/**
+ * Passes a deferred unsolicited command or message to the task which invokes its handler. The payload is null for a
+ * message and for a coalesced handler, which takes the payload from its slot. Returns false when it can't be passed.
+ */
+using at_deferred_dispatcher =
+    inplace_function<bool(at_handler_token token, at_payload_ptr payload), AT_CMD_HANDLER_CALLBACK_STORAGE_SIZE>;
+
+//! Tells whether an awaited unsolicited command has arrived with the expected payload, e.g. "1" of "+CEREG: 1".
+using at_payload_predicate = inplace_function<bool(const line_view &payload), AT_CMD_HANDLER_CALLBACK_STORAGE_SIZE>;
+
+//! An entry of a table of the handlers which are known at build time. \see at_cmd_handler
+template <typename Key, typename Handler> struct at_static_handler
+{
+    Key key;
+    Handler handler;
+};
+
+//! How long a command may last, when it's awaited. \see at_cmd_handler
+struct at_timeout_profile
+{
+    //! From issuing the command to its final result code.
+    uint32_t total_ms;
 
-template <typename CmdsNotExtended,
-          typename CmdsExtended,
-          typename AsynchMsgs,
-          size_t CmdsNotExtendedNum,
-          size_t CmdsExtendedNum,
-          size_t AsynchMsgsNum>
-class at_cmd_handler
+    //! The longest silence between the lines of the response, after the first line. Zero means no such limit.
+    uint32_t inter_line_ms = 0;
+};
+
+//! An entry of a table of the timeout profiles of the commands. \see at_cmd_handler
+template <typename Cmd> struct at_cmd_timeout
 {
+    Cmd command;
+    at_timeout_profile profile;
+};
+
+//! An entry of a table of the queries which responses are cached, e.g. {cmd::csq, at_cmd_type::exec, 2000}.
+template <typename Cmd> struct at_cmd_cache_ttl
+{
+    Cmd command;
+    at_cmd_type command_type;
+
+    //! How long the payload of the successful response is reused, since it's been received.
+    uint32_t ttl_ms;
+};
+
+//! An entry of a table of the sizes of the responses, e.g. {cmd::cmgl, 1024}. \see at_line_list
+template <typename Cmd> struct at_cmd_response_size
+{
+    Cmd command;
+
+    //! Reserved for the payload of the response, when the command is issued.
+    size_t bytes;
+};
+
+//! Takes the payload in place, within the RX buffer, so it's never copied.
+template <typename Cmd> using at_static_cmd_handler = at_static_handler<Cmd, void (*)(line_view payload)>;
+
+template <typename Msg> using at_static_msg_handler = at_static_handler<Msg, void (*)()>;
+
+namespace jungles {
+
+/**
+ * \brief Handles received AT commands' responses, handles unsolicited commands, composes commands to transmit.
+ *
+ * The commands are defined by the CommandSet, which must provide:
+ *  - enum class cmd, which starts with 'at' (for the simplest "AT" command), then lists the not-extended commands,
+ *    then the extended ones (which start with "AT+"), and ends with 'number_of_commands' and 'none',
+ *  - enum class unsolicited_msg, which lists the messages without the AT prefix (e.g. "RING") and ends with
+ *    'number_of_msgs' and 'none',
+ *  - static constexpr std::array<std::string_view, N> cmd_names, with the names mapped by enum class cmd,
+ *  - static constexpr std::size_t first_extended_cmd_idx,
+ *  - static constexpr std::array<std::string_view, M> unsolicited_msg_strs, mapped by enum class unsolicited_msg.
+ *
+ * The CommandSet may also provide the handlers of the unsolicited commands and messages which are known at build time:
+ *  - static constexpr std::array<at_static_cmd_handler<cmd>, K> static_cmd_handlers,
+ *  - static constexpr std::array<at_static_msg_handler<unsolicited_msg>, L> static_msg_handlers,
+ * with at most one handler per command or message. Those are invoked on each arrival, before the registered handler.
+ *
+ * The CommandSet may also provide the timeout profiles of the slow commands (e.g. "AT+COPS=?"), as an array or
+ * a std::array of at_cmd_timeout<cmd> named timeout_profiles. The other commands get AT_CMD_HANDLER_DEFAULT_TIMEOUT_MS
+ * without the inter-line limit.
+ *
+ * The CommandSet may also bind the schemas of the payloads to the commands, as a std::tuple of at_cmd_schema types
+ * named payload_schemas. Then the payloads of those commands can be obtained as typed values, both from the
+ * responses (\see parse_response()) and from the unsolicited commands (\see register_typed_handler()).
+ *
+ * The CommandSet may also list the queries which responses are cached, as an array or a std::array of
+ * at_cmd_cache_ttl<cmd> named cache_profiles (\see at_response_cache).
+ *
+ * The CommandSet may also tell the expected sizes of the multi-line responses (e.g. to AT+CMGL or AT+COPS=?), as an
+ * array or a std::array of at_cmd_response_size<cmd> named response_sizes. So much is reserved for the payload before
+ * such a command is sent, so the payload isn't reallocated while the lines arrive.
+ *
+ * The CommandSet may also provide the signatures of the write commands, as a std::tuple of at_cmd_args types named
+ * write_signatures. Then the payloads of those commands can be formatted from typed arguments
+ * (\see format_write_args()).
+ *
+ * The CommandSet may also set static constexpr bool is_tolerant_matching, for the devices which don't keep to the
+ * format of the responses, e.g. answer "+Qird : 5" for "+QIRD: 5". Then the names after '+' are recognised
+ * regardless of the case of the letters and of the spaces within them, and any spaces after the colon are skipped.
+ * The case is folded while the name is matched, so it costs as much as the exact matching. The final result codes
+ * and the unsolicited messages are still matched exactly.
+ *
+ * All the tables used to compose and to recognise the commands are generated from the CommandSet at compile time,
+ * so the handlers with different command sets (e.g. one per modem) don't cost anything at runtime.
+ *
+ * This is not thread safe. Each access to a non-static method must be thread safe between each other.
+ */
+template <typename CommandSet> class at_cmd_handler
+{
+    template <typename T, typename = void> struct static_cmd_handlers_of
+    {
+        static constexpr std::array<at_static_cmd_handler<typename T::cmd>, 0> value{};
+    };
+
+    template <typename T> struct static_cmd_handlers_of<T, std::void_t<decltype(T::static_cmd_handlers)>>
+    {
+        static constexpr auto &value{T::static_cmd_handlers};
+    };
+
+    template <typename T, typename = void> struct static_msg_handlers_of
+    {
+        static constexpr std::array<at_static_msg_handler<typename T::unsolicited_msg>, 0> value{};
+    };
+
+    template <typename T> struct static_msg_handlers_of<T, std::void_t<decltype(T::static_msg_handlers)>>
+    {
+        static constexpr auto &value{T::static_msg_handlers};
+    };
+
+    template <typename T, typename = void> struct timeout_profiles_of
+    {
+        static constexpr std::array<at_cmd_timeout<typename T::cmd>, 0> value{};
+    };
+
+    template <typename T> struct timeout_profiles_of<T, std::void_t<decltype(T::timeout_profiles)>>
+    {
+        static constexpr auto &value{T::timeout_profiles};
+    };
+
+    template <typename T, typename = void> struct cache_profiles_of
+    {
+        static constexpr std::array<at_cmd_cache_ttl<typename T::cmd>, 0> value{};
+    };
+
+    template <typename T> struct cache_profiles_of<T, std::void_t<decltype(T::cache_profiles)>>
+    {
+        static constexpr auto &value{T::cache_profiles};
+    };
+
+    template <typename T, typename = void> struct response_sizes_of
+    {
+        static constexpr std::array<at_cmd_response_size<typename T::cmd>, 0> value{};
+    };
+
+    template <typename T> struct response_sizes_of<T, std::void_t<decltype(T::response_sizes)>>
+    {
+        static constexpr auto &value{T::response_sizes};
+    };
+
+    template <typename T, typename = void> struct payload_schemas_of
+    {
+        using type = std::tuple<>;
+    };
+
+    template <typename T> struct payload_schemas_of<T, std::void_t<typename T::payload_schemas>>
+    {
+        using type = typename T::payload_schemas;
+    };
+
+    template <typename T, typename = void> struct write_signatures_of
+    {
+        using type = std::tuple<>;
+    };
+
+    template <typename T> struct write_signatures_of<T, std::void_t<typename T::write_signatures>>
+    {
+        using type = typename T::write_signatures;
+    };
+
+    template <typename T, typename = void> struct is_tolerant_matching_of
+    {
+        static constexpr bool value{false};
+    };
+
+    template <typename T> struct is_tolerant_matching_of<T, std::void_t<decltype(T::is_tolerant_matching)>>
+    {
+        static constexpr bool value{T::is_tolerant_matching};
+    };
+
   public:
-    constexpr at_cmd_handler(const std::array<std::string_view, CmdsNotExtendedNum> &cmds_not_extended,
-                             const std::array<std::string_view, CmdsExtendedNum> &cmds_extended,
-                             const std::array<std::string_view, AsynchMsgsNum> &asynch_msgs)
-        : m_cmds_not_extended(cmds_not_extended), m_cmds_extended(cmds_extended), m_asynch_msgs(asynch_msgs)
+    using cmd = typename CommandSet::cmd;
+    using unsolicited_msg = typename CommandSet::unsolicited_msg;
+
+    //! The result of the single-pass classification of a received line.
+    struct response_class
     {
-    }
+        //! The final result code or at_err::prompt_request. at_err::unknown for any other line.
+        at_err code = at_err::unknown;
+
+        //! Set when the line is an echo of a sent command.
+        bool is_echo = false;
+
+        //! Set when the line starts with '+' followed by a name, e.g. "+NAME: PAYLOAD".
+        bool has_command_name = false;
+
+        //! The extended command which name is placed in the line. cmd::none when there is no such command.
+        cmd command = cmd::none;
+
+        //! The length of the name, which starts right after '+'.
+        size_t name_len = 0;
+
+        //! The position where the payload starts, i.e. after the name, the colon and the optional space.
+        size_t payload_offset = 0;
+    };
+
+    //! Returns a string with AT command prefix ready to be sent to a device which handles AT commands.
+    static std::string prepare_cmd_prefix_to_transmit(cmd command, at_cmd_type command_type);
+
+    //! Returns the same prefix as prepare_cmd_prefix_to_transmit() without building it, as it's made at compile time.
+    static constexpr std::string_view get_cmd_prefix(cmd command, at_cmd_type command_type) noexcept;
+
+    static constexpr bool is_extended_cmd(cmd command) noexcept;
+
+    /**
+     * The prefix of the echoes of the commands, which handle_received_response() ignores, so the lines which start with
+     * it may be discarded before they are handled at all. Empty when an unsolicited message starts with it too.
+     */
+    static constexpr std::string_view get_discardable_echo_prefix() noexcept;
+
+    //! Looked up in a table made at compile time.
+    static constexpr at_timeout_profile get_timeout_profile(cmd command) noexcept;
+
+    //! The size of the response listed within CommandSet::response_sizes, zero when there is none.
+    static constexpr size_t get_response_size(cmd command) noexcept;
+
+    //! The queries which responses are cached, an empty array when there are none.
+    static constexpr auto &cache_profiles{cache_profiles_of<CommandSet>::value};
+
+    //! The schema bound to the command within CommandSet::payload_schemas, void when there is none.
+    template <cmd Command>
+    using payload_schema = typename at_find_schema<Command, typename payload_schemas_of<CommandSet>::type>::type;
+
+    //! The typed values of the payload of the command.
+    template <cmd Command> using payload_values = typename payload_schema<Command>::values;
 
-    //! Make an AT command. The T type must be CmdsExtended or CmdsNotExtended.
-    template <typename T> std::string make_cmd_prefix(T cmd, at_cmd_type cmd_type) const;
+    /**
+     * \brief Parses the payload of the successful response into the values of the schema of the command.
+     *
+     * \returns the result of the command when it isn't at_err::ok, at_err::invalid_payload when the payload doesn't
+     *          match the schema.
+     */
+    template <cmd Command>
+    static at_err parse_response(at_err result, const at_string &response_payload, payload_values<Command> &values);
 
-    //! Handle a received response on an AT command. The T type must be CmdsExtended or CmdsNotExtended.
-    template <typename T>
-    at_err handle_rcvd_response(std::unique_ptr<std::string> response, T awaited_cmd, std::string &response_payload);
+    //! The signature of the command within CommandSet::write_signatures, void when there is none.
+    template <cmd Command>
+    using write_signature = typename at_find_schema<Command, typename write_signatures_of<CommandSet>::type>::type;
 
-    //! Register a handler called on a received unsolicited message. The T type must be CmdsExtended or CmdsNotExtended.
-    void register_unsolicited_handler(CmdsExtended unsolicited_command,
-                                      std::function<at_handler_policy(std::unique_ptr<std::string>)> handler);
+    /**
+     * \brief Formats the arguments into the payload of the write command, e.g. 1,"TCP",80 for
+     *        at_cmd_args<cmd, int, quoted_string, int>. Doesn't compile when the arguments don't match the signature.
+     *
+     * The payload is sized up front, so it's allocated at most once (or not at all when it fits into the small string
+     * buffer or into a block of the pool).
+     */
+    template <cmd Command, typename... Args> static at_string format_write_args(const Args &... args);
 
-    void register_asynch_msg_handler(AsynchMsgs asynch_msg, std::function<at_handler_policy()> handler);
+    /**
+     * \brief Handles a single line of the response, without copying it as long as it isn't a part of the payload.
+     *
+     * The line is classified and its prefix is stripped within the view. Only the payload of the awaited command is
+     * copied to response_payload and the payload of an unsolicited command is copied for its handler.
+     */
+    at_err handle_received_response(line_view response, cmd awaited_command, at_string &response_payload);
+
+    /**
+     * Overload of handle_received_response() which takes the position of the first colon within the line (or the
+     * length of the line when there is none), e.g. as recorded by string_buf_rx, so the line isn't scanned for it.
+     */
+    at_err handle_received_response(line_view response,
+                                    size_t colon_pos,
+                                    cmd awaited_command,
+                                    at_string &response_payload);
+
+    //! Overload of handle_received_response() which records the lines of the payload. \see at_line_list
+    at_err handle_received_response(line_view response,
+                                    size_t colon_pos,
+                                    cmd awaited_command,
+                                    at_line_list &response_lines);
+
+    //! Overload of handle_received_response() which takes an owned string.
+    at_err handle_received_response(std::unique_ptr<std::string> response,
+                                    cmd awaited_command,
+                                    at_string &response_payload);
+
+    /*
+     * The steps of handle_received_response(), for the caller which guards the awaited command with a lock, while the
+     * unsolicited handlers need none (see set_lock()): the line is classified once, then it's either taken into the
+     * response or passed to the unsolicited handlers, so the lock is taken only for the former.
+     */
+
+    /**
+     * \brief Classifies the line in a single pass. The position of the first colon (or the length of the line when
+     *        there is none) may be unknown_colon_pos, then the line is scanned for it.
+     */
+    static response_class classify_response(const line_view &response, size_t colon_pos);
+
+    //! Tells whether the line belongs to the response to the awaited command: a result code, its payload or its echo.
+    static bool is_part_of_response(const response_class &cls, cmd awaited_command);
+
+    /**
+     * \brief Takes the line which is a part of the response, so its payload is appended to response_payload. Returns
+     *        the meaning of the line, e.g. at_err::handling_cmd, or at_err::unknown for the echo.
+     */
+    template <typename Payload>
+    static at_err take_response_line(line_view response,
+                                     const response_class &cls,
+                                     cmd awaited_command,
+                                     Payload &response_payload);
+
+    /**
+     * \brief Invokes the observer and the handlers of the unsolicited line. The payload is copied only for the
+     *        handlers. The handlers (un)registered since the previous line take effect beforehand.
+     */
+    void handle_unsolicited_response(line_view response, const response_class &cls);
+
+    //! Tells that the position of the colon isn't known. \see classify_response()
+    static constexpr size_t unknown_colon_pos = static_cast<size_t>(-1);
+
+    //! Returns an empty token when AT_CMD_HANDLER_MAX_UNSOLICITED_HANDLERS handlers are already registered.
+    at_handler_token register_unsolicited_handler(cmd unsolicited_command,
+                                                  at_unsolicited_cmd_handler &&handler,
+                                                  at_dispatch dispatch = at_dispatch::immediate);
+    at_handler_token register_unsolicited_handler(unsolicited_msg message,
+                                                  at_unsolicited_msg_handler &&handler,
+                                                  at_dispatch dispatch = at_dispatch::immediate);
+
+    /**
+     * \brief Registers the handler which gets the values of the fields of the schema of the command, e.g.
+     *        bool(int, int) for at_cmd_schema<cmd, int, int>. The handler returns true when it shall be unregistered,
+     *        like the other handlers. The payloads which don't match the schema are ignored.
+     *
+     * The string fields view the payload, so they are valid only during the call. The handler and its captures must
+     * fit into AT_CMD_HANDLER_CALLBACK_STORAGE_SIZE bytes.
+     */
+    template <cmd Command, typename Handler>
+    at_handler_token register_typed_handler(Handler &&handler, at_dispatch dispatch = at_dispatch::immediate);
+
+    //! Wraps the typed handler into an ordinary one. \see register_typed_handler()
+    template <cmd Command, typename Handler> static at_unsolicited_cmd_handler make_typed_handler(Handler &&handler);
+
+    /**
+     * \brief Removes the handler in constant time. Returns false when the handler has been removed already.
+     *
+     * May be called by any handler during its invocation, then the removal takes effect after the handler returns.
+     */
+    bool unregister_unsolicited_handler(at_handler_token token);
+
+    /**
+     * \brief Lets the handlers be (un)registered by any task, while the lines are handled by a single task, without
+     *        any lock. The lock (e.g. a critical section) is held only for a few steps of each (un)registration.
+     *
+     * A handler registered by another task takes effect from the next line. An unregistered handler isn't invoked
+     * anymore, but a call in progress, and it's released by the task which handles the lines, at the next line or
+     * apply_registrations(). A deferred handler is used by the task which invokes it without any lock, too.
+     */
+    void set_lock(void (*lock)(), void (*unlock)());
+
+    //! Applies the (un)registrations made by the other tasks. Called by the task which handles the lines.
+    void apply_registrations();
+
+    //! Without the dispatcher, the deferred handlers are invoked immediately.
+    void set_deferred_dispatcher(at_deferred_dispatcher &&dispatcher);
+
+    /**
+     * Sees each unsolicited command and message before its handlers, also when it has no handler. The message is
+     * unsolicited_msg::none for a command and the command is cmd::none for a message. The payload of a command is
+     * passed in place, within the RX buffer.
+     */
+    using unsolicited_observer = inplace_function<void(cmd command, unsolicited_msg message, const line_view &payload),
+                                                  AT_CMD_HANDLER_CALLBACK_STORAGE_SIZE>;
+
+    void set_unsolicited_observer(unsolicited_observer &&observer);
+
+    /**
+     * \brief Invokes the handler passed to the deferred dispatcher, unless it has been unregistered meanwhile, and
+     *        removes it when it returns true.
+     *
+     * The record is pinned meanwhile, so it's neither released nor moved, while the following arrivals are deferred
+     * to the same handler. A coalesced handler gets the latest payload from its slot instead of payload, then the
+     * following arrival wakes the dispatcher again. Must be called by a single task.
+     */
+    void invoke_deferred_handler(at_handler_token token, at_payload_ptr payload);
 
   private:
     // ----------------------------------------------------------------------------------------------------------------
-    // Private variables
+    // Compile-time tables
     // ----------------------------------------------------------------------------------------------------------------
-    const std::array<std::string_view, CmdsNotExtendedNum> &m_cmds_not_extended;
-    const std::array<std::string_view, CmdsExtendedNum> &m_cmds_extended;
-    const std::array<std::string_view, AsynchMsgsNum> &m_asynch_msgs;
+    static constexpr auto number_of_commands{to_u_type(cmd::number_of_commands)};
+    static constexpr auto number_of_msgs{to_u_type(unsolicited_msg::number_of_msgs)};
+    static constexpr auto &cmd_names{CommandSet::cmd_names};
+    static constexpr auto &unsolicited_msg_strs{CommandSet::unsolicited_msg_strs};
+    static constexpr auto first_extended_cmd_idx{CommandSet::first_extended_cmd_idx};
+    static constexpr bool is_tolerant_matching{is_tolerant_matching_of<CommandSet>::value};
 
-    std::list < std::pair<std::function<at_handler_policy(std::unique_ptr<std::string>)>, CmdsExtended>
-                    unsolicited_cmd_handlers;
-    std::list < std::pair<std::function<at_handler_policy(void)>, AsynchMsgs> asynch_msgs_handlers;
+    static_assert(cmd_names.size() == number_of_commands, "Each command must have its name");
+    static_assert(unsolicited_msg_strs.size() == number_of_msgs, "Each unsolicited message must have its string");
 
     static constexpr std::string_view at_prefix{"AT"};
-    static constexpr std::string_view cme_error_str{"+CME ERROR"};
+
+    //! The names of the extended final result codes, which are placed like the names of the commands.
+    static constexpr std::string_view cme_error_name{"CME ERROR"};
+    static constexpr std::string_view cms_error_name{"CMS ERROR"};
+
+    //! The suffixes of the commands' types, mapped by enum class at_cmd_type.
+    static constexpr std::array<std::string_view, 4> cmd_type_suffixes{"", "=", "?", "=?"};
+
+    /*
+     * The full prefixes to transmit, e.g. "AT+CSQ=?", for each command and each type of the command, so sending
+     * a command doesn't need to build its prefix.
+     */
+    static constexpr auto cmd_prefixes_len{
+        calc_cmd_prefixes_len(cmd_names, first_extended_cmd_idx, cmd_type_suffixes)};
+    static constexpr auto cmd_prefixes_chars{
+        make_cmd_prefixes_chars<cmd_prefixes_len>(cmd_names, first_extended_cmd_idx, cmd_type_suffixes)};
+    static constexpr auto cmd_prefixes{
+        make_cmd_prefixes(cmd_prefixes_chars, cmd_names, first_extended_cmd_idx, cmd_type_suffixes)};
+
+    /*
+     * The names which may follow '+' in a received line: those of the extended commands, indexed like cmd_names, and
+     * then those of the extended final result codes. They are matched with a trie walked along the name, so the name
+     * is recognized at cost proportional to its length, no matter how many commands are defined.
+     */
+    static constexpr auto plus_names{append_names(cmd_names, cme_error_name, cms_error_name)};
+    static constexpr auto cme_error_name_idx{number_of_commands};
+    static constexpr auto cms_error_name_idx{number_of_commands + 1};
+    static constexpr auto no_plus_name_idx{plus_names.size()};
+    static constexpr auto plus_name_trie_size{
+        calc_name_trie_size(plus_names, first_extended_cmd_idx, is_tolerant_matching)};
+    static constexpr auto plus_name_trie{
+        make_name_trie<plus_name_trie_size>(plus_names, first_extended_cmd_idx, is_tolerant_matching)};
+
+    //! Tells which unsolicited messages may start with the character.
+    static constexpr auto unsolicited_msg_first_char_index{make_first_char_index(unsolicited_msg_strs)};
+
+    //! The handlers known at build time, indexed by the command or the message. nullptr when there is no handler.
+    static constexpr auto static_cmd_handler_index{
+        make_static_handler_index<number_of_commands>(static_cmd_handlers_of<CommandSet>::value)};
+    static constexpr auto static_msg_handler_index{
+        make_static_handler_index<number_of_msgs>(static_msg_handlers_of<CommandSet>::value)};
+
+    //! The timeout profiles indexed by the command.
+    static constexpr auto timeout_profile_index{make_timeout_profile_index<number_of_commands>(
+        timeout_profiles_of<CommandSet>::value, at_timeout_profile{AT_CMD_HANDLER_DEFAULT_TIMEOUT_MS})};
+
+    //! The sizes of the responses indexed by the command.
+    static constexpr auto response_size_index{
+        make_response_size_index<number_of_commands>(response_sizes_of<CommandSet>::value)};
+
+    // ----------------------------------------------------------------------------------------------------------------
+    // Private types and variables
+    // ----------------------------------------------------------------------------------------------------------------
+    template <typename Handler> struct unsolicited_record
+    {
+        Handler handler;
+        at_dispatch dispatch = at_dispatch::immediate;
+
+        /*
+         * Used only by a coalesced handler: the latest payload and whether the dispatcher has been woken for it, which
+         * are exchanged within the lock, and the replaced payload, kept by the task which handles the lines for the
+         * next arrival, so its capacity is reused.
+         */
+        at_payload_ptr latest_payload;
+        bool is_pending = false;
+        at_payload_ptr spare_payload;
+    };
+
+    using unsolicited_cmd_record = unsolicited_record<at_unsolicited_cmd_handler>;
+    using unsolicited_msg_record = unsolicited_record<at_unsolicited_msg_handler>;
+
+    //! The handlers are queued by the command, so only the handlers of the received command are visited.
+    handler_table<unsolicited_cmd_record, number_of_commands, AT_CMD_HANDLER_MAX_UNSOLICITED_HANDLERS>
+        unsolicited_cmd_handlers;
+
+    //! The handlers are queued by the message, so only the handlers of the received message are visited.
+    handler_table<unsolicited_msg_record, number_of_msgs, AT_CMD_HANDLER_MAX_UNSOLICITED_HANDLERS>
+        unsolicited_msg_handlers;
+
+    at_deferred_dispatcher m_deferred_dispatcher;
+    unsolicited_observer m_unsolicited_observer;
+
+    //! \see set_lock()
+    void (*m_lock)() = nullptr;
+    void (*m_unlock)() = nullptr;
 
     // ----------------------------------------------------------------------------------------------------------------
     // Private methods
     // ----------------------------------------------------------------------------------------------------------------
-    template <typename T> constexpr bool is_extended_cmd(T cmd) const noexcept;
-    template <typename T> constexpr auto get_at_array_size() const noexcept;
-    template <typename T> constexpr const auto &get_ref_to_at_array() const noexcept;
-
-    at_err handle_unsolicited_cmd(std::unique_ptr<std::string> response);
-
-    bool is_echo(const std::string &response);
-    bool is_response_to_specific_extended_command(const std::string &response, CmdsExtended command);
-    bool is_specific_asynch_msg(const std::string &message, AsynchMsgs asynch_msg) size_t
-        calc_prefix_len_in_response_on_extended_cmd(const std::string &response, CmdsExtended command);
-    void remove_prefix_from_response(std::string &response, size_t chars_to_erase_at_beginning);
-    at_err resolve_is_control_message(const std::string &response);
-    template <typename T> at_err resolve_is_response_to_command(const std::string &response, T command);
+    template <typename Payload>
+    at_err handle_received_line(line_view response, size_t colon_pos, cmd awaited_command, Payload &response_payload);
+
+    static void classify_response_with_name(const line_view &response, size_t colon_pos, response_class &cls);
+    static unsigned short step_name(unsigned short node, char c);
+    static size_t skip_colon_and_space(const line_view &response, size_t pos);
+    static at_err response_to_at_err(const response_class &cls, cmd awaited_command);
+    static bool is_specific_unsolicited_msg(const line_view &response, unsolicited_msg message);
+    static void append_string_and_if_nonempty_add_newline(const line_view &src, at_string &dst);
+    static void append_string_and_if_nonempty_add_newline(const line_view &src, at_line_list &dst);
+    void lock() const;
+    void unlock() const;
+    void coalesce(const line_view &payload, at_handler_token token, unsolicited_cmd_record &record);
+    void wake_deferred(at_handler_token token, bool &is_pending);
 };
 
-namespace {
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PUBLIC MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <typename CommandSet>
+std::string at_cmd_handler<CommandSet>::prepare_cmd_prefix_to_transmit(cmd command, at_cmd_type type)
+{
+    return std::string(get_cmd_prefix(command, type));
+}
 
-static void append_string_and_if_nonempty_add_newline(std::string &&src, std::string &dst)
+template <typename CommandSet>
+constexpr std::string_view at_cmd_handler<CommandSet>::get_cmd_prefix(cmd command, at_cmd_type type) noexcept
 {
-    if (dst.empty())
-    {
-        dst = std::move(src);
-    }
-    else
-    {
-        dst += "\r\n";
-        dst += std::move(src);
-    }
+    return cmd_prefixes[to_u_type(command)][to_u_type(type)];
 }
 
-} // namespace
+template <typename CommandSet> constexpr bool at_cmd_handler<CommandSet>::is_extended_cmd(cmd command) noexcept
+{
+    auto idx{static_cast<std::size_t>(to_u_type(command))};
+    return idx >= first_extended_cmd_idx && idx < number_of_commands;
+}
 
-}; // namespace jungles
+template <typename CommandSet>
+constexpr std::string_view at_cmd_handler<CommandSet>::get_discardable_echo_prefix() noexcept
+{
+    for (auto msg : unsolicited_msg_strs)
+        if (msg.substr(0, at_prefix.length()) == at_prefix)
+            return {};
+    return at_prefix;
+}
 
-template <typename T1, typename T2, typename T3, size_t S1, size_t S2, size_t S3, typename... Ts>
-constexpr auto make_at_cmd_handler(const std::array<std::string_view, S1> &cmds_not_extended,
-                                   const std::array<std::string_view, S2> &cmds_extended,
-                                   const std::array<std::string_view, S3> &asynch_msgs)
+template <typename CommandSet>
+constexpr at_timeout_profile at_cmd_handler<CommandSet>::get_timeout_profile(cmd command) noexcept
 {
-    return at_cmd_handler<T1, T2, T3, S1, S2, S3>(cmds_not_extended, cmds_extended, asynch_msgs);
+    auto idx{static_cast<std::size_t>(to_u_type(command))};
+    if (idx >= number_of_commands)
+        return {AT_CMD_HANDLER_DEFAULT_TIMEOUT_MS};
+    return timeout_profile_index[idx];
 }
 
-template <typename T1, typename T2, typename T3, size_t S1, size_t S2, size_t S3>
-template <typename T>
-std::string at_cmd_handler<T1, T2, T3, S1, S2, S3>::make_cmd_prefix(T cmd, at_cmd_type cmd_type) const
+template <typename CommandSet>
+constexpr size_t at_cmd_handler<CommandSet>::get_response_size(cmd command) noexcept
 {
-    const auto is_extended = is_extended_cmd(cmd);
-    const auto &at_cmd_str = get_ref_to_at_array<T>();
+    auto idx{static_cast<std::size_t>(to_u_type(command))};
+    if (idx >= number_of_commands)
+        return 0;
+    return response_size_index[idx];
+}
 
-    // Calculate the command length to know how much memory to reserve to make it
-    size_t len = at_prefix.length() + at_cmd_str[to_u_type(cmd)].length() + (is_extended ? 1 : 0);
-    if (cmd_type == at_cmd_type::read || cmd_type == at_cmd_type::write)
-        len += 1; // One character for '?' or '='
-    else if (cmd_type == at_cmd_type::test)
-        len += 2; // One character for '=' and the second for '?'.
+template <typename CommandSet>
+template <typename at_cmd_handler<CommandSet>::cmd Command>
+at_err at_cmd_handler<CommandSet>::parse_response(at_err result,
+                                                  const at_string &response_payload,
+                                                  payload_values<Command> &values)
+{
+    if (result != at_err::ok)
+        return result;
+    return payload_schema<Command>::parse(line_view(response_payload), values) ? at_err::ok : at_err::invalid_payload;
+}
 
-    std::string msg;
+template <typename CommandSet>
+template <typename at_cmd_handler<CommandSet>::cmd Command, typename... Args>
+at_string at_cmd_handler<CommandSet>::format_write_args(const Args &... args)
+{
+    using signature = write_signature<Command>;
+    static_assert(!std::is_void_v<signature>, "The command has no signature within CommandSet::write_signatures");
+    return signature::template format<at_string>(args...);
+}
 
-    // Reserve the needed length and also some characters more if one wanted to put a CRLF into it.
-    msg.reserve(len + 4);
+template <typename CommandSet>
+at_err at_cmd_handler<CommandSet>::handle_received_response(line_view response,
+                                                            cmd awaited_command,
+                                                            at_string &response_payload)
+{
+    return handle_received_response(response, unknown_colon_pos, awaited_command, response_payload);
+}
 
-    msg += at_prefix;
-    if (is_extended)
-        msg += '+';
-    msg += at_cmd_str[to_u_type(cmd)];
+template <typename CommandSet>
+at_err at_cmd_handler<CommandSet>::handle_received_response(line_view response,
+                                                            size_t colon_pos,
+                                                            cmd awaited_command,
+                                                            at_string &response_payload)
+{
+    return handle_received_line(response, colon_pos, awaited_command, response_payload);
+}
 
-    if (cmd_type == at_cmd_type::read)
-        msg += '?';
-    else if (cmd_type == at_cmd_type::test)
-        msg += "=?";
-    else if (cmd_type == at_cmd_type::write)
-        msg += '=';
+template <typename CommandSet>
+at_err at_cmd_handler<CommandSet>::handle_received_response(line_view response,
+                                                            size_t colon_pos,
+                                                            cmd awaited_command,
+                                                            at_line_list &response_lines)
+{
+    return handle_received_line(response, colon_pos, awaited_command, response_lines);
+}
 
-    return msg;
+template <typename CommandSet>
+at_err at_cmd_handler<CommandSet>::handle_received_response(std::unique_ptr<std::string> response,
+                                                            cmd awaited_command,
+                                                            at_string &response_payload)
+{
+    return handle_received_response(line_view(*response), awaited_command, response_payload);
 }
 
-template <typename CmdsNotExtended, typename CmdsExtended, typename T3, size_t S1, size_t S2, size_t S3>
-template <typename T>
-constexpr bool at_cmd_handler<CmdsNotExtended, CmdsExtended, T3, S1, S2, S3>::is_extended_cmd(T cmd) const noexcept
+template <typename CommandSet>
+bool at_cmd_handler<CommandSet>::is_part_of_response(const response_class &cls, cmd awaited_command)
 {
-    static_assert(std::is_same_v<T, CmdsNotExtended> || std::is_same_v<T, CmdsExtended>,
-                  "Function can only take as a paramater an enum class which defines AT commands");
-    if constexpr (std::is_same_v<T, CmdsNotExtended>)
+    if (awaited_command == cmd::none)
         return false;
-    else
-        return true;
-}
-
-template <typename CmdsNotExtended,
-          typename CmdsExtended,
-          typename T3,
-          size_t CmdsNotExtendedNum,
-          size_t CmdsExtendedNum,
-          size_t S3>
-template <typename T>
-constexpr auto
-at_cmd_handler<CmdsNotExtended, CmdsExtended, T3, CmdsNotExtendedNum, CmdsExtendedNum, S3>::get_at_array_size() const
-    noexcept
-{
-    static_assert(std::is_same_v<T, CmdsNotExtended> || std::is_same_v<T, CmdsExtended>,
-                  "Function can only take as a paramater an enum class which defines AT commands");
-    if constexpr (std::is_same_v<T, CmdsNotExtended>)
-        return CmdsNotExtendedNum;
-    else
-        return CmdsExtendedNum;
-}
-
-template <typename CmdsNotExtended,
-          typename CmdsExtended,
-          typename T3,
-          size_t CmdsNotExtendedNum,
-          size_t CmdsExtendedNum,
-          size_t S3>
-template <typename T>
-constexpr const auto &
-at_cmd_handler<CmdsNotExtended, CmdsExtended, T3, CmdsNotExtendedNum, CmdsExtendedNum, S3>::get_ref_to_at_array() const
-    noexcept
-{
-    static_assert(std::is_same_v<T, CmdsNotExtended> || std::is_same_v<T, CmdsExtended>,
-                  "Function can only take as a paramater an enum class which defines AT commands");
-    if constexpr (std::is_same_v<T, CmdsNotExtended>)
-        return m_cmds_not_extended;
-    else
-        return m_cmds_extended;
+    return cls.is_echo || response_to_at_err(cls, awaited_command) != at_err::unknown;
 }
 
-template <typename CmdsNotExtended,
-          typename CmdsExtended,
-          typename T3,
-          size_t CmdsNotExtendedNum,
-          size_t CmdsExtendedNum,
-          size_t S3>
-template <typename T>
-at_err at_cmd_handler<CmdsNotExtended, CmdsExtended, T3, CmdsNotExtendedNum, CmdsExtendedNum, S3>::handle_rcvd_response(
-    std::unique_ptr<std::string> response, T awaited_cmd, std::string &response_payload)
+template <typename CommandSet>
+template <typename Payload>
+at_err at_cmd_handler<CommandSet>::take_response_line(line_view response,
+                                                      const response_class &cls,
+                                                      cmd awaited_command,
+                                                      Payload &response_payload)
 {
-    static_assert(std::is_same_v<T, CmdsNotExtended> || std::is_same_v<T, CmdsExtended>,
-                  "Function can only take as a paramater an enum class which defines AT commands");
-
-    if (awaited_cmd == T::none)
-        return handle_unsolicited_cmd(std::move(response));
-    if (is_echo(*response))
+    if (cls.is_echo)
         return at_err::unknown;
 
-    auto response_meaning = resolve_is_control_message(*response);
-    if (response_meaning == at_err::unknown)
-	{
-		if constexpr(std::is_same_v<T, CmdsExtended>)
-		{
-			if(is_response_to_specific_extended_command(*response, awaited_cmd))
-		}
-	}
-        response_meaning = resolve_is_response_to_command(*response, awaited_cmd);
-
-    if (response_meaning == at_err::cme_error)
+    auto response_meaning = response_to_at_err(cls, awaited_command);
+
+    if (response_meaning == at_err::cme_error || response_meaning == at_err::cms_error ||
+        response_meaning == at_err::handling_cmd)
+    {
+        response.remove_prefix(cls.payload_offset);
+        append_string_and_if_nonempty_add_newline(response, response_payload);
+    }
+    return response_meaning;
+}
+
+template <typename CommandSet>
+at_handler_token at_cmd_handler<CommandSet>::register_unsolicited_handler(cmd unsolicited_command,
+                                                                          at_unsolicited_cmd_handler &&handler,
+                                                                          at_dispatch dispatch)
+{
+    return {unsolicited_cmd_handlers.push_back(to_u_type(unsolicited_command), {std::move(handler), dispatch}), false};
+}
+
+template <typename CommandSet>
+at_handler_token at_cmd_handler<CommandSet>::register_unsolicited_handler(unsolicited_msg message,
+                                                                          at_unsolicited_msg_handler &&handler,
+                                                                          at_dispatch dispatch)
+{
+    return {unsolicited_msg_handlers.push_back(to_u_type(message), {std::move(handler), dispatch}), true};
+}
+
+template <typename CommandSet>
+template <typename at_cmd_handler<CommandSet>::cmd Command, typename Handler>
+at_handler_token at_cmd_handler<CommandSet>::register_typed_handler(Handler &&handler, at_dispatch dispatch)
+{
+    return register_unsolicited_handler(
+        Command, make_typed_handler<Command>(std::forward<Handler>(handler)), dispatch);
+}
+
+template <typename CommandSet>
+template <typename at_cmd_handler<CommandSet>::cmd Command, typename Handler>
+at_unsolicited_cmd_handler at_cmd_handler<CommandSet>::make_typed_handler(Handler &&handler)
+{
+    using schema = payload_schema<Command>;
+    static_assert(!std::is_void_v<schema>, "The command has no schema within CommandSet::payload_schemas");
+
+    return [handler = std::forward<Handler>(handler)](at_payload_ptr payload) mutable {
+        typename schema::values values;
+        return payload && schema::parse(line_view(*payload), values) && std::apply(handler, values);
+    };
+}
+
+template <typename CommandSet>
+bool at_cmd_handler<CommandSet>::unregister_unsolicited_handler(at_handler_token token)
+{
+    return token.is_msg_handler ? unsolicited_msg_handlers.remove(token.record)
+                                : unsolicited_cmd_handlers.remove(token.record);
+}
+
+template <typename CommandSet>
+void at_cmd_handler<CommandSet>::set_deferred_dispatcher(at_deferred_dispatcher &&dispatcher)
+{
+    m_deferred_dispatcher = std::move(dispatcher);
+}
+
+template <typename CommandSet>
+void at_cmd_handler<CommandSet>::set_unsolicited_observer(unsolicited_observer &&observer)
+{
+    m_unsolicited_observer = std::move(observer);
+}
+
+template <typename CommandSet> void at_cmd_handler<CommandSet>::set_lock(void (*lock)(), void (*unlock)())
+{
+    m_lock = lock;
+    m_unlock = unlock;
+    unsolicited_cmd_handlers.set_lock(lock, unlock);
+    unsolicited_msg_handlers.set_lock(lock, unlock);
+}
+
+template <typename CommandSet> void at_cmd_handler<CommandSet>::apply_registrations()
+{
+    unsolicited_cmd_handlers.apply_changes();
+    unsolicited_msg_handlers.apply_changes();
+}
+
+/**
+ * Only the task which invokes the deferred handlers touches the handler of a pinned record, so it's invoked without
+ * any lock, while the task which handles the lines keeps deferring the following arrivals to it.
+ */
+template <typename CommandSet>
+void at_cmd_handler<CommandSet>::invoke_deferred_handler(at_handler_token token, at_payload_ptr payload)
+{
+    if (token.is_msg_handler)
     {
-        remove_prefix_from_response(*response, cme_error_str.length());
-        append_string_and_if_nonempty_add_newline(std::move(*response), response_payload);
+        auto record = unsolicited_msg_handlers.pin(token.record);
+        if (!record)
+            return;
+        lock();
+        record->is_pending = false;
+        unlock();
+        if (record->handler())
+            unsolicited_msg_handlers.remove(token.record);
+        unsolicited_msg_handlers.unpin(token.record);
+        return;
     }
-    else if (response_meaning == at_err::handling_cmd)
+
+    auto record = unsolicited_cmd_handlers.pin(token.record);
+    if (!record)
+        return;
+    if (record->dispatch == at_dispatch::coalesced)
     {
-        if (is_response_containing_command_name(*response))
-        {
-            auto prefix_len = calc_prefix_len_in_response_on_extended_cmd(*response, awaited_cmd);
-            remove_prefix_from_response(*response, prefix_len);
-        }
-        append_string_and_if_nonempty_add_newline(std::move(*response), response_payload);
+        lock();
+        payload = std::move(record->latest_payload);
+        record->is_pending = false;
+        unlock();
     }
-    else if (response_meaning == at_err::unknown)
-        return handle_unsolicited_cmd(std::move(response));
+    if (record->handler(std::move(payload)))
+        unsolicited_cmd_handlers.remove(token.record);
+    unsolicited_cmd_handlers.unpin(token.record);
+}
 
-    return response_meaning;
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <typename CommandSet>
+template <typename Payload>
+at_err at_cmd_handler<CommandSet>::handle_received_line(line_view response,
+                                                        size_t colon_pos,
+                                                        cmd awaited_command,
+                                                        Payload &response_payload)
+{
+    // The line is scanned only once; the rest of the handling uses the result of the classification.
+    auto cls = classify_response(response, colon_pos);
+    if (is_part_of_response(cls, awaited_command))
+        return take_response_line(response, cls, awaited_command, response_payload);
+
+    handle_unsolicited_response(response, cls);
+    return at_err::unknown;
 }
 
-template <typename T1, typename T2, typename T3, size_t S1, size_t S2, size_t S3>
-at_err at_cmd_handler<T1, T2, T3, S1, S2, S3>::handle_unsolicited_cmd(std::unique_ptr<std::string> response)
+template <typename CommandSet>
+void at_cmd_handler<CommandSet>::handle_unsolicited_response(line_view response, const response_class &cls)
 {
-    for (auto it = unsolicited_cmd_handlers.begin(); it != unsolicited_cmd_handlers.end(); ++it)
+    apply_registrations();
+    if (response.empty())
+        return;
+
+    auto command = cls.command;
+    if (command != cmd::none)
     {
-        const auto &[handler, command] = *it;
-        if (is_response_to_specific_extended_command(*response, command))
-        {
-            auto prefix_len = calc_prefix_len_in_response_on_extended_cmd(*response, command);
-            remove_prefix_from_response(*response, prefix_len);
-            // When the handler returns ::remove then the unsolicited handler won't be invoked anymore.
-            // This allows to control easily how many times should the handler be invoked.
-            if (handler(std::move(response)) == at_handler_policy::remove)
-                unsolicited_cmd_handlers.erase(it);
-            // After moving the unique_ptr it is invalidated so we must return to not to cause a segmentation fault.
-            return at_err::handled_unsolicited;
-        }
+        auto idx = to_u_type(command);
+        auto static_handler = static_cmd_handler_index[idx];
+        if (!static_handler && unsolicited_cmd_handlers.empty(idx) && !m_unsolicited_observer)
+            return;
+
+        response.remove_prefix(cls.payload_offset);
+        if (m_unsolicited_observer)
+            m_unsolicited_observer(command, unsolicited_msg::none, response);
+        if (static_handler)
+            static_handler(response);
+
+        // The payload is copied out of the view only here, when there is a handler which takes it.
+        // When the handler returns true then the unsolicited handler won't be invoked anymore.
+        // This allows to control easily how many times should the handler be invoked.
+        at_handler_token token{unsolicited_cmd_handlers.get_front_token(idx), false};
+        unsolicited_cmd_handlers.visit_front(idx, [this, &response, token](unsolicited_cmd_record &record) {
+            if (!m_deferred_dispatcher || record.dispatch == at_dispatch::immediate)
+                return record.handler(at_make_unique<at_string>(response.to_string<at_string>()));
+
+            if (record.dispatch == at_dispatch::deferred)
+                m_deferred_dispatcher(token, at_make_unique<at_string>(response.to_string<at_string>()));
+            else
+                coalesce(response, token, record);
+            return false;
+        });
+        return;
     }
-    for (auto it = asynch_msgs_handlers.begin(); it != asynch_msgs_handlers.end(); ++it)
+
+    // Only the messages which start with the same character as the response are compared.
+    auto candidates = unsolicited_msg_first_char_index[static_cast<unsigned char>(response[0])];
+    for (unsigned i = 0; candidates != 0; ++i, candidates >>= 1)
     {
-        const auto &[handler, message] = *it;
-        if (is_specific_asynch_msg(*response, message))
+        auto static_handler = static_msg_handler_index[i];
+        if (!(candidates & 1) || (!static_handler && unsolicited_msg_handlers.empty(i) && !m_unsolicited_observer))
+            continue;
+
+        auto message = static_cast<unsolicited_msg>(i);
+        if (is_specific_unsolicited_msg(response, message))
         {
-            if (handler() == at_handler_policy::remove)
-                asynch_msgs_handlers.erase(it);
-            return at_err::handled_unsolicited;
+            if (m_unsolicited_observer)
+                m_unsolicited_observer(cmd::none, message, response);
+            if (static_handler)
+                static_handler();
+            at_handler_token token{unsolicited_msg_handlers.get_front_token(i), true};
+            unsolicited_msg_handlers.visit_front(i, [this, token](unsolicited_msg_record &record) {
+                if (!m_deferred_dispatcher || record.dispatch == at_dispatch::immediate)
+                    return record.handler();
+
+                if (record.dispatch == at_dispatch::deferred)
+                    m_deferred_dispatcher(token, nullptr);
+                else
+                    wake_deferred(token, record.is_pending);
+                return false;
+            });
+            return;
         }
     }
-    return at_err::unknown;
 }
 
-template <typename T1, typename CmdsExtended, typename T3, size_t S1, size_t S2, size_t S3>
-bool at_cmd_handler<T1, CmdsExtended, T3, S1, S2, S3>::is_response_to_specific_extended_command(
-    const std::string &response, CmdsExtended command)
+template <typename CommandSet>
+typename at_cmd_handler<CommandSet>::response_class
+at_cmd_handler<CommandSet>::classify_response(const line_view &response, size_t colon_pos)
 {
-    const auto &cmd_name = cmds_extended[to_u_type(command)];
-    return response.compare(1, cmd_name.length(), cmd_name) == 0;
+    response_class cls;
+    auto len = response.length();
+    if (len == 0)
+        return cls;
+
+    // The first character tells which few strings may be compared at all.
+    switch (response[0])
+    {
+    case 'O':
+        if (response == "OK")
+            cls.code = at_err::ok;
+        break;
+    case 'E':
+        if (response == "ERROR")
+            cls.code = at_err::error;
+        break;
+    case '>':
+        if (len == 1)
+            cls.code = at_err::prompt_request;
+        break;
+    case 'A':
+        cls.is_echo = len >= at_prefix.length() && response[1] == at_prefix[1];
+        break;
+    case 'B':
+        if (response == "BUSY")
+            cls.code = at_err::busy;
+        break;
+    case 'C':
+        // The connection speed may follow, e.g. "CONNECT 9600".
+        if (response.starts_with("CONNECT") && (len == 7 || response[7] == ' '))
+            cls.code = at_err::connect;
+        break;
+    case 'N':
+        if (response == "NO CARRIER")
+            cls.code = at_err::no_carrier;
+        else if (response == "NO ANSWER")
+            cls.code = at_err::no_answer;
+        break;
+    case '+':
+        classify_response_with_name(response, colon_pos, cls);
+        break;
+    default:
+        break;
+    }
+    return cls;
 }
 
-template <typename T1, typename CmdsExtended, typename T3, size_t S1, size_t S2, size_t S3>
-size_t at_cmd_handler<T1, CmdsExtended, T3, S1, S2, S3>::calc_prefix_len_in_response_on_extended_cmd(
-    const std::string &response, CmdsExtended command)
+template <typename CommandSet>
+void at_cmd_handler<CommandSet>::classify_response_with_name(const line_view &response,
+                                                             size_t colon_pos,
+                                                             response_class &cls)
 {
-    const auto &cmd_name = cmds_extended[to_u_type(command)];
-    const size_t sz = sizeof(char('+')) + cmd_name.length() + sizeof(char(':'));
-    // Check whether there is space after the colon
-    if (response[sz] == ' ')
-        return sz + 1;
+    // The name is placed between '+' and ':' (or the end of the response, when there is no payload).
+    // Walk the trie in the same pass as searching for the end of the name, unless the end is known already.
+    auto node = name_trie_root;
+    size_t name_end = 1;
+    if (colon_pos == unknown_colon_pos)
+        for (; name_end < response.length() && response[name_end] != ':'; ++name_end)
+            node = step_name(node, response[name_end]);
     else
-        return sz;
+        for (; name_end < colon_pos; ++name_end)
+            node = step_name(node, response[name_end]);
+
+    cls.payload_offset = skip_colon_and_space(response, name_end);
+
+    // The extended error result codes have the same format as the responses to the commands.
+    auto name_idx = name_trie_match<no_plus_name_idx>(plus_name_trie, node);
+    if (name_idx == cme_error_name_idx)
+        cls.code = at_err::cme_error;
+    else if (name_idx == cms_error_name_idx)
+        cls.code = at_err::cms_error;
+    else
+    {
+        cls.has_command_name = true;
+        cls.name_len = name_end - 1;
+        cls.command = name_idx < number_of_commands ? static_cast<cmd>(name_idx) : cmd::none;
+    }
+}
+
+template <typename CommandSet> unsigned short at_cmd_handler<CommandSet>::step_name(unsigned short node, char c)
+{
+    if constexpr (is_tolerant_matching)
+    {
+        // A stray space is skipped, unless the name continues with a space there, like "CME ERROR" does.
+        if (c == ' ' && name_trie_step(plus_name_trie, node, c) == name_trie_miss)
+            return node;
+        c = to_upper(c);
+    }
+    return name_trie_step(plus_name_trie, node, c);
 }
 
-template <typename T1, typename T2, typename T3, size_t S1, size_t S2, size_t S3>
-void at_cmd_handler<T1, T2, T3, S1, S2, S3>::remove_prefix_from_response(std::string &response,
-                                                                         size_t chars_to_erase_at_beginning)
+template <typename CommandSet>
+size_t at_cmd_handler<CommandSet>::skip_colon_and_space(const line_view &response, size_t pos)
 {
-    response.erase(response.begin(), response.begin() + chars_to_erase_at_beginning);
+    if (pos < response.length() && response[pos] == ':')
+        pos++;
+    // Check whether there is space after the colon
+    if constexpr (is_tolerant_matching)
+        while (pos < response.length() && response[pos] == ' ')
+            pos++;
+    else if (pos < response.length() && response[pos] == ' ')
+        pos++;
+    return pos;
 }
 
-template <typename T1, typename T2, typename AsynchMsgs, size_t S1, size_t S2, size_t S3>
-bool at_cmd_handler<T1, T2, AsynchMsgs, S1, S2, S3>::is_specific_asynch_msg(const std::string &message,
-                                                                            AsynchMsgs asynch_msg)
+template <typename CommandSet>
+at_err at_cmd_handler<CommandSet>::response_to_at_err(const response_class &cls, cmd awaited_command)
 {
-    return string_starts_with(message, m_asynch_msgs[to_u_type(asynch_msg)]);
+    if (cls.code != at_err::unknown)
+        return cls.code;
+
+    // Do not handle not extended AT commands as they are not used commonly.
+    if (!is_extended_cmd(awaited_command))
+        return at_err::unknown;
+
+    // When the response doesn't contain a prefix (e.g. :"+CREG:...") then automatically mark it as a response.
+    // This should be changed, because sometimes there are unsolicited messages which doesn't contain the command's
+    // name (like e.g. "RING") which will cause this implementation to be buggy.
+    if (!cls.has_command_name)
+        return at_err::handling_cmd;
+
+    return cls.command == awaited_command ? at_err::handling_cmd : at_err::unknown;
 }
 
-template <typename T1, typename T2, typename T3, size_t S1, size_t S2, size_t S3>
-bool at_cmd_handler<T1, T2, T3, S1, S2, S3>::is_echo(const std::string &response)
+template <typename CommandSet>
+bool at_cmd_handler<CommandSet>::is_specific_unsolicited_msg(const line_view &response, unsolicited_msg message)
 {
-    return string_starts_with(response, at_prefix);
+    return response.starts_with(unsolicited_msg_strs[to_u_type(message)]);
 }
 
-template <typename T1, typename T2, typename T3, size_t S1, size_t S2, size_t S3>
-at_err at_cmd_handler<T1, T2, T3, S1, S2, S3>::resolve_is_control_message(const std::string &response)
+template <typename CommandSet>
+void at_cmd_handler<CommandSet>::append_string_and_if_nonempty_add_newline(const line_view &src, at_string &dst)
 {
-    at_err result = at_err::unknown;
-    if (response == "OK")
-        result = at_err::ok;
-    else if (response == "ERROR")
-        result = at_err::error;
-    else if (response == ">")
-        result = at_err::prompt_request;
-    else if (string_starts_with(response, cme_error_str))
-        result = at_err::cme_error;
-    return result;
+    if (!dst.empty())
+        dst += "\r\n";
+    src.append_to(dst);
 }
 
-template <typename CmdsNotExtended, typename CmdsNotExtended, typename T3, size_t S1, size_t S2, size_t S3>
-template <typename T>
-at_err at_cmd_handler<CmdsNotExtended, CmdsExtended, T3, S1, S2, S3>::resolve_is_response_to_command(
-    const std::string &response, T command)
+template <typename CommandSet>
+void at_cmd_handler<CommandSet>::append_string_and_if_nonempty_add_newline(const line_view &src, at_line_list &dst)
 {
+    dst.append(src);
 }
 
+template <typename CommandSet> void at_cmd_handler<CommandSet>::lock() const
+{
+    if (m_lock)
+        m_lock();
 }
-; // namespace jungles
+
+template <typename CommandSet> void at_cmd_handler<CommandSet>::unlock() const
+{
+    if (m_unlock)
+        m_unlock();
+}
+
+//! Replaces the latest payload of the coalesced handler within the lock, as the handler may be taking it meanwhile.
+template <typename CommandSet>
+void at_cmd_handler<CommandSet>::coalesce(const line_view &payload,
+                                          at_handler_token token,
+                                          unsolicited_cmd_record &record)
+{
+    // The replaced payload keeps its capacity, so it's allocated only when a longer payload arrives.
+    auto latest = std::move(record.spare_payload);
+    if (latest)
+    {
+        latest->clear();
+        payload.append_to(*latest);
+    }
+    else
+        latest = at_make_unique<at_string>(payload.to_string<at_string>());
+
+    lock();
+    std::swap(latest, record.latest_payload);
+    unlock();
+    record.spare_payload = std::move(latest);
+    wake_deferred(token, record.is_pending);
+}
+
+//! Wakes the dispatcher, unless it's been woken already and the handler hasn't taken its payload yet.
+template <typename CommandSet>
+void at_cmd_handler<CommandSet>::wake_deferred(at_handler_token token, bool &is_pending)
+{
+    lock();
+    auto is_woken = is_pending;
+    is_pending = true;
+    unlock();
+    if (is_woken || m_deferred_dispatcher(token, nullptr))
+        return;
+
+    lock();
+    is_pending = false;
+    unlock();
+}
+
+} // namespace jungles
 
 #endif /* AT_CMD_HANDLER_IMPL_HPP */
@@ -0,0 +1,478 @@
+/**
+ * @file	at_co.hpp
+ * @brief	Lets the C++20 coroutines await the AT commands, so a sequence of commands is written as linear code.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef AT_CO_HPP
+#define AT_CO_HPP
+
+#if !defined(__cpp_impl_coroutine) || !__has_include(<coroutine>)
+#error "at_co.hpp requires C++20 coroutines"
+#endif
+
+#include "FreeRTOS.h"
+#include "at_channel.hpp"
+#include "at_cmd.hpp"
+#include "at_os_objects.hpp"
+#include "os_lockguard.hpp"
+#include "semphr.h"
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+/*
+ * A coroutine which awaits a command is suspended till the completion of the command (\see at_send_async()), which
+ * resumes it within the receiver task of the channel. Thus a sequence of the commands takes a coroutine frame rather
+ * than a task with its own stack, but the code between the co_awaits runs on the receiver task and can't block, like
+ * the completion itself.
+ *
+ * The commands which are awaited meanwhile compete for the slots of the queue of the commands with the ones issued by
+ * at_send() and the others. A command which finds the queue full is parked by its scheduler (at_co_scheduler) and
+ * issued when one of the commands of the scheduler completes, before the coroutine of that one is resumed, so the
+ * parked commands are issued in the order they were awaited. When none of the commands of the scheduler is in flight,
+ * nothing would issue the parked one, so it fails immediately with at_err::timeout, like at_send() which can't queue
+ * the command on time.
+ *
+ * The frames of the coroutines are allocated with the operator new.
+ */
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE COROUTINES
+// --------------------------------------------------------------------------------------------------------------------
+/**
+ * \brief A coroutine which awaits the commands and returns at_err.
+ *
+ * Starts when it's awaited by another coroutine, which is resumed when this one returns, or when it's spawned with
+ * at_co_spawn(). Thus a sequence, e.g. opening a socket, awaits the smaller ones, e.g. the attach to the network.
+ */
+class at_co_task
+{
+  public:
+    struct promise_type;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    //! Resumes the coroutine which awaits the returning one, without nesting the call on the stack.
+    struct final_awaiter
+    {
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        std::coroutine_handle<> await_suspend(handle_type finished) noexcept
+        {
+            return finished.promise().continuation;
+        }
+
+        void await_resume() const noexcept
+        {
+        }
+    };
+
+    struct promise_type
+    {
+        at_err result = at_err::unknown;
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+
+        at_co_task get_return_object() noexcept
+        {
+            return at_co_task(handle_type::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() const noexcept
+        {
+            return {};
+        }
+
+        final_awaiter final_suspend() const noexcept
+        {
+            return {};
+        }
+
+        void return_value(at_err res) noexcept
+        {
+            result = res;
+        }
+
+        void unhandled_exception() const noexcept
+        {
+            std::terminate();
+        }
+    };
+
+    at_co_task(at_co_task &&other) noexcept : m_handle(std::exchange(other.m_handle, nullptr))
+    {
+    }
+
+    at_co_task(const at_co_task &) = delete;
+    at_co_task &operator=(const at_co_task &) = delete;
+    at_co_task &operator=(at_co_task &&) = delete;
+
+    ~at_co_task()
+    {
+        if (m_handle)
+            m_handle.destroy();
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        m_handle.promise().continuation = awaiting;
+        return m_handle;
+    }
+
+    at_err await_resume() const noexcept
+    {
+        return m_handle.promise().result;
+    }
+
+  private:
+    explicit at_co_task(handle_type handle) noexcept : m_handle(handle)
+    {
+    }
+
+    handle_type m_handle;
+};
+
+namespace at_co_detail {
+
+//! The root of the spawned coroutines, which frees its frame by itself when it's done.
+struct detached
+{
+    struct promise_type
+    {
+        detached get_return_object() const noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() const noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() const noexcept
+        {
+            return {};
+        }
+
+        void return_void() const noexcept
+        {
+        }
+
+        void unhandled_exception() const noexcept
+        {
+            std::terminate();
+        }
+    };
+};
+
+template <typename Done> detached run_detached(at_co_task task, Done done)
+{
+    done(co_await task);
+}
+
+} // namespace at_co_detail
+
+/**
+ * \brief Runs the coroutine till its first co_await, within the calling task. Then it's resumed by the receiver
+ *        task, which also invokes done with its result, if given.
+ */
+template <typename Done> void at_co_spawn(at_co_task &&task, Done &&done)
+{
+    at_co_detail::run_detached(std::move(task), std::forward<Done>(done));
+}
+
+inline void at_co_spawn(at_co_task &&task)
+{
+    at_co_spawn(std::move(task), [](at_err) {});
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE SCHEDULER
+// --------------------------------------------------------------------------------------------------------------------
+template <typename Channel> class at_co_scheduler;
+
+/**
+ * \brief Awaits a command; the result of the command is the result of the co_await.
+ *
+ * Lives in the frame of the awaiting coroutine, which is where the completion of the command finds it.
+ */
+template <typename Channel> class at_co_send
+{
+  public:
+    using cmd = typename Channel::cmd;
+
+    at_co_send(at_co_scheduler<Channel> &scheduler,
+               cmd command,
+               at_cmd_type command_type,
+               at_string &&payload,
+               at_string *response_payload,
+               at_priority priority) :
+        m_scheduler(scheduler),
+        m_command(command),
+        m_command_type(command_type),
+        m_payload(std::move(payload)),
+        m_response_payload(response_payload),
+        m_priority(priority)
+    {
+    }
+
+    at_co_send(const at_co_send &) = delete;
+    at_co_send &operator=(const at_co_send &) = delete;
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    //! Returns false when the command fails at once, so the coroutine isn't suspended at all.
+    bool await_suspend(std::coroutine_handle<> awaiting)
+    {
+        m_awaiting = awaiting;
+        return m_scheduler.issue(*this);
+    }
+
+    at_err await_resume() const noexcept
+    {
+        return m_result;
+    }
+
+  private:
+    friend class at_co_scheduler<Channel>;
+
+    at_co_scheduler<Channel> &m_scheduler;
+    cmd m_command;
+    at_cmd_type m_command_type;
+    at_string m_payload;
+    at_string *m_response_payload;
+    at_priority m_priority;
+    std::coroutine_handle<> m_awaiting;
+    at_err m_result = at_err::unknown;
+
+    //! The next of the parked commands.
+    at_co_send *m_next = nullptr;
+};
+
+/**
+ * \brief Issues the commands awaited by the coroutines through the channel, and parks the ones which don't fit into
+ *        the queue of the commands till one of its own commands completes.
+ *
+ * Channel is jungles::at_channel, or anything else with the same send_async() which takes the completion.
+ */
+template <typename Channel> class at_co_scheduler
+{
+  public:
+    using cmd = typename Channel::cmd;
+
+    explicit at_co_scheduler(Channel &channel);
+    ~at_co_scheduler();
+
+    at_co_scheduler(const at_co_scheduler &) = delete;
+    at_co_scheduler &operator=(const at_co_scheduler &) = delete;
+
+    //! `co_await scheduler.send(...)` gives the result of the command. \see at_send_co()
+    at_co_send<Channel> send(cmd command,
+                             at_cmd_type command_type,
+                             at_string &&payload = {},
+                             at_priority priority = at_priority::normal);
+    at_co_send<Channel> send(cmd command,
+                             at_cmd_type command_type,
+                             at_string &&payload,
+                             at_string &response_payload,
+                             at_priority priority = at_priority::normal);
+
+  private:
+    friend class at_co_send<Channel>;
+
+    //! Returns false when the command has failed, and the coroutine shall go on.
+    bool issue(at_co_send<Channel> &awaiter);
+    void complete(at_co_send<Channel> &awaiter, at_err result, at_string &&response_payload);
+
+    //! Must be called with m_mux taken. Doesn't touch the awaiter after it's been issued, as it may be resumed then.
+    bool try_issue(at_co_send<Channel> &awaiter);
+
+    //! Must be called with m_mux taken.
+    void issue_parked();
+
+    Channel &m_channel;
+    at_semaphore_memory m_mux_memory;
+    SemaphoreHandle_t m_mux;
+
+    //! The number of the commands issued which haven't completed yet.
+    unsigned m_in_flight_num = 0;
+    at_co_send<Channel> *m_parked_head = nullptr;
+    at_co_send<Channel> *m_parked_tail = nullptr;
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE FUNCTIONS OF THE DEFAULT CHANNEL
+// --------------------------------------------------------------------------------------------------------------------
+//! Issues the commands through the default channel, with at_send_async().
+struct at_co_default_channel
+{
+    using cmd = at_cmd;
+
+    static at_async_handle send_async(at_cmd command,
+                                      at_cmd_type command_type,
+                                      at_string &&payload,
+                                      at_async_completion completion,
+                                      at_priority priority)
+    {
+        return at_send_async(command, command_type, std::move(payload), std::move(completion), priority);
+    }
+};
+
+inline at_co_default_channel at_co_default_channel_instance;
+inline at_co_scheduler<at_co_default_channel> at_co_default_scheduler{at_co_default_channel_instance};
+
+/**
+ * \brief Send an AT command from a coroutine; `co_await at_send_co(...)` gives the result of the command.
+ *
+ * The coroutine is resumed by the task which receives the responses, so it can't use any blocking OS function till
+ * its next co_await.
+ *
+ * \param[in] command       The command to be sent.
+ * \param[in] command_type  The type of the command.
+ * \param[in] payload       The payload of the write AT command. Shall be empty for the other command types.
+ * \param[in] priority      Commands with a higher priority overtake the queued ones. \see at_priority
+ */
+inline at_co_send<at_co_default_channel> at_send_co(at_cmd command,
+                                                    at_cmd_type command_type,
+                                                    at_string &&payload = {},
+                                                    at_priority priority = at_priority::normal)
+{
+    return at_co_default_scheduler.send(command, command_type, std::move(payload), priority);
+}
+
+//! The same as above, which also gives the payload of the response, which must be valid until the co_await is done.
+inline at_co_send<at_co_default_channel> at_send_co(at_cmd command,
+                                                    at_cmd_type command_type,
+                                                    at_string &&payload,
+                                                    at_string &response_payload,
+                                                    at_priority priority = at_priority::normal)
+{
+    return at_co_default_scheduler.send(command, command_type, std::move(payload), response_payload, priority);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE MEMBER FUNCTIONS OF at_co_scheduler
+// --------------------------------------------------------------------------------------------------------------------
+template <typename Channel>
+at_co_scheduler<Channel>::at_co_scheduler(Channel &channel) :
+    m_channel(channel), m_mux(at_create_mutex(m_mux_memory))
+{
+}
+
+template <typename Channel> at_co_scheduler<Channel>::~at_co_scheduler()
+{
+    vSemaphoreDelete(m_mux);
+}
+
+template <typename Channel>
+at_co_send<Channel> at_co_scheduler<Channel>::send(cmd command,
+                                                   at_cmd_type command_type,
+                                                   at_string &&payload,
+                                                   at_priority priority)
+{
+    return at_co_send<Channel>(*this, command, command_type, std::move(payload), nullptr, priority);
+}
+
+template <typename Channel>
+at_co_send<Channel> at_co_scheduler<Channel>::send(cmd command,
+                                                   at_cmd_type command_type,
+                                                   at_string &&payload,
+                                                   at_string &response_payload,
+                                                   at_priority priority)
+{
+    return at_co_send<Channel>(*this, command, command_type, std::move(payload), &response_payload, priority);
+}
+
+template <typename Channel> bool at_co_scheduler<Channel>::issue(at_co_send<Channel> &awaiter)
+{
+    os_lockguard guard(m_mux);
+    // The parked commands go first.
+    if (!m_parked_head && try_issue(awaiter))
+        return true;
+    if (m_in_flight_num == 0)
+    {
+        awaiter.m_result = at_err::timeout;
+        return false;
+    }
+    if (m_parked_tail)
+        m_parked_tail->m_next = &awaiter;
+    else
+        m_parked_head = &awaiter;
+    m_parked_tail = &awaiter;
+    return true;
+}
+
+template <typename Channel>
+void at_co_scheduler<Channel>::complete(at_co_send<Channel> &awaiter, at_err result, at_string &&response_payload)
+{
+    awaiter.m_result = result;
+    if (awaiter.m_response_payload)
+        *awaiter.m_response_payload = std::move(response_payload);
+
+    at_co_send<Channel> *expired = nullptr;
+    {
+        os_lockguard guard(m_mux);
+        m_in_flight_num--;
+        // The slot of this command is free already, so the parked ones take it before the resumed coroutine does.
+        issue_parked();
+        if (m_in_flight_num == 0)
+        {
+            expired = std::exchange(m_parked_head, nullptr);
+            m_parked_tail = nullptr;
+        }
+    }
+
+    awaiter.m_awaiting.resume();
+    // The rest of the queue is taken by the commands of the others, which wouldn't issue the parked ones.
+    while (expired)
+    {
+        auto next = expired->m_next;
+        expired->m_result = at_err::timeout;
+        expired->m_awaiting.resume();
+        expired = next;
+    }
+}
+
+template <typename Channel> bool at_co_scheduler<Channel>::try_issue(at_co_send<Channel> &awaiter)
+{
+    // The payload is moved only when the command is queued, so it's kept for the next attempt otherwise.
+    auto handle = m_channel.send_async(
+        awaiter.m_command,
+        awaiter.m_command_type,
+        std::move(awaiter.m_payload),
+        [&awaiter](at_err result, at_string &&response_payload) {
+            awaiter.m_scheduler.complete(awaiter, result, std::move(response_payload));
+        },
+        awaiter.m_priority);
+    if (!handle.is_valid())
+        return false;
+    // The completion takes m_mux, so it can't run before the command is counted.
+    m_in_flight_num++;
+    return true;
+}
+
+template <typename Channel> void at_co_scheduler<Channel>::issue_parked()
+{
+    while (m_parked_head)
+    {
+        auto parked = m_parked_head;
+        auto next = parked->m_next;
+        if (!try_issue(*parked))
+            return;
+        m_parked_head = next;
+        if (!m_parked_head)
+            m_parked_tail = nullptr;
+    }
+}
+
+#endif /* AT_CO_HPP */
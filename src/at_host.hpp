@@ -0,0 +1,564 @@
+/**
+ * @file	at_host.hpp
+ * @brief	Defines the backend which drives the modems from a Linux process (e.g. a gateway with USB modems), without
+ *          FreeRTOS.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef AT_HOST_HPP
+#define AT_HOST_HPP
+
+#include "at_cmd_handler_impl.hpp"
+#include "request_queue.hpp"
+#include "string_buf_rx.hpp"
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <fcntl.h>
+#include <functional>
+#include <mutex>
+#include <poll.h>
+#include <string>
+#include <string_view>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF PUBLIC FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+
+/**
+ * \brief Opens the serial port (e.g. "/dev/ttyUSB2") in the raw mode with the baud rate (e.g. B115200).
+ * \returns the file descriptor or -1 on failure, with errno set.
+ */
+inline int at_host_open_tty(const char *path, speed_t baud);
+
+/**
+ * Pass it as the timeout to wait as long as the timeout profile of the command tells.
+ * \see at_profile_timeout
+ */
+constexpr std::chrono::milliseconds at_host_profile_timeout{-1};
+
+namespace jungles {
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS OF STRUCTURES, DATA TYPES, ...
+// --------------------------------------------------------------------------------------------------------------------
+
+/**
+ * \brief A single thread which reads the bytes from many ports at once (e.g. dozens of USB modems) and passes them in
+ *        bulk to their handlers.
+ *
+ * The ports are watched with epoll, so the thread sleeps until any of them has bytes to read and then takes as many
+ * of them as are ready with a single read(). The handlers are invoked within the thread of the reactor one at a time,
+ * so they shall be short and they mustn't add or remove the ports.
+ */
+class at_host_reactor
+{
+  public:
+    //! Gets the bytes just read from the port.
+    using rx_handler = std::function<void(const char *bytes, size_t num)>;
+
+    at_host_reactor();
+    at_host_reactor(const at_host_reactor &) = delete;
+    at_host_reactor &operator=(const at_host_reactor &) = delete;
+    ~at_host_reactor();
+
+    //! Starts the thread. Returns false when the OS objects couldn't be created.
+    bool start();
+
+    //! Stops the thread and returns once it has finished.
+    void stop();
+
+    //! The port may be added also while the thread runs. Returns false when epoll refuses the descriptor.
+    bool add(int fd, rx_handler &&handler);
+
+    //! Once this returns, the handler of the port isn't invoked anymore.
+    void remove(int fd);
+
+  private:
+    struct port
+    {
+        int fd;
+        rx_handler handler;
+    };
+
+    //! Most USB modems deliver at most 512 bytes per transfer, so a single read usually takes all which is ready.
+    static constexpr size_t rx_chunk_len = 4096;
+    static constexpr size_t max_events_num = 32;
+
+    int m_epoll_fd = -1;
+
+    //! Written by stop() to wake the thread up.
+    int m_stop_fd = -1;
+
+    std::thread m_thread;
+
+    //! Held while a handler is invoked, so the port can't be removed meanwhile.
+    std::mutex m_ports_mux;
+    std::vector<port> m_ports;
+
+    void run();
+    void handle_readable(int fd, char *chunk);
+};
+
+/**
+ * \brief The counterpart of at_channel for a port driven by at_host_reactor: the same parser of the responses and of
+ *        the unsolicited commands, the same queue of the commands, with std::mutex and std::condition_variable instead
+ *        of the FreeRTOS objects.
+ *
+ * The CommandSet is the same as for at_cmd_handler. The Config must provide the static constexpr members:
+ *  - size_t rx_buf_len and size_t rx_lines_num, which size the RX buffer (\see string_buf_rx),
+ *  - size_t cmd_queue_len, the number of the commands which can be queued at once.
+ *
+ * The commands are written to the port by the thread which issues them, or by the thread of the reactor once the final
+ * result code of the previous one arrives. The responses are parsed and the unsolicited handlers are invoked within
+ * the thread of the reactor, with the mutex of the channel taken, so the handlers mustn't send any command through
+ * the same channel.
+ *
+ * The port shall be in the blocking mode for writing; it's read only when epoll tells that it has bytes ready.
+ * The strings are allocated from the heap, as AT_CMD_HANDLER_POOL needs FreeRTOS.
+ */
+template <typename CommandSet, typename Config> class at_host_channel
+{
+  public:
+    using cmd_handler_type = at_cmd_handler<CommandSet>;
+    using cmd = typename cmd_handler_type::cmd;
+    using unsolicited_msg = typename cmd_handler_type::unsolicited_msg;
+    using timeout_type = std::chrono::milliseconds;
+
+    explicit at_host_channel(int fd);
+    at_host_channel(const at_host_channel &) = delete;
+    at_host_channel &operator=(const at_host_channel &) = delete;
+
+    //! Makes the reactor feed the channel with the bytes from its port. The port must be removed from the reactor
+    //! before the channel is destroyed.
+    bool attach(at_host_reactor &reactor);
+
+    //! \see at_send()
+    at_err send(cmd command, at_string &&payload, timeout_type timeout, at_string &response_payload);
+    at_err send(cmd command, at_string &&payload, timeout_type timeout);
+    at_err send(cmd command, at_cmd_type command_type, timeout_type timeout, at_string &response_payload);
+    at_err send(cmd command, at_cmd_type command_type, timeout_type timeout);
+
+    //! \see at_register_unsolicited_handler()
+    at_handler_token register_unsolicited_handler(cmd command, at_unsolicited_cmd_handler handler);
+    at_handler_token register_unsolicited_handler(unsolicited_msg message, at_unsolicited_msg_handler handler);
+
+    //! \see at_unregister_unsolicited_handler()
+    bool unregister_unsolicited_handler(at_handler_token token);
+
+    //! Called by the reactor with the bytes read from the port.
+    void handle_rx_bytes(const char *bytes, size_t num);
+
+  private:
+    using clock = std::chrono::steady_clock;
+
+    struct request
+    {
+        cmd command = cmd::none;
+        std::string_view prefix;
+        at_string payload;
+        at_string response_payload;
+        at_err result = at_err::unknown;
+        bool is_done = false;
+
+        //! Notified when the request is done. The issuer waits on it with the mutex of the channel.
+        std::condition_variable done_cv;
+    };
+
+    static constexpr std::string_view crlf_str{"\r\n"};
+
+    const int m_fd;
+
+    //! Guards all the members below, the RX buffer included, as its producer and consumer are the same thread.
+    std::mutex m_mux;
+
+    cmd_handler_type m_cmd_handler;
+    string_buf_rx<Config::rx_buf_len, Config::rx_lines_num> m_rx_buf;
+
+    //! The front one is the command in flight.
+    request_queue<request, Config::cmd_queue_len> m_requests;
+
+    //! Notified when a slot of the queue is released.
+    std::condition_variable m_free_slot_cv;
+
+    //! Lines received when no command is in flight are treated as unsolicited; their payload is discarded here.
+    at_string m_dummy_payload;
+
+    at_err send_and_get_response(cmd command,
+                                 std::string_view prefix,
+                                 at_string &&payload,
+                                 timeout_type timeout,
+                                 at_string &response_payload);
+    void handle_received_response(line_view response, size_t colon_pos);
+    void withdraw_request(request &req);
+    void transmit_request(request &req);
+    void write_all(const char *data, size_t len);
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PUBLIC FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+inline int at_host_open_tty(const char *path, speed_t baud)
+{
+    auto fd = open(path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    termios tio;
+    if (tcgetattr(fd, &tio) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, baud);
+    cfsetospeed(&tio, baud);
+    tio.c_cflag |= CLOCAL | CREAD;
+    // A read returns whatever has arrived, at least a single byte.
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    if (tcsetattr(fd, TCSANOW, &tio) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    tcflush(fd, TCIOFLUSH);
+    return fd;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PUBLIC MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+inline at_host_reactor::at_host_reactor() = default;
+
+inline at_host_reactor::~at_host_reactor()
+{
+    stop();
+}
+
+inline bool at_host_reactor::start()
+{
+    if (m_thread.joinable())
+        return true;
+
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    m_stop_fd = eventfd(0, EFD_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = m_stop_fd;
+    if (m_epoll_fd < 0 || m_stop_fd < 0 || epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_stop_fd, &ev) != 0)
+    {
+        stop();
+        return false;
+    }
+
+    // The ports added before the start are watched from now on.
+    std::lock_guard<std::mutex> lock(m_ports_mux);
+    for (auto &p : m_ports)
+    {
+        ev.data.fd = p.fd;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, p.fd, &ev);
+    }
+    m_thread = std::thread([this] { run(); });
+    return true;
+}
+
+inline void at_host_reactor::stop()
+{
+    if (m_thread.joinable())
+    {
+        uint64_t one = 1;
+        auto written = write(m_stop_fd, &one, sizeof(one));
+        (void)written;
+        m_thread.join();
+    }
+    if (m_stop_fd >= 0)
+        close(m_stop_fd);
+    if (m_epoll_fd >= 0)
+        close(m_epoll_fd);
+    m_stop_fd = m_epoll_fd = -1;
+}
+
+inline bool at_host_reactor::add(int fd, rx_handler &&handler)
+{
+    std::lock_guard<std::mutex> lock(m_ports_mux);
+    if (m_epoll_fd >= 0)
+    {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0)
+            return false;
+    }
+    m_ports.push_back({fd, std::move(handler)});
+    return true;
+}
+
+inline void at_host_reactor::remove(int fd)
+{
+    std::lock_guard<std::mutex> lock(m_ports_mux);
+    if (m_epoll_fd >= 0)
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    for (auto it = m_ports.begin(); it != m_ports.end(); ++it)
+        if (it->fd == fd)
+        {
+            m_ports.erase(it);
+            return;
+        }
+}
+
+template <typename CommandSet, typename Config>
+at_host_channel<CommandSet, Config>::at_host_channel(int fd) : m_fd{fd}
+{
+    m_rx_buf.discard_strings_starting_with(cmd_handler_type::get_discardable_echo_prefix());
+}
+
+template <typename CommandSet, typename Config>
+bool at_host_channel<CommandSet, Config>::attach(at_host_reactor &reactor)
+{
+    return reactor.add(m_fd, [this](const char *bytes, size_t num) { handle_rx_bytes(bytes, num); });
+}
+
+template <typename CommandSet, typename Config>
+at_err at_host_channel<CommandSet, Config>::send(cmd command,
+                                                 at_string &&payload,
+                                                 timeout_type timeout,
+                                                 at_string &response_payload)
+{
+    return send_and_get_response(command,
+                                 cmd_handler_type::get_cmd_prefix(command, at_cmd_type::write),
+                                 std::move(payload),
+                                 timeout,
+                                 response_payload);
+}
+
+template <typename CommandSet, typename Config>
+at_err at_host_channel<CommandSet, Config>::send(cmd command, at_string &&payload, timeout_type timeout)
+{
+    at_string dummy;
+    return send(command, std::move(payload), timeout, dummy);
+}
+
+template <typename CommandSet, typename Config>
+at_err at_host_channel<CommandSet, Config>::send(cmd command,
+                                                 at_cmd_type command_type,
+                                                 timeout_type timeout,
+                                                 at_string &response_payload)
+{
+    return send_and_get_response(
+        command, cmd_handler_type::get_cmd_prefix(command, command_type), {}, timeout, response_payload);
+}
+
+template <typename CommandSet, typename Config>
+at_err at_host_channel<CommandSet, Config>::send(cmd command, at_cmd_type command_type, timeout_type timeout)
+{
+    at_string dummy;
+    return send(command, command_type, timeout, dummy);
+}
+
+template <typename CommandSet, typename Config>
+at_handler_token at_host_channel<CommandSet, Config>::register_unsolicited_handler(cmd command,
+                                                                                   at_unsolicited_cmd_handler handler)
+{
+    std::lock_guard<std::mutex> lock(m_mux);
+    return m_cmd_handler.register_unsolicited_handler(command, std::move(handler));
+}
+
+template <typename CommandSet, typename Config>
+at_handler_token at_host_channel<CommandSet, Config>::register_unsolicited_handler(unsolicited_msg message,
+                                                                                   at_unsolicited_msg_handler handler)
+{
+    std::lock_guard<std::mutex> lock(m_mux);
+    return m_cmd_handler.register_unsolicited_handler(message, std::move(handler));
+}
+
+template <typename CommandSet, typename Config>
+bool at_host_channel<CommandSet, Config>::unregister_unsolicited_handler(at_handler_token token)
+{
+    std::lock_guard<std::mutex> lock(m_mux);
+    return m_cmd_handler.unregister_unsolicited_handler(token);
+}
+
+//! The whole chunk is pushed at once and then all the lines which it has completed are handled.
+template <typename CommandSet, typename Config>
+void at_host_channel<CommandSet, Config>::handle_rx_bytes(const char *bytes, size_t num)
+{
+    std::lock_guard<std::mutex> lock(m_mux);
+    m_rx_buf.push_bytes_and_count_string_ends(bytes, num);
+    while (!m_rx_buf.is_empty())
+    {
+        auto response = m_rx_buf.peek_string();
+        if (!response.empty())
+            handle_received_response(response, m_rx_buf.peek_colon_pos());
+        m_rx_buf.release_string();
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+inline void at_host_reactor::run()
+{
+    std::array<epoll_event, max_events_num> events;
+    std::array<char, rx_chunk_len> chunk;
+    for (;;)
+    {
+        auto events_num = epoll_wait(m_epoll_fd, events.data(), events.size(), -1);
+        if (events_num < 0 && errno == EINTR)
+            continue;
+        if (events_num < 0)
+            return;
+
+        for (int i = 0; i < events_num; ++i)
+        {
+            if (events[i].data.fd == m_stop_fd)
+                return;
+            handle_readable(events[i].data.fd, chunk.data());
+        }
+    }
+}
+
+inline void at_host_reactor::handle_readable(int fd, char *chunk)
+{
+    std::lock_guard<std::mutex> lock(m_ports_mux);
+    auto len = read(fd, chunk, rx_chunk_len);
+    if (len < 0 && (errno == EINTR || errno == EAGAIN))
+        return;
+    if (len <= 0)
+    {
+        // The port has hung up (e.g. the modem has been unplugged), so it would be reported as readable forever.
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        return;
+    }
+
+    for (auto &p : m_ports)
+        if (p.fd == fd)
+        {
+            p.handler(chunk, static_cast<size_t>(len));
+            return;
+        }
+}
+
+template <typename CommandSet, typename Config>
+at_err at_host_channel<CommandSet, Config>::send_and_get_response(cmd command,
+                                                                  std::string_view prefix,
+                                                                  at_string &&payload,
+                                                                  timeout_type timeout,
+                                                                  at_string &response_payload)
+{
+    if (timeout == at_host_profile_timeout)
+        timeout = timeout_type{cmd_handler_type::get_timeout_profile(command).total_ms};
+    auto deadline = clock::now() + timeout;
+
+    std::unique_lock<std::mutex> lock(m_mux);
+    // The time spent on waiting for a free slot is included in the time of waiting for the response.
+    request *req = nullptr;
+    if (!m_free_slot_cv.wait_until(lock, deadline, [&] { return (req = m_requests.acquire()) != nullptr; }))
+        return at_err::timeout;
+
+    req->command = command;
+    req->prefix = prefix;
+    req->payload = std::move(payload);
+    req->response_payload.clear();
+    req->result = at_err::unknown;
+    req->is_done = false;
+    m_requests.push_back(req);
+    // When no other command is in flight then send this one straight away. Otherwise it will be sent by the reactor,
+    // once the final result code of the previous command arrives.
+    if (m_requests.front() == req)
+        transmit_request(*req);
+
+    req->done_cv.wait_until(lock, deadline, [req] { return req->is_done; });
+
+    auto result = at_err::timeout;
+    if (req->is_done)
+    {
+        result = req->result;
+        response_payload = std::move(req->response_payload);
+    }
+    else
+        withdraw_request(*req);
+    m_requests.release(req);
+    m_free_slot_cv.notify_one();
+    return result;
+}
+
+//! Must be called with m_mux taken.
+template <typename CommandSet, typename Config>
+void at_host_channel<CommandSet, Config>::handle_received_response(line_view response, size_t colon_pos)
+{
+    auto req = m_requests.front();
+    auto res = req ? m_cmd_handler.handle_received_response(response, colon_pos, req->command, req->response_payload)
+                   : m_cmd_handler.handle_received_response(response, colon_pos, cmd::none, m_dummy_payload);
+    m_dummy_payload.clear();
+    if (!req || !is_final_result_code(res))
+        return;
+
+    req->result = res;
+    req->is_done = true;
+    m_requests.remove(req);
+    req->done_cv.notify_one();
+    // The slot for the next command is free immediately after the final result code has arrived.
+    if (auto next = m_requests.front())
+        transmit_request(*next);
+}
+
+/**
+ * Must be called with m_mux taken. When the request is in flight then the next one is started, so a command which is
+ * never responded doesn't block the whole queue.
+ */
+template <typename CommandSet, typename Config>
+void at_host_channel<CommandSet, Config>::withdraw_request(request &req)
+{
+    auto was_in_flight = m_requests.front() == &req;
+    m_requests.remove(&req);
+    if (!was_in_flight)
+        return;
+
+    // The rest of the line being received belongs to the withdrawn command, not to the next one.
+    m_rx_buf.discard_current_string();
+    if (auto next = m_requests.front())
+        transmit_request(*next);
+}
+
+//! Must be called with m_mux taken. When the port fails, then the command times out.
+template <typename CommandSet, typename Config>
+void at_host_channel<CommandSet, Config>::transmit_request(request &req)
+{
+    std::string line;
+    line.reserve(req.prefix.length() + req.payload.length() + crlf_str.length());
+    line.append(req.prefix).append(req.payload.data(), req.payload.length()).append(crlf_str);
+    write_all(line.data(), line.length());
+}
+
+template <typename CommandSet, typename Config>
+void at_host_channel<CommandSet, Config>::write_all(const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        auto written = write(m_fd, data, len);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written < 0 && errno == EAGAIN)
+        {
+            pollfd pfd{m_fd, POLLOUT, 0};
+            poll(&pfd, 1, -1);
+            continue;
+        }
+        if (written <= 0)
+            return;
+        data += written;
+        len -= static_cast<size_t>(written);
+    }
+}
+
+} // namespace jungles
+
+#endif /* AT_HOST_HPP */
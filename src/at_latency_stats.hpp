@@ -0,0 +1,145 @@
+/**
+ * @file	at_latency_stats.hpp
+ * @brief	Defines histograms of the latencies of the phases of the AT commands.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef AT_LATENCY_STATS_HPP
+#define AT_LATENCY_STATS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+//! The phases of a command, from queueing it to receiving its final result code.
+enum class at_latency_phase
+{
+    //! From enqueueing the command to the start of its transmission, i.e. the time spent behind other commands.
+    queue,
+
+    //! From the start of the transmission to the moment when the last byte has been handed over to the port.
+    transmission,
+
+    //! From the end of the transmission to the first byte received afterwards, i.e. the reaction time of the device.
+    response,
+
+    //! From the first received byte to the final result code, i.e. receiving and parsing of the whole response.
+    reception,
+
+    //! From enqueueing the command to the final result code.
+    total,
+
+    number_of_phases
+};
+
+inline const char *at_latency_phase_to_string(at_latency_phase phase)
+{
+    static constexpr const char *phase_str[] = {"queue", "transmission", "response", "reception", "total"};
+    return phase_str[static_cast<size_t>(phase)];
+}
+
+/**
+ * \brief Counts latencies in buckets which cover exponentially growing ranges.
+ *
+ * The bucket 'i' counts the latencies from the range [2^i, 2^(i+1)), expressed in the units of the timestamps.
+ * The bucket 0 counts also zero and the last bucket counts all the latencies which don't fit into the other ones.
+ */
+struct at_latency_histogram
+{
+    static constexpr size_t buckets_num = 20;
+
+    std::array<uint32_t, buckets_num> counts = {};
+    uint32_t max = 0;
+
+    void add(uint32_t latency) noexcept
+    {
+        size_t bucket = 0;
+        for (auto l = latency >> 1; l != 0 && bucket < buckets_num - 1; l >>= 1)
+            ++bucket;
+        counts[bucket]++;
+        if (latency > max)
+            max = latency;
+    }
+
+    uint32_t total_count() const noexcept
+    {
+        uint32_t total = 0;
+        for (auto c : counts)
+            total += c;
+        return total;
+    }
+};
+
+//! The points in time of a single command, taken with the timestamp source of the port.
+struct at_latency_timestamps
+{
+    uint32_t enqueued;
+    uint32_t tx_started;
+    uint32_t tx_completed;
+    uint32_t first_rx_byte;
+    uint32_t final_result_code;
+};
+
+/**
+ * \brief The histograms of each phase for each command, held in static memory.
+ *
+ * Recording is done by a single task. The histograms may be read by any task, in that case a single count may be
+ * read before or after it has been updated, what doesn't matter for the statistics.
+ */
+template <size_t CmdsNum> class at_latency_stats
+{
+  public:
+    void record(size_t cmd_idx, const at_latency_timestamps &t) noexcept;
+
+    const at_latency_histogram &get(size_t cmd_idx, at_latency_phase phase) const noexcept;
+
+    void reset() noexcept;
+
+  private:
+    static constexpr auto phases_num{static_cast<size_t>(at_latency_phase::number_of_phases)};
+
+    std::array<std::array<at_latency_histogram, phases_num>, CmdsNum> m_histograms;
+
+    void add(size_t cmd_idx, at_latency_phase phase, uint32_t latency) noexcept;
+};
+
+//! Used instead of at_latency_stats when the latencies aren't measured.
+struct at_no_latency_stats
+{
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PUBLIC MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <size_t CmdsNum>
+void at_latency_stats<CmdsNum>::record(size_t cmd_idx, const at_latency_timestamps &t) noexcept
+{
+    // The unsigned subtraction handles the wrap around of the timestamps.
+    add(cmd_idx, at_latency_phase::queue, t.tx_started - t.enqueued);
+    add(cmd_idx, at_latency_phase::transmission, t.tx_completed - t.tx_started);
+    add(cmd_idx, at_latency_phase::response, t.first_rx_byte - t.tx_completed);
+    add(cmd_idx, at_latency_phase::reception, t.final_result_code - t.first_rx_byte);
+    add(cmd_idx, at_latency_phase::total, t.final_result_code - t.enqueued);
+}
+
+template <size_t CmdsNum>
+const at_latency_histogram &at_latency_stats<CmdsNum>::get(size_t cmd_idx, at_latency_phase phase) const noexcept
+{
+    return m_histograms[cmd_idx][static_cast<size_t>(phase)];
+}
+
+template <size_t CmdsNum> void at_latency_stats<CmdsNum>::reset() noexcept
+{
+    m_histograms = {};
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <size_t CmdsNum>
+void at_latency_stats<CmdsNum>::add(size_t cmd_idx, at_latency_phase phase, uint32_t latency) noexcept
+{
+    m_histograms[cmd_idx][static_cast<size_t>(phase)].add(latency);
+}
+
+#endif /* AT_LATENCY_STATS_HPP */
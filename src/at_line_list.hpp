@@ -0,0 +1,205 @@
+/**
+ * @file	at_line_list.hpp
+ * @brief	Keeps the lines of a response in a single buffer, along with the place of each line within it.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef AT_LINE_LIST_HPP
+#define AT_LINE_LIST_HPP
+
+#include "at_cmd_config.hpp"
+#include "at_pool.hpp"
+#include "line_view.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <string_view>
+#include <utility>
+
+#ifndef AT_CMD_HANDLER_MAX_RESPONSE_LINES
+#define AT_CMD_HANDLER_MAX_RESPONSE_LINES 16
+#endif /* AT_CMD_HANDLER_MAX_RESPONSE_LINES */
+
+/**
+ * \brief The lines of the payload of a response, which are visited one by one without splitting the payload again.
+ *
+ * The lines are appended to a single buffer, joined with CRLF, so the buffer is the same payload as the one returned
+ * by the functions which take at_string (\see joined()). The place of each line is recorded when it's appended.
+ * When the buffer is reserved for the whole response (\see at_cmd_response_size), then it isn't reallocated while the
+ * response grows.
+ *
+ * At most AT_CMD_HANDLER_MAX_RESPONSE_LINES lines are recorded; the last one spans the rest of the lines then, joined
+ * with CRLF like in the buffer, so nothing is lost.
+ */
+class at_line_list
+{
+  public:
+    class iterator
+    {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const std::string_view *;
+        using reference = std::string_view;
+
+        iterator(const at_line_list &list, size_t idx) noexcept : m_list(&list), m_idx(idx)
+        {
+        }
+
+        std::string_view operator*() const noexcept
+        {
+            return (*m_list)[m_idx];
+        }
+
+        iterator &operator++() noexcept
+        {
+            ++m_idx;
+            return *this;
+        }
+
+        iterator operator++(int) noexcept
+        {
+            auto it = *this;
+            ++m_idx;
+            return it;
+        }
+
+        bool operator==(const iterator &other) const noexcept
+        {
+            return m_idx == other.m_idx;
+        }
+
+        bool operator!=(const iterator &other) const noexcept
+        {
+            return m_idx != other.m_idx;
+        }
+
+      private:
+        const at_line_list *m_list;
+        size_t m_idx;
+    };
+
+    static constexpr size_t max_lines_num = AT_CMD_HANDLER_MAX_RESPONSE_LINES;
+
+    size_t size() const noexcept;
+    bool empty() const noexcept;
+
+    //! The line without CRLF. Refers to the buffer, so it's valid till the list is changed.
+    std::string_view operator[](size_t idx) const noexcept;
+
+    iterator begin() const noexcept;
+    iterator end() const noexcept;
+
+    //! All the lines joined with CRLF.
+    const at_string &joined() const noexcept;
+
+    void reserve(size_t len);
+    size_t capacity() const noexcept;
+
+    void append(const line_view &line);
+    void clear() noexcept;
+    void swap(at_line_list &other) noexcept;
+
+    //! Gives the joined lines to the string, which buffer is taken for the next lines, so no buffer is released.
+    void swap_joined(at_string &joined) noexcept;
+
+    //! Moves the joined lines out, leaving the list empty.
+    at_string release_joined() noexcept;
+
+  private:
+    struct line_pos
+    {
+        size_t offset;
+        size_t length;
+    };
+
+    at_string m_joined;
+    std::array<line_pos, max_lines_num> m_lines{};
+    size_t m_lines_num = 0;
+};
+
+inline size_t at_line_list::size() const noexcept
+{
+    return m_lines_num;
+}
+
+inline bool at_line_list::empty() const noexcept
+{
+    return m_lines_num == 0;
+}
+
+inline std::string_view at_line_list::operator[](size_t idx) const noexcept
+{
+    return std::string_view(m_joined).substr(m_lines[idx].offset, m_lines[idx].length);
+}
+
+inline at_line_list::iterator at_line_list::begin() const noexcept
+{
+    return {*this, 0};
+}
+
+inline at_line_list::iterator at_line_list::end() const noexcept
+{
+    return {*this, m_lines_num};
+}
+
+inline const at_string &at_line_list::joined() const noexcept
+{
+    return m_joined;
+}
+
+inline void at_line_list::reserve(size_t len)
+{
+    // Never shrinks, so the buffer of the bigger responses is kept for the next ones.
+    if (m_joined.capacity() < len)
+        m_joined.reserve(len);
+}
+
+inline size_t at_line_list::capacity() const noexcept
+{
+    return m_joined.capacity();
+}
+
+inline void at_line_list::append(const line_view &line)
+{
+    if (!m_joined.empty())
+        m_joined += "\r\n";
+    auto offset = m_joined.size();
+    line.append_to(m_joined);
+    if (m_lines_num < m_lines.size())
+        m_lines[m_lines_num++] = {offset, line.length()};
+    else
+        m_lines.back().length = m_joined.size() - m_lines.back().offset;
+}
+
+inline void at_line_list::clear() noexcept
+{
+    m_joined.clear();
+    m_lines_num = 0;
+}
+
+inline void at_line_list::swap(at_line_list &other) noexcept
+{
+    m_joined.swap(other.m_joined);
+    // Only the recorded lines are exchanged.
+    auto lines_num = std::max(m_lines_num, other.m_lines_num);
+    std::swap_ranges(m_lines.begin(), m_lines.begin() + lines_num, other.m_lines.begin());
+    std::swap(m_lines_num, other.m_lines_num);
+}
+
+inline void at_line_list::swap_joined(at_string &joined) noexcept
+{
+    m_joined.swap(joined);
+    clear();
+}
+
+inline at_string at_line_list::release_joined() noexcept
+{
+    auto joined = std::move(m_joined);
+    clear();
+    return joined;
+}
+
+#endif /* AT_LINE_LIST_HPP */
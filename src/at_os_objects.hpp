@@ -0,0 +1,147 @@
+/**
+ * @file	at_os_objects.hpp
+ * @brief	Creates the tasks, the semaphores and the queues of the channels in their own memory, when FreeRTOS allows.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef AT_OS_OBJECTS_HPP
+#define AT_OS_OBJECTS_HPP
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "semphr.h"
+#include "stream_buffer.h"
+#include "task.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * When configSUPPORT_STATIC_ALLOCATION is set, the OS objects are created with the xCreate...Static() functions, in the
+ * memory held by the objects below, which are members of the channels. Then a channel defined at the namespace scope
+ * takes its tasks' stacks from .bss, the AT stack takes nothing from the heap of FreeRTOS and it works with
+ * configSUPPORT_DYNAMIC_ALLOCATION unset. Otherwise the holders are empty and the objects are allocated on the heap.
+ */
+
+//! Lets a task of the channel run on any core of a FreeRTOS SMP build. Has the same value as tskNO_AFFINITY.
+constexpr UBaseType_t at_no_core_affinity = ~static_cast<UBaseType_t>(0);
+
+template <configSTACK_DEPTH_TYPE StackDepth> struct at_task_memory
+{
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    StaticTask_t tcb;
+    std::array<StackType_t, StackDepth> stack;
+#endif /* (configSUPPORT_STATIC_ALLOCATION == 1) */
+};
+
+struct at_semaphore_memory
+{
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    StaticSemaphore_t semaphore;
+#endif /* (configSUPPORT_STATIC_ALLOCATION == 1) */
+};
+
+template <size_t Len, size_t ItemSize> struct at_queue_memory
+{
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    StaticQueue_t queue;
+    std::array<uint8_t, Len * ItemSize> storage;
+#endif /* (configSUPPORT_STATIC_ALLOCATION == 1) */
+};
+
+template <size_t Len> struct at_stream_buffer_memory
+{
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    StaticStreamBuffer_t stream_buffer;
+    //! The stream buffer keeps one byte free, which xStreamBufferCreate() adds by itself.
+    std::array<uint8_t, Len + 1> storage;
+#endif /* (configSUPPORT_STATIC_ALLOCATION == 1) */
+};
+
+/**
+ * \brief Creates the task with the stack of StackDepth words, pinned to the cores of core_affinity on a FreeRTOS SMP
+ *        build with configUSE_CORE_AFFINITY set.
+ */
+template <configSTACK_DEPTH_TYPE StackDepth>
+TaskHandle_t at_create_task(TaskFunction_t task,
+                            const char *name,
+                            at_task_memory<StackDepth> &memory,
+                            void *params,
+                            UBaseType_t priority,
+                            UBaseType_t core_affinity)
+{
+    TaskHandle_t handle = nullptr;
+#if defined(configNUMBER_OF_CORES) && (configNUMBER_OF_CORES > 1) && (configUSE_CORE_AFFINITY == 1)
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    handle = xTaskCreateStaticAffinitySet(
+        task, name, StackDepth, params, priority, memory.stack.data(), &memory.tcb, core_affinity);
+#else
+    (void)memory;
+    xTaskCreateAffinitySet(task, name, StackDepth, params, priority, core_affinity, &handle);
+#endif /* (configSUPPORT_STATIC_ALLOCATION == 1) */
+#else
+    (void)core_affinity;
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    handle = xTaskCreateStatic(task, name, StackDepth, params, priority, memory.stack.data(), &memory.tcb);
+#else
+    (void)memory;
+    xTaskCreate(task, name, StackDepth, params, priority, &handle);
+#endif /* (configSUPPORT_STATIC_ALLOCATION == 1) */
+#endif
+    return handle;
+}
+
+inline SemaphoreHandle_t at_create_mutex(at_semaphore_memory &memory)
+{
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    return xSemaphoreCreateMutexStatic(&memory.semaphore);
+#else
+    (void)memory;
+    return xSemaphoreCreateMutex();
+#endif /* (configSUPPORT_STATIC_ALLOCATION == 1) */
+}
+
+inline SemaphoreHandle_t at_create_binary_semaphore(at_semaphore_memory &memory)
+{
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    return xSemaphoreCreateBinaryStatic(&memory.semaphore);
+#else
+    (void)memory;
+    return xSemaphoreCreateBinary();
+#endif /* (configSUPPORT_STATIC_ALLOCATION == 1) */
+}
+
+inline SemaphoreHandle_t
+at_create_counting_semaphore(UBaseType_t max_count, UBaseType_t initial_count, at_semaphore_memory &memory)
+{
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    return xSemaphoreCreateCountingStatic(max_count, initial_count, &memory.semaphore);
+#else
+    (void)memory;
+    return xSemaphoreCreateCounting(max_count, initial_count);
+#endif /* (configSUPPORT_STATIC_ALLOCATION == 1) */
+}
+
+template <size_t Len, size_t ItemSize> QueueHandle_t at_create_queue(at_queue_memory<Len, ItemSize> &memory)
+{
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    return xQueueCreateStatic(Len, ItemSize, memory.storage.data(), &memory.queue);
+#else
+    (void)memory;
+    return xQueueCreate(Len, ItemSize);
+#endif /* (configSUPPORT_STATIC_ALLOCATION == 1) */
+}
+
+template <size_t Len>
+StreamBufferHandle_t at_create_stream_buffer(size_t trigger_level, at_stream_buffer_memory<Len> &memory)
+{
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    return xStreamBufferCreateStatic(
+        memory.storage.size(), trigger_level, memory.storage.data(), &memory.stream_buffer);
+#else
+    (void)memory;
+    return xStreamBufferCreate(Len, trigger_level);
+#endif /* (configSUPPORT_STATIC_ALLOCATION == 1) */
+}
+
+#endif /* AT_OS_OBJECTS_HPP */
@@ -0,0 +1,196 @@
+/**
+ * @file	at_pool.hpp
+ * @brief	Defines the allocator which takes the memory of the AT stack from fixed-block pools instead of the heap.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef AT_POOL_HPP
+#define AT_POOL_HPP
+
+#include "at_cmd_config.hpp"
+#include <memory>
+#include <string>
+#include <utility>
+
+#ifdef AT_CMD_HANDLER_POOL
+
+#include "block_pool.hpp"
+#include <new>
+
+#ifndef AT_CMD_HANDLER_POOL_LOCK
+#include "FreeRTOS.h"
+#include "task.h"
+//! The pools are used only by the tasks, so a critical section keeps the operations short and bounded.
+#define AT_CMD_HANDLER_POOL_LOCK() taskENTER_CRITICAL()
+#define AT_CMD_HANDLER_POOL_UNLOCK() taskEXIT_CRITICAL()
+#endif /* AT_CMD_HANDLER_POOL_LOCK */
+
+#ifndef AT_CMD_HANDLER_POOL_SMALL_BLOCK_SIZE
+#define AT_CMD_HANDLER_POOL_SMALL_BLOCK_SIZE 32
+#endif /* AT_CMD_HANDLER_POOL_SMALL_BLOCK_SIZE */
+
+#ifndef AT_CMD_HANDLER_POOL_SMALL_BLOCKS_NUM
+#define AT_CMD_HANDLER_POOL_SMALL_BLOCKS_NUM 32
+#endif /* AT_CMD_HANDLER_POOL_SMALL_BLOCKS_NUM */
+
+#ifndef AT_CMD_HANDLER_POOL_MEDIUM_BLOCK_SIZE
+#define AT_CMD_HANDLER_POOL_MEDIUM_BLOCK_SIZE 128
+#endif /* AT_CMD_HANDLER_POOL_MEDIUM_BLOCK_SIZE */
+
+#ifndef AT_CMD_HANDLER_POOL_MEDIUM_BLOCKS_NUM
+#define AT_CMD_HANDLER_POOL_MEDIUM_BLOCKS_NUM 16
+#endif /* AT_CMD_HANDLER_POOL_MEDIUM_BLOCKS_NUM */
+
+#ifndef AT_CMD_HANDLER_POOL_LARGE_BLOCK_SIZE
+#define AT_CMD_HANDLER_POOL_LARGE_BLOCK_SIZE 512
+#endif /* AT_CMD_HANDLER_POOL_LARGE_BLOCK_SIZE */
+
+#ifndef AT_CMD_HANDLER_POOL_LARGE_BLOCKS_NUM
+#define AT_CMD_HANDLER_POOL_LARGE_BLOCKS_NUM 4
+#endif /* AT_CMD_HANDLER_POOL_LARGE_BLOCKS_NUM */
+
+//! The numbers of the free blocks of the pools. \see at_pool::get_stats()
+struct at_pool_stats
+{
+    size_t small_free, small_min_free;
+    size_t medium_free, medium_min_free;
+    size_t large_free, large_min_free;
+};
+
+/**
+ * \brief Three pools of fixed-size blocks, from which all the memory of the AT stack is taken.
+ *
+ * A request is served by the pool with the smallest blocks which are big enough. When that pool is exhausted, then
+ * std::bad_alloc is thrown: the shared heap is never used, so the AT stack can't fragment it. The worst case
+ * allocation time doesn't depend on the history of the allocations.
+ */
+class at_pool
+{
+  public:
+    static void *allocate(size_t size)
+    {
+        void *p = nullptr;
+        AT_CMD_HANDLER_POOL_LOCK();
+        if (size <= small_pool.block_size)
+            p = small_pool.allocate();
+        else if (size <= medium_pool.block_size)
+            p = medium_pool.allocate();
+        else if (size <= large_pool.block_size)
+            p = large_pool.allocate();
+        AT_CMD_HANDLER_POOL_UNLOCK();
+
+        if (!p)
+            throw std::bad_alloc();
+        return p;
+    }
+
+    static void deallocate(void *p) noexcept
+    {
+        AT_CMD_HANDLER_POOL_LOCK();
+        if (small_pool.owns(p))
+            small_pool.deallocate(p);
+        else if (medium_pool.owns(p))
+            medium_pool.deallocate(p);
+        else
+            large_pool.deallocate(p);
+        AT_CMD_HANDLER_POOL_UNLOCK();
+    }
+
+    static at_pool_stats get_stats() noexcept
+    {
+        return {small_pool.get_num_free_blocks(),
+                small_pool.get_min_num_free_blocks(),
+                medium_pool.get_num_free_blocks(),
+                medium_pool.get_min_num_free_blocks(),
+                large_pool.get_num_free_blocks(),
+                large_pool.get_min_num_free_blocks()};
+    }
+
+  private:
+    static inline block_pool<AT_CMD_HANDLER_POOL_SMALL_BLOCK_SIZE, AT_CMD_HANDLER_POOL_SMALL_BLOCKS_NUM> small_pool;
+    static inline block_pool<AT_CMD_HANDLER_POOL_MEDIUM_BLOCK_SIZE, AT_CMD_HANDLER_POOL_MEDIUM_BLOCKS_NUM> medium_pool;
+    static inline block_pool<AT_CMD_HANDLER_POOL_LARGE_BLOCK_SIZE, AT_CMD_HANDLER_POOL_LARGE_BLOCKS_NUM> large_pool;
+};
+
+//! The allocator for the standard containers, which takes the memory from at_pool.
+template <typename T> struct at_pool_allocator
+{
+    using value_type = T;
+
+    at_pool_allocator() noexcept = default;
+    template <typename U> at_pool_allocator(const at_pool_allocator<U> &) noexcept
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(at_pool::allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, size_t) noexcept
+    {
+        at_pool::deallocate(p);
+    }
+};
+
+template <typename T, typename U> bool operator==(const at_pool_allocator<T> &, const at_pool_allocator<U> &)
+{
+    return true;
+}
+
+template <typename T, typename U> bool operator!=(const at_pool_allocator<T> &, const at_pool_allocator<U> &)
+{
+    return false;
+}
+
+template <typename T> using at_allocator = at_pool_allocator<T>;
+
+//! Destroys the object allocated with at_make_unique().
+template <typename T> struct at_pool_deleter
+{
+    void operator()(T *p) const noexcept
+    {
+        p->~T();
+        at_pool::deallocate(p);
+    }
+};
+
+template <typename T> using at_unique_ptr = std::unique_ptr<T, at_pool_deleter<T>>;
+
+template <typename T, typename... Args> at_unique_ptr<T> at_make_unique(Args &&... args)
+{
+    auto p = at_pool::allocate(sizeof(T));
+    try
+    {
+        return at_unique_ptr<T>(new (p) T(std::forward<Args>(args)...));
+    }
+    catch (...)
+    {
+        at_pool::deallocate(p);
+        throw;
+    }
+}
+
+#else /* AT_CMD_HANDLER_POOL */
+
+template <typename T> using at_allocator = std::allocator<T>;
+
+template <typename T> using at_unique_ptr = std::unique_ptr<T>;
+
+template <typename T, typename... Args> at_unique_ptr<T> at_make_unique(Args &&... args)
+{
+    return std::make_unique<T>(std::forward<Args>(args)...);
+}
+
+#endif /* AT_CMD_HANDLER_POOL */
+
+/**
+ * The string which holds the payloads of the commands and of the responses. When AT_CMD_HANDLER_POOL isn't defined,
+ * then this is just std::string.
+ */
+using at_string = std::basic_string<char, std::char_traits<char>, at_allocator<char>>;
+
+//! Holds the payload of an unsolicited command passed to its handler.
+using at_payload_ptr = at_unique_ptr<at_string>;
+
+#endif /* AT_POOL_HPP */
@@ -0,0 +1,190 @@
+/**
+ * @file	at_response_cache.hpp
+ * @brief	Defines a cache of the payloads of the responses to the READ and TEST queries.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef AT_RESPONSE_CACHE_HPP
+#define AT_RESPONSE_CACHE_HPP
+
+#include "at_cmd_handler_impl.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * \brief Keeps the payloads of the successful responses to the queries listed in the profiles, e.g. "AT+CSQ" or
+ *        "AT+CREG?", for their time to live.
+ *
+ * A query which misses the cache is filled by a single issuer: begin_fill() tells whether another issuer fills it
+ * already, so the concurrent issuers of the same query may await that one instead of sending it again. An unsolicited
+ * occurrence of the command (e.g. "+CREG: 5") invalidates its entries; when it arrives while an entry is being filled,
+ * then the response isn't stored, as it may reflect the state from before the change.
+ *
+ * The time is measured in any unit, which wraps around at 2^32, e.g. in the ticks of the OS.
+ *
+ * This is not thread safe, but invalidate_without_lock(): it only bumps the generations of the entries, which the other
+ * members compare, so a single task may call it without the lock which guards the rest, e.g. the task which handles
+ * the unsolicited lines.
+ */
+template <typename Cmd, size_t N, typename String> class at_response_cache
+{
+  public:
+    using profile_type = at_cmd_cache_ttl<Cmd>;
+
+    explicit at_response_cache(const profile_type *profiles) noexcept;
+
+    //! Returns the entry of the query, -1 when the query isn't cached.
+    int find(Cmd command, at_cmd_type command_type) const noexcept;
+
+    uint32_t get_ttl_ms(size_t slot) const noexcept;
+
+    //! Copies the payload of the entry when it's been stored less than ttl ago. Returns false on a miss.
+    bool get(size_t slot, uint32_t now, uint32_t ttl, String &payload) const;
+
+    //! Marks the entry as being filled. Returns false when it's being filled already.
+    bool begin_fill(size_t slot) noexcept;
+
+    //! Stores the payload when the query has succeeded and it hasn't been invalidated meanwhile.
+    void end_fill(size_t slot, uint32_t now, at_err result, const String &payload);
+
+    //! Invalidates all the entries of the command, no matter of the type of the query.
+    void invalidate(Cmd command) noexcept;
+
+    //! Same as invalidate(), but may be called without the lock which guards the rest, by a single task at a time.
+    void invalidate_without_lock(Cmd command) noexcept;
+
+    void clear() noexcept;
+
+  private:
+    struct entry
+    {
+        String payload;
+        uint32_t stored_at = 0;
+        bool is_valid = false;
+        bool is_pending = false;
+
+        //! Set when the entry is invalidated while it's being filled.
+        bool is_stale = false;
+
+        //! The generations of the entry when the fill has begun and when the payload has been stored.
+        uint32_t filled_generation = 0;
+        uint32_t stored_generation = 0;
+    };
+
+    const profile_type *m_profiles;
+    std::array<entry, N> m_entries;
+
+    //! Bumped on each invalidation of the entry with the same index without the lock. Written by a single task.
+    std::array<std::atomic<uint32_t>, N> m_generations{};
+
+    uint32_t get_generation(size_t slot) const noexcept;
+    void bump_generation(size_t slot) noexcept;
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PUBLIC MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <typename Cmd, size_t N, typename String>
+at_response_cache<Cmd, N, String>::at_response_cache(const profile_type *profiles) noexcept : m_profiles(profiles)
+{
+}
+
+template <typename Cmd, size_t N, typename String>
+int at_response_cache<Cmd, N, String>::find(Cmd command, at_cmd_type command_type) const noexcept
+{
+    for (size_t i = 0; i < N; ++i)
+        if (m_profiles[i].command == command && m_profiles[i].command_type == command_type)
+            return static_cast<int>(i);
+    return -1;
+}
+
+template <typename Cmd, size_t N, typename String>
+uint32_t at_response_cache<Cmd, N, String>::get_ttl_ms(size_t slot) const noexcept
+{
+    return m_profiles[slot].ttl_ms;
+}
+
+template <typename Cmd, size_t N, typename String>
+bool at_response_cache<Cmd, N, String>::get(size_t slot, uint32_t now, uint32_t ttl, String &payload) const
+{
+    auto &e = m_entries[slot];
+    // The subtraction is correct also when the time has wrapped around since the entry was stored.
+    if (!e.is_valid || e.stored_generation != get_generation(slot) || static_cast<uint32_t>(now - e.stored_at) >= ttl)
+        return false;
+    payload = e.payload;
+    return true;
+}
+
+template <typename Cmd, size_t N, typename String>
+bool at_response_cache<Cmd, N, String>::begin_fill(size_t slot) noexcept
+{
+    auto &e = m_entries[slot];
+    if (e.is_pending)
+        return false;
+    e.is_pending = true;
+    e.is_stale = false;
+    e.filled_generation = get_generation(slot);
+    return true;
+}
+
+template <typename Cmd, size_t N, typename String>
+void at_response_cache<Cmd, N, String>::end_fill(size_t slot, uint32_t now, at_err result, const String &payload)
+{
+    auto &e = m_entries[slot];
+    e.is_pending = false;
+    // An invalidation during the fill means the response may reflect the state from before the change.
+    if (result != at_err::ok || e.is_stale || e.filled_generation != get_generation(slot))
+        return;
+    e.payload = payload;
+    e.stored_at = now;
+    e.stored_generation = e.filled_generation;
+    e.is_valid = true;
+}
+
+template <typename Cmd, size_t N, typename String>
+void at_response_cache<Cmd, N, String>::invalidate(Cmd command) noexcept
+{
+    for (size_t i = 0; i < N; ++i)
+        if (m_profiles[i].command == command)
+        {
+            m_entries[i].is_valid = false;
+            m_entries[i].is_stale = m_entries[i].is_pending;
+        }
+}
+
+template <typename Cmd, size_t N, typename String>
+void at_response_cache<Cmd, N, String>::invalidate_without_lock(Cmd command) noexcept
+{
+    for (size_t i = 0; i < N; ++i)
+        if (m_profiles[i].command == command)
+            bump_generation(i);
+}
+
+template <typename Cmd, size_t N, typename String> void at_response_cache<Cmd, N, String>::clear() noexcept
+{
+    for (auto &e : m_entries)
+    {
+        e.is_valid = false;
+        e.is_stale = e.is_pending;
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <typename Cmd, size_t N, typename String>
+uint32_t at_response_cache<Cmd, N, String>::get_generation(size_t slot) const noexcept
+{
+    return m_generations[slot].load(std::memory_order_relaxed);
+}
+
+//! A plain load and store, as there is a single writer, so it works also without atomic read-modify-write.
+template <typename Cmd, size_t N, typename String>
+void at_response_cache<Cmd, N, String>::bump_generation(size_t slot) noexcept
+{
+    m_generations[slot].store(get_generation(slot) + 1, std::memory_order_relaxed);
+}
+
+#endif /* AT_RESPONSE_CACHE_HPP */
@@ -0,0 +1,239 @@
+/**
+ * @file	at_rx_dispatcher.hpp
+ * @brief	Defines the receiver task which handles the received lines of multiple at_channel instances.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef AT_RX_DISPATCHER_HPP
+#define AT_RX_DISPATCHER_HPP
+
+#include "FreeRTOS.h"
+#include "at_channel.hpp"
+#include "at_os_objects.hpp"
+#include "semphr.h"
+#include "task.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace jungles {
+
+/**
+ * \brief A single receiver task which handles the received lines of up to ChannelsNum channels, e.g. of the modems
+ *        on multiple UARTs, instead of a task per channel.
+ *
+ * Each channel is given a bit of the notification value of the task, which its RX interrupt sets. The task takes
+ * the channels in turns, starting from a different one each round, and handles at most MaxLinesPerTurn lines of
+ * a channel per turn, so a chatty device doesn't hold the responses of the others. The lines left are handled in
+ * the next round, without waiting for another notification.
+ *
+ * The dispatcher shall be started before the channels are initialized with at_channel::init(dispatcher). The
+ * handlers of the unsolicited messages of those channels are invoked within its task, unless they are deferred.
+ *
+ * The task waits on the notification bits rather than on an event group, because an event group is set from an
+ * interrupt through the timer service task, which would add a context switch to each received line.
+ *
+ * The stack of the task, of StackDepth words, is held by the dispatcher when configSUPPORT_STATIC_ALLOCATION is set.
+ */
+template <size_t ChannelsNum, unsigned MaxLinesPerTurn = 4, configSTACK_DEPTH_TYPE StackDepth = 1024>
+class at_rx_dispatcher
+{
+    static_assert(ChannelsNum > 0 && ChannelsNum <= 32, "The channels are tracked with the bits of a 32-bit mask");
+    static_assert(MaxLinesPerTurn > 0, "Each channel must get some lines handled per turn");
+
+  public:
+    void start(const char *name, UBaseType_t priority, UBaseType_t core_affinity = at_no_core_affinity);
+
+    //! The channels shall be detached beforehand.
+    void stop();
+
+    /**
+     * \brief Makes the task handle the received lines of the channel. Called by at_channel::init(dispatcher).
+     *
+     * \returns the bit of the notification value which wakes up the task for the channel, or zero when all the
+     *          ChannelsNum channels are attached already.
+     */
+    template <typename Channel> uint32_t attach(Channel &channel);
+
+    //! The channel isn't handled anymore once this returns. Called by at_channel::deinit(dispatcher).
+    void detach(uint32_t channel_bit);
+
+    TaskHandle_t get_task_handle() const;
+
+  private:
+    using mask = uint32_t;
+
+    //! Let the task reach the channel without knowing its type.
+    struct port
+    {
+        void *channel = nullptr;
+        TickType_t (*handle_received_lines)(void *channel, unsigned max_lines_num, bool &is_drained) = nullptr;
+
+        //! The channel shall be handled again after timed_ticks, counting from timed_since, even if no line arrives.
+        bool is_timed = false;
+        TickType_t timed_since = 0;
+        TickType_t timed_ticks = 0;
+    };
+
+    std::array<port, ChannelsNum> m_ports;
+
+    //! The bits are indexed with the ports.
+    mask m_attached = 0;
+
+    //! Taken by the task for each round, so a channel is never handled after it has been detached.
+    SemaphoreHandle_t m_ports_mux = nullptr;
+    at_semaphore_memory m_ports_mux_memory;
+    TaskHandle_t m_task_handle = nullptr;
+    at_task_memory<StackDepth> m_task_memory;
+
+    //! The port which is taken first in the next round: the one after the last port handled.
+    size_t m_next = 0;
+
+    static constexpr mask bit(size_t idx);
+
+    static void task(void *self);
+    void run();
+
+    //! Must be called with m_ports_mux taken. Clears the bits of the ports which have been drained.
+    //! \returns how long the task may sleep till some port is due.
+    TickType_t handle_round(mask &pending);
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PUBLIC MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <size_t ChannelsNum, unsigned MaxLinesPerTurn, configSTACK_DEPTH_TYPE StackDepth>
+void at_rx_dispatcher<ChannelsNum, MaxLinesPerTurn, StackDepth>::start(const char *name,
+                                                                      UBaseType_t priority,
+                                                                      UBaseType_t core_affinity)
+{
+    m_ports_mux = at_create_mutex(m_ports_mux_memory);
+    m_task_handle = at_create_task(task, name, m_task_memory, this, priority, core_affinity);
+}
+
+template <size_t ChannelsNum, unsigned MaxLinesPerTurn, configSTACK_DEPTH_TYPE StackDepth>
+void at_rx_dispatcher<ChannelsNum, MaxLinesPerTurn, StackDepth>::stop()
+{
+    configASSERT(m_attached == 0);
+    vTaskDelete(m_task_handle);
+    vSemaphoreDelete(m_ports_mux);
+    m_task_handle = nullptr;
+}
+
+template <size_t ChannelsNum, unsigned MaxLinesPerTurn, configSTACK_DEPTH_TYPE StackDepth>
+template <typename Channel>
+uint32_t at_rx_dispatcher<ChannelsNum, MaxLinesPerTurn, StackDepth>::attach(Channel &channel)
+{
+    uint32_t attached_bit = 0;
+    with_mutex(m_ports_mux)
+    {
+        for (size_t idx = 0; idx < ChannelsNum; ++idx)
+        {
+            if (m_attached & bit(idx))
+                continue;
+            auto &p = m_ports[idx];
+            p.channel = &channel;
+            p.handle_received_lines = [](void *ch, unsigned max_lines_num, bool &is_drained) {
+                return static_cast<Channel *>(ch)->handle_received_lines(max_lines_num, is_drained);
+            };
+            p.is_timed = false;
+            m_attached |= bit(idx);
+            attached_bit = bit(idx);
+            break;
+        }
+    }
+    return attached_bit;
+}
+
+template <size_t ChannelsNum, unsigned MaxLinesPerTurn, configSTACK_DEPTH_TYPE StackDepth>
+void at_rx_dispatcher<ChannelsNum, MaxLinesPerTurn, StackDepth>::detach(uint32_t channel_bit)
+{
+    with_mutex(m_ports_mux)
+    {
+        m_attached &= ~channel_bit;
+    }
+}
+
+template <size_t ChannelsNum, unsigned MaxLinesPerTurn, configSTACK_DEPTH_TYPE StackDepth>
+TaskHandle_t at_rx_dispatcher<ChannelsNum, MaxLinesPerTurn, StackDepth>::get_task_handle() const
+{
+    return m_task_handle;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <size_t ChannelsNum, unsigned MaxLinesPerTurn, configSTACK_DEPTH_TYPE StackDepth>
+constexpr typename at_rx_dispatcher<ChannelsNum, MaxLinesPerTurn, StackDepth>::mask
+    at_rx_dispatcher<ChannelsNum, MaxLinesPerTurn, StackDepth>::bit(size_t idx)
+{
+    return static_cast<mask>(1) << idx;
+}
+
+template <size_t ChannelsNum, unsigned MaxLinesPerTurn, configSTACK_DEPTH_TYPE StackDepth>
+void at_rx_dispatcher<ChannelsNum, MaxLinesPerTurn, StackDepth>::task(void *self)
+{
+    static_cast<at_rx_dispatcher *>(self)->run();
+}
+
+template <size_t ChannelsNum, unsigned MaxLinesPerTurn, configSTACK_DEPTH_TYPE StackDepth>
+void at_rx_dispatcher<ChannelsNum, MaxLinesPerTurn, StackDepth>::run()
+{
+    mask pending = 0;
+    TickType_t ticks_to_wait = portMAX_DELAY;
+    for (;;)
+    {
+        // The channels which haven't been drained in the previous round are handled without waiting.
+        uint32_t notified = 0;
+        xTaskNotifyWait(0, ~static_cast<uint32_t>(0), &notified, pending ? 0 : ticks_to_wait);
+        pending |= notified;
+        with_mutex(m_ports_mux)
+        {
+            pending &= m_attached;
+            ticks_to_wait = handle_round(pending);
+        }
+    }
+}
+
+template <size_t ChannelsNum, unsigned MaxLinesPerTurn, configSTACK_DEPTH_TYPE StackDepth>
+TickType_t at_rx_dispatcher<ChannelsNum, MaxLinesPerTurn, StackDepth>::handle_round(mask &pending)
+{
+    auto now = xTaskGetTickCount();
+    auto next = m_next;
+    for (size_t i = 0; i < ChannelsNum; ++i)
+    {
+        auto idx = (m_next + i) % ChannelsNum;
+        auto &p = m_ports[idx];
+        auto is_due = p.is_timed && static_cast<TickType_t>(now - p.timed_since) >= p.timed_ticks;
+        if (!(m_attached & bit(idx)) || (!(pending & bit(idx)) && !is_due))
+            continue;
+
+        bool is_drained;
+        auto ticks = p.handle_received_lines(p.channel, MaxLinesPerTurn, is_drained);
+        if (is_drained)
+            pending &= ~bit(idx);
+        p.is_timed = ticks != portMAX_DELAY;
+        p.timed_since = xTaskGetTickCount();
+        p.timed_ticks = ticks;
+        next = (idx + 1) % ChannelsNum;
+    }
+    m_next = next;
+
+    now = xTaskGetTickCount();
+    TickType_t ticks_to_wait = portMAX_DELAY;
+    for (size_t idx = 0; idx < ChannelsNum; ++idx)
+    {
+        auto &p = m_ports[idx];
+        if (!(m_attached & bit(idx)) || !p.is_timed)
+            continue;
+        auto elapsed = static_cast<TickType_t>(now - p.timed_since);
+        auto remaining = elapsed < p.timed_ticks ? p.timed_ticks - elapsed : 0;
+        ticks_to_wait = std::min(ticks_to_wait, remaining);
+    }
+    return ticks_to_wait;
+}
+
+} // namespace jungles
+
+#endif /* AT_RX_DISPATCHER_HPP */
@@ -0,0 +1,203 @@
+/**
+ * @file	at_schema.hpp
+ * @brief	Defines the schemas which parse the payloads of the responses into typed values, at compile time.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef AT_SCHEMA_HPP
+#define AT_SCHEMA_HPP
+
+#include "line_view.hpp"
+#include <cstddef>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS OF STRUCTURES, DATA TYPES, ...
+// --------------------------------------------------------------------------------------------------------------------
+
+//! A field within double quotes, e.g. "internet" of +CGDCONT. Its value views the characters between the quotes.
+struct quoted_string
+{
+};
+
+//! A field without quotes, which lasts to the next comma, e.g. 4807.038N of +QGPSLOC. Its value views it in place.
+struct unquoted_string
+{
+};
+
+/**
+ * \brief Parses a single field of the type T, at the position within the payload, and moves the position past it.
+ *
+ * Supports the integral types, quoted_string and unquoted_string. The integers are decimal; the unsigned ones
+ * don't take the sign and the values which don't fit into T are rejected.
+ */
+template <typename T, typename = void> struct at_field;
+
+template <typename T> struct at_field<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+{
+    using value_type = T;
+
+    static bool parse(const line_view &payload, size_t &pos, T &value) noexcept
+    {
+        auto is_negative = std::is_signed_v<T> && pos < payload.length() && payload[pos] == '-';
+        if (is_negative)
+            ++pos;
+
+        // The magnitude of the lowest value is bigger by one than the highest value.
+        using magnitude = std::make_unsigned_t<T>;
+        auto limit = static_cast<magnitude>(std::numeric_limits<T>::max()) + (is_negative ? 1u : 0u);
+        magnitude m = 0;
+        auto begin = pos;
+        for (; pos < payload.length() && payload[pos] >= '0' && payload[pos] <= '9'; ++pos)
+        {
+            auto digit = static_cast<magnitude>(payload[pos] - '0');
+            if (m > (limit - digit) / 10)
+                return false;
+            m = static_cast<magnitude>(m * 10 + digit);
+        }
+        if (pos == begin)
+            return false;
+
+        value = is_negative ? static_cast<T>(0 - m) : static_cast<T>(m);
+        return true;
+    }
+};
+
+template <> struct at_field<quoted_string>
+{
+    using value_type = line_view;
+
+    static bool parse(const line_view &payload, size_t &pos, line_view &value) noexcept
+    {
+        if (pos >= payload.length() || payload[pos] != '"')
+            return false;
+
+        auto begin = ++pos;
+        for (; pos < payload.length(); ++pos)
+            if (payload[pos] == '"')
+            {
+                value = payload.substr(begin, pos++ - begin);
+                return true;
+            }
+        return false;
+    }
+};
+
+template <> struct at_field<unquoted_string>
+{
+    using value_type = line_view;
+
+    static bool parse(const line_view &payload, size_t &pos, line_view &value) noexcept
+    {
+        auto begin = pos;
+        while (pos < payload.length() && payload[pos] != ',' && payload[pos] != '\n')
+            ++pos;
+        value = payload.substr(begin, pos - begin);
+        return true;
+    }
+};
+
+/**
+ * \brief Parses a payload made of the comma-separated Fields into a tuple of their values, in a single pass over the
+ *        payload, without any allocation.
+ *
+ * E.g. at_schema<int, int, quoted_string> parses "1,-5,\"abc\"" into {1, -5, "abc"}. A space after a comma is allowed.
+ * The payload must end after the last field, or at the end of its first line, when it's a multi-line payload. The
+ * string fields are viewed in place, so they are valid as long as the payload is.
+ */
+template <typename... Fields> struct at_schema
+{
+    static_assert(sizeof...(Fields) > 0, "The schema must have at least one field");
+
+    using values = std::tuple<typename at_field<Fields>::value_type...>;
+
+    //! Returns false when the payload doesn't match the schema, then the values are partially overwritten.
+    static bool parse(const line_view &payload, values &out) noexcept;
+
+  private:
+    template <size_t... Is> static bool parse(const line_view &payload, values &out, std::index_sequence<Is...>);
+
+    static bool expect_separator(const line_view &payload, size_t &pos, bool is_last) noexcept;
+};
+
+/**
+ * \brief Binds the schema to the command, so its solicited responses and its unsolicited occurrences are parsed
+ *        with it.
+ *
+ * The command set lists the bound schemas as a tuple type named payload_schemas, e.g.
+ *     using payload_schemas = std::tuple<at_cmd_schema<cmd::qgpsloc, unquoted_string, unquoted_string, int>>;
+ */
+template <auto Command, typename... Fields> struct at_cmd_schema : at_schema<Fields...>
+{
+    static constexpr auto command = Command;
+};
+
+//! Finds the schema of the Command within the tuple of at_cmd_schema types, void when there is none.
+template <auto Command, typename Schemas> struct at_find_schema;
+
+template <auto Command> struct at_find_schema<Command, std::tuple<>>
+{
+    using type = void;
+};
+
+template <auto Command, typename Schema, typename... Rest> struct at_find_schema<Command, std::tuple<Schema, Rest...>>
+{
+    using type = std::conditional_t<Schema::command == Command,
+                                    Schema,
+                                    typename at_find_schema<Command, std::tuple<Rest...>>::type>;
+};
+
+/**
+ * \brief An unsolicited handler known at build time (\see at_static_cmd_handler), which gets the values of the
+ *        fields, parsed in place, within the RX buffer. The payloads which don't match the schema are ignored.
+ *
+ * E.g. {cmd::qgps, &at_typed_static_handler<qgps_schema, on_qgps>}, where on_qgps is void(int).
+ */
+template <typename Schema, auto Handler> void at_typed_static_handler(line_view payload);
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PUBLIC FUNCTIONS AND MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <typename... Fields> bool at_schema<Fields...>::parse(const line_view &payload, values &out) noexcept
+{
+    return parse(payload, out, std::index_sequence_for<Fields...>{});
+}
+
+template <typename Schema, auto Handler> void at_typed_static_handler(line_view payload)
+{
+    typename Schema::values values;
+    if (Schema::parse(payload, values))
+        std::apply(Handler, values);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <typename... Fields>
+template <size_t... Is>
+bool at_schema<Fields...>::parse(const line_view &payload, values &out, std::index_sequence<Is...>)
+{
+    size_t pos = 0;
+    // The fold stops at the first field which doesn't match.
+    return ((at_field<Fields>::parse(payload, pos, std::get<Is>(out))
+             && expect_separator(payload, pos, Is + 1 == sizeof...(Fields)))
+            && ...);
+}
+
+template <typename... Fields>
+bool at_schema<Fields...>::expect_separator(const line_view &payload, size_t &pos, bool is_last) noexcept
+{
+    if (is_last)
+        return pos == payload.length() || payload[pos] == '\n';
+
+    if (pos >= payload.length() || payload[pos] != ',')
+        return false;
+    ++pos;
+    if (pos < payload.length() && payload[pos] == ' ')
+        ++pos;
+    return true;
+}
+
+#endif /* AT_SCHEMA_HPP */
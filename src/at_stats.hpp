@@ -0,0 +1,238 @@
+/**
+ * @file	at_stats.hpp
+ * @brief	Defines the counters of the traffic and of the commands handled by a channel.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef AT_STATS_HPP
+#define AT_STATS_HPP
+
+#include "at_cmd_handler_impl.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS OF STRUCTURES, DATA TYPES, ...
+// --------------------------------------------------------------------------------------------------------------------
+
+/**
+ * \brief The values of the counters of a channel at some point, for CmdsNum commands and MsgsNum unsolicited messages.
+ *
+ * The counters only grow and may wrap around, so compare two snapshots to see what has happened meanwhile.
+ */
+template <size_t CmdsNum, size_t MsgsNum> struct at_basic_stats
+{
+    uint32_t rx_bytes;
+    uint32_t tx_bytes;
+
+    //! The lines which have reached the command handler. The discarded echoes aren't included.
+    uint32_t lines_parsed;
+
+    //! The lines and the unsolicited commands dropped for the lack of space. \see at_rx_drop_stats
+    uint32_t lines_dropped;
+
+    //! The unsolicited occurrences of each command, e.g. "+CREG: 5", which the handlers have been given.
+    std::array<uint32_t, CmdsNum> urcs_per_cmd;
+
+    //! The occurrences of each unsolicited message, e.g. "RDY".
+    std::array<uint32_t, MsgsNum> urcs_per_msg;
+
+    //! The transmitted commands. Each command of a batch is counted. The queries answered from the cache aren't.
+    std::array<uint32_t, CmdsNum> commands_issued;
+
+    //! The final result codes, indexed by at_err, along with the commands which have timed out (at_err::timeout).
+    std::array<uint32_t, at_err_num> results;
+
+    //! How many times a task has had to wait for the mutex of the channel, and for how many ticks.
+    uint32_t mux_contentions;
+    uint32_t mux_wait_ticks;
+    uint32_t mux_max_wait_ticks;
+
+    //! The most characters which the RX buffer has held at once.
+    uint32_t peak_rx_chars;
+
+    //! How many times the device has been stopped with RTS, because the RX buffer has reached its high watermark.
+    uint32_t rx_throttles;
+
+    //! The bursts of the commands, each from the command transmitted while the device sleeps till the final result
+    //! code of the last queued one. \see at_channel
+    uint32_t wake_cycles;
+
+    uint32_t get_num_results(at_err result) const noexcept
+    {
+        return results[static_cast<size_t>(result)];
+    }
+};
+
+/**
+ * \brief The counters of a channel, which can be read by any task, at any time, without any lock.
+ *
+ * Each counter has a single writer at a time: the RX interrupt, the TX interrupt, the receiver task (the lines and
+ * the unsolicited commands and messages) or the task which holds the mutex of the channel. Thus the counters are
+ * incremented with a plain load and store, which e.g. ARMv6-M supports, and read with relaxed loads. A snapshot
+ * is consistent per counter, not across the counters.
+ */
+template <size_t CmdsNum, size_t MsgsNum> class at_stats_counters
+{
+  public:
+    using snapshot_type = at_basic_stats<CmdsNum, MsgsNum>;
+
+    void count_rx_bytes(size_t num) noexcept;
+    void count_tx_bytes(size_t num) noexcept;
+    void count_line() noexcept;
+    void count_urc_cmd(size_t command) noexcept;
+    void count_urc_msg(size_t message) noexcept;
+    void count_issued(size_t command) noexcept;
+    void count_result(at_err result) noexcept;
+    void count_mux_wait(uint32_t ticks) noexcept;
+    void count_rx_throttle() noexcept;
+    void count_wake_cycle() noexcept;
+
+    //! Takes the fields which the counters don't hold: lines_dropped and peak_rx_chars.
+    snapshot_type snapshot(uint32_t lines_dropped, uint32_t peak_rx_chars) const noexcept;
+
+  private:
+    using counter = std::atomic<uint32_t>;
+
+    counter m_rx_bytes{0};
+    counter m_tx_bytes{0};
+    counter m_lines_parsed{0};
+    std::array<counter, CmdsNum> m_urcs_per_cmd{};
+    std::array<counter, MsgsNum> m_urcs_per_msg{};
+    std::array<counter, CmdsNum> m_commands_issued{};
+    std::array<counter, at_err_num> m_results{};
+    counter m_mux_contentions{0};
+    counter m_mux_wait_ticks{0};
+    counter m_mux_max_wait_ticks{0};
+    counter m_rx_throttles{0};
+    counter m_wake_cycles{0};
+
+    static void add(counter &c, uint32_t n) noexcept;
+
+    static uint32_t read(const counter &c) noexcept;
+
+    template <size_t N> static std::array<uint32_t, N> read(const std::array<counter, N> &counters) noexcept;
+};
+
+//! Used instead of at_stats_counters when the channel isn't counted.
+struct at_no_stats
+{
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PUBLIC MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <size_t CmdsNum, size_t MsgsNum>
+void at_stats_counters<CmdsNum, MsgsNum>::count_rx_bytes(size_t num) noexcept
+{
+    add(m_rx_bytes, static_cast<uint32_t>(num));
+}
+
+template <size_t CmdsNum, size_t MsgsNum>
+void at_stats_counters<CmdsNum, MsgsNum>::count_tx_bytes(size_t num) noexcept
+{
+    add(m_tx_bytes, static_cast<uint32_t>(num));
+}
+
+template <size_t CmdsNum, size_t MsgsNum>
+void at_stats_counters<CmdsNum, MsgsNum>::count_line() noexcept
+{
+    add(m_lines_parsed, 1);
+}
+
+template <size_t CmdsNum, size_t MsgsNum>
+void at_stats_counters<CmdsNum, MsgsNum>::count_urc_cmd(size_t command) noexcept
+{
+    if (command < CmdsNum)
+        add(m_urcs_per_cmd[command], 1);
+}
+
+template <size_t CmdsNum, size_t MsgsNum>
+void at_stats_counters<CmdsNum, MsgsNum>::count_urc_msg(size_t message) noexcept
+{
+    if (message < MsgsNum)
+        add(m_urcs_per_msg[message], 1);
+}
+
+template <size_t CmdsNum, size_t MsgsNum>
+void at_stats_counters<CmdsNum, MsgsNum>::count_issued(size_t command) noexcept
+{
+    if (command < CmdsNum)
+        add(m_commands_issued[command], 1);
+}
+
+template <size_t CmdsNum, size_t MsgsNum>
+void at_stats_counters<CmdsNum, MsgsNum>::count_result(at_err result) noexcept
+{
+    add(m_results[static_cast<size_t>(result)], 1);
+}
+
+template <size_t CmdsNum, size_t MsgsNum>
+void at_stats_counters<CmdsNum, MsgsNum>::count_mux_wait(uint32_t ticks) noexcept
+{
+    add(m_mux_contentions, 1);
+    add(m_mux_wait_ticks, ticks);
+    if (ticks > read(m_mux_max_wait_ticks))
+        m_mux_max_wait_ticks.store(ticks, std::memory_order_relaxed);
+}
+
+template <size_t CmdsNum, size_t MsgsNum> void at_stats_counters<CmdsNum, MsgsNum>::count_rx_throttle() noexcept
+{
+    add(m_rx_throttles, 1);
+}
+
+template <size_t CmdsNum, size_t MsgsNum> void at_stats_counters<CmdsNum, MsgsNum>::count_wake_cycle() noexcept
+{
+    add(m_wake_cycles, 1);
+}
+
+template <size_t CmdsNum, size_t MsgsNum>
+typename at_stats_counters<CmdsNum, MsgsNum>::snapshot_type
+    at_stats_counters<CmdsNum, MsgsNum>::snapshot(uint32_t lines_dropped, uint32_t peak_rx_chars) const noexcept
+{
+    snapshot_type s;
+    s.rx_bytes = read(m_rx_bytes);
+    s.tx_bytes = read(m_tx_bytes);
+    s.lines_parsed = read(m_lines_parsed);
+    s.lines_dropped = lines_dropped;
+    s.urcs_per_cmd = read(m_urcs_per_cmd);
+    s.urcs_per_msg = read(m_urcs_per_msg);
+    s.commands_issued = read(m_commands_issued);
+    s.results = read(m_results);
+    s.mux_contentions = read(m_mux_contentions);
+    s.mux_wait_ticks = read(m_mux_wait_ticks);
+    s.mux_max_wait_ticks = read(m_mux_max_wait_ticks);
+    s.peak_rx_chars = peak_rx_chars;
+    s.rx_throttles = read(m_rx_throttles);
+    s.wake_cycles = read(m_wake_cycles);
+    return s;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <size_t CmdsNum, size_t MsgsNum>
+void at_stats_counters<CmdsNum, MsgsNum>::add(counter &c, uint32_t n) noexcept
+{
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+template <size_t CmdsNum, size_t MsgsNum>
+uint32_t at_stats_counters<CmdsNum, MsgsNum>::read(const counter &c) noexcept
+{
+    return c.load(std::memory_order_relaxed);
+}
+
+template <size_t CmdsNum, size_t MsgsNum>
+template <size_t N>
+std::array<uint32_t, N> at_stats_counters<CmdsNum, MsgsNum>::read(const std::array<counter, N> &counters) noexcept
+{
+    std::array<uint32_t, N> values;
+    for (size_t i = 0; i < N; ++i)
+        values[i] = read(counters[i]);
+    return values;
+}
+
+#endif /* AT_STATS_HPP */
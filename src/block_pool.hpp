@@ -0,0 +1,111 @@
+/**
+ * @file	block_pool.hpp
+ * @brief	Defines a pool of fixed-size memory blocks.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef BLOCK_POOL_HPP
+#define BLOCK_POOL_HPP
+
+#include <cstddef>
+
+/**
+ * \brief A pool of BlocksNum blocks of BlockSize bytes each, held in static memory.
+ *
+ * The free blocks are linked in a list which is stored within the blocks themselves, so both allocation and
+ * deallocation take constant time and the pool never fragments.
+ *
+ * This is not thread safe.
+ */
+template <size_t BlockSize, size_t BlocksNum> class block_pool
+{
+    static_assert(BlockSize % alignof(std::max_align_t) == 0, "The blocks must be aligned for any type");
+    static_assert(BlocksNum > 0, "The pool must have at least one block");
+
+  public:
+    static constexpr size_t block_size = BlockSize;
+    static constexpr size_t blocks_num = BlocksNum;
+
+    block_pool() noexcept;
+    block_pool(const block_pool &) = delete;
+    block_pool &operator=(const block_pool &) = delete;
+
+    //! Returns nullptr when there is no free block.
+    void *allocate() noexcept;
+
+    //! The block must have been allocated from this pool.
+    void deallocate(void *p) noexcept;
+
+    bool owns(const void *p) const noexcept;
+
+    size_t get_num_free_blocks() const noexcept;
+
+    //! The least number of the free blocks ever, useful for sizing the pool.
+    size_t get_min_num_free_blocks() const noexcept;
+
+  private:
+    union block
+    {
+        block *next;
+        alignas(std::max_align_t) unsigned char data[BlockSize];
+    };
+
+    block m_blocks[BlocksNum];
+    block *m_free_list;
+    size_t m_num_free;
+    size_t m_min_num_free;
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PUBLIC MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <size_t BlockSize, size_t BlocksNum>
+block_pool<BlockSize, BlocksNum>::block_pool() noexcept
+    : m_free_list(m_blocks), m_num_free(BlocksNum), m_min_num_free(BlocksNum)
+{
+    for (size_t i = 0; i < BlocksNum - 1; ++i)
+        m_blocks[i].next = &m_blocks[i + 1];
+    m_blocks[BlocksNum - 1].next = nullptr;
+}
+
+template <size_t BlockSize, size_t BlocksNum> void *block_pool<BlockSize, BlocksNum>::allocate() noexcept
+{
+    if (!m_free_list)
+        return nullptr;
+
+    auto b = m_free_list;
+    m_free_list = b->next;
+    if (--m_num_free < m_min_num_free)
+        m_min_num_free = m_num_free;
+    return b->data;
+}
+
+template <size_t BlockSize, size_t BlocksNum> void block_pool<BlockSize, BlocksNum>::deallocate(void *p) noexcept
+{
+    auto b = static_cast<block *>(p);
+    b->next = m_free_list;
+    m_free_list = b;
+    m_num_free++;
+}
+
+template <size_t BlockSize, size_t BlocksNum>
+bool block_pool<BlockSize, BlocksNum>::owns(const void *p) const noexcept
+{
+    auto c = static_cast<const unsigned char *>(p);
+    auto begin = reinterpret_cast<const unsigned char *>(m_blocks);
+    return c >= begin && c < begin + sizeof(m_blocks);
+}
+
+template <size_t BlockSize, size_t BlocksNum>
+size_t block_pool<BlockSize, BlocksNum>::get_num_free_blocks() const noexcept
+{
+    return m_num_free;
+}
+
+template <size_t BlockSize, size_t BlocksNum>
+size_t block_pool<BlockSize, BlocksNum>::get_min_num_free_blocks() const noexcept
+{
+    return m_min_num_free;
+}
+
+#endif /* BLOCK_POOL_HPP */
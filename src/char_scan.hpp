@@ -0,0 +1,139 @@
+/**
+ * @file	char_scan.hpp
+ * @brief	Finds the first of the given characters within a chunk many bytes at a time.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef CHAR_SCAN_HPP
+#define CHAR_SCAN_HPP
+
+#include "at_cmd_config.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+/*
+ * Each of the functions returns the pointer to the first of the Chars within [beg, end), or end when there is none.
+ * char_scan() is the fastest one which the target supports: SSE2 on x86, NEON on AArch64, and otherwise the byte by
+ * byte one or, with AT_CMD_HANDLER_SWAR_SCAN, the word at a time one (SWAR). The others are kept for the comparison
+ * (see tests/bench/at_bench.cpp).
+ *
+ * The bytes which are left after the last whole vector or word are checked one by one. Each word is tested for each of
+ * the characters, so SWAR wins only over the long runs of the bytes which aren't looked for, and loses over the short
+ * lines of the most responses.
+ */
+
+//! Tells for each byte whether it is one of the Chars, so a byte is tested with a single load, like in string_buf_rx.
+template <char... Chars> struct char_scan_set
+{
+    static constexpr std::array<bool, 256> make()
+    {
+        std::array<bool, 256> members{};
+        ((members[static_cast<unsigned char>(Chars)] = true), ...);
+        return members;
+    }
+
+    static constexpr std::array<bool, 256> members{make()};
+};
+
+template <char... Chars> inline bool char_scan_is_one_of(char c)
+{
+    return char_scan_set<Chars...>::members[static_cast<unsigned char>(c)];
+}
+
+template <char... Chars> const char *char_scan_scalar(const char *beg, const char *end)
+{
+    for (; beg != end; ++beg)
+        if (char_scan_is_one_of<Chars...>(*beg))
+            break;
+    return beg;
+}
+
+//! The word of the native width: 32 bits on Cortex-M.
+using char_scan_word = uintptr_t;
+
+//! Has the highest bit set in each byte of the word which is zero, at least in the lowest such byte.
+inline char_scan_word char_scan_zero_bytes(char_scan_word w)
+{
+    constexpr char_scan_word ones = ~static_cast<char_scan_word>(0) / 0xFF;
+    constexpr char_scan_word highs = ones << 7;
+    return (w - ones) & ~w & highs;
+}
+
+template <char... Chars> const char *char_scan_swar(const char *beg, const char *end)
+{
+    constexpr char_scan_word ones = ~static_cast<char_scan_word>(0) / 0xFF;
+    constexpr size_t word_len = sizeof(char_scan_word);
+
+    // The words are loaded from the aligned addresses, as Cortex-M0 can't load any other.
+    while (beg != end && reinterpret_cast<uintptr_t>(beg) % word_len != 0)
+    {
+        if (char_scan_is_one_of<Chars...>(*beg))
+            return beg;
+        ++beg;
+    }
+    for (; static_cast<size_t>(end - beg) >= word_len; beg += word_len)
+    {
+        char_scan_word w;
+        std::memcpy(&w, beg, word_len);
+        // A byte equal to the character becomes zero.
+        if ((char_scan_zero_bytes(w ^ (ones * static_cast<unsigned char>(Chars))) | ...))
+            break;
+    }
+    return char_scan_scalar<Chars...>(beg, end);
+}
+
+#if defined(__SSE2__)
+template <char... Chars> const char *char_scan_sse2(const char *beg, const char *end)
+{
+    constexpr size_t vector_len = sizeof(__m128i);
+    for (; static_cast<size_t>(end - beg) >= vector_len; beg += vector_len)
+    {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(beg));
+        auto matches = _mm_setzero_si128();
+        ((matches = _mm_or_si128(matches, _mm_cmpeq_epi8(v, _mm_set1_epi8(Chars)))), ...);
+        if (auto mask = _mm_movemask_epi8(matches))
+            return beg + __builtin_ctz(static_cast<unsigned>(mask));
+    }
+    return char_scan_scalar<Chars...>(beg, end);
+}
+#endif /* defined(__SSE2__) */
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+template <char... Chars> const char *char_scan_neon(const char *beg, const char *end)
+{
+    constexpr size_t vector_len = sizeof(uint8x16_t);
+    for (; static_cast<size_t>(end - beg) >= vector_len; beg += vector_len)
+    {
+        auto v = vld1q_u8(reinterpret_cast<const uint8_t *>(beg));
+        auto matches = vdupq_n_u8(0);
+        ((matches = vorrq_u8(matches, vceqq_u8(v, vdupq_n_u8(static_cast<uint8_t>(Chars))))), ...);
+        // NEON has no movemask, the vector which matches is looked through once more.
+        if (vmaxvq_u8(matches))
+            return char_scan_scalar<Chars...>(beg, beg + vector_len);
+    }
+    return char_scan_scalar<Chars...>(beg, end);
+}
+#endif /* defined(__ARM_NEON) && defined(__aarch64__) */
+
+template <char... Chars> const char *char_scan(const char *beg, const char *end)
+{
+#if defined(__SSE2__)
+    return char_scan_sse2<Chars...>(beg, end);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    return char_scan_neon<Chars...>(beg, end);
+#elif defined(AT_CMD_HANDLER_SWAR_SCAN)
+    return char_scan_swar<Chars...>(beg, end);
+#else
+    return char_scan_scalar<Chars...>(beg, end);
+#endif
+}
+
+#endif /* CHAR_SCAN_HPP */
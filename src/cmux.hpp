@@ -0,0 +1,412 @@
+/**
+ * @file	cmux.hpp
+ * @brief	Defines the GSM 07.10 multiplexer (CMUX), which carries multiple at_channel instances over a single port.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef CMUX_HPP
+#define CMUX_HPP
+
+#include "FreeRTOS.h"
+#include "cmux_frame.hpp"
+#include "os.h"
+#include "task.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace jungles {
+
+/**
+ * \brief Multiplexes up to DlcisNum virtual channels (DLCI 1 to DlcisNum) over a single serial port, with the basic
+ *        option of GSM 07.10, so e.g. the data and the control of a cellular modem are handled concurrently.
+ *
+ * Each DLCI is served by its own at_channel, with its own command queue and receiver task, which transmits and receives
+ * through cmux_dlci_hal. The multiplexer sits between the interrupts of the physical port and those channels: the
+ * received frames are decoded in the RX interrupt and their information is passed to the channel of the DLCI, while
+ * the TX interrupt frames the bytes which the channels transmit, taking the DLCIs in turns, up to MaxInfoLen bytes per
+ * frame, so a long transmission on one DLCI doesn't hold the others.
+ *
+ * The device must be switched to the multiplexer mode beforehand, with AT+CMUX=0 sent through an ordinary channel of
+ * the port. Then the channels are attached and the DLCIs are opened with open().
+ *
+ * The Hal of the physical port must provide the static functions void enable_tx_it(), void disable_tx_it() and
+ * void send_byte(char c), which work like those of at_channel. The interrupt handlers of the port shall call the
+ * it_handle_*() methods. The RX and TX interrupts mustn't preempt each other.
+ *
+ * The channels must transmit byte by byte (Config::is_tx_dma unset) and from the tasks only (Config::is_prompt_from_isr
+ * unset). A channel regards its transmission completed when its last byte is framed, a bit before it's sent.
+ */
+template <typename Hal, size_t DlcisNum, size_t MaxInfoLen = 64> class cmux
+{
+    static_assert(DlcisNum > 0 && DlcisNum < 32, "The DLCIs are tracked with the bits of a 32-bit mask");
+    static_assert(MaxInfoLen > 0, "The frames must carry some information");
+
+  public:
+    /**
+     * \brief Passes the information of the frames of the DLCI to the channel, and the channel transmits through
+     *        cmux_dlci_hal of the same DLCI. Shall be called before open().
+     */
+    template <typename Channel> void attach(unsigned dlci, Channel &channel);
+
+    /**
+     * \brief Opens the control channel (DLCI 0) and then all the attached DLCIs.
+     *
+     * \returns false when the device hasn't acknowledged all of them within ticks_to_wait, for each phase.
+     */
+    bool open(TickType_t ticks_to_wait);
+
+    /**
+     * \brief Closes the attached DLCIs and then the control channel, after which the device leaves the multiplexer
+     *        mode.
+     *
+     * \returns false when the device hasn't acknowledged all of them within ticks_to_wait, for each phase.
+     */
+    bool close(TickType_t ticks_to_wait);
+
+    bool is_open(unsigned dlci) const;
+
+    //! The frames which were malformed or which check sequence didn't match. \see cmux_frame_decoder
+    unsigned get_num_dropped_frames() const;
+
+    //! Call it from the RX interrupt of the physical port.
+    void it_handle_byte_rx(char c);
+
+    //! Call it from the interrupt which receives a chunk of bytes, e.g. on the idle line after DMA reception.
+    void it_handle_bytes_rx(const char *bytes, size_t num);
+
+    //! Call it from the TX interrupt of the physical port.
+    void it_handle_byte_tx();
+
+    // The interface of the virtual ports, used by cmux_dlci_hal.
+
+    //! Called by the task which starts the transmission of the DLCI.
+    void request_tx(unsigned dlci);
+
+    //! Called from the TX interrupt, while a frame is built, when the DLCI has nothing more to transmit.
+    void end_tx(unsigned dlci);
+
+    //! Called from the TX interrupt, while a frame is built. Appends the byte to the information of the frame.
+    void put_byte(char c);
+
+  private:
+    using mask = uint32_t;
+
+    //! Let the multiplexer reach the channel without knowing its type.
+    struct port
+    {
+        void *channel = nullptr;
+        void (*rx)(void *channel, const char *bytes, size_t num) = nullptr;
+        void (*tx)(void *channel) = nullptr;
+    };
+
+    std::array<port, DlcisNum + 1> m_ports;
+
+    //! The bits are indexed with the DLCIs.
+    mask m_attached = 0;
+    volatile mask m_open = 0;
+    volatile mask m_tx_pending = 0;
+    volatile mask m_sabm_pending = 0;
+    volatile mask m_disc_pending = 0;
+
+    //! The DLCIs for which DISC has been sent, so their UA acknowledges closing, not opening.
+    volatile mask m_closing = 0;
+
+    //! The task which waits within open() or close().
+    TaskHandle_t volatile m_waiting_task = nullptr;
+
+    volatile bool m_is_tx_active = false;
+    std::array<uint8_t, MaxInfoLen + cmux_max_frame_overhead> m_frame;
+    size_t m_frame_len = 0;
+    size_t m_frame_pos = 0;
+    std::array<char, MaxInfoLen> m_info;
+    size_t m_info_len = 0;
+
+    //! The DLCI which is asked first for the data of the next frame.
+    unsigned m_next_dlci = 1;
+
+    cmux_frame_decoder<MaxInfoLen> m_decoder;
+
+    static constexpr mask bit(unsigned dlci);
+
+    //! Sends SABM or DISC to the DLCIs and waits until each of them is open or closed, respectively.
+    bool control(mask dlcis, bool is_opening, TickType_t ticks_to_wait);
+
+    void handle_frame();
+    size_t build_next_frame();
+    void start_tx();
+};
+
+/**
+ * \brief The Hal of at_channel which transmits through the DLCI of the multiplexer Mux.
+ *
+ * E.g. with
+ *     cmux<modem_hal, 2> mux;
+ * the channel of DLCI 1 is
+ *     at_channel<modem_cmd_set, cmux_dlci_hal<mux, 1>, modem_config> modem;
+ * and then mux.attach(1, modem).
+ *
+ * The bytes are received by the multiplexer, so enable_rx_it() does nothing.
+ */
+template <auto &Mux, unsigned Dlci> struct cmux_dlci_hal
+{
+    static void enable_rx_it()
+    {
+    }
+
+    static void enable_tx_it()
+    {
+        Mux.request_tx(Dlci);
+    }
+
+    static void disable_tx_it()
+    {
+        Mux.end_tx(Dlci);
+    }
+
+    static void send_byte(char c)
+    {
+        Mux.put_byte(c);
+    }
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PUBLIC MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <typename Hal, size_t DlcisNum, size_t MaxInfoLen>
+template <typename Channel>
+void cmux<Hal, DlcisNum, MaxInfoLen>::attach(unsigned dlci, Channel &channel)
+{
+    configASSERT(dlci > 0 && dlci <= DlcisNum);
+    m_ports[dlci].channel = &channel;
+    m_ports[dlci].rx = [](void *ch, const char *bytes, size_t num) {
+        static_cast<Channel *>(ch)->it_handle_bytes_rx(bytes, num);
+    };
+    m_ports[dlci].tx = [](void *ch) { static_cast<Channel *>(ch)->it_handle_byte_tx(); };
+    m_attached |= bit(dlci);
+}
+
+template <typename Hal, size_t DlcisNum, size_t MaxInfoLen>
+bool cmux<Hal, DlcisNum, MaxInfoLen>::open(TickType_t ticks_to_wait)
+{
+    // The control channel must be open before any other DLCI.
+    return control(bit(0), true, ticks_to_wait) && control(m_attached, true, ticks_to_wait);
+}
+
+template <typename Hal, size_t DlcisNum, size_t MaxInfoLen>
+bool cmux<Hal, DlcisNum, MaxInfoLen>::close(TickType_t ticks_to_wait)
+{
+    return control(m_attached, false, ticks_to_wait) && control(bit(0), false, ticks_to_wait);
+}
+
+template <typename Hal, size_t DlcisNum, size_t MaxInfoLen>
+bool cmux<Hal, DlcisNum, MaxInfoLen>::is_open(unsigned dlci) const
+{
+    return m_open & bit(dlci);
+}
+
+template <typename Hal, size_t DlcisNum, size_t MaxInfoLen>
+unsigned cmux<Hal, DlcisNum, MaxInfoLen>::get_num_dropped_frames() const
+{
+    return m_decoder.get_num_dropped();
+}
+
+template <typename Hal, size_t DlcisNum, size_t MaxInfoLen>
+void cmux<Hal, DlcisNum, MaxInfoLen>::it_handle_byte_rx(char c)
+{
+    if (m_decoder.push_byte(static_cast<uint8_t>(c)))
+        handle_frame();
+}
+
+template <typename Hal, size_t DlcisNum, size_t MaxInfoLen>
+void cmux<Hal, DlcisNum, MaxInfoLen>::it_handle_bytes_rx(const char *bytes, size_t num)
+{
+    for (size_t i = 0; i < num; ++i)
+        if (m_decoder.push_byte(static_cast<uint8_t>(bytes[i])))
+            handle_frame();
+}
+
+template <typename Hal, size_t DlcisNum, size_t MaxInfoLen> void cmux<Hal, DlcisNum, MaxInfoLen>::it_handle_byte_tx()
+{
+    if (m_frame_pos == m_frame_len)
+    {
+        m_frame_pos = 0;
+        m_frame_len = build_next_frame();
+        if (m_frame_len == 0)
+        {
+            m_is_tx_active = false;
+            Hal::disable_tx_it();
+            return;
+        }
+    }
+    Hal::send_byte(static_cast<char>(m_frame[m_frame_pos++]));
+}
+
+template <typename Hal, size_t DlcisNum, size_t MaxInfoLen>
+void cmux<Hal, DlcisNum, MaxInfoLen>::request_tx(unsigned dlci)
+{
+    taskENTER_CRITICAL();
+    m_tx_pending |= bit(dlci);
+    start_tx();
+    taskEXIT_CRITICAL();
+}
+
+template <typename Hal, size_t DlcisNum, size_t MaxInfoLen>
+void cmux<Hal, DlcisNum, MaxInfoLen>::end_tx(unsigned dlci)
+{
+    m_tx_pending &= ~bit(dlci);
+}
+
+template <typename Hal, size_t DlcisNum, size_t MaxInfoLen> void cmux<Hal, DlcisNum, MaxInfoLen>::put_byte(char c)
+{
+    m_info[m_info_len++] = c;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <typename Hal, size_t DlcisNum, size_t MaxInfoLen>
+constexpr typename cmux<Hal, DlcisNum, MaxInfoLen>::mask cmux<Hal, DlcisNum, MaxInfoLen>::bit(unsigned dlci)
+{
+    return mask{1} << dlci;
+}
+
+template <typename Hal, size_t DlcisNum, size_t MaxInfoLen>
+bool cmux<Hal, DlcisNum, MaxInfoLen>::control(mask dlcis, bool is_opening, TickType_t ticks_to_wait)
+{
+    auto is_done = [&]() { return (m_open & dlcis) == (is_opening ? dlcis : 0); };
+
+    taskENTER_CRITICAL();
+    m_waiting_task = xTaskGetCurrentTaskHandle();
+    if (is_opening)
+        m_sabm_pending |= dlcis;
+    else
+    {
+        m_closing |= dlcis;
+        m_disc_pending |= dlcis;
+    }
+    start_tx();
+    taskEXIT_CRITICAL();
+
+    // The acknowledgements may come before the task waits, then their notifications are taken at once.
+    TimeOut_t timeout;
+    vTaskSetTimeOutState(&timeout);
+    auto res = true;
+    while (!is_done())
+        if (xTaskCheckForTimeOut(&timeout, &ticks_to_wait) == pdTRUE)
+        {
+            res = is_done();
+            break;
+        }
+        else
+            ulTaskNotifyTake(pdTRUE, ticks_to_wait);
+
+    taskENTER_CRITICAL();
+    m_waiting_task = nullptr;
+    // The DLCIs which haven't responded aren't asked again.
+    m_sabm_pending &= ~dlcis;
+    m_disc_pending &= ~dlcis;
+    taskEXIT_CRITICAL();
+    return res;
+}
+
+//! Called from the RX interrupt.
+template <typename Hal, size_t DlcisNum, size_t MaxInfoLen> void cmux<Hal, DlcisNum, MaxInfoLen>::handle_frame()
+{
+    auto dlci = m_decoder.dlci();
+    if (dlci > DlcisNum)
+        return;
+
+    auto b = bit(dlci);
+    switch (m_decoder.type())
+    {
+    case cmux_frame_type::uih:
+        if (m_ports[dlci].rx && (m_open & b))
+        {
+            auto info = m_decoder.info();
+            if (!info.empty())
+                m_ports[dlci].rx(m_ports[dlci].channel, info.data(), info.length());
+        }
+        return;
+
+    case cmux_frame_type::ua:
+        if (m_closing & b)
+        {
+            m_closing &= ~b;
+            m_open &= ~b;
+        }
+        else
+        {
+            m_open |= b;
+            // The transmission requested before the DLCI was opened can start now.
+            if (m_tx_pending & b)
+                start_tx();
+        }
+        break;
+
+    case cmux_frame_type::dm:
+        m_closing &= ~b;
+        m_open &= ~b;
+        break;
+
+    default:
+        // The device doesn't issue any commands which the multiplexer would have to follow.
+        return;
+    }
+
+    if (m_waiting_task)
+        notify_from_isr(m_waiting_task);
+}
+
+//! Called from the TX interrupt. Returns the length of the frame, zero when there is nothing more to transmit.
+template <typename Hal, size_t DlcisNum, size_t MaxInfoLen> size_t cmux<Hal, DlcisNum, MaxInfoLen>::build_next_frame()
+{
+    // The control frames go first, the opening ones from DLCI 0 up.
+    for (unsigned dlci = 0; dlci <= DlcisNum; ++dlci)
+    {
+        auto b = bit(dlci);
+        if (m_sabm_pending & b)
+        {
+            m_sabm_pending &= ~b;
+            return cmux_encode_frame(m_frame.data(), dlci, cmux_frame_type::sabm, true, {});
+        }
+        if (m_disc_pending & b)
+        {
+            m_disc_pending &= ~b;
+            return cmux_encode_frame(m_frame.data(), dlci, cmux_frame_type::disc, true, {});
+        }
+    }
+
+    for (unsigned i = 0; i < DlcisNum; ++i)
+    {
+        auto dlci = m_next_dlci;
+        m_next_dlci = dlci % DlcisNum + 1;
+
+        auto b = bit(dlci);
+        if (!(m_tx_pending & m_open & b))
+            continue;
+
+        // Pump the TX interrupt of the channel until it's done or the frame is full.
+        m_info_len = 0;
+        while ((m_tx_pending & b) && m_info_len < MaxInfoLen)
+            m_ports[dlci].tx(m_ports[dlci].channel);
+        if (m_info_len > 0)
+            return cmux_encode_frame(
+                m_frame.data(), dlci, cmux_frame_type::uih, false, {m_info.data(), m_info_len});
+    }
+    return 0;
+}
+
+//! Called within a critical section or from the RX interrupt.
+template <typename Hal, size_t DlcisNum, size_t MaxInfoLen> void cmux<Hal, DlcisNum, MaxInfoLen>::start_tx()
+{
+    // The TX interrupt builds the frames by itself, until there is nothing more to transmit.
+    if (m_is_tx_active)
+        return;
+    m_is_tx_active = true;
+    Hal::enable_tx_it();
+}
+
+} // namespace jungles
+
+#endif /* CMUX_HPP */
@@ -0,0 +1,290 @@
+/**
+ * @file	cmux_frame.hpp
+ * @brief	Defines the encoding and the decoding of the frames of the GSM 07.10 multiplexer (CMUX), basic option.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef CMUX_FRAME_HPP
+#define CMUX_FRAME_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS OF STRUCTURES, DATA TYPES, ...
+// --------------------------------------------------------------------------------------------------------------------
+
+//! The control fields of the frames, without the poll/final bit.
+enum class cmux_frame_type : uint8_t
+{
+    //! Opens the DLCI.
+    sabm = 0x2F,
+
+    //! Acknowledges SABM or DISC.
+    ua = 0x63,
+
+    //! Tells that the DLCI is closed.
+    dm = 0x0F,
+
+    //! Closes the DLCI.
+    disc = 0x43,
+
+    //! Carries the data, which isn't covered by the frame check sequence.
+    uih = 0xEF
+};
+
+//! Opens and closes each frame.
+constexpr uint8_t cmux_flag = 0xF9;
+
+//! The poll/final bit of the control field.
+constexpr uint8_t cmux_pf_bit = 0x10;
+
+//! The flags, the address, the control field, two bytes of the length and the frame check sequence.
+constexpr size_t cmux_max_frame_overhead = 7;
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF PUBLIC FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+
+/**
+ * \brief Writes a whole frame of the basic option to dst, e.g. a UIH frame with the data of the DLCI.
+ *
+ * The frames are sent as commands of the initiator, i.e. with the C/R bit set. The length takes a single byte up to
+ * 127 bytes of the information and two bytes above.
+ *
+ * \param[out] dst   Must hold at least info.length() + cmux_max_frame_overhead bytes.
+ * \returns the number of the bytes written.
+ */
+size_t cmux_encode_frame(uint8_t *dst, unsigned dlci, cmux_frame_type type, bool is_pf, std::string_view info);
+
+/**
+ * \brief Decodes the frames of the basic option from the received bytes, one byte at a time.
+ *
+ * The bytes before the opening flag and the frames which are malformed, too long or which check sequence doesn't
+ * match are dropped and counted; the decoder resynchronises at the next flag. The closing flag of a frame may open
+ * the next one. Doesn't allocate any memory, so it may be fed from an interrupt.
+ */
+template <size_t MaxInfoLen> class cmux_frame_decoder
+{
+  public:
+    //! Returns true when the byte completes a valid frame, which is available until the next byte is pushed.
+    bool push_byte(uint8_t b);
+
+    unsigned dlci() const;
+    cmux_frame_type type() const;
+    bool is_pf() const;
+    std::string_view info() const;
+
+    unsigned get_num_dropped() const;
+
+  private:
+    enum class state
+    {
+        hunting,
+        address,
+        control,
+        length,
+        length_high,
+        info,
+        fcs,
+        closing_flag
+    };
+
+    state m_state = state::hunting;
+    uint8_t m_address = 0;
+    uint8_t m_control = 0;
+    uint8_t m_crc = 0;
+    size_t m_len = 0;
+    size_t m_info_len = 0;
+    std::array<char, MaxInfoLen> m_info;
+    unsigned m_num_dropped = 0;
+
+    //! Drops the frame which doesn't fit or doesn't match. When the byte is a flag, then it opens the next frame.
+    void drop(uint8_t b);
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+namespace cmux_detail {
+
+//! CRC-8 of GSM 07.10: the reversed polynomial x^8 + x^2 + x + 1, initialised with 0xFF.
+constexpr std::array<uint8_t, 256> make_crc_table()
+{
+    std::array<uint8_t, 256> table = {};
+    for (unsigned i = 0; i < 256; ++i)
+    {
+        uint8_t crc = static_cast<uint8_t>(i);
+        for (unsigned bit = 0; bit < 8; ++bit)
+            crc = (crc & 1) ? static_cast<uint8_t>((crc >> 1) ^ 0xE0) : static_cast<uint8_t>(crc >> 1);
+        table[i] = crc;
+    }
+    return table;
+}
+
+constexpr auto crc_table{make_crc_table()};
+
+constexpr uint8_t crc_init = 0xFF;
+
+//! The value of the CRC over the checked bytes followed by their frame check sequence.
+constexpr uint8_t crc_good = 0xCF;
+
+constexpr uint8_t update_crc(uint8_t crc, uint8_t b)
+{
+    return crc_table[crc ^ b];
+}
+
+} // namespace cmux_detail
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PUBLIC FUNCTIONS AND MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+inline size_t
+cmux_encode_frame(uint8_t *dst, unsigned dlci, cmux_frame_type type, bool is_pf, std::string_view info)
+{
+    using namespace cmux_detail;
+
+    size_t pos = 0;
+    dst[pos++] = cmux_flag;
+
+    // The frame check sequence of UIH covers the address, the control field and the length only.
+    auto crc = crc_init;
+    auto put_checked = [&](uint8_t b) {
+        dst[pos++] = b;
+        crc = update_crc(crc, b);
+    };
+
+    put_checked(static_cast<uint8_t>((dlci << 2) | 0x02 | 0x01));
+    put_checked(static_cast<uint8_t>(static_cast<uint8_t>(type) | (is_pf ? cmux_pf_bit : 0)));
+    auto len = info.length();
+    if (len <= 0x7F)
+        put_checked(static_cast<uint8_t>((len << 1) | 0x01));
+    else
+    {
+        put_checked(static_cast<uint8_t>(len << 1));
+        put_checked(static_cast<uint8_t>(len >> 7));
+    }
+
+    for (auto c : info)
+        dst[pos++] = static_cast<uint8_t>(c);
+    dst[pos++] = static_cast<uint8_t>(0xFF - crc);
+    dst[pos++] = cmux_flag;
+    return pos;
+}
+
+template <size_t MaxInfoLen> bool cmux_frame_decoder<MaxInfoLen>::push_byte(uint8_t b)
+{
+    using namespace cmux_detail;
+
+    switch (m_state)
+    {
+    case state::hunting:
+        // The bytes out of the frames are skipped, they've been counted with the frame which has been dropped.
+        if (b == cmux_flag)
+            m_state = state::address;
+        return false;
+
+    case state::address:
+        // The consecutive flags are allowed between the frames.
+        if (b == cmux_flag)
+            return false;
+        if (!(b & 0x01))
+        {
+            drop(b);
+            return false;
+        }
+        m_address = b;
+        m_crc = update_crc(crc_init, b);
+        m_state = state::control;
+        return false;
+
+    case state::control:
+        m_control = b;
+        m_crc = update_crc(m_crc, b);
+        m_state = state::length;
+        return false;
+
+    case state::length:
+        m_crc = update_crc(m_crc, b);
+        m_len = b >> 1;
+        m_info_len = 0;
+        if (!(b & 0x01))
+            m_state = state::length_high;
+        else if (m_len > MaxInfoLen)
+            drop(b);
+        else
+            m_state = m_len == 0 ? state::fcs : state::info;
+        return false;
+
+    case state::length_high:
+        m_crc = update_crc(m_crc, b);
+        m_len |= static_cast<size_t>(b) << 7;
+        if (m_len > MaxInfoLen)
+            drop(b);
+        else
+            m_state = m_len == 0 ? state::fcs : state::info;
+        return false;
+
+    case state::info:
+        m_info[m_info_len++] = static_cast<char>(b);
+        if (m_info_len == m_len)
+            m_state = state::fcs;
+        return false;
+
+    case state::fcs:
+        if (update_crc(m_crc, b) != crc_good)
+            drop(b);
+        else
+            m_state = state::closing_flag;
+        return false;
+
+    case state::closing_flag:
+        if (b != cmux_flag)
+        {
+            drop(b);
+            return false;
+        }
+        // The closing flag opens the next frame as well.
+        m_state = state::address;
+        return true;
+    }
+    return false;
+}
+
+template <size_t MaxInfoLen> unsigned cmux_frame_decoder<MaxInfoLen>::dlci() const
+{
+    return m_address >> 2;
+}
+
+template <size_t MaxInfoLen> cmux_frame_type cmux_frame_decoder<MaxInfoLen>::type() const
+{
+    return static_cast<cmux_frame_type>(m_control & ~cmux_pf_bit);
+}
+
+template <size_t MaxInfoLen> bool cmux_frame_decoder<MaxInfoLen>::is_pf() const
+{
+    return m_control & cmux_pf_bit;
+}
+
+template <size_t MaxInfoLen> std::string_view cmux_frame_decoder<MaxInfoLen>::info() const
+{
+    return {m_info.data(), m_info_len};
+}
+
+template <size_t MaxInfoLen> unsigned cmux_frame_decoder<MaxInfoLen>::get_num_dropped() const
+{
+    return m_num_dropped;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <size_t MaxInfoLen> void cmux_frame_decoder<MaxInfoLen>::drop(uint8_t b)
+{
+    m_num_dropped++;
+    m_state = b == cmux_flag ? state::address : state::hunting;
+}
+
+#endif /* CMUX_FRAME_HPP */
@@ -0,0 +1,421 @@
+/**
+ * @file	handler_table.hpp
+ * @brief	Defines a fixed-size table of records kept in queues, one queue per key.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef HANDLER_TABLE_HPP
+#define HANDLER_TABLE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+/**
+ * \brief Identifies a record of handler_table. The generation tells apart the records which reused the same place,
+ *        so a token of a removed record never matches a record added afterwards.
+ */
+struct handler_token
+{
+    unsigned short index = 0xFFFF;
+    unsigned short generation = 0;
+
+    //! False for the token which doesn't identify any record, e.g. when the record couldn't be added.
+    explicit operator bool() const noexcept
+    {
+        return index != 0xFFFF;
+    }
+};
+
+/**
+ * \brief Holds up to Capacity records in a single array, each one queued behind the records of the same key.
+ *
+ * The queues are linked both ways with the indexes of the records, so adding a record and removing any record by
+ * its token take constant time, without any allocation, and all the records lie next to each other. The free
+ * records are linked in the same way.
+ *
+ * A record may be removed while it's being visited (see visit_front()), e.g. by the handler which it holds; then its
+ * removal is deferred until the visit is over, so the record isn't destroyed under the feet of the visitor.
+ *
+ * By default this is not thread safe. Once set_lock() is called, push_back() and remove() may be called by any task,
+ * while the queues belong to a single task, the owner: the records are taken and marked within the lock, but they are
+ * linked into and unlinked from the queues only by apply_changes(), which the owner calls before it visits them. A
+ * removed record isn't visited anymore, even before the owner applies the removal. Besides, a single other task may
+ * pin a record, so it uses the record without the lock and the record isn't released till it's unpinned.
+ *
+ * T must be default constructible and move assignable.
+ */
+template <typename T, size_t KeysNum, size_t Capacity> class handler_table
+{
+    static_assert(Capacity > 0, "The table must have at least one record");
+    static_assert(Capacity < 0xFFFF, "The records are linked with 16-bit indexes");
+
+  public:
+    static constexpr size_t capacity = Capacity;
+
+    //! Enters or leaves the lock, e.g. a critical section.
+    using lock_fn = void (*)();
+
+    handler_table() noexcept;
+
+    //! Lets push_back() and remove() be called by any task, see the description of the class.
+    void set_lock(lock_fn lock, lock_fn unlock) noexcept;
+
+    //! Returns an empty token when all the records are taken.
+    handler_token push_back(size_t key, T &&value);
+
+    //! Returns false when the token doesn't identify a record, e.g. when the record has been removed already.
+    bool remove(handler_token token);
+
+    //! Links the records pushed and unlinks the records removed by the other tasks since the last call.
+    void apply_changes();
+
+    /**
+     * \brief Passes the first record of the key to the visitor, which returns true when the record shall be removed.
+     *
+     * Does nothing when no record of the key is queued.
+     */
+    template <typename Visitor> void visit_front(size_t key, Visitor &&visitor);
+
+    //! Returns nullptr when the token doesn't identify a record.
+    T *get(handler_token token) noexcept;
+
+    //! Returns an empty token when no record of the key is queued.
+    handler_token get_front_token(size_t key) const noexcept;
+
+    bool empty(size_t key) const noexcept;
+
+    size_t get_num_free() const noexcept;
+
+    /**
+     * \brief Returns the queued record, which isn't released until unpin() is called, or nullptr when the record has
+     *        been removed. Meant for a single task other than the owner.
+     */
+    T *pin(handler_token token) noexcept;
+
+    //! Releases the record when it has been removed while pinned.
+    void unpin(handler_token token);
+
+  private:
+    using index = unsigned short;
+    static constexpr index none = 0xFFFF;
+
+    enum class record_state : unsigned char
+    {
+        free,
+
+        //! Taken by push_back(), which moves the value into it.
+        filling,
+
+        //! Pushed, but not linked into its queue yet.
+        unlinked,
+        linked,
+
+        //! Unlinked and about to be released, once it's unpinned.
+        detached
+    };
+
+    std::array<T, Capacity> m_records;
+    std::array<index, Capacity> m_next;
+    std::array<index, Capacity> m_prev;
+    std::array<index, Capacity> m_keys;
+    std::array<unsigned short, Capacity> m_generations = {};
+    std::array<index, KeysNum> m_heads;
+    std::array<index, KeysNum> m_tails;
+    index m_free;
+    size_t m_num_free;
+
+    //! The record passed to the visitor.
+    index m_visited = none;
+
+    lock_fn m_lock = nullptr;
+    lock_fn m_unlock = nullptr;
+
+    /*
+     * The state of each record. All but m_is_removed are modified within the lock. m_is_removed is read by the owner
+     * also without the lock, so it skips the removed records.
+     */
+    std::array<record_state, Capacity> m_states = {};
+    std::array<std::atomic<bool>, Capacity> m_is_removed = {};
+    std::array<bool, Capacity> m_is_pinned = {};
+
+    //! The records whose state the owner has to apply, in their order. Modified within the lock.
+    std::array<index, Capacity> m_pending_next;
+    std::array<bool, Capacity> m_is_pending = {};
+    std::atomic<index> m_pending_head{none};
+    index m_pending_tail = none;
+
+    void lock() const;
+    void unlock() const;
+    bool is_valid(handler_token token) const noexcept;
+    void mark_pending(index i);
+    void link(index i);
+    void unlink_and_release(index i);
+    void release(index i);
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PUBLIC MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <typename T, size_t KeysNum, size_t Capacity>
+handler_table<T, KeysNum, Capacity>::handler_table() noexcept : m_free(0), m_num_free(Capacity)
+{
+    for (size_t i = 0; i < Capacity - 1; ++i)
+        m_next[i] = static_cast<index>(i + 1);
+    m_next[Capacity - 1] = none;
+    m_heads.fill(none);
+    m_tails.fill(none);
+}
+
+template <typename T, size_t KeysNum, size_t Capacity>
+void handler_table<T, KeysNum, Capacity>::set_lock(lock_fn lock, lock_fn unlock) noexcept
+{
+    m_lock = lock;
+    m_unlock = unlock;
+}
+
+template <typename T, size_t KeysNum, size_t Capacity>
+handler_token handler_table<T, KeysNum, Capacity>::push_back(size_t key, T &&value)
+{
+    lock();
+    if (m_free == none)
+    {
+        unlock();
+        return {};
+    }
+    auto i = m_free;
+    m_free = m_next[i];
+    m_num_free--;
+    m_states[i] = record_state::filling;
+    handler_token token{i, m_generations[i]};
+    unlock();
+
+    // The record is invisible to the owner till it's marked as pending, so the value is moved without the lock.
+    m_records[i] = std::move(value);
+    m_keys[i] = static_cast<index>(key);
+
+    lock();
+    m_states[i] = record_state::unlinked;
+    mark_pending(i);
+    unlock();
+
+    // Without the lock the caller is the owner, so the record is queued right away.
+    if (!m_lock)
+        apply_changes();
+    return token;
+}
+
+template <typename T, size_t KeysNum, size_t Capacity>
+bool handler_table<T, KeysNum, Capacity>::remove(handler_token token)
+{
+    lock();
+    auto is_removed = is_valid(token) && m_states[token.index] != record_state::detached
+        && !m_is_removed[token.index].load(std::memory_order_relaxed);
+    if (is_removed)
+    {
+        m_is_removed[token.index].store(true, std::memory_order_relaxed);
+        mark_pending(token.index);
+    }
+    unlock();
+
+    if (!m_lock)
+        apply_changes();
+    return is_removed;
+}
+
+template <typename T, size_t KeysNum, size_t Capacity> void handler_table<T, KeysNum, Capacity>::apply_changes()
+{
+    while (m_pending_head.load(std::memory_order_relaxed) != none)
+    {
+        lock();
+        auto i = m_pending_head.load(std::memory_order_relaxed);
+        m_pending_head.store(m_pending_next[i], std::memory_order_relaxed);
+        if (m_pending_next[i] == none)
+            m_pending_tail = none;
+        m_is_pending[i] = false;
+        auto state = m_states[i];
+        auto is_removed = m_is_removed[i].load(std::memory_order_relaxed);
+        if (state == record_state::unlinked && !is_removed)
+            m_states[i] = record_state::linked;
+        unlock();
+
+        // The visited record is released by visit_front(), once the visitor returns.
+        if (state == record_state::unlinked && !is_removed)
+            link(i);
+        else if (state == record_state::linked && is_removed && i != m_visited)
+            unlink_and_release(i);
+        else if (state == record_state::unlinked && is_removed)
+            release(i);
+    }
+}
+
+template <typename T, size_t KeysNum, size_t Capacity>
+template <typename Visitor>
+void handler_table<T, KeysNum, Capacity>::visit_front(size_t key, Visitor &&visitor)
+{
+    // The records removed by the other tasks make room for the ones behind them right away.
+    auto i = m_heads[key];
+    while (i != none && m_is_removed[i].load(std::memory_order_relaxed))
+    {
+        unlink_and_release(i);
+        i = m_heads[key];
+    }
+    if (i == none)
+        return;
+
+    m_visited = i;
+    auto is_to_remove = visitor(m_records[i]);
+    m_visited = none;
+
+    if (is_to_remove || m_is_removed[i].load(std::memory_order_relaxed))
+        unlink_and_release(i);
+}
+
+template <typename T, size_t KeysNum, size_t Capacity>
+T *handler_table<T, KeysNum, Capacity>::get(handler_token token) noexcept
+{
+    return is_valid(token) ? &m_records[token.index] : nullptr;
+}
+
+template <typename T, size_t KeysNum, size_t Capacity>
+handler_token handler_table<T, KeysNum, Capacity>::get_front_token(size_t key) const noexcept
+{
+    auto i = m_heads[key];
+    return i == none ? handler_token{} : handler_token{i, m_generations[i]};
+}
+
+template <typename T, size_t KeysNum, size_t Capacity>
+bool handler_table<T, KeysNum, Capacity>::empty(size_t key) const noexcept
+{
+    return m_heads[key] == none;
+}
+
+template <typename T, size_t KeysNum, size_t Capacity>
+size_t handler_table<T, KeysNum, Capacity>::get_num_free() const noexcept
+{
+    lock();
+    auto num = m_num_free;
+    unlock();
+    return num;
+}
+
+template <typename T, size_t KeysNum, size_t Capacity>
+T *handler_table<T, KeysNum, Capacity>::pin(handler_token token) noexcept
+{
+    lock();
+    auto is_pinned = is_valid(token) && m_states[token.index] == record_state::linked
+        && !m_is_removed[token.index].load(std::memory_order_relaxed);
+    if (is_pinned)
+        m_is_pinned[token.index] = true;
+    unlock();
+    return is_pinned ? &m_records[token.index] : nullptr;
+}
+
+template <typename T, size_t KeysNum, size_t Capacity>
+void handler_table<T, KeysNum, Capacity>::unpin(handler_token token)
+{
+    lock();
+    m_is_pinned[token.index] = false;
+    auto is_detached = m_states[token.index] == record_state::detached;
+    unlock();
+
+    if (is_detached)
+        release(token.index);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <typename T, size_t KeysNum, size_t Capacity> void handler_table<T, KeysNum, Capacity>::lock() const
+{
+    if (m_lock)
+        m_lock();
+}
+
+template <typename T, size_t KeysNum, size_t Capacity> void handler_table<T, KeysNum, Capacity>::unlock() const
+{
+    if (m_unlock)
+        m_unlock();
+}
+
+template <typename T, size_t KeysNum, size_t Capacity>
+bool handler_table<T, KeysNum, Capacity>::is_valid(handler_token token) const noexcept
+{
+    // The generation is bumped on each release, so only the token of the current record matches (as long as the
+    // record isn't reused 65536 times meanwhile).
+    return token.index < Capacity && m_generations[token.index] == token.generation
+        && m_states[token.index] != record_state::free && m_states[token.index] != record_state::filling;
+}
+
+//! Must be called within the lock. A record is pending at most once, as the owner applies its latest state.
+template <typename T, size_t KeysNum, size_t Capacity>
+void handler_table<T, KeysNum, Capacity>::mark_pending(index i)
+{
+    if (m_is_pending[i])
+        return;
+    m_is_pending[i] = true;
+    m_pending_next[i] = none;
+    if (m_pending_tail == none)
+        m_pending_head.store(i, std::memory_order_relaxed);
+    else
+        m_pending_next[m_pending_tail] = i;
+    m_pending_tail = i;
+}
+
+template <typename T, size_t KeysNum, size_t Capacity> void handler_table<T, KeysNum, Capacity>::link(index i)
+{
+    auto key = m_keys[i];
+    m_next[i] = none;
+    m_prev[i] = m_tails[key];
+    if (m_tails[key] == none)
+        m_heads[key] = i;
+    else
+        m_next[m_tails[key]] = i;
+    m_tails[key] = i;
+}
+
+template <typename T, size_t KeysNum, size_t Capacity>
+void handler_table<T, KeysNum, Capacity>::unlink_and_release(index i)
+{
+    auto key = m_keys[i];
+    if (m_prev[i] == none)
+        m_heads[key] = m_next[i];
+    else
+        m_next[m_prev[i]] = m_next[i];
+    if (m_next[i] == none)
+        m_tails[key] = m_prev[i];
+    else
+        m_prev[m_next[i]] = m_prev[i];
+    release(i);
+}
+
+/**
+ * The token stops matching first, so neither remove() nor pin() reach the record while it's being released. A pinned
+ * record is released by unpin() instead.
+ */
+template <typename T, size_t KeysNum, size_t Capacity> void handler_table<T, KeysNum, Capacity>::release(index i)
+{
+    lock();
+    auto is_pinned = m_is_pinned[i];
+    auto was_detached = m_states[i] == record_state::detached;
+    m_states[i] = record_state::detached;
+    if (!was_detached)
+        m_generations[i]++;
+    unlock();
+    if (is_pinned)
+        return;
+
+    // Release whatever the record holds right away, not when the record is reused.
+    m_records[i] = T{};
+
+    lock();
+    m_states[i] = record_state::free;
+    m_is_removed[i].store(false, std::memory_order_relaxed);
+    m_next[i] = m_free;
+    m_free = i;
+    m_num_free++;
+    unlock();
+}
+
+#endif /* HANDLER_TABLE_HPP */
@@ -7,6 +7,9 @@
 #ifndef HW_AT_H
 #define HW_AT_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -26,6 +29,42 @@ void hw_at_disable_rx_it();
 //! Transmits byte over the AT TX line.
 void hw_at_send_byte(char c);
 
+/**
+ * Starts transmission of the block over the AT TX line (e.g. with DMA) and returns immediately. The data stays
+ * untouched until it_handle_at_block_tx_done() is called. Used only when AT_CMD_HANDLER_TX_DMA is defined.
+ */
+void hw_at_send_block(const char *data, size_t len);
+
+/**
+ * Asserts the RTS line, so the modem may send. Called by the receiver task when it starts and once the received lines
+ * have been handled. Used only when AT_CMD_HANDLER_RX_RTS_HIGH_WATERMARK is defined.
+ */
+void hw_at_assert_rts(void);
+
+/**
+ * Releases the RTS line, so the modem stops sending. Called from the RX interrupt, when the RX buffer reaches the high
+ * watermark. Used only when AT_CMD_HANDLER_RX_RTS_HIGH_WATERMARK is defined.
+ */
+void hw_at_release_rts(void);
+
+/**
+ * Wakes the modem up, e.g. with its DTR or wake-up pin, and returns once it may receive. Called by a task before a
+ * command is transmitted while the modem sleeps. Used only when AT_CMD_HANDLER_WAKE_LINE is defined.
+ */
+void hw_at_wake_device(void);
+
+/**
+ * Lets the modem sleep again. Called by the receiver task after the final result code of the last queued command.
+ * Used only when AT_CMD_HANDLER_WAKE_LINE is defined.
+ */
+void hw_at_allow_device_sleep(void);
+
+/**
+ * Returns the current time in any unit, e.g. in microseconds from a free-running timer. Called also from the
+ * interrupts. Used only when AT_CMD_HANDLER_LATENCY_STATS or AT_CMD_HANDLER_CAPTURE_LEN is defined.
+ */
+uint32_t hw_at_get_timestamp(void);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
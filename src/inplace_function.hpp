@@ -0,0 +1,130 @@
+/**
+ * @file	inplace_function.hpp
+ * @brief	Defines a callable wrapper which keeps the callable within itself, never on the heap.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef INPLACE_FUNCTION_HPP
+#define INPLACE_FUNCTION_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <typename Signature, size_t Capacity> class inplace_function;
+
+/**
+ * \brief Holds any callable of the signature R(Args...) in Capacity bytes of its own storage, like std::function,
+ *        but which never allocates.
+ *
+ * A callable which doesn't fit into the storage doesn't compile, so the size of the captures is checked at build
+ * time instead of ending up on the heap. The wrapper can be moved but not copied, so the callables with move-only
+ * captures can be held as well.
+ */
+template <typename R, typename... Args, size_t Capacity> class inplace_function<R(Args...), Capacity>
+{
+  public:
+    static constexpr size_t capacity = Capacity;
+
+    inplace_function() noexcept = default;
+
+    inplace_function(std::nullptr_t) noexcept
+    {
+    }
+
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, inplace_function>>>
+    inplace_function(F &&f)
+    {
+        using T = std::decay_t<F>;
+        static_assert(sizeof(T) <= Capacity, "The callable doesn't fit into the storage, make the capacity bigger");
+        static_assert(alignof(T) <= alignof(std::max_align_t), "The callable is over-aligned");
+        static_assert(std::is_invocable_r_v<R, T &, Args...>, "The callable doesn't match the signature");
+        static_assert(std::is_nothrow_move_constructible_v<T>, "The callable must be moved without exceptions");
+
+        new (m_storage) T(std::forward<F>(f));
+        m_ops = &ops_of<T>;
+    }
+
+    inplace_function(inplace_function &&other) noexcept
+    {
+        take(other);
+    }
+
+    inplace_function &operator=(inplace_function &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            take(other);
+        }
+        return *this;
+    }
+
+    inplace_function(const inplace_function &) = delete;
+    inplace_function &operator=(const inplace_function &) = delete;
+
+    ~inplace_function()
+    {
+        reset();
+    }
+
+    //! Destroys the held callable, so its captures are released right away.
+    void reset() noexcept
+    {
+        if (m_ops)
+            m_ops->destroy(m_storage);
+        m_ops = nullptr;
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return m_ops != nullptr;
+    }
+
+    //! Must not be called on an empty wrapper.
+    R operator()(Args... args) const
+    {
+        return m_ops->invoke(m_storage, std::forward<Args>(args)...);
+    }
+
+  private:
+    //! The operations on the held callable, one static table per the type of the callable.
+    struct ops
+    {
+        R (*invoke)(void *storage, Args &&... args);
+        void (*move)(void *dst, void *src) noexcept;
+        void (*destroy)(void *storage) noexcept;
+    };
+
+    template <typename T> static R invoke(void *storage, Args &&... args)
+    {
+        return (*static_cast<T *>(storage))(std::forward<Args>(args)...);
+    }
+
+    template <typename T> static void move(void *dst, void *src) noexcept
+    {
+        new (dst) T(std::move(*static_cast<T *>(src)));
+        static_cast<T *>(src)->~T();
+    }
+
+    template <typename T> static void destroy(void *storage) noexcept
+    {
+        static_cast<T *>(storage)->~T();
+    }
+
+    template <typename T> static constexpr ops ops_of{&invoke<T>, &move<T>, &destroy<T>};
+
+    alignas(std::max_align_t) mutable unsigned char m_storage[Capacity];
+    const ops *m_ops = nullptr;
+
+    void take(inplace_function &other) noexcept
+    {
+        if (other.m_ops)
+            other.m_ops->move(m_storage, other.m_storage);
+        m_ops = other.m_ops;
+        other.m_ops = nullptr;
+    }
+};
+
+#endif /* INPLACE_FUNCTION_HPP */
@@ -0,0 +1,169 @@
+/**
+ * @file	line_view.hpp
+ * @brief	Defines a non-owning view over a line, which may be split into two segments (e.g. in a cyclic buffer).
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef LINE_VIEW_HPP
+#define LINE_VIEW_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+/**
+ * \brief A view over a line which doesn't own the characters.
+ *
+ * When the line is held in a cyclic buffer and wraps around its end, then the line consists of two segments: the first
+ * one lasts to the end of the buffer and the second one starts at the beginning of the buffer. The view allows to
+ * compare and slice the line without copying it to a contiguous memory.
+ *
+ * The owner of the characters must keep them untouched as long as the view is used.
+ */
+class line_view
+{
+  public:
+    line_view() = default;
+    line_view(std::string_view first, std::string_view second = {}) noexcept;
+
+    size_t length() const noexcept;
+    bool empty() const noexcept;
+
+    //! Accesses the character at the specified position. The position must be lower than length().
+    char operator[](size_t pos) const noexcept;
+
+    //! Checks whether the line is equal to the string.
+    bool operator==(std::string_view s) const noexcept;
+    bool operator!=(std::string_view s) const noexcept;
+
+    bool starts_with(std::string_view s) const noexcept;
+
+    //! Checks whether the string is placed within the line at the position. False when the line is too short.
+    bool contains_at(size_t pos, std::string_view s) const noexcept;
+
+    //! Moves the beginning of the view forward by n characters. n must not be greater than length().
+    void remove_prefix(size_t n) noexcept;
+
+    //! Views n characters from the position, which may span both segments. The range must lie within the line.
+    line_view substr(size_t pos, size_t n) const noexcept;
+
+    //! Appends the line to the string, what is the only copy this view performs. Accepts any std::basic_string.
+    template <typename String> void append_to(String &dst) const;
+
+    template <typename String = std::string> String to_string() const;
+
+    std::string_view first() const noexcept;
+    std::string_view second() const noexcept;
+
+  private:
+    std::string_view m_first;
+    std::string_view m_second;
+};
+
+inline line_view::line_view(std::string_view first, std::string_view second) noexcept
+    : m_first(first), m_second(second)
+{
+    // Keep the invariant that the second segment is used only when the first one isn't empty.
+    if (m_first.empty())
+        std::swap(m_first, m_second);
+}
+
+inline size_t line_view::length() const noexcept
+{
+    return m_first.length() + m_second.length();
+}
+
+inline bool line_view::empty() const noexcept
+{
+    return m_first.empty();
+}
+
+inline char line_view::operator[](size_t pos) const noexcept
+{
+    return pos < m_first.length() ? m_first[pos] : m_second[pos - m_first.length()];
+}
+
+inline bool line_view::operator==(std::string_view s) const noexcept
+{
+    return length() == s.length() && contains_at(0, s);
+}
+
+inline bool line_view::operator!=(std::string_view s) const noexcept
+{
+    return !(*this == s);
+}
+
+inline bool line_view::starts_with(std::string_view s) const noexcept
+{
+    return contains_at(0, s);
+}
+
+inline bool line_view::contains_at(size_t pos, std::string_view s) const noexcept
+{
+    if (pos + s.length() > length())
+        return false;
+
+    // Compare the part which lies within the first segment and then the rest within the second one.
+    if (pos < m_first.length())
+    {
+        size_t in_first = std::min(m_first.length() - pos, s.length());
+        if (m_first.compare(pos, in_first, s.data(), in_first) != 0)
+            return false;
+        s.remove_prefix(in_first);
+        pos = 0;
+    }
+    else
+        pos -= m_first.length();
+
+    return s.empty() || m_second.compare(pos, s.length(), s) == 0;
+}
+
+inline void line_view::remove_prefix(size_t n) noexcept
+{
+    if (n < m_first.length())
+    {
+        m_first.remove_prefix(n);
+        return;
+    }
+
+    n -= m_first.length();
+    m_first = m_second.substr(n);
+    m_second = {};
+}
+
+inline line_view line_view::substr(size_t pos, size_t n) const noexcept
+{
+    if (pos >= m_first.length())
+        return {m_second.substr(pos - m_first.length(), n)};
+
+    auto in_first = std::min(m_first.length() - pos, n);
+    return {m_first.substr(pos, in_first), m_second.substr(0, n - in_first)};
+}
+
+template <typename String> void line_view::append_to(String &dst) const
+{
+    dst.append(m_first.data(), m_first.length());
+    dst.append(m_second.data(), m_second.length());
+}
+
+template <typename String> String line_view::to_string() const
+{
+    String s;
+    s.reserve(length());
+    append_to(s);
+    return s;
+}
+
+inline std::string_view line_view::first() const noexcept
+{
+    return m_first;
+}
+
+inline std::string_view line_view::second() const noexcept
+{
+    return m_second;
+}
+
+#endif /* LINE_VIEW_HPP */
@@ -0,0 +1,25 @@
+/**
+ * @file	os_flag.cpp
+ * @brief	Implementation of one-to-many RTOS flag.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "os_flag.hpp"
+
+//! The only bit of the event group used by the flag.
+static constexpr EventBits_t flag_bit = 1;
+
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+os_flag::os_flag() : event_group(xEventGroupCreateStatic(&event_group_memory)) {}
+#else
+os_flag::os_flag() : event_group(xEventGroupCreate()) {}
+#endif /* (configSUPPORT_STATIC_ALLOCATION == 1) */
+
+os_flag::~os_flag() { vEventGroupDelete(event_group); }
+
+void os_flag::wait_set() { xEventGroupWaitBits(event_group, flag_bit, pdFALSE, pdTRUE, portMAX_DELAY); }
+
+void os_flag::set() { xEventGroupSetBits(event_group, flag_bit); }
+
+void os_flag::reset() { xEventGroupClearBits(event_group, flag_bit); }
+
+bool os_flag::is_set() { return (xEventGroupGetBits(event_group) & flag_bit) != 0; }
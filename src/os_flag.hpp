@@ -14,7 +14,7 @@
  *
  * This flag will put a task to the blocked state when it is being awaited. It is thread-safe. Only one task is
  * allowed to call set() method.
- * The flag is reset by default.
+ * The flag is reset by default. The event group is held by the flag when configSUPPORT_STATIC_ALLOCATION is set.
  */
 class os_flag
 {
@@ -33,6 +33,9 @@ class os_flag
 	os_flag &operator=(os_flag &&) = delete;
 
   private:
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+	StaticEventGroup_t event_group_memory;
+#endif /* (configSUPPORT_STATIC_ALLOCATION == 1) */
 	EventGroupHandle_t event_group;
 };
 
@@ -7,101 +7,134 @@
 #define OS_QUEUE_HPP
 
 #include "FreeRTOS.h"
-#include "neither/neither.hpp"
-#include "os_lockguard.hpp"
 #include "semphr.h"
-#include <cassert>
-#include <stdexcept>
-#include <vector>
+#include "task.h"
+#include <cstddef>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
 
+/**
+ * \brief A FIFO queue of N elements of any type, held in place, in a ring.
+ *
+ * Unlike FreeRTOS Queue, the elements are moved in and out, not copied byte by byte, so the move-only and non-trivial
+ * types can be queued. Nothing is allocated besides the semaphore, which counts the queued elements, so the receivers
+ * may block on it. The indexes of the ring are updated within a critical section which lasts only for a single move
+ * of an element, so each operation takes the semaphore or gives it once, without any mutex.
+ *
+ * Any task may send and receive. T must be nothrow move constructible, as it's moved within the critical section.
+ */
 template <typename T, size_t N> class os_queue
 {
+    static_assert(N > 0, "The queue must have at least one element");
+    static_assert(std::is_nothrow_move_constructible_v<T>, "The elements are moved within a critical section");
+
   public:
     explicit os_queue();
 
+    //! Destroys the elements which are still queued.
     ~os_queue();
 
-    //! Returns true when the element has been sent correctly to the queue, false otherwise.
+    os_queue(const os_queue &) = delete;
+    os_queue &operator=(const os_queue &) = delete;
+
+    //! Returns true when the element has been sent correctly to the queue, false when the queue is full.
     template <typename... U> bool send(U &&... u);
 
-    //! Overwrites the element in the queue. Is only enabled when the queuen size is equal to one.
+    //! Overwrites the element in the queue. Is only enabled when the queue size is equal to one.
     template <size_t dim = N, class = typename std::enable_if_t<dim == 1>, typename... U> void overwrite(U &&... u);
 
-    //! Either returns an element from the queue or returns false when timeout occured while awaiting for an element.
-    neither::Either<T, bool> receive(TickType_t timeout);
+    //! Returns the oldest element, or nothing when the timeout occured while awaiting an element.
+    std::optional<T> receive(TickType_t timeout);
 
   private:
-    //! This vector contains elements of the queue. It's used to handle non-trivial types.
-    std::vector<T> m_queue;
-
-    //! Mutex which guards acces to the queue.
-    SemaphoreHandle_t m_mux;
+    //! The ring of the elements, which are constructed and destroyed in place.
+    alignas(T) unsigned char m_storage[N][sizeof(T)];
+    size_t m_head = 0;
+    size_t m_tail = 0;
+    size_t m_size = 0;
 
-    //! Counting semaphore used to count how many elements are in the queue.
+    //! Counts how many elements are in the queue.
     SemaphoreHandle_t m_queue_num_elems_sem;
+
+    T *slot(size_t idx) noexcept;
 };
 
 template <typename T, size_t N> os_queue<T, N>::os_queue()
 {
-    // The size is reserved once and the queue's capacity must not be changed any more.
-    m_queue.reserve(N);
-    m_mux = xSemaphoreCreateMutex();
     m_queue_num_elems_sem = xSemaphoreCreateCounting(N, 0);
 }
 
 template <typename T, size_t N> os_queue<T, N>::~os_queue()
 {
-    vSemaphoreDelete(m_mux);
+    for (; m_size != 0; --m_size, m_tail = (m_tail + 1) % N)
+        slot(m_tail)->~T();
     vSemaphoreDelete(m_queue_num_elems_sem);
 }
 
 template <typename T, size_t N> template <typename... U> bool os_queue<T, N>::send(U &&... u)
 {
-    bool is_full = false;
+    // The element is made outside of the critical section, as it may take long, e.g. when it allocates.
+    T t(std::forward<U>(u)...);
 
+    taskENTER_CRITICAL();
+    auto is_full = m_size == N;
+    if (!is_full)
     {
-        os_lockguard guard(m_mux);
-        if (m_queue.size() == N)
-            is_full = true;
-        else
-            m_queue.emplace_back(std::forward<U>(u)...);
+        new (slot(m_head)) T(std::move(t));
+        m_head = (m_head + 1) % N;
+        m_size++;
     }
+    taskEXIT_CRITICAL();
 
     if (!is_full)
-        assert(xSemaphoreGive(m_queue_num_elems_sem) == pdTRUE);
-
+        xSemaphoreGive(m_queue_num_elems_sem);
     return !is_full;
 }
 
 template <typename T, size_t N> template <size_t dim, class, typename... U> void os_queue<T, N>::overwrite(U &&... u)
 {
+    T t(std::forward<U>(u)...);
+
+    taskENTER_CRITICAL();
+    auto is_empty = m_size == 0;
+    if (is_empty)
+    {
+        new (slot(0)) T(std::move(t));
+        m_size = 1;
+    }
+    else
     {
-        os_lockguard guard(m_mux);
-        if (m_queue.size() == 0)
-        {
-            m_queue.emplace_back(std::forward<U>(u)...);
-        }
-        else
-        {
-            T t(std::forward<U>(u)...);
-            m_queue[0] = std::move(t);
-        }
+        // The old element is swapped into t, so it's destroyed outside of the critical section.
+        std::swap(*slot(0), t);
     }
-    xSemaphoreGive(m_queue_num_elems_sem);
+    taskEXIT_CRITICAL();
+
+    // The semaphore counts up to one, so it's given only for the element which has been placed in the empty queue.
+    if (is_empty)
+        xSemaphoreGive(m_queue_num_elems_sem);
 }
 
-template <typename T, size_t N> neither::Either<T, bool> os_queue<T, N>::receive(TickType_t timeout)
+template <typename T, size_t N> std::optional<T> os_queue<T, N>::receive(TickType_t timeout)
 {
     if (xSemaphoreTake(m_queue_num_elems_sem, timeout) == pdFALSE)
-        return neither::right(false);
-    else
-    {
-        os_lockguard guard(m_mux);
-        auto res = std::move(m_queue[m_queue.size() - 1]);
-        m_queue.pop_back();
-        return neither::left(static_cast<T>(res));
-    }
+        return std::nullopt;
+
+    std::optional<T> res;
+    taskENTER_CRITICAL();
+    auto s = slot(m_tail);
+    res.emplace(std::move(*s));
+    s->~T();
+    m_tail = (m_tail + 1) % N;
+    m_size--;
+    taskEXIT_CRITICAL();
+    return res;
 }
 
-#endif /* OS_QUEUE_HPP */
+template <typename T, size_t N> T *os_queue<T, N>::slot(size_t idx) noexcept
+{
+    return std::launder(reinterpret_cast<T *>(m_storage[idx]));
+}
 
+#endif /* OS_QUEUE_HPP */
@@ -0,0 +1,163 @@
+/**
+ * @file	request_queue.hpp
+ * @brief	Defines a fixed-capacity queue of requests which are stored in preallocated slots.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef REQUEST_QUEUE_HPP
+#define REQUEST_QUEUE_HPP
+
+#include <array>
+#include <cstddef>
+
+/**
+ * \brief A FIFO of requests which live in preallocated slots.
+ *
+ * A slot is acquired, filled in and pushed to the back of the queue. The slot stays at the same address until it is
+ * released, so the parties which wait for the completion of the request may refer to it directly. A request may be
+ * removed from any place of the queue, e.g. when its issuer doesn't want to wait for it anymore.
+ *
+ * The requests may be prioritised: a request pushed with a higher priority overtakes the queued ones with a lower
+ * priority. The front request is never overtaken, as it may be in progress already.
+ *
+ * This is not thread safe and doesn't allocate any memory.
+ */
+template <typename T, size_t N> class request_queue
+{
+  public:
+    //! Takes a free slot. Returns nullptr when all the slots are used.
+    T *acquire() noexcept;
+
+    //! Gives the slot back. The slot mustn't be within the queue.
+    void release(T *slot) noexcept;
+
+    //! Appends the acquired slot to the back of the queue.
+    void push_back(T *slot) noexcept;
+
+    /**
+     * Inserts the acquired slot behind all the queued requests with the same or a higher priority. A request is
+     * overtaken at most max_overtakes times, then it isn't overtaken anymore, so the requests with a low priority
+     * aren't starved.
+     */
+    void push(T *slot, unsigned priority, unsigned max_overtakes) noexcept;
+
+    //! Returns the oldest request or nullptr when the queue is empty.
+    T *front() noexcept;
+
+    void pop_front() noexcept;
+
+    //! Removes the request from the queue no matter where it is. Returns false when the request wasn't queued.
+    bool remove(T *slot) noexcept;
+
+    bool is_empty() const noexcept;
+
+    size_t size() const noexcept;
+
+    //! Gives access to all the slots, no matter whether they are used. Useful for initialisation of the slots.
+    std::array<T, N> &slots() noexcept;
+
+  private:
+    std::array<T, N> m_slots;
+
+    //! Tells which slots are acquired.
+    std::array<bool, N> m_is_used = {};
+
+    //! The queued slots in the order of the service.
+    std::array<T *, N> m_queue = {};
+
+    //! The priority of each queued slot and how many times it has been overtaken.
+    std::array<unsigned, N> m_priorities = {};
+    std::array<unsigned, N> m_overtakes = {};
+
+    size_t m_queue_len = 0;
+};
+
+template <typename T, size_t N> T *request_queue<T, N>::acquire() noexcept
+{
+    for (size_t i = 0; i < N; ++i)
+    {
+        if (!m_is_used[i])
+        {
+            m_is_used[i] = true;
+            return &m_slots[i];
+        }
+    }
+    return nullptr;
+}
+
+template <typename T, size_t N> void request_queue<T, N>::release(T *slot) noexcept
+{
+    m_is_used[slot - m_slots.data()] = false;
+}
+
+template <typename T, size_t N> void request_queue<T, N>::push_back(T *slot) noexcept
+{
+    push(slot, 0, 0);
+}
+
+template <typename T, size_t N>
+void request_queue<T, N>::push(T *slot, unsigned priority, unsigned max_overtakes) noexcept
+{
+    // There are only N slots so the queue can't overflow.
+    auto pos = m_queue_len;
+    while (pos > 1 && m_priorities[pos - 1] < priority && m_overtakes[pos - 1] < max_overtakes)
+        --pos;
+
+    for (auto i = m_queue_len; i > pos; --i)
+    {
+        m_queue[i] = m_queue[i - 1];
+        m_priorities[i] = m_priorities[i - 1];
+        m_overtakes[i] = m_overtakes[i - 1] + 1;
+    }
+    m_queue[pos] = slot;
+    m_priorities[pos] = priority;
+    m_overtakes[pos] = 0;
+    m_queue_len++;
+}
+
+template <typename T, size_t N> T *request_queue<T, N>::front() noexcept
+{
+    return is_empty() ? nullptr : m_queue[0];
+}
+
+template <typename T, size_t N> void request_queue<T, N>::pop_front() noexcept
+{
+    remove(front());
+}
+
+template <typename T, size_t N> bool request_queue<T, N>::remove(T *slot) noexcept
+{
+    // The queue is short so shifting the pointers is cheaper than maintaining a linked list.
+    for (size_t i = 0; i < m_queue_len; ++i)
+    {
+        if (m_queue[i] == slot)
+        {
+            for (size_t j = i + 1; j < m_queue_len; ++j)
+            {
+                m_queue[j - 1] = m_queue[j];
+                m_priorities[j - 1] = m_priorities[j];
+                m_overtakes[j - 1] = m_overtakes[j];
+            }
+            m_queue_len--;
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T, size_t N> bool request_queue<T, N>::is_empty() const noexcept
+{
+    return m_queue_len == 0;
+}
+
+template <typename T, size_t N> size_t request_queue<T, N>::size() const noexcept
+{
+    return m_queue_len;
+}
+
+template <typename T, size_t N> std::array<T, N> &request_queue<T, N>::slots() noexcept
+{
+    return m_slots;
+}
+
+#endif /* REQUEST_QUEUE_HPP */
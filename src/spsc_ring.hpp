@@ -0,0 +1,167 @@
+/**
+ * @file	spsc_ring.hpp
+ * @brief	Defines a lock-free ring buffer for a single producer and a single consumer.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include "cyclic_buf.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+#ifndef AT_CMD_HANDLER_CACHE_LINE_SIZE
+#define AT_CMD_HANDLER_CACHE_LINE_SIZE 64
+#endif /* AT_CMD_HANDLER_CACHE_LINE_SIZE */
+
+/**
+ * \brief A ring buffer shared between a single producer (e.g. an ISR) and a single consumer (e.g. a task).
+ *
+ * The producer stages the elements first, what makes them invisible to the consumer, and then publishes all the
+ * staged elements at once with a single store-release of the head index. The consumer loads the head index with
+ * acquire ordering, so it sees all the elements published before. Releasing the elements by the consumer works the
+ * same way in the other direction, with the tail index. Thus no lock nor critical section is needed.
+ *
+ * The indexes are placed on separate cache lines, so the producer and the consumer don't invalidate each other's
+ * cache lines when updating their own index.
+ *
+ * One element is always unused, to distinguish the full buffer from the empty one. The size must be a power of two.
+ */
+template <typename T, size_t N> class spsc_ring
+{
+    static_assert(is_power_of_two(N) && N > 1, "The size of the ring must be a power of two");
+    static_assert(std::atomic<unsigned>::is_always_lock_free, "The indexes must be lock-free");
+
+  public:
+    // ----------------------------------------------------------------------------------------------------------------
+    // The producer side
+    // ----------------------------------------------------------------------------------------------------------------
+    //! The number of the elements which can be staged yet.
+    size_t free_space() const noexcept;
+
+    //! Writes the elements after the staged ones. The elements must fit into free_space().
+    void stage(const T *p, size_t n) noexcept;
+
+    //! The index where the next staged element will be placed.
+    unsigned staged_head() const noexcept;
+
+    //! Withdraws the staged elements from the index to the staged head. The index mustn't precede the published head.
+    void unstage_to(unsigned idx) noexcept;
+
+    //! Makes all the staged elements visible to the consumer.
+    void publish() noexcept;
+
+    // ----------------------------------------------------------------------------------------------------------------
+    // The consumer side
+    // ----------------------------------------------------------------------------------------------------------------
+    bool is_empty() const noexcept;
+
+    //! The index of the oldest element.
+    unsigned tail() const noexcept;
+
+    //! The oldest element. The ring mustn't be empty.
+    const T &front() const noexcept;
+
+    //! Gives a direct access to the elements, e.g. to refer to them without copying.
+    const T *data() const noexcept;
+
+    //! Releases the oldest element. The ring mustn't be empty.
+    void pop_front() noexcept;
+
+    //! Releases the elements up to the index, which must lie between the tail and the published head.
+    void release_to(unsigned idx) noexcept;
+
+  private:
+    static constexpr unsigned mask = N - 1;
+
+    //! Written by the producer only.
+    alignas(AT_CMD_HANDLER_CACHE_LINE_SIZE) std::atomic<unsigned> m_head{0};
+
+    //! Accessed by the producer only, so it can share the cache line with the head.
+    unsigned m_staged_head = 0;
+
+    //! Written by the consumer only.
+    alignas(AT_CMD_HANDLER_CACHE_LINE_SIZE) std::atomic<unsigned> m_tail{0};
+
+    alignas(AT_CMD_HANDLER_CACHE_LINE_SIZE) T m_buf[N];
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE PRODUCER SIDE
+// --------------------------------------------------------------------------------------------------------------------
+template <typename T, size_t N> size_t spsc_ring<T, N>::free_space() const noexcept
+{
+    // The consumer mustn't have been reading the released elements anymore, when they are overwritten.
+    auto t = m_tail.load(std::memory_order_acquire);
+    return mask - ((m_staged_head - t) & mask);
+}
+
+template <typename T, size_t N> void spsc_ring<T, N>::stage(const T *p, size_t n) noexcept
+{
+    if (n == 0)
+        return;
+
+    // When the elements wrap around the end of the buffer, then they are copied in two parts.
+    size_t size_to_end = N - m_staged_head;
+    if (size_to_end < n)
+    {
+        std::copy(p, p + size_to_end, m_buf + m_staged_head);
+        std::copy(p + size_to_end, p + n, m_buf);
+    }
+    else
+        std::copy(p, p + n, m_buf + m_staged_head);
+
+    m_staged_head = (m_staged_head + n) & mask;
+}
+
+template <typename T, size_t N> unsigned spsc_ring<T, N>::staged_head() const noexcept
+{
+    return m_staged_head;
+}
+
+template <typename T, size_t N> void spsc_ring<T, N>::unstage_to(unsigned idx) noexcept
+{
+    m_staged_head = idx;
+}
+
+template <typename T, size_t N> void spsc_ring<T, N>::publish() noexcept
+{
+    m_head.store(m_staged_head, std::memory_order_release);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE CONSUMER SIDE
+// --------------------------------------------------------------------------------------------------------------------
+template <typename T, size_t N> bool spsc_ring<T, N>::is_empty() const noexcept
+{
+    return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_relaxed);
+}
+
+template <typename T, size_t N> unsigned spsc_ring<T, N>::tail() const noexcept
+{
+    return m_tail.load(std::memory_order_relaxed);
+}
+
+template <typename T, size_t N> const T &spsc_ring<T, N>::front() const noexcept
+{
+    return m_buf[tail()];
+}
+
+template <typename T, size_t N> const T *spsc_ring<T, N>::data() const noexcept
+{
+    return m_buf;
+}
+
+template <typename T, size_t N> void spsc_ring<T, N>::pop_front() noexcept
+{
+    release_to((tail() + 1) & mask);
+}
+
+template <typename T, size_t N> void spsc_ring<T, N>::release_to(unsigned idx) noexcept
+{
+    m_tail.store(idx, std::memory_order_release);
+}
+
+#endif /* SPSC_RING_HPP */
@@ -7,13 +7,16 @@
 #ifndef STRING_BUF_RX_HPP
 #define STRING_BUF_RX_HPP
 
-#include "cyclic_buf.hpp"
+#include "char_scan.hpp"
+#include "line_view.hpp"
+#include "spsc_ring.hpp"
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
-
-//! Calculates the length of span between two indexes in the cyclic buffer.
-static inline unsigned calc_len_in_circular_buffer(unsigned beg_idx, unsigned end_idx, unsigned cyclic_buf_size);
+#include <string_view>
 
 /**
  * \brief Push a single byte to it and pop whole strings. Useful when receiving messages using interrupts.
@@ -24,121 +27,726 @@ static inline unsigned calc_len_in_circular_buffer(unsigned beg_idx, unsigned en
  * The typical usage is that: push single bytes to it (e.g. on an interrupt on byte received), pop a command when
  * a whole command has been received.
  *
+ * At most MaxStringsNum - 1 strings can be held at once. When there is no space for a string, either for its
+ * characters or for its index, then the whole string is dropped and the buffer resynchronises at the next string
+ * terminator. So the strings are never split nor merged on overflow. The dropped strings are counted.
+ *
+ * The pushing side (the producer, e.g. an ISR) and the popping side (the consumer, e.g. a task) don't need any lock,
+ * as both buffers are single-producer single-consumer rings. A terminated string becomes visible to the consumer when
+ * it's published; a chunk of bytes is published once, no matter how many strings it terminates.
+ *
+ * Raw binary data, which follows a header with its length (e.g. "+QIRD: 1460"), may be received in the binary mode
+ * (\see arm_binary_mode()). The header is recognised by the producer, so no byte of the data is scanned for the
+ * terminators, even when the data comes right after the header.
+ *
+ * The ExceptionalChars are treated as whole strings even when a string terminator hasn't arrived, when they are
+ * received alone. E.g. pass '>' to treat a single '>' as a full string. It is allowed to pass various characters.
+ *
+ * The producer looks at each byte anyway, so it records the position of the first colon of each string along with its
+ * end (\see peek_colon_pos()), what spares the consumer from scanning the string for it again. The strings which the
+ * consumer would ignore anyway (e.g. the echoes of the commands) may be discarded by the producer, before they are
+ * published (\see discard_strings_starting_with()). The echo of the transmitted characters may be matched as it arrives
+ * and discarded the same way (\see expect_echo()).
+ *
  * \todo	Make the cyclic buffers resizeable.
- * \todo	Keep track of the commands on overflow, because when an overflow in one of the buffers occurs the data
- *	        between the buffers is inconsistent: the indexes to the end of the buffers may not properlypoint
- *              to the real ends of commands.
- * \todo	Implement pushing multiple elements.
  */
-template <size_t ImmediateBufferSize> class string_buf_rx
+template <size_t ImmediateBufferSize, size_t MaxStringsNum = 16, char... ExceptionalChars> class string_buf_rx
 {
   public:
-    /**
-     * Takes string which contains exceptional characters which should be treated as a whole strings even when a
-     * string terminator hasn't arrived. E.g. when you want to treat single '>' as a full string then pass it
-     * in the argument. It is allowed to treat various characters in this manner.
-     */
-    string_buf_rx(std::string exceptional_chars = "");
-
     /**
      * Push a byte and check whether the byte terminates the string.
      * By default the string terminators are: CR, LF and '\0'
      */
     bool push_byte_and_is_string_end(char c);
 
+    /**
+     * Push a chunk of bytes (e.g. a DMA half-buffer or an idle-line chunk) and return how many strings have been
+     * terminated within it. The chunk is scanned once and the bytes between the terminators are copied in bulk.
+     */
+    unsigned push_bytes_and_count_string_ends(const char *bytes, size_t num);
+
     //! Pop a whole string. When there is no string this returns an empty string.
     std::unique_ptr<std::string> pop_string();
 
+    /**
+     * \brief Get a view over the oldest string without copying it out of the buffer.
+     *
+     * When the string wraps around the end of the buffer, then the view consists of two segments. The space occupied
+     * by the string is released only after calling release_string(), so the view is valid until then. When there is
+     * no string this returns an empty view.
+     */
+    line_view peek_string() const;
+
+    /**
+     * The position of the first colon within the oldest string, as recorded by the producer, or the length of the
+     * string when it doesn't contain any colon.
+     */
+    size_t peek_colon_pos() const;
+
+    //! Releases the space occupied by the string obtained with peek_string().
+    void release_string();
+
+    /**
+     * Makes the producer discard the strings which start with the prefix, instead of publishing them, e.g. "AT" to
+     * discard the echoes of the commands. An empty prefix discards nothing. The prefix must be valid as long as the
+     * buffer is used. Called before the producer starts.
+     */
+    void discard_strings_starting_with(std::string_view prefix);
+
+    /**
+     * \brief Makes the producer discard the next string which is the concatenation of the segments, e.g. the echo of
+     *        the command which is being transmitted, instead of publishing it.
+     *
+     * The characters are matched as they are pushed, so the string isn't scanned once more at its terminator. The
+     * strings which don't match (e.g. an unsolicited command received before the echo) are published as usual and the
+     * echo is still expected. Passing no segments stops expecting the echo. The segments must be valid until then or
+     * until the echo has arrived. Must be called while the producer can't run, e.g. within a critical section, or by
+     * the producer itself.
+     */
+    void expect_echo(std::string_view first = {}, std::string_view second = {}, std::string_view third = {});
+
+    //! The number of the echoes discarded (\see expect_echo()).
+    unsigned get_num_discarded_echoes() const;
+
     bool is_empty();
 
+    //! The number of the strings dropped, because there was no space for their characters.
+    unsigned get_num_dropped_on_buffer_overflow() const;
+
+    //! The number of the strings dropped, because MaxStringsNum - 1 strings were already held.
+    unsigned get_num_dropped_on_strings_overflow() const;
+
+    //! The most characters which have been held at once, including the ones of the string being received.
+    unsigned get_peak_num_chars() const;
+
+    /**
+     * The number of the characters held, including the ones of the string being received. Called by the producer or
+     * while the producer can't run, e.g. within a critical section.
+     */
+    unsigned get_num_chars() const;
+
+    /**
+     * \brief Make the next string which starts with the header switch the buffer into the binary mode.
+     *
+     * The header shall be followed by an optional colon and space and by the decimal number of the bytes, e.g.
+     * "+QIRD" for "+QIRD: 1460,..." or "CONNECT" for "CONNECT 1024". The string itself is pushed as usual. Then exactly
+     * that number of bytes is copied to dst, without looking for the terminators, and the buffer returns to the
+     * normal mode. The LF which follows the CR terminating the header is skipped. The bytes which don't fit into
+     * capacity are discarded. The header must be valid until disarm_binary_mode() is called.
+     *
+     * Called by the consumer, when the mode is disarmed.
+     */
+    void arm_binary_mode(std::string_view header, char *dst, size_t capacity);
+
+    /**
+     * Stops copying of the binary data to the buffer given to arm_binary_mode() and returns the number of the bytes
+     * copied. The rest of the binary data, if still awaited, is discarded. Must be called while the producer can't
+     * run, e.g. within a critical section.
+     */
+    size_t disarm_binary_mode();
+
+    /**
+     * Tells whether an exceptional character has been received alone since the previous call, e.g. to react to
+     * a prompt right away. Called by the producer, after pushing.
+     */
+    bool take_exceptional_string();
+
+    /**
+     * Drops the string being received, if any, along with its characters which arrive up to the terminator, e.g.
+     * the rest of the response of a withdrawn command. Must be called while the producer can't run, e.g. within
+     * a critical section.
+     */
+    void discard_current_string();
+
   private:
-    //! The default size of the buffer where the indexes with commands' ends are held.
-    static constexpr size_t ends_indexes_cb_def_size = 16;
+    //! The metadata of a string, which the producer gathers as the characters arrive.
+    struct string_end
+    {
+        unsigned end_idx;
 
-    //! This is a helper object which holds the indexes of the commands' ends. @todo Allocator pvPortMalloc
-    cyclic_buf<unsigned int, ends_indexes_cb_def_size> m_end_indexes_cb;
+        //! The offset of the first colon from the beginning of the string, no_colon when there is none.
+        unsigned colon_pos;
+    };
 
-    //! The cyclic buffer where the commands are held.
-    cyclic_buf<char, ImmediateBufferSize> m_cb;
+    static constexpr unsigned no_colon = ~0u;
 
-    //! Contains the exceptional characters which should be treated as whole strings.
-    const std::string m_exceptional_chars;
+    //! This is a helper object which holds the indexes of the commands' ends.
+    spsc_ring<string_end, MaxStringsNum> m_end_indexes;
+
+    //! The ring where the characters of the commands are held.
+    spsc_ring<char, ImmediateBufferSize> m_chars;
 
     //! Last head index in the immediate buffer.
     unsigned m_last_end_idx = 0;
+
+    //! Set when the current string has been dropped. The following characters are skipped up to the terminator.
+    bool m_is_dropping = false;
+
+    //! Set when an exceptional character has been closed as a string. Owned by the producer.
+    bool m_is_exceptional_closed = false;
+
+    //! The offset of the first colon within the current string. Owned by the producer.
+    unsigned m_colon_pos = no_colon;
+
+    std::string_view m_discarded_prefix;
+
+    //! The non-empty segments of the expected echo and the position up to which the current string has matched them.
+    std::array<std::string_view, 3> m_echo_segments;
+    size_t m_echo_segments_num = 0;
+    size_t m_echo_segment_idx = 0;
+    size_t m_echo_offset = 0;
+    bool m_is_echo_mismatched = false;
+
+    std::atomic<unsigned> m_num_discarded_echoes{0};
+
+    std::atomic<unsigned> m_num_dropped_on_buffer_overflow{0};
+    std::atomic<unsigned> m_num_dropped_on_strings_overflow{0};
+    std::atomic<unsigned> m_peak_num_chars{0};
+
+    //! Set by the consumer after the fields of the armed binary mode are written; cleared when the header is matched.
+    std::atomic<bool> m_is_binary_armed{false};
+    std::string_view m_armed_binary_header;
+    char *m_armed_binary_dst = nullptr;
+    size_t m_armed_binary_capacity = 0;
+
+    //! The binary data being received, owned by the producer.
+    char *m_binary_dst = nullptr;
+    size_t m_binary_capacity = 0;
+    size_t m_binary_stored = 0;
+    size_t m_binary_remaining = 0;
+    bool m_is_binary_skipping_lf = false;
+
+    static constexpr uint8_t char_class_terminator = 1 << 0;
+    static constexpr uint8_t char_class_exceptional = 1 << 1;
+    static constexpr uint8_t char_class_colon = 1 << 2;
+
+    static constexpr std::array<uint8_t, 256> make_char_classes();
+
+    //! The classes of all the characters, built at compile time, so classifying a received byte is a single load.
+    static const std::array<uint8_t, 256> char_classes;
+
+    static uint8_t get_char_class(char c);
+
+    //! Tells whether no character of the current string has been received yet.
+    bool is_at_string_beginning() const;
+
+    //! Records the colon which is about to be placed at the offset from the staged characters of the current string.
+    void note_colon(unsigned offset);
+
+    //! Matches the characters of the current string, which are being pushed, against the expected echo.
+    void match_echo(const char *chars, unsigned num);
+
+    //! Tells whether the whole current string is the expected echo. Starts matching anew for the next string.
+    bool take_echo_match();
+
+    //! Appends the characters to the current string or drops the whole string when there is no space for them.
+    void push_to_current_string(const char *chars, unsigned num);
+
+    /**
+     * Marks the end of the current string. Returns false when the string is empty and nothing has been marked.
+     * The terminator is '\0' when the string is terminated by an exceptional character.
+     */
+    bool close_string(char terminator = '\0');
+
+    line_view view_of_chars(unsigned beg, unsigned end) const;
+
+    //! Enters the binary mode when the string is the armed header.
+    void match_binary_header(const line_view &str, char terminator);
+
+    bool is_in_binary_mode() const;
+
+    //! Takes the bytes of the binary data from the beginning of the chunk. Returns the number of the bytes taken.
+    size_t consume_binary(const char *bytes, size_t num);
+
+    //! Makes the closed strings visible to the consumer.
+    void publish();
+
+    //! Only the producer increments the counters, so no atomic read-modify-write is needed, which e.g. ARMv6-M lacks.
+    static void increment_counter(std::atomic<unsigned> &counter);
+
+    //! Withdraws the characters of the current string. The producer owns them, as they aren't published yet.
+    void drop_current_string();
 };
 
-template <size_t ImmediateBufferSize>
-string_buf_rx<ImmediateBufferSize>::string_buf_rx(std::string exceptional_chars)
-    : m_exceptional_chars(exceptional_chars)
-{
-}
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+constexpr std::array<uint8_t, 256> string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::char_classes{
+    make_char_classes()};
 
-template <size_t ImmediateBufferSize> bool string_buf_rx<ImmediateBufferSize>::push_byte_and_is_string_end(char c)
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+bool string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::push_byte_and_is_string_end(char c)
 {
+    if (is_in_binary_mode())
+    {
+        consume_binary(&c, 1);
+        return false;
+    }
+
+    auto cls = get_char_class(c);
+
+    if (cls & char_class_colon)
+        note_colon(0);
+
     // Treat the carriage return, line feed or null terminating character as the end of command.
-    if (c == '\n' || c == '\r' || c == '\0')
+    if (cls & char_class_terminator)
     {
-        // When received a command of length 0 then do nothing.
-        if (m_last_end_idx == m_cb.head)
+        if (!close_string(c))
             return false;
-        else
-        {
-            m_end_indexes_cb.push_elem(m_cb.head);
-            m_last_end_idx = m_cb.head;
-            return true;
-        }
+        publish();
+        return true;
     }
 
     // After receiving the exceptional character:
-    if (m_exceptional_chars.find(c) != std::string::npos)
+    if (cls & char_class_exceptional)
     {
         // Exceptional characters work only when they are received alone.
-        if (m_last_end_idx == m_cb.head)
+        if (is_at_string_beginning())
         {
-            m_cb.push_elem(c);
-            m_end_indexes_cb.push_elem(m_cb.head);
-            m_last_end_idx = m_cb.head;
+            push_to_current_string(&c, 1);
+            if (!close_string())
+                return false;
+            m_is_exceptional_closed = true;
+            publish();
             return true;
         }
     }
 
     // Push any other character to the buffer.
-    m_cb.push_elem(c);
+    push_to_current_string(&c, 1);
 
     return false;
 }
 
-template <size_t ImmediateBufferSize> std::unique_ptr<std::string> string_buf_rx<ImmediateBufferSize>::pop_string()
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+unsigned
+string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::push_bytes_and_count_string_ends(
+    const char *bytes, size_t num)
+{
+    unsigned string_ends = 0;
+
+    // The bytes between the terminators are not pushed one by one, but the whole run is copied at once when
+    // a terminator is found or when the chunk ends.
+    const char *it = bytes;
+    const char *const end = bytes + num;
+    if (is_in_binary_mode())
+        it += consume_binary(bytes, num);
+    const char *run_beg = it;
+    // Most of the bytes are neither terminators, nor exceptional characters, nor colons, so they are skipped many at
+    // a time.
+    for (; (it = char_scan<'\n', '\r', '\0', ':', ExceptionalChars...>(it, end)) != end; ++it)
+    {
+        const char c = *it;
+        auto cls = get_char_class(c);
+
+        if (cls & char_class_colon)
+        {
+            note_colon(it - run_beg);
+            if (cls == char_class_colon)
+                continue;
+        }
+
+        if (cls & char_class_terminator)
+        {
+            push_to_current_string(run_beg, it - run_beg);
+            if (close_string(c))
+                string_ends++;
+            // The binary data may follow the header within the same chunk.
+            if (is_in_binary_mode())
+                it += consume_binary(it + 1, end - it - 1);
+            run_beg = it + 1;
+        }
+        // Exceptional characters work only when they are received alone, so nor the pending run, neither the
+        // buffer may contain any character of the current string.
+        else if (it == run_beg && is_at_string_beginning())
+        {
+            push_to_current_string(it, 1);
+            run_beg = it + 1;
+            if (close_string())
+            {
+                m_is_exceptional_closed = true;
+                string_ends++;
+            }
+        }
+    }
+    push_to_current_string(run_beg, end - run_beg);
+
+    if (string_ends > 0)
+        publish();
+
+    return string_ends;
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+std::unique_ptr<std::string> string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::pop_string()
+{
+    auto s = std::make_unique<std::string>(peek_string().to_string());
+    release_string();
+    return s;
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+line_view string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::peek_string() const
+{
+    if (m_end_indexes.is_empty())
+        return {};
+
+    // The producer doesn't touch the space between the tail and the end of the oldest string until the string is
+    // released.
+    return view_of_chars(m_chars.tail(), m_end_indexes.front().end_idx);
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+size_t string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::peek_colon_pos() const
+{
+    if (m_end_indexes.is_empty())
+        return 0;
+
+    auto &end = m_end_indexes.front();
+    if (end.colon_pos != no_colon)
+        return end.colon_pos;
+    auto beg = m_chars.tail();
+    return end.end_idx >= beg ? end.end_idx - beg : ImmediateBufferSize - beg + end.end_idx;
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+void string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::release_string()
 {
-    // Firstly check whether there are lines in the buffer. If not then return immediately.
     if (is_empty())
-        return std::make_unique<std::string>("");
+        return;
+
+    m_chars.release_to(m_end_indexes.front().end_idx);
+    m_end_indexes.pop_front();
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+void string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::discard_strings_starting_with(
+    std::string_view prefix)
+{
+    m_discarded_prefix = prefix;
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+bool string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::is_empty()
+{
+    return m_end_indexes.is_empty();
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+unsigned
+string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::get_num_dropped_on_buffer_overflow() const
+{
+    return m_num_dropped_on_buffer_overflow;
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+unsigned
+string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::get_num_dropped_on_strings_overflow() const
+{
+    return m_num_dropped_on_strings_overflow;
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+unsigned string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::get_peak_num_chars() const
+{
+    return m_peak_num_chars.load(std::memory_order_relaxed);
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+unsigned string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::get_num_chars() const
+{
+    return static_cast<unsigned>(ImmediateBufferSize - 1 - m_chars.free_space());
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+void string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::arm_binary_mode(std::string_view header,
+                                                                                             char *dst,
+                                                                                             size_t capacity)
+{
+    m_armed_binary_header = header;
+    m_armed_binary_dst = dst;
+    m_armed_binary_capacity = capacity;
+    // The producer reads the fields only after it has seen the flag set.
+    m_is_binary_armed.store(true, std::memory_order_release);
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+void string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::expect_echo(std::string_view first,
+                                                                                         std::string_view second,
+                                                                                         std::string_view third)
+{
+    m_echo_segments_num = 0;
+    for (auto segment : {first, second, third})
+        if (!segment.empty())
+            m_echo_segments[m_echo_segments_num++] = segment;
+    m_echo_segment_idx = 0;
+    m_echo_offset = 0;
+    // The current string has begun before the echo has been expected, so it can't be the echo anymore.
+    m_is_echo_mismatched = !is_at_string_beginning();
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+unsigned string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::get_num_discarded_echoes() const
+{
+    return m_num_discarded_echoes;
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+size_t string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::disarm_binary_mode()
+{
+    m_is_binary_armed.store(false, std::memory_order_relaxed);
+    auto stored = m_binary_stored;
+    m_binary_dst = nullptr;
+    m_binary_stored = 0;
+    return stored;
+}
 
-    auto beg = m_cb.tail;
-    auto end = m_end_indexes_cb.pop_elem();
-    unsigned int len = calc_len_in_circular_buffer(beg, end, ImmediateBufferSize);
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+bool string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::take_exceptional_string()
+{
+    auto is_closed = m_is_exceptional_closed;
+    m_is_exceptional_closed = false;
+    return is_closed;
+}
 
-    // Get the string to be returned.
-    std::string s(len, '\0');
-    m_cb.pop_nelems(&s.front(), len);
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+void string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::discard_current_string()
+{
+    if (!is_at_string_beginning())
+        drop_current_string();
+}
 
-    return std::make_unique<std::string>(std::move(s));
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+constexpr std::array<uint8_t, 256>
+string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::make_char_classes()
+{
+    std::array<uint8_t, 256> classes{};
+    for (unsigned char c : {'\n', '\r', '\0'})
+        classes[c] |= char_class_terminator;
+    classes[static_cast<unsigned char>(':')] |= char_class_colon;
+    ((classes[static_cast<unsigned char>(ExceptionalChars)] |= char_class_exceptional), ...);
+    return classes;
 }
 
-template <size_t ImmediateBufferSize> bool string_buf_rx<ImmediateBufferSize>::is_empty()
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+uint8_t string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::get_char_class(char c)
 {
-    return m_end_indexes_cb.is_empty();
+    return char_classes[static_cast<unsigned char>(c)];
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+bool string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::close_string(char terminator)
+{
+    string_end end{m_chars.staged_head(), m_colon_pos};
+    m_colon_pos = no_colon;
+
+    // The terminator of the dropped string resynchronises the buffer.
+    if (m_is_dropping)
+    {
+        m_is_dropping = false;
+        take_echo_match();
+        return false;
+    }
+
+    // When received a command of length 0 then do nothing.
+    if (m_last_end_idx == end.end_idx)
+        return false;
+
+    auto is_echo = take_echo_match();
+    auto str = view_of_chars(m_last_end_idx, end.end_idx);
+    if (is_echo || (!m_discarded_prefix.empty() && str.starts_with(m_discarded_prefix)))
+    {
+        if (is_echo)
+            increment_counter(m_num_discarded_echoes);
+        m_chars.unstage_to(m_last_end_idx);
+        return false;
+    }
+
+    if (m_end_indexes.free_space() == 0)
+    {
+        increment_counter(m_num_dropped_on_strings_overflow);
+        drop_current_string();
+        m_is_dropping = false;
+        return false;
+    }
+
+    m_end_indexes.stage(&end, 1);
+    if (m_is_binary_armed.load(std::memory_order_acquire))
+        match_binary_header(str, terminator);
+    m_last_end_idx = end.end_idx;
+    return true;
 }
 
-static inline unsigned calc_len_in_circular_buffer(unsigned beg_idx, unsigned end_idx, unsigned cyclic_buf_size)
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+line_view
+string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::view_of_chars(unsigned beg, unsigned end) const
 {
-    unsigned int len;
-    // Check whether there will be a swing.
-    if (beg_idx > end_idx)
-        len = cyclic_buf_size - beg_idx + end_idx;
+    auto data = m_chars.data();
+    if (beg > end)
+        return {{data + beg, ImmediateBufferSize - beg}, {data, end}};
     else
-        len = end_idx - beg_idx;
-    return len;
+        return {{data + beg, end - beg}};
 }
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+void string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::match_binary_header(const line_view &str,
+                                                                                                 char terminator)
+{
+    if (!str.starts_with(m_armed_binary_header))
+        return;
+
+    auto pos = m_armed_binary_header.length();
+    if (pos < str.length() && str[pos] == ':')
+        ++pos;
+    if (pos < str.length() && str[pos] == ' ')
+        ++pos;
+    auto digits_beg = pos;
+    size_t len = 0;
+    for (; pos < str.length() && str[pos] >= '0' && str[pos] <= '9'; ++pos)
+        len = len * 10 + (str[pos] - '0');
+    if (pos == digits_beg)
+        return;
+
+    m_is_binary_armed.store(false, std::memory_order_relaxed);
+    m_binary_dst = m_armed_binary_dst;
+    m_binary_capacity = m_armed_binary_capacity;
+    m_binary_stored = 0;
+    m_binary_remaining = len;
+    m_is_binary_skipping_lf = terminator == '\r';
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+bool string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::is_in_binary_mode() const
+{
+    return m_binary_remaining > 0;
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+size_t
+string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::consume_binary(const char *bytes, size_t num)
+{
+    size_t skipped = 0;
+    if (m_is_binary_skipping_lf && num > 0)
+    {
+        m_is_binary_skipping_lf = false;
+        if (bytes[0] == '\n')
+            skipped = 1;
+    }
+
+    auto len = std::min(num - skipped, m_binary_remaining);
+    if (m_binary_dst)
+    {
+        auto len_to_store = std::min(len, m_binary_capacity - m_binary_stored);
+        std::copy(bytes + skipped, bytes + skipped + len_to_store, m_binary_dst + m_binary_stored);
+        m_binary_stored += len_to_store;
+    }
+    m_binary_remaining -= len;
+    return skipped + len;
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+void string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::publish()
+{
+    // The characters are published before the indexes, so the consumer never sees an index to unpublished characters.
+    m_chars.publish();
+    m_end_indexes.publish();
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+void
+string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::increment_counter(
+    std::atomic<unsigned> &counter)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+bool string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::is_at_string_beginning() const
+{
+    return !m_is_dropping && m_last_end_idx == m_chars.staged_head();
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+void string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::note_colon(unsigned offset)
+{
+    if (m_colon_pos == no_colon && !m_is_dropping)
+        m_colon_pos = ((m_chars.staged_head() - m_last_end_idx) & (ImmediateBufferSize - 1)) + offset;
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+void string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::push_to_current_string(const char *chars,
+                                                                                                    unsigned num)
+{
+    if (m_is_dropping || num == 0)
+        return;
+
+    auto free_space = m_chars.free_space();
+    if (num > free_space)
+    {
+        increment_counter(m_num_dropped_on_buffer_overflow);
+        drop_current_string();
+        return;
+    }
+
+    if (m_echo_segments_num != 0)
+        match_echo(chars, num);
+    m_chars.stage(chars, num);
+
+    // Only the producer updates the peak, so it's a plain load and store.
+    auto num_chars = static_cast<unsigned>(ImmediateBufferSize - 1 - free_space + num);
+    if (num_chars > m_peak_num_chars.load(std::memory_order_relaxed))
+        m_peak_num_chars.store(num_chars, std::memory_order_relaxed);
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+void string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::match_echo(const char *chars,
+                                                                                        unsigned num)
+{
+    while (num > 0 && !m_is_echo_mismatched)
+    {
+        // The characters which come after the whole echo make the string longer than the echo.
+        if (m_echo_segment_idx == m_echo_segments_num)
+        {
+            m_is_echo_mismatched = true;
+            return;
+        }
+
+        auto expected = m_echo_segments[m_echo_segment_idx].substr(m_echo_offset);
+        auto n = std::min<size_t>(num, expected.length());
+        m_is_echo_mismatched = expected.compare(0, n, chars, n) != 0;
+        chars += n;
+        num -= n;
+        m_echo_offset += n;
+        if (m_echo_offset == m_echo_segments[m_echo_segment_idx].length())
+        {
+            m_echo_segment_idx++;
+            m_echo_offset = 0;
+        }
+    }
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+bool string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::take_echo_match()
+{
+    if (m_echo_segments_num == 0)
+        return false;
+
+    auto is_match = !m_is_echo_mismatched && m_echo_segment_idx == m_echo_segments_num;
+    // The echo is discarded once; otherwise it's still expected, from the beginning of the next string.
+    if (is_match)
+        m_echo_segments_num = 0;
+    m_echo_segment_idx = 0;
+    m_echo_offset = 0;
+    m_is_echo_mismatched = false;
+    return is_match;
+}
+
+template <size_t ImmediateBufferSize, size_t MaxStringsNum, char... ExceptionalChars>
+void string_buf_rx<ImmediateBufferSize, MaxStringsNum, ExceptionalChars...>::drop_current_string()
+{
+    m_chars.unstage_to(m_last_end_idx);
+    m_is_dropping = true;
+    m_colon_pos = no_colon;
+    // The rest of the dropped string isn't matched, so it can't be taken for the echo.
+    m_is_echo_mismatched = true;
+}
+
 #endif /* STRING_BUF_RX_HPP */
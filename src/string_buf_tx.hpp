@@ -7,40 +7,190 @@
 #ifndef STRING_BUF_TX_HPP
 #define STRING_BUF_TX_HPP
 
-#include <list>
-#include <memory>
+#include <array>
+#include <cstddef>
 #include <string>
+#include <string_view>
 
 /**
  * \brief       Easily push strings to buffer and pop single bytes from it (e.g. when transmitting some data and
  *              using interrupts).
  *
+ * The buffer is a ring of at most SegmentsNum segments, each one described by a pointer and a length. A segment
+ * either owns a string, which is moved in without copying its characters, or references characters which outlive
+ * the transmission (e.g. string literals like CRLF). Pushing doesn't allocate any memory.
+ *
  * This structure must be cleaned up manually. It's implemented in that way because earlier it cleaned up itself when
  * popping bytes. The problem was that the pop_byte() function was called from an FreeRTOS ISR. This caused to call
  * vPortFree sometimes in the ISR what was breaking the application.
  *
  * This is not thread safe at all. The best way to keep this object fit is to clean it up in the same place as the
  * push_string() method is used.
+ *
+ * The String may be any std::basic_string of chars, e.g. one with a pool allocator.
  */
-class string_buf_tx
+template <size_t SegmentsNum, typename String = std::string> class string_buf_tx
 {
   public:
-    void push_string(std::unique_ptr<std::string> &&s);
+    //! Takes the ownership of the string. Returns false when there is no free segment.
+    bool push_string(String &&s);
+
+    //! References the characters without copying them. They must be untouched until clean() is called.
+    bool push_static(std::string_view s);
+
+    //! Views the characters of the segment pushed last, e.g. of the string it owns. Empty when there is none.
+    std::string_view get_last_pushed() const;
+
     char pop_byte();
+
+    //! Returns the contiguous, not popped part of the oldest segment. Empty when there is nothing to pop.
+    std::string_view peek_segment();
+
+    //! Pops the rest of the oldest segment at once, e.g. after it has been transmitted as a block.
+    void pop_segment();
+
+    //! Pops all the segments at once, e.g. to abort the transmission. The segments must still be cleaned up.
+    void pop_all();
+
     bool is_empty();
 
+    //! The number of the segments which can be pushed yet. The popped segments are free only after clean().
+    size_t get_free_segments_num() const;
+
     //! When using FreeRTOS call this from a task context. This mustn't be called from the ISR.
     void clean();
 
   private:
-    //! Aggregates the strings.
-    std::list<std::unique_ptr<std::string>> m_strings;
+    struct segment
+    {
+        const char *data = nullptr;
+        size_t len = 0;
+        bool is_owned = false;
+    };
+
+    bool push_segment(const char *data, size_t len, bool is_owned);
 
-    //! Iterates over the strings.
-    typename std::list<std::unique_ptr<std::string>>::iterator m_strings_it = m_strings.begin();
+    std::array<segment, SegmentsNum> m_segments;
 
-    //! Used to iterate over the strings when popping single bytes.
-    const char *m_byte_it = nullptr;
+    //! The strings owned by the segments with the same index.
+    std::array<String, SegmentsNum> m_owned_strings;
+
+    //! The counters of the pushed, popped and cleaned segments. They only grow, so: cleaned <= popped <= pushed.
+    size_t m_pushed_num = 0;
+    size_t m_popped_num = 0;
+    size_t m_cleaned_num = 0;
+
+    //! The position within the segment which is being popped.
+    size_t m_byte_idx = 0;
 };
 
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PUBLIC MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <size_t SegmentsNum, typename String> bool string_buf_tx<SegmentsNum, String>::push_string(String &&s)
+{
+    if (m_pushed_num - m_cleaned_num == SegmentsNum)
+        return false;
+
+    // Moving the string doesn't reallocate its characters. The pointer is taken after the move, because the short
+    // strings are held within the string object itself.
+    auto &owned = m_owned_strings[m_pushed_num % SegmentsNum];
+    owned = std::move(s);
+    return push_segment(owned.data(), owned.length(), true);
+}
+
+template <size_t SegmentsNum, typename String> bool string_buf_tx<SegmentsNum, String>::push_static(std::string_view s)
+{
+    return push_segment(s.data(), s.length(), false);
+}
+
+template <size_t SegmentsNum, typename String>
+std::string_view string_buf_tx<SegmentsNum, String>::get_last_pushed() const
+{
+    if (m_pushed_num == m_cleaned_num)
+        return {};
+
+    const auto &last_segment = m_segments[(m_pushed_num - 1) % SegmentsNum];
+    return {last_segment.data, last_segment.len};
+}
+
+template <size_t SegmentsNum, typename String> char string_buf_tx<SegmentsNum, String>::pop_byte()
+{
+    if (is_empty())
+        return '\0';
+
+    const auto &current_segment = m_segments[m_popped_num % SegmentsNum];
+    char result = current_segment.data[m_byte_idx++];
+
+    // When the whole segment has been popped then switch to another one.
+    if (m_byte_idx == current_segment.len)
+    {
+        m_byte_idx = 0;
+        m_popped_num++;
+    }
+
+    return result;
+}
+
+template <size_t SegmentsNum, typename String> std::string_view string_buf_tx<SegmentsNum, String>::peek_segment()
+{
+    if (is_empty())
+        return {};
+
+    const auto &current_segment = m_segments[m_popped_num % SegmentsNum];
+    return {current_segment.data + m_byte_idx, current_segment.len - m_byte_idx};
+}
+
+template <size_t SegmentsNum, typename String> void string_buf_tx<SegmentsNum, String>::pop_segment()
+{
+    if (is_empty())
+        return;
+
+    m_byte_idx = 0;
+    m_popped_num++;
+}
+
+template <size_t SegmentsNum, typename String> void string_buf_tx<SegmentsNum, String>::pop_all()
+{
+    m_byte_idx = 0;
+    m_popped_num = m_pushed_num;
+}
+
+template <size_t SegmentsNum, typename String> bool string_buf_tx<SegmentsNum, String>::is_empty()
+{
+    return m_popped_num == m_pushed_num;
+}
+
+template <size_t SegmentsNum, typename String> size_t string_buf_tx<SegmentsNum, String>::get_free_segments_num() const
+{
+    return SegmentsNum - (m_pushed_num - m_cleaned_num);
+}
+
+template <size_t SegmentsNum, typename String> void string_buf_tx<SegmentsNum, String>::clean()
+{
+    for (; m_cleaned_num != m_popped_num; ++m_cleaned_num)
+    {
+        auto idx = m_cleaned_num % SegmentsNum;
+        if (m_segments[idx].is_owned)
+            // Free the memory, what clear() wouldn't do.
+            String().swap(m_owned_strings[idx]);
+        m_segments[idx] = {};
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE MEMBER FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <size_t SegmentsNum, typename String>
+bool string_buf_tx<SegmentsNum, String>::push_segment(const char *data, size_t len, bool is_owned)
+{
+    if (m_pushed_num - m_cleaned_num == SegmentsNum)
+        return false;
+
+    // The empty segments are skipped, so pop_byte() never has to skip them.
+    if (len != 0)
+        m_segments[m_pushed_num++ % SegmentsNum] = {data, len, is_owned};
+    return true;
+}
+
 #endif /* STRING_BUF_TX_HPP */
@@ -0,0 +1,119 @@
+/**
+ * @file	alloc_tracker.cpp
+ * @brief	Replaces the global allocation functions to count the allocations within the tracking scopes.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "alloc_tracker.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF PRIVATE MACROS, FUNCTIONS AND VARIABLES
+// --------------------------------------------------------------------------------------------------------------------
+static std::atomic<bool> is_tracking{false};
+static std::atomic<size_t> num_allocations{0};
+static std::atomic<size_t> num_allocated_bytes{0};
+
+static void count_allocation(size_t size);
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PUBLIC FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+alloc_tracking_scope::alloc_tracking_scope()
+{
+    num_allocations = 0;
+    num_allocated_bytes = 0;
+    is_tracking = true;
+}
+
+alloc_tracking_scope::~alloc_tracking_scope()
+{
+    is_tracking = false;
+}
+
+size_t alloc_tracking_scope::get_allocations_num() const
+{
+    return num_allocations;
+}
+
+size_t alloc_tracking_scope::get_allocated_bytes() const
+{
+    return num_allocated_bytes;
+}
+
+void alloc_tracking_scope::pause()
+{
+    is_tracking = false;
+}
+
+void alloc_tracking_scope::resume()
+{
+    is_tracking = true;
+}
+
+//! Called by traceMALLOC() of FreeRTOS (see tests/rtos/FreeRTOSConfig.h), so pvPortMalloc() is counted as well.
+extern "C" void alloc_tracker_count_kernel_malloc(void *address, size_t size)
+{
+    if (address)
+        count_allocation(size);
+}
+
+void *operator new(size_t size)
+{
+    // The C++ standard requires a unique pointer for a zero sized allocation.
+    auto p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    count_allocation(size);
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    auto p = std::malloc(size ? size : 1);
+    if (p)
+        count_allocation(size);
+    return p;
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+static void count_allocation(size_t size)
+{
+    if (!is_tracking.load(std::memory_order_relaxed))
+        return;
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    num_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+}
@@ -0,0 +1,68 @@
+/**
+ * @file	alloc_tracker.hpp
+ * @brief	Counts the allocations from the heap, so the tests can check the budget of the AT stack.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef ALLOC_TRACKER_HPP
+#define ALLOC_TRACKER_HPP
+
+#include "at_cmd_config.hpp"
+#include <cstddef>
+
+/*
+ * The tracker replaces the global operator new, and counts pvPortMalloc() of FreeRTOS through traceMALLOC() within
+ * the RTOS tests. Only the allocations made while a scope is open are counted, by any task or thread, so everything
+ * the test itself allocates shall be prepared before the scope is opened.
+ *
+ * With AT_CMD_HANDLER_POOL the payloads are taken from the block pools, so sending a command and receiving a line
+ * shall not touch the heap at all. Without it each payload handed over to a handler of an unsolicited message is a
+ * std::unique_ptr<std::string>: the string, and its buffer when the payload doesn't fit into the string itself.
+ */
+
+//! A command is queued and transmitted in the memory of the channel, and its payload is moved, not copied.
+#ifndef ALLOC_BUDGET_PER_SEND
+#define ALLOC_BUDGET_PER_SEND 0
+#endif /* ALLOC_BUDGET_PER_SEND */
+
+//! The solicited lines are appended to the payload of the issuer, whose space is reused.
+#ifndef ALLOC_BUDGET_PER_RESPONSE_LINE
+#define ALLOC_BUDGET_PER_RESPONSE_LINE 0
+#endif /* ALLOC_BUDGET_PER_RESPONSE_LINE */
+
+#ifndef ALLOC_BUDGET_PER_UNSOLICITED_LINE
+#ifdef AT_CMD_HANDLER_POOL
+#define ALLOC_BUDGET_PER_UNSOLICITED_LINE 0
+#else
+#define ALLOC_BUDGET_PER_UNSOLICITED_LINE 2
+#endif /* AT_CMD_HANDLER_POOL */
+#endif /* ALLOC_BUDGET_PER_UNSOLICITED_LINE */
+
+/**
+ * \brief Counts the allocations while it lives. The scopes shall not be nested.
+ *
+ * The counting can be paused while the test prepares the next operation, e.g. the mocked response to the next
+ * command, in between the measured ones.
+ */
+class alloc_tracking_scope
+{
+  public:
+    alloc_tracking_scope();
+    ~alloc_tracking_scope();
+
+    alloc_tracking_scope(const alloc_tracking_scope &) = delete;
+    alloc_tracking_scope &operator=(const alloc_tracking_scope &) = delete;
+
+    size_t get_allocations_num() const;
+    size_t get_allocated_bytes() const;
+
+    void pause();
+    void resume();
+};
+
+//! Fails the test when more than the budget of allocations per each of the operations has been counted by the scope.
+#define TEST_ASSERT_ALLOC_BUDGET(scope, budget_per_operation, operations_num)                                          \
+    TEST_ASSERT_MESSAGE((scope).get_allocations_num() <= static_cast<size_t>(budget_per_operation) * (operations_num), \
+                        "The heap allocation budget has been exceeded")
+
+#endif /* ALLOC_TRACKER_HPP */
@@ -0,0 +1,446 @@
+/**
+ * @file	at_bench.cpp
+ * @brief	Benchmarks the receiving path: recorded traces are replayed through string_buf_rx and at_cmd_handler.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "FreeRTOS.h"
+#include "at_cmd_handler.hpp"
+#include "char_scan.hpp"
+#include "stream_buffer.h"
+#include "string_buf_rx.hpp"
+#include "task.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS OF STRUCTURES, DATA TYPES, ...
+// --------------------------------------------------------------------------------------------------------------------
+
+//! A part of a trace: the received bytes and the command awaited while they are received.
+struct bench_exchange
+{
+    at_cmd awaited_command;
+    const char *received;
+};
+
+//! A recorded trace, replayed as a whole for the number of the iterations.
+struct bench_trace
+{
+    const char *name;
+    std::vector<bench_exchange> exchanges;
+    unsigned iterations;
+};
+
+struct bench_result
+{
+    unsigned long long lines = 0;
+    unsigned long long allocations = 0;
+    size_t peak_heap = 0;
+    double seconds = 0;
+};
+
+//! How the received bytes reach the receiver task (\see rx_stream_len of at_channel).
+enum class bench_rx_transport
+{
+    //! The RX interrupt pushes each byte to string_buf_rx, which splits the lines.
+    direct,
+    //! The RX interrupt copies each byte to a stream buffer, the receiver task passes them to string_buf_rx in bulk.
+    stream,
+};
+
+struct bench_transport_result
+{
+    unsigned long long bytes = 0;
+    unsigned long long lines = 0;
+    //! The notifications which the RX interrupt would give to the receiver task.
+    unsigned long long wakes = 0;
+    double isr_seconds = 0;
+    double task_seconds = 0;
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF PRIVATE FUNCTIONS AND VARIABLES
+// --------------------------------------------------------------------------------------------------------------------
+
+//! The size of the chunks passed to the RX buffer, like from a DMA/idle-line interrupt.
+constexpr size_t rx_chunk_len = 64;
+
+//! The characters which string_buf_rx without any exceptional character looks for.
+#define BENCH_SCANNED_CHARS '\n', '\r', '\0', ':'
+
+constexpr size_t bench_rx_buf_len = 512;
+constexpr size_t bench_rx_lines_num = 32;
+
+//! Like in at_channel: the chunks taken by the receiver task from the stream, its size and its trigger level.
+constexpr size_t bench_rx_stream_chunk_len = 32;
+constexpr size_t bench_rx_stream_len = 512;
+constexpr size_t bench_rx_stream_trigger_level = 32;
+
+//! The lines of e.g. a list of the operators or of the data read from a socket as hex, longer than the vectors.
+#define BENCH_LONG_PAYLOAD                                                                                             \
+    "474554202F20485454502F312E310D0A486F73743A206578616D706C652E636F6D0D0A557365722D4167656E743A206174"          \
+    "2D636D642D68616E646C65720D0A4163636570743A202A2F2A0D0A436F6E6E656374696F6E3A20636C6F73650D0A0D0A"
+
+static const std::vector<bench_trace> bench_traces{
+    {"solicited_multiline",
+     {{at_cmd::first,
+       "AT+FIRST?\r\n"
+       "+FIRST: 1,\"SM\",10,20\r\n+FIRST: 2,\"SM\",11,20\r\n+FIRST: 3,\"SM\",12,20\r\n+FIRST: 4,\"SM\",13,20\r\n"
+       "+FIRST: 5,\"SM\",14,20\r\n+FIRST: 6,\"SM\",15,20\r\n+FIRST: 7,\"SM\",16,20\r\n+FIRST: 8,\"SM\",17,20\r\n"
+       "\r\nOK\r\n"}},
+     20000},
+    {"urc_flood",
+     {{at_cmd::none,
+       "+SECOND: 1,5\r\n+SECOND: 2,5\r\n+THIRD: 0\r\nNeul\r\n+SECOND: 3,5\r\n+SECOND: 4,5\r\nNeul\r\n"
+       "+THIRD: 1\r\n+SECOND: 5,5\r\n+SECOND: 6,5\r\n+THIRD: 2\r\nNO CARRIER\r\n"}},
+     20000},
+    {"echoes",
+     {{at_cmd::fourth, "AT+FOURTH=1,2\r\n\r\nOK\r\n"},
+      {at_cmd::e, "ATE\r\n\r\nOK\r\n"},
+      {at_cmd::fifth, "AT+FIFTH\r\n\r\nERROR\r\n"},
+      {at_cmd::sixth, "AT+SIXTH=?\r\n+SIXTH: (0-1)\r\n\r\nOK\r\n"}},
+     40000},
+    {"mixed",
+     {{at_cmd::seventh, "AT+SEVENTH?\r\n+SECOND: 7,5\r\n+SEVENTH: 1\r\n+SEVENTH: 2\r\n"},
+      {at_cmd::seventh, "Neul\r\n+SEVENTH: 3\r\n\r\nOK\r\n"},
+      {at_cmd::eighth, "AT+EIGHTH=\"text\"\r\n\r\n+CME ERROR: 10\r\n"},
+      {at_cmd::ninth, "AT+NINTH\r\n+THIRD: 3\r\n350101234567890\r\n\r\nOK\r\n"}},
+     20000},
+    {"long_lines",
+     {{at_cmd::ninth,
+       "AT+NINTH\r\n+NINTH: 1,\"" BENCH_LONG_PAYLOAD "\"\r\n+NINTH: 2,\"" BENCH_LONG_PAYLOAD "\"\r\n\r\nOK\r\n"}},
+     20000},
+};
+
+//! Counted by the replaced global allocation functions.
+static unsigned long long num_allocations;
+static size_t current_heap;
+static size_t peak_heap;
+
+static bench_result run_trace(const bench_trace &trace);
+static bench_transport_result
+run_trace_through(const bench_trace &trace, bench_rx_transport transport, size_t isr_chunk_len);
+static double run_scanner(const bench_trace &trace, const char *(*scan)(const char *beg, const char *end));
+static void register_counting_handlers(at_cmd_handler &handler, unsigned long long &num_urcs);
+static void handle_chunk(string_buf_rx<bench_rx_buf_len, bench_rx_lines_num> &rx_buf,
+                         at_cmd_handler &handler,
+                         at_cmd awaited_command,
+                         at_string &response_payload,
+                         unsigned long long &lines);
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE ALLOCATION FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+/*
+ * The size of each allocation is kept in front of the block, so the heap usage can be tracked without relying on any
+ * allocator specific function.
+ */
+constexpr size_t alloc_header_len = alignof(std::max_align_t);
+
+void *operator new(size_t size)
+{
+    auto p = static_cast<char *>(std::malloc(size + alloc_header_len));
+    if (!p)
+        throw std::bad_alloc();
+    *reinterpret_cast<size_t *>(p) = size;
+    num_allocations++;
+    current_heap += size;
+    if (current_heap > peak_heap)
+        peak_heap = current_heap;
+    return p + alloc_header_len;
+}
+
+void operator delete(void *p) noexcept
+{
+    if (!p)
+        return;
+    auto block = static_cast<char *>(p) - alloc_header_len;
+    current_heap -= *reinterpret_cast<size_t *>(block);
+    std::free(block);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE HOOKS OF FREERTOS
+// --------------------------------------------------------------------------------------------------------------------
+/*
+ * Only the stream buffers of FreeRTOS are used, without the scheduler, so the memory of its tasks is never asked for.
+ * The hooks are needed only to link the kernel, which is built with configSUPPORT_STATIC_ALLOCATION.
+ */
+extern "C" void vApplicationGetIdleTaskMemory(StaticTask_t **tcb, StackType_t **stack, uint32_t *stack_depth)
+{
+    *tcb = nullptr;
+    *stack = nullptr;
+    *stack_depth = 0;
+}
+
+extern "C" void vApplicationGetTimerTaskMemory(StaticTask_t **tcb, StackType_t **stack, uint32_t *stack_depth)
+{
+    *tcb = nullptr;
+    *stack = nullptr;
+    *stack_depth = 0;
+}
+
+//! Called by traceMALLOC() of the configuration of the RTOS tests. The stream buffers are created in their memory.
+extern "C" void alloc_tracker_count_kernel_malloc(void *, size_t)
+{
+    num_allocations++;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXECUTION OF THE BENCHMARKS
+// --------------------------------------------------------------------------------------------------------------------
+int main()
+{
+    std::printf("%-22s %12s %14s %10s %14s %12s\n", "trace", "lines", "lines/s", "ns/line", "allocs/line", "peak heap");
+    for (const auto &trace : bench_traces)
+    {
+        auto r = run_trace(trace);
+        std::printf("%-22s %12llu %14.0f %10.1f %14.3f %12zu\n",
+                    trace.name,
+                    r.lines,
+                    r.lines / r.seconds,
+                    r.seconds * 1e9 / r.lines,
+                    static_cast<double>(r.allocations) / r.lines,
+                    r.peak_heap);
+    }
+
+    // The bytes are received one by one, like from the RXNE interrupt of a UART, and in chunks, like from the DMA.
+    std::printf("\n%-22s %10s %6s %14s %14s %12s\n",
+                "trace",
+                "transport",
+                "chunk",
+                "isr ns/byte",
+                "task ns/line",
+                "wakes/line");
+    for (const auto &trace : bench_traces)
+        for (auto isr_chunk_len : {static_cast<size_t>(1), rx_chunk_len})
+            for (auto transport : {bench_rx_transport::direct, bench_rx_transport::stream})
+            {
+                auto r = run_trace_through(trace, transport, isr_chunk_len);
+                std::printf("%-22s %10s %6zu %14.1f %14.1f %12.3f\n",
+                            trace.name,
+                            transport == bench_rx_transport::direct ? "direct" : "stream",
+                            isr_chunk_len,
+                            r.isr_seconds * 1e9 / r.bytes,
+                            r.task_seconds * 1e9 / r.lines,
+                            static_cast<double>(r.wakes) / r.lines);
+            }
+
+    // The scanners which look for the characters string_buf_rx classifies: the byte by byte one and the fastest ones.
+    std::printf("\n%-22s %14s %14s %14s\n", "trace", "scalar ns/B", "swar ns/B", "simd ns/B");
+    for (const auto &trace : bench_traces)
+    {
+        std::printf("%-22s %14.3f %14.3f ",
+                    trace.name,
+                    run_scanner(trace, &char_scan_scalar<BENCH_SCANNED_CHARS>),
+                    run_scanner(trace, &char_scan_swar<BENCH_SCANNED_CHARS>));
+#if defined(__SSE2__)
+        std::printf("%14.3f\n", run_scanner(trace, &char_scan_sse2<BENCH_SCANNED_CHARS>));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        std::printf("%14.3f\n", run_scanner(trace, &char_scan_neon<BENCH_SCANNED_CHARS>));
+#else
+        std::printf("%14s\n", "-");
+#endif
+    }
+    return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+static bench_result run_trace(const bench_trace &trace)
+{
+    // The buffer and the handler are created before the measurement, as they live for the whole application.
+    auto rx_buf = std::make_unique<string_buf_rx<bench_rx_buf_len, bench_rx_lines_num>>();
+    at_cmd_handler handler;
+    unsigned long long num_urcs = 0;
+    register_counting_handlers(handler, num_urcs);
+    at_string response_payload;
+
+    bench_result result;
+    auto allocations_before = num_allocations;
+    auto heap_before = current_heap;
+    peak_heap = current_heap;
+    auto start = std::chrono::steady_clock::now();
+
+    for (unsigned i = 0; i < trace.iterations; ++i)
+    {
+        for (const auto &exchange : trace.exchanges)
+        {
+            std::string_view received{exchange.received};
+            for (size_t pos = 0; pos < received.length(); pos += rx_chunk_len)
+            {
+                auto chunk = received.substr(pos, rx_chunk_len);
+                rx_buf->push_bytes_and_count_string_ends(chunk.data(), chunk.length());
+                handle_chunk(*rx_buf, handler, exchange.awaited_command, response_payload, result.lines);
+            }
+        }
+    }
+
+    auto stop = std::chrono::steady_clock::now();
+    result.seconds = std::chrono::duration<double>(stop - start).count();
+    result.allocations = num_allocations - allocations_before;
+    result.peak_heap = peak_heap - heap_before;
+    return result;
+}
+
+/**
+ * Each exchange is received whole by the interrupts before the receiver task handles it, so both phases are timed
+ * separately. The stream buffer is used as at_channel uses it: the interrupt doesn't look for the line ends, only for
+ * the newline which wakes up the task, and the task fills the RX buffer with the scheduler suspended.
+ */
+static bench_transport_result
+run_trace_through(const bench_trace &trace, bench_rx_transport transport, size_t isr_chunk_len)
+{
+    auto rx_buf = std::make_unique<string_buf_rx<bench_rx_buf_len, bench_rx_lines_num>>();
+    auto rx_stream = xStreamBufferCreate(bench_rx_stream_len, bench_rx_stream_trigger_level);
+    at_cmd_handler handler;
+    unsigned long long num_urcs = 0;
+    register_counting_handlers(handler, num_urcs);
+    at_string response_payload;
+
+    bench_transport_result result;
+    std::chrono::steady_clock::duration isr_time{}, task_time{};
+    for (unsigned i = 0; i < trace.iterations; ++i)
+    {
+        for (const auto &exchange : trace.exchanges)
+        {
+            std::string_view received{exchange.received};
+            result.bytes += received.length();
+
+            auto isr_start = std::chrono::steady_clock::now();
+            if (isr_chunk_len == 1)
+                for (auto c : received)
+                {
+                    if (transport == bench_rx_transport::direct)
+                    {
+                        if (rx_buf->push_byte_and_is_string_end(c))
+                            result.wakes++;
+                        continue;
+                    }
+                    BaseType_t higher_prior_task_woken = pdFALSE;
+                    xStreamBufferSendFromISR(rx_stream, &c, 1, &higher_prior_task_woken);
+                    if (c == '\n' || xStreamBufferBytesAvailable(rx_stream) == bench_rx_stream_trigger_level)
+                        result.wakes++;
+                }
+            else
+                for (size_t pos = 0; pos < received.length(); pos += isr_chunk_len)
+                {
+                    auto chunk = received.substr(pos, isr_chunk_len);
+                    if (transport == bench_rx_transport::direct)
+                    {
+                        if (rx_buf->push_bytes_and_count_string_ends(chunk.data(), chunk.length()) > 0)
+                            result.wakes++;
+                        continue;
+                    }
+                    // Each chunk wakes up the task.
+                    BaseType_t higher_prior_task_woken = pdFALSE;
+                    xStreamBufferSendFromISR(rx_stream, chunk.data(), chunk.length(), &higher_prior_task_woken);
+                    result.wakes++;
+                }
+            auto task_start = std::chrono::steady_clock::now();
+
+            if (transport == bench_rx_transport::stream)
+            {
+                std::array<char, bench_rx_stream_chunk_len> chunk;
+                while (auto num = xStreamBufferReceive(rx_stream, chunk.data(), chunk.size(), 0))
+                {
+                    vTaskSuspendAll();
+                    rx_buf->push_bytes_and_count_string_ends(chunk.data(), num);
+                    xTaskResumeAll();
+                    handle_chunk(*rx_buf, handler, exchange.awaited_command, response_payload, result.lines);
+                }
+            }
+            else
+                handle_chunk(*rx_buf, handler, exchange.awaited_command, response_payload, result.lines);
+
+            auto task_stop = std::chrono::steady_clock::now();
+            isr_time += task_start - isr_start;
+            task_time += task_stop - task_start;
+        }
+    }
+
+    vStreamBufferDelete(rx_stream);
+    result.isr_seconds = std::chrono::duration<double>(isr_time).count();
+    result.task_seconds = std::chrono::duration<double>(task_time).count();
+    return result;
+}
+
+/**
+ * The received bytes of the trace are scanned from each character found to the next one, as
+ * push_bytes_and_count_string_ends() does, in the chunks of rx_chunk_len. \returns the nanoseconds per byte.
+ */
+static double run_scanner(const bench_trace &trace, const char *(*scan)(const char *beg, const char *end))
+{
+    std::string received;
+    for (const auto &exchange : trace.exchanges)
+        received += exchange.received;
+
+    unsigned long long found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < trace.iterations; ++i)
+        for (size_t pos = 0; pos < received.length(); pos += rx_chunk_len)
+        {
+            const char *it = received.data() + pos;
+            const char *end = received.data() + std::min(received.length(), pos + rx_chunk_len);
+            for (; (it = scan(it, end)) != end; ++it)
+                found++;
+        }
+    auto stop = std::chrono::steady_clock::now();
+
+    // Keeps the scanning from being optimised out.
+    static volatile unsigned long long sink;
+    sink = found;
+    (void)sink;
+    return std::chrono::duration<double>(stop - start).count() * 1e9 / (received.length() * trace.iterations);
+}
+
+static void register_counting_handlers(at_cmd_handler &handler, unsigned long long &num_urcs)
+{
+    handler.register_unsolicited_handler(at_cmd::second, [&num_urcs](at_payload_ptr) {
+        num_urcs++;
+        return false;
+    });
+    handler.register_unsolicited_handler(at_cmd::third, [&num_urcs](at_payload_ptr) {
+        num_urcs++;
+        return false;
+    });
+    handler.register_unsolicited_handler(at_unsolicited_msg::neul, [&num_urcs]() {
+        num_urcs++;
+        return false;
+    });
+}
+
+static void handle_chunk(string_buf_rx<bench_rx_buf_len, bench_rx_lines_num> &rx_buf,
+                         at_cmd_handler &handler,
+                         at_cmd awaited_command,
+                         at_string &response_payload,
+                         unsigned long long &lines)
+{
+    while (!rx_buf.is_empty())
+    {
+        auto response = rx_buf.peek_string();
+        if (!response.empty())
+        {
+            auto res = handler.handle_received_response(response, awaited_command, response_payload);
+            // The payload is handed over to the issuer on the final result code, so its space is reused.
+            if (is_final_result_code(res))
+                response_payload.clear();
+            lines++;
+        }
+        rx_buf.release_string();
+    }
+}
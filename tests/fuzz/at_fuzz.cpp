@@ -0,0 +1,219 @@
+/**
+ * @file	at_fuzz.cpp
+ * @brief	Fuzzes the receiving path: arbitrary bytes are pushed to string_buf_rx and its lines to at_cmd_handler.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "at_cmd_handler.hpp"
+#include "string_buf_rx.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF PRIVATE MACROS, FUNCTIONS AND VARIABLES
+// --------------------------------------------------------------------------------------------------------------------
+/*
+ * The input starts with two bytes, which choose how the rest of it is received:
+ *  - bit 0 of the first byte: pushed in chunks rather than byte by byte,
+ *  - bit 1: the echoes of the commands are discarded by the producer,
+ *  - bit 2: the binary mode is armed for "+QIRD" beforehand,
+ *  - bits 4-7: the length of the chunks, 1 + 4 * bits,
+ *  - the second byte: the command awaited.
+ */
+constexpr size_t fuzz_header_len = 2;
+constexpr uint8_t fuzz_flag_chunked = 1 << 0;
+constexpr uint8_t fuzz_flag_echo_discarded = 1 << 1;
+constexpr uint8_t fuzz_flag_binary_armed = 1 << 2;
+
+//! Small, so the overflows of the characters and of the strings are reached often.
+constexpr size_t fuzz_rx_buf_len = 128;
+constexpr size_t fuzz_rx_lines_num = 8;
+constexpr size_t fuzz_binary_capacity = 16;
+
+//! The same as the RX buffer of at_channel when the prompt is recognised by the producer.
+using fuzz_rx_buf = string_buf_rx<fuzz_rx_buf_len, fuzz_rx_lines_num, '>'>;
+
+//! The pieces of the responses the random inputs are made of, the same as in at.dict.
+static const std::string_view fuzz_tokens[] = {
+    "\r\n", "\r", "\n", std::string_view("\0", 1), "OK", "ERROR", "+CME ERROR: ", "+CMS ERROR:", "AT+FIRST?",
+    "+FIRST: ", "+FIFTH:", "+SIXTH: ", "+SEVENTH", "Neul", "NO CARRIER", "CONNECT", "+QIRD: 12", ":", " ", ",", "\"",
+    ">", "0", "1", "9",
+};
+
+static void receive(const uint8_t *data, size_t size);
+static void handle_lines(fuzz_rx_buf &rx_buf, at_cmd_handler &handler, at_cmd awaited_cmd, at_string &pload);
+static std::vector<uint8_t> generate_input(std::mt19937 &rng);
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PUBLIC FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+//! The entry point of libFuzzer and of AFL++, which is given each input.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    receive(data, size);
+    return 0;
+}
+
+#ifndef AT_FUZZ_LIBFUZZER
+/**
+ * Without libFuzzer: replays the inputs from the files given, e.g. a crash found elsewhere or a corpus, or runs the
+ * random inputs made of the tokens and reports the executions per second, as the baseline of the throughput.
+ */
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::ifstream file(argv[i], std::ios::binary);
+            std::vector<uint8_t> input{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+            receive(input.data(), input.size());
+        }
+        std::printf("%d inputs replayed\n", argc - 1);
+        return 0;
+    }
+
+    constexpr unsigned executions_num = 200000;
+    std::mt19937 rng(0);
+    unsigned long long bytes = 0;
+    std::chrono::duration<double> elapsed{0};
+    for (unsigned i = 0; i < executions_num; ++i)
+    {
+        auto input = generate_input(rng);
+        auto start = std::chrono::steady_clock::now();
+        receive(input.data(), input.size());
+        elapsed += std::chrono::steady_clock::now() - start;
+        bytes += input.size();
+    }
+    std::printf("%u executions in %.2f s: %.0f exec/s, %.1f MB/s\n",
+                executions_num,
+                elapsed.count(),
+                executions_num / elapsed.count(),
+                bytes / elapsed.count() / 1e6);
+    return 0;
+}
+#endif /* AT_FUZZ_LIBFUZZER */
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+static void receive(const uint8_t *data, size_t size)
+{
+    if (size < fuzz_header_len)
+        return;
+    auto flags = data[0];
+    auto commands_num = static_cast<size_t>(at_cmd::number_of_commands);
+    auto awaited_idx = data[1] % (commands_num + 1);
+    auto awaited_cmd = awaited_idx == commands_num ? at_cmd::none : static_cast<at_cmd>(awaited_idx);
+    auto chunk_len = static_cast<size_t>(1 + 4 * (flags >> 4));
+    auto bytes = reinterpret_cast<const char *>(data + fuzz_header_len);
+    auto bytes_num = size - fuzz_header_len;
+
+    auto rx_buf = std::make_unique<fuzz_rx_buf>();
+    if (flags & fuzz_flag_echo_discarded)
+        rx_buf->discard_strings_starting_with(at_cmd_handler::get_discardable_echo_prefix());
+    std::array<char, fuzz_binary_capacity> binary;
+    if (flags & fuzz_flag_binary_armed)
+        rx_buf->arm_binary_mode("+QIRD", binary.data(), binary.size());
+
+    at_cmd_handler handler;
+    handler.register_unsolicited_handler(at_cmd::fifth, [](at_payload_ptr) { return false; });
+    handler.register_unsolicited_handler(at_cmd::sixth, [](at_payload_ptr) { return false; }, at_dispatch::coalesced);
+    // Is unregistered by the first occurrence.
+    handler.register_unsolicited_handler(at_cmd::seventh, [](at_payload_ptr) { return true; });
+    handler.register_unsolicited_handler(at_unsolicited_msg::neul, [] { return false; });
+    at_string pload;
+
+    if (flags & fuzz_flag_chunked)
+    {
+        for (size_t pos = 0; pos < bytes_num; pos += chunk_len)
+        {
+            auto num = std::min(chunk_len, bytes_num - pos);
+            if (rx_buf->push_bytes_and_count_string_ends(bytes + pos, num) > 0)
+                handle_lines(*rx_buf, handler, awaited_cmd, pload);
+        }
+    }
+    else
+    {
+        for (size_t pos = 0; pos < bytes_num; ++pos)
+            if (rx_buf->push_byte_and_is_string_end(bytes[pos]))
+                handle_lines(*rx_buf, handler, awaited_cmd, pload);
+    }
+    handle_lines(*rx_buf, handler, awaited_cmd, pload);
+
+    if (flags & fuzz_flag_binary_armed)
+    {
+        auto copied = rx_buf->disarm_binary_mode();
+        if (copied > binary.size())
+            std::abort();
+    }
+}
+
+/**
+ * Each line is handed to the parser in the copies of its segments, which are exactly as long as the segments, so
+ * the sanitizer catches any read past the end of a line, which would stay within the RX buffer otherwise.
+ */
+static void handle_lines(fuzz_rx_buf &rx_buf, at_cmd_handler &handler, at_cmd awaited_cmd, at_string &pload)
+{
+    while (!rx_buf.is_empty())
+    {
+        auto line = rx_buf.peek_string();
+        auto colon_pos = rx_buf.peek_colon_pos();
+        if (line.length() > fuzz_rx_buf_len || colon_pos > line.length())
+            std::abort();
+        if (!line.empty())
+        {
+            auto first = std::make_unique<char[]>(line.first().length());
+            auto second = std::make_unique<char[]>(line.second().length());
+            std::copy(line.first().begin(), line.first().end(), first.get());
+            std::copy(line.second().begin(), line.second().end(), second.get());
+            line_view copy({first.get(), line.first().length()}, {second.get(), line.second().length()});
+            for (size_t i = 0; i < colon_pos; ++i)
+                if (copy[i] == ':')
+                    std::abort();
+            if (colon_pos < copy.length() && copy[colon_pos] != ':')
+                std::abort();
+
+            auto res = handler.handle_received_response(copy, colon_pos, awaited_cmd, pload);
+            // The payload is handed over to the issuer on the final result code.
+            if (is_final_result_code(res))
+                pload.clear();
+            // The line is passed once more without the colon known, as the parser scans for it by itself then.
+            at_string scanned_pload;
+            auto res_scanned = handler.handle_received_response(copy, awaited_cmd, scanned_pload);
+            if (is_final_result_code(res) != is_final_result_code(res_scanned))
+                std::abort();
+        }
+        rx_buf.release_string();
+    }
+}
+
+static std::vector<uint8_t> generate_input(std::mt19937 &rng)
+{
+    std::vector<uint8_t> input;
+    input.push_back(static_cast<uint8_t>(rng()));
+    input.push_back(static_cast<uint8_t>(rng()));
+    auto tokens_num = rng() % 64;
+    for (unsigned i = 0; i < tokens_num; ++i)
+    {
+        // Mostly the tokens, sometimes the arbitrary bytes between them.
+        if (rng() % 8 == 0)
+        {
+            input.push_back(static_cast<uint8_t>(rng()));
+            continue;
+        }
+        auto token = fuzz_tokens[rng() % std::size(fuzz_tokens)];
+        input.insert(input.end(), token.begin(), token.end());
+    }
+    return input;
+}
@@ -0,0 +1,108 @@
+/**
+ * @file	at_args_test.cpp
+ * @brief	Contains unit tests of the signatures which format the typed arguments of the write commands.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "at_args.hpp"
+#include "unity.h"
+#include <climits>
+#include <cstdint>
+#include <string>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS OF STRUCTURES, DATA TYPES, ...
+// --------------------------------------------------------------------------------------------------------------------
+enum class test_cmd
+{
+    qiopen,
+    cfun,
+    cops
+};
+
+enum class context_type : uint8_t
+{
+    ipv4 = 1,
+    ipv6 = 2
+};
+
+using qiopen_args = at_cmd_args<test_cmd::qiopen, int, int, quoted_string, quoted_string, int, int, int>;
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_signature_of_ints_and_strings_WHEN_formatted_THEN_comma_separated_payload_obtained();
+static void GIVEN_integer_limits_WHEN_formatted_THEN_each_digit_written();
+static void GIVEN_enum_and_unquoted_string_WHEN_formatted_THEN_written_as_underlying_value_and_verbatim();
+static void GIVEN_mismatching_arguments_WHEN_validated_THEN_rejected_at_compile_time();
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXECUTION OF THE TESTS
+// --------------------------------------------------------------------------------------------------------------------
+void test_at_args()
+{
+    RUN_TEST(GIVEN_signature_of_ints_and_strings_WHEN_formatted_THEN_comma_separated_payload_obtained);
+    RUN_TEST(GIVEN_integer_limits_WHEN_formatted_THEN_each_digit_written);
+    RUN_TEST(GIVEN_enum_and_unquoted_string_WHEN_formatted_THEN_written_as_underlying_value_and_verbatim);
+    RUN_TEST(GIVEN_mismatching_arguments_WHEN_validated_THEN_rejected_at_compile_time);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_signature_of_ints_and_strings_WHEN_formatted_THEN_comma_separated_payload_obtained()
+{
+    // GIVEN
+    std::string ip{"1.2.3.4"};
+
+    // WHEN
+    auto payload = qiopen_args::format<std::string>(1, 0, "TCP", ip, 80, 0, 1);
+
+    // THEN
+    TEST_ASSERT_EQUAL_STRING("1,0,\"TCP\",\"1.2.3.4\",80,0,1", payload.c_str());
+    TEST_ASSERT_EQUAL(payload.length(), std::char_traits<char>::length(payload.c_str()));
+}
+
+static void GIVEN_integer_limits_WHEN_formatted_THEN_each_digit_written()
+{
+    // GIVEN
+    using int_args = at_cmd_args<test_cmd::cfun, int, unsigned, int8_t, long long>;
+
+    // WHEN
+    auto lowest = int_args::format<std::string>(INT_MIN, UINT_MAX, INT8_MIN, LLONG_MIN);
+    auto highest = int_args::format<std::string>(INT_MAX, 0u, INT8_MAX, LLONG_MAX);
+    auto negative = at_cmd_args<test_cmd::cfun, int>::format<std::string>(-7);
+
+    // THEN
+    TEST_ASSERT_EQUAL_STRING("-2147483648,4294967295,-128,-9223372036854775808", lowest.c_str());
+    TEST_ASSERT_EQUAL_STRING("2147483647,0,127,9223372036854775807", highest.c_str());
+    TEST_ASSERT_EQUAL_STRING("-7", negative.c_str());
+}
+
+static void GIVEN_enum_and_unquoted_string_WHEN_formatted_THEN_written_as_underlying_value_and_verbatim()
+{
+    // GIVEN
+    using cops_args = at_cmd_args<test_cmd::cops, context_type, unquoted_string, quoted_string>;
+
+    // WHEN
+    auto payload = cops_args::format<std::string>(context_type::ipv6, std::string_view{"2"}, "");
+
+    // THEN
+    TEST_ASSERT_EQUAL_STRING("2,2,\"\"", payload.c_str());
+}
+
+static void GIVEN_mismatching_arguments_WHEN_validated_THEN_rejected_at_compile_time()
+{
+    // GIVEN
+    using enum_args = at_cmd_args<test_cmd::cops, context_type, int>;
+
+    // WHEN
+    // THEN
+    TEST_ASSERT((qiopen_args::is_valid<int, int, const char *, std::string, int, int, long>));
+    TEST_ASSERT_FALSE((qiopen_args::is_valid<int, int, const char *, std::string, int, int>));
+    TEST_ASSERT_FALSE((qiopen_args::is_valid<int, int, int, std::string, int, int, int>));
+    TEST_ASSERT_FALSE((qiopen_args::is_valid<int, int, const char *, std::string, const char *, int, int>));
+    TEST_ASSERT((enum_args::is_valid<context_type, short>));
+    TEST_ASSERT_FALSE((enum_args::is_valid<int, int>));
+    TEST_ASSERT_FALSE((enum_args::is_valid<context_type, bool>));
+    TEST_ASSERT_FALSE((enum_args::is_valid<context_type, char>));
+}
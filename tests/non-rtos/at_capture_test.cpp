@@ -0,0 +1,150 @@
+/**
+ * @file	at_capture_test.cpp
+ * @brief	Contains unit tests of the ring which records the traffic of a port.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "at_capture.hpp"
+#include "unity.h"
+#include <string>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_capture_WHEN_bytes_appended_in_both_directions_THEN_records_exported_in_order();
+static void GIVEN_full_capture_WHEN_more_bytes_appended_THEN_oldest_records_overwritten();
+static void GIVEN_chunk_longer_than_record_limit_WHEN_appended_THEN_split_into_records();
+static void GIVEN_truncated_capture_WHEN_read_THEN_only_whole_records_obtained();
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF PRIVATE MACROS, FUNCTIONS AND VARIABLES
+// --------------------------------------------------------------------------------------------------------------------
+template <size_t N> static std::string export_all(const at_capture_ring<N> &capture);
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXECUTION OF THE TESTS
+// --------------------------------------------------------------------------------------------------------------------
+void test_at_capture()
+{
+    RUN_TEST(GIVEN_capture_WHEN_bytes_appended_in_both_directions_THEN_records_exported_in_order);
+    RUN_TEST(GIVEN_full_capture_WHEN_more_bytes_appended_THEN_oldest_records_overwritten);
+    RUN_TEST(GIVEN_chunk_longer_than_record_limit_WHEN_appended_THEN_split_into_records);
+    RUN_TEST(GIVEN_truncated_capture_WHEN_read_THEN_only_whole_records_obtained);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_capture_WHEN_bytes_appended_in_both_directions_THEN_records_exported_in_order()
+{
+    // GIVEN
+    at_capture_ring<64> capture;
+
+    // WHEN
+    capture.append(at_capture_direction::tx, 10, "AT+CSQ\r\n", 8);
+    capture.append(at_capture_direction::rx, 0x01020304, "+CSQ", 4);
+    capture.append(at_capture_direction::rx, 0x01020305, ": 20,99", 7);
+    capture.end_record();
+    capture.append(at_capture_direction::rx, 0x01020310, "OK", 2);
+
+    // THEN
+    auto exported = export_all(capture);
+    TEST_ASSERT_EQUAL(3 * at_capture_ring<64>::header_len + 8 + 11 + 2, exported.length());
+    TEST_ASSERT_EQUAL(capture.size(), exported.length());
+    std::string_view blob{exported};
+    at_capture_record record;
+    TEST_ASSERT(at_read_capture_record(blob, record));
+    TEST_ASSERT(record.direction == at_capture_direction::tx);
+    TEST_ASSERT_EQUAL(10, record.timestamp);
+    TEST_ASSERT((record.bytes == "AT+CSQ\r\n"));
+    TEST_ASSERT(at_read_capture_record(blob, record));
+    TEST_ASSERT(record.direction == at_capture_direction::rx);
+    TEST_ASSERT_EQUAL_UINT32(0x01020304, record.timestamp);
+    TEST_ASSERT((record.bytes == "+CSQ: 20,99"));
+    TEST_ASSERT(at_read_capture_record(blob, record));
+    TEST_ASSERT_EQUAL_UINT32(0x01020310, record.timestamp);
+    TEST_ASSERT((record.bytes == "OK"));
+    TEST_ASSERT_FALSE(at_read_capture_record(blob, record));
+}
+
+static void GIVEN_full_capture_WHEN_more_bytes_appended_THEN_oldest_records_overwritten()
+{
+    // GIVEN
+    at_capture_ring<32> capture;
+    capture.append(at_capture_direction::tx, 1, "AT\r\n", 4);
+    capture.append(at_capture_direction::rx, 2, "OK", 2);
+    capture.end_record();
+
+    // WHEN
+    // 11 + 9 + 12 bytes: only the last two records fit.
+    capture.append(at_capture_direction::rx, 3, "RDY", 3);
+    capture.end_record();
+    capture.append(at_capture_direction::rx, 4, "+CPIN", 5);
+
+    // THEN
+    TEST_ASSERT_EQUAL(1, capture.get_num_overwritten());
+    auto exported = export_all(capture);
+    TEST_ASSERT_EQUAL(capture.size(), exported.length());
+    std::string_view blob{exported};
+    at_capture_record record;
+    TEST_ASSERT(at_read_capture_record(blob, record));
+    TEST_ASSERT((record.bytes == "OK"));
+    TEST_ASSERT(at_read_capture_record(blob, record));
+    TEST_ASSERT((record.bytes == "RDY"));
+    TEST_ASSERT(at_read_capture_record(blob, record));
+    TEST_ASSERT((record.bytes == "+CPIN"));
+    TEST_ASSERT_EQUAL(4, record.timestamp);
+    TEST_ASSERT(blob.empty());
+}
+
+static void GIVEN_chunk_longer_than_record_limit_WHEN_appended_THEN_split_into_records()
+{
+    // GIVEN
+    at_capture_ring<32> capture;
+    const std::string chunk(12, 'x');
+
+    // WHEN
+    // A record of the ring of 32 bytes takes at most 16 bytes, i.e. 9 bytes of the traffic.
+    capture.append(at_capture_direction::rx, 5, chunk.data(), chunk.length());
+
+    // THEN
+    auto exported = export_all(capture);
+    std::string_view blob{exported};
+    at_capture_record record;
+    TEST_ASSERT(at_read_capture_record(blob, record));
+    TEST_ASSERT_EQUAL(9, record.bytes.length());
+    TEST_ASSERT(at_read_capture_record(blob, record));
+    TEST_ASSERT_EQUAL(3, record.bytes.length());
+    TEST_ASSERT_EQUAL(5, record.timestamp);
+    TEST_ASSERT(blob.empty());
+}
+
+static void GIVEN_truncated_capture_WHEN_read_THEN_only_whole_records_obtained()
+{
+    // GIVEN
+    at_capture_ring<64> capture;
+    capture.append(at_capture_direction::rx, 1, "+QGPS: 1", 8);
+    auto exported = export_all(capture);
+    exported.pop_back();
+    std::string_view blob{exported};
+    std::string_view header_only{exported.data(), 5};
+
+    // WHEN
+    at_capture_record record;
+    auto is_read = at_read_capture_record(blob, record);
+    auto is_header_read = at_read_capture_record(header_only, record);
+
+    // THEN
+    TEST_ASSERT_FALSE(is_read);
+    TEST_ASSERT_FALSE(is_header_read);
+    TEST_ASSERT_EQUAL(exported.length(), blob.length());
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE MACROS, FUNCTIONS AND VARIABLES
+// --------------------------------------------------------------------------------------------------------------------
+template <size_t N> static std::string export_all(const at_capture_ring<N> &capture)
+{
+    std::string exported;
+    capture.export_to([&exported](const char *data, size_t len) { exported.append(data, len); });
+    return exported;
+}
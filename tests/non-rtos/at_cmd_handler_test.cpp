@@ -3,6 +3,7 @@
  * @brief	Contains unit tests and behaviour driven tests of AT command handler class.
  * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
  */
+#include "alloc_tracker.hpp"
 #include "at_cmd_handler.hpp"
 #include "unity.h"
 
@@ -16,6 +17,7 @@ static void UNIT_TEST_at_prepare_cmd_write();
 static void UNIT_TEST_at_prepare_cmd_test();
 static void UNIT_TEST_at_prepare_cmd_exec();
 static void UNIT_TEST_at_prepare_cmd_read();
+static void UNIT_TEST_at_get_cmd_prefix();
 
 // TODO: implement handling command which uses a prompt.
 // static void UNIT_TEST_at_send_prompted();
@@ -37,11 +39,112 @@ static void GIVEN_awaited_two_unsolicited_WHEN_first_arrives_THEN_the_first_hand
 
 static void UNIT_TEST_at_ignore_echo();
 static void UNIT_TEST_at_handle_response_no_space_after_colon();
+static void GIVEN_at_cmd_handler_WHEN_response_split_into_two_segments_received_THEN_payload_obtained();
+static void GIVEN_unsolicited_handler_WHEN_unsolicited_split_into_two_segments_received_THEN_payload_obtained();
+static void GIVEN_handlers_for_many_unsolicited_WHEN_each_arrives_THEN_only_its_handler_invoked();
+static void GIVEN_unsolicited_handler_WHEN_command_with_longer_name_arrives_THEN_handler_not_invoked();
+static void GIVEN_awaited_command_WHEN_cme_or_cms_error_received_THEN_error_code_obtained_as_payload();
+static void GIVEN_awaited_command_WHEN_call_related_final_result_code_received_THEN_recognised();
+static void GIVEN_custom_cmd_set_WHEN_prefix_get_THEN_prefix_made_of_its_names();
+static void GIVEN_custom_cmd_set_WHEN_responses_received_THEN_handled_independently_of_default_set();
+static void GIVEN_static_handlers_in_cmd_set_WHEN_unsolicited_arrives_THEN_invoked_before_registered_handler();
+static void GIVEN_max_handlers_registered_WHEN_another_registered_THEN_refused_until_one_removed();
+static void GIVEN_registered_handlers_WHEN_unregistered_by_token_THEN_not_invoked_anymore();
+static void GIVEN_coalesced_handler_WHEN_flood_of_unsolicited_arrives_THEN_dispatched_once_with_latest_payload();
+static void GIVEN_unsolicited_observer_WHEN_unsolicited_without_handlers_arrive_THEN_each_one_observed();
+static void GIVEN_timeout_profiles_WHEN_profile_get_THEN_listed_ones_overridden_and_others_default();
+static void GIVEN_typed_handler_WHEN_unsolicited_arrives_THEN_invoked_with_values_of_schema();
+static void GIVEN_typed_static_handler_WHEN_unsolicited_arrives_THEN_invoked_with_values_parsed_in_place();
+static void GIVEN_response_payload_WHEN_parsed_with_schema_THEN_values_or_invalid_payload_obtained();
+static void GIVEN_colon_position_known_WHEN_response_received_THEN_payload_obtained();
+static void GIVEN_classified_lines_WHEN_taken_into_response_or_dispatched_THEN_handled_as_by_whole_handling();
+static void GIVEN_names_sharing_prefix_with_known_names_WHEN_received_THEN_only_exact_names_recognised();
+static void GIVEN_tolerant_matching_WHEN_names_in_other_case_or_with_spaces_received_THEN_recognised();
+static void GIVEN_unsolicited_messages_WHEN_discardable_echo_prefix_get_THEN_empty_only_when_message_starts_with_at();
+static void GIVEN_warmed_up_handler_WHEN_lines_of_scenarios_replayed_THEN_heap_allocations_within_budget();
 
 // --------------------------------------------------------------------------------------------------------------------
 // DECLARATION OF PRIVATE MACROS, FUNCTIONS AND VARIABLES
 // --------------------------------------------------------------------------------------------------------------------
 
+//! A command set of a GNSS module, which is defined by hand, next to the default one from at_cmd_config.hpp.
+struct gnss_cmd_set
+{
+    enum class cmd
+    {
+        at,
+        qgps,
+        qgpsloc,
+        qgpsend,
+        number_of_commands,
+        none
+    };
+
+    enum class unsolicited_msg
+    {
+        rdy,
+        number_of_msgs,
+        none
+    };
+
+    static constexpr std::array<std::string_view, 4> cmd_names{"", "QGPS", "QGPSLOC", "QGPSEND"};
+    static constexpr std::size_t first_extended_cmd_idx{1};
+    static constexpr std::array<std::string_view, 1> unsolicited_msg_strs{"RDY"};
+};
+
+using gnss_cmd_handler = jungles::at_cmd_handler<gnss_cmd_set>;
+
+static std::string static_loc_payload;
+static int static_rdy_cnt;
+
+static void on_static_loc(line_view payload)
+{
+    static_loc_payload = payload.to_string<std::string>();
+}
+
+static void on_static_rdy()
+{
+    static_rdy_cnt++;
+}
+
+//! The same GNSS command set, whose unsolicited handlers are known at build time.
+struct gnss_static_cmd_set : gnss_cmd_set
+{
+    static constexpr std::array<at_static_cmd_handler<cmd>, 1> static_cmd_handlers{{{cmd::qgpsloc, &on_static_loc}}};
+    static constexpr std::array<at_static_msg_handler<unsolicited_msg>, 1> static_msg_handlers{
+        {{unsolicited_msg::rdy, &on_static_rdy}}};
+};
+
+static int static_typed_loc_fix;
+static std::string static_typed_loc_latitude;
+
+static void on_static_typed_loc(line_view latitude, int fix)
+{
+    static_typed_loc_latitude = latitude.to_string();
+    static_typed_loc_fix = fix;
+}
+
+using qgpsloc_schema = at_cmd_schema<gnss_cmd_set::cmd::qgpsloc, unquoted_string, int>;
+
+//! The same GNSS command set, whose static handler gets the typed values.
+struct gnss_typed_cmd_set : gnss_cmd_set
+{
+    static constexpr std::array<at_static_cmd_handler<cmd>, 1> static_cmd_handlers{
+        {{cmd::qgpsloc, &at_typed_static_handler<qgpsloc_schema, on_static_typed_loc>}}};
+};
+
+//! The timeout profiles may be given as a plain array.
+struct gnss_slow_cmd_set : gnss_cmd_set
+{
+    static constexpr at_cmd_timeout<cmd> timeout_profiles[]{{cmd::qgpsloc, {30000, 500}}, {cmd::qgpsend, {2000}}};
+};
+
+//! The same GNSS command set, of a module which doesn't keep to the case and to the spacing of the names.
+struct gnss_tolerant_cmd_set : gnss_cmd_set
+{
+    static constexpr bool is_tolerant_matching{true};
+};
+
 // --------------------------------------------------------------------------------------------------------------------
 // EXECUTION OF THE TESTS
 // --------------------------------------------------------------------------------------------------------------------
@@ -54,6 +157,7 @@ void test_at_cmd_handler()
     RUN_TEST(UNIT_TEST_at_prepare_cmd_test);
     RUN_TEST(UNIT_TEST_at_prepare_cmd_exec);
     RUN_TEST(UNIT_TEST_at_prepare_cmd_read);
+    RUN_TEST(UNIT_TEST_at_get_cmd_prefix);
 
     RUN_TEST(UNIT_TEST_at_handle_unsolicited_one_shot);
     RUN_TEST(UNIT_TEST_at_handle_unsolicited_multiple_times);
@@ -72,6 +176,29 @@ void test_at_cmd_handler()
 
     RUN_TEST(UNIT_TEST_at_ignore_echo);
     RUN_TEST(UNIT_TEST_at_handle_response_no_space_after_colon);
+    RUN_TEST(GIVEN_at_cmd_handler_WHEN_response_split_into_two_segments_received_THEN_payload_obtained);
+    RUN_TEST(GIVEN_unsolicited_handler_WHEN_unsolicited_split_into_two_segments_received_THEN_payload_obtained);
+    RUN_TEST(GIVEN_handlers_for_many_unsolicited_WHEN_each_arrives_THEN_only_its_handler_invoked);
+    RUN_TEST(GIVEN_unsolicited_handler_WHEN_command_with_longer_name_arrives_THEN_handler_not_invoked);
+    RUN_TEST(GIVEN_awaited_command_WHEN_cme_or_cms_error_received_THEN_error_code_obtained_as_payload);
+    RUN_TEST(GIVEN_awaited_command_WHEN_call_related_final_result_code_received_THEN_recognised);
+    RUN_TEST(GIVEN_custom_cmd_set_WHEN_prefix_get_THEN_prefix_made_of_its_names);
+    RUN_TEST(GIVEN_custom_cmd_set_WHEN_responses_received_THEN_handled_independently_of_default_set);
+    RUN_TEST(GIVEN_static_handlers_in_cmd_set_WHEN_unsolicited_arrives_THEN_invoked_before_registered_handler);
+    RUN_TEST(GIVEN_max_handlers_registered_WHEN_another_registered_THEN_refused_until_one_removed);
+    RUN_TEST(GIVEN_registered_handlers_WHEN_unregistered_by_token_THEN_not_invoked_anymore);
+    RUN_TEST(GIVEN_coalesced_handler_WHEN_flood_of_unsolicited_arrives_THEN_dispatched_once_with_latest_payload);
+    RUN_TEST(GIVEN_unsolicited_observer_WHEN_unsolicited_without_handlers_arrive_THEN_each_one_observed);
+    RUN_TEST(GIVEN_timeout_profiles_WHEN_profile_get_THEN_listed_ones_overridden_and_others_default);
+    RUN_TEST(GIVEN_typed_handler_WHEN_unsolicited_arrives_THEN_invoked_with_values_of_schema);
+    RUN_TEST(GIVEN_typed_static_handler_WHEN_unsolicited_arrives_THEN_invoked_with_values_parsed_in_place);
+    RUN_TEST(GIVEN_response_payload_WHEN_parsed_with_schema_THEN_values_or_invalid_payload_obtained);
+    RUN_TEST(GIVEN_colon_position_known_WHEN_response_received_THEN_payload_obtained);
+    RUN_TEST(GIVEN_classified_lines_WHEN_taken_into_response_or_dispatched_THEN_handled_as_by_whole_handling);
+    RUN_TEST(GIVEN_names_sharing_prefix_with_known_names_WHEN_received_THEN_only_exact_names_recognised);
+    RUN_TEST(GIVEN_tolerant_matching_WHEN_names_in_other_case_or_with_spaces_received_THEN_recognised);
+    RUN_TEST(GIVEN_unsolicited_messages_WHEN_discardable_echo_prefix_get_THEN_empty_only_when_message_starts_with_at);
+    RUN_TEST(GIVEN_warmed_up_handler_WHEN_lines_of_scenarios_replayed_THEN_heap_allocations_within_budget);
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -139,6 +266,18 @@ static void UNIT_TEST_at_prepare_cmd_read()
                              at_cmd_handler::prepare_cmd_prefix_to_transmit(at_cmd::eighth, at_cmd_type::read).c_str());
 }
 
+static void UNIT_TEST_at_get_cmd_prefix()
+{
+    TEST_ASSERT(at_cmd_handler::get_cmd_prefix(at_cmd::at, at_cmd_type::exec) == "AT");
+    TEST_ASSERT(at_cmd_handler::get_cmd_prefix(at_cmd::s0, at_cmd_type::read) == "ATS0?");
+    TEST_ASSERT(at_cmd_handler::get_cmd_prefix(at_cmd::first, at_cmd_type::exec) == "AT+FIRST");
+    TEST_ASSERT(at_cmd_handler::get_cmd_prefix(at_cmd::first, at_cmd_type::write) == "AT+FIRST=");
+    TEST_ASSERT(at_cmd_handler::get_cmd_prefix(at_cmd::tenth, at_cmd_type::test) == "AT+TENTH=?");
+    // The prefixes are generated at compile time, so they are never rebuilt.
+    TEST_ASSERT(at_cmd_handler::get_cmd_prefix(at_cmd::ninth, at_cmd_type::read).data() ==
+                at_cmd_handler::get_cmd_prefix(at_cmd::ninth, at_cmd_type::read).data());
+}
+
 static void UNIT_TEST_at_handle_unsolicited_one_shot()
 {
     at_cmd_handler h;
@@ -462,3 +601,579 @@ static void UNIT_TEST_at_handle_response_no_space_after_colon()
 
     TEST_ASSERT_EQUAL_STRING(expected_pload.c_str(), pload.c_str());
 }
+
+static void GIVEN_at_cmd_handler_WHEN_response_split_into_two_segments_received_THEN_payload_obtained()
+{
+    // GIVEN
+    at_cmd_handler at_handler;
+    std::string pload;
+    auto awaited_cmd = at_cmd::eighth;
+
+    // WHEN
+    TEST_ASSERT(at_handler.handle_received_response(line_view("+EIG", "HTH: SPLIT"), awaited_cmd, pload) ==
+                at_err::handling_cmd);
+    TEST_ASSERT(at_handler.handle_received_response(line_view("O", "K"), awaited_cmd, pload) == at_err::ok);
+
+    // THEN
+    TEST_ASSERT_EQUAL_STRING("SPLIT", pload.c_str());
+}
+
+static void GIVEN_unsolicited_handler_WHEN_unsolicited_split_into_two_segments_received_THEN_payload_obtained()
+{
+    // GIVEN
+    at_cmd_handler at_handler;
+    std::string pload;
+    at_handler.register_unsolicited_handler(at_cmd::tenth, [&pload](std::unique_ptr<std::string> response) {
+        pload = std::move(*response);
+        return true;
+    });
+
+    // WHEN
+    std::string dummy_pload;
+    TEST_ASSERT(at_handler.handle_received_response(line_view("+TENTH: PAY", "LOAD"), at_cmd::none, dummy_pload) ==
+                at_err::unknown);
+
+    // THEN
+    TEST_ASSERT_EQUAL_STRING("PAYLOAD", pload.c_str());
+}
+
+static void GIVEN_handlers_for_many_unsolicited_WHEN_each_arrives_THEN_only_its_handler_invoked()
+{
+    // GIVEN
+    at_cmd_handler at_handler;
+    std::string third_pload, ninth_pload;
+    int no_carrier_cnt = 0, neul_cnt = 0;
+    at_handler.register_unsolicited_handler(at_cmd::third, [&third_pload](std::unique_ptr<std::string> response) {
+        third_pload += *response;
+        return false;
+    });
+    at_handler.register_unsolicited_handler(at_cmd::ninth, [&ninth_pload](std::unique_ptr<std::string> response) {
+        ninth_pload += *response;
+        return false;
+    });
+    at_handler.register_unsolicited_handler(at_unsolicited_msg::no_carrier, [&no_carrier_cnt]() {
+        no_carrier_cnt++;
+        return false;
+    });
+    at_handler.register_unsolicited_handler(at_unsolicited_msg::neul, [&neul_cnt]() {
+        neul_cnt++;
+        return false;
+    });
+
+    // WHEN
+    std::string dummy_pload;
+    at_handler.handle_received_response(std::make_unique<std::string>("+NINTH: 9"), at_cmd::none, dummy_pload);
+    at_handler.handle_received_response(std::make_unique<std::string>("NO CARRIER"), at_cmd::none, dummy_pload);
+    at_handler.handle_received_response(std::make_unique<std::string>("+THIRD: 3"), at_cmd::none, dummy_pload);
+    at_handler.handle_received_response(std::make_unique<std::string>("+FIFTH: 5"), at_cmd::none, dummy_pload);
+    at_handler.handle_received_response(std::make_unique<std::string>("+NINTH:99"), at_cmd::none, dummy_pload);
+
+    // THEN
+    TEST_ASSERT_EQUAL_STRING("3", third_pload.c_str());
+    TEST_ASSERT_EQUAL_STRING("999", ninth_pload.c_str());
+    TEST_ASSERT_EQUAL(1, no_carrier_cnt);
+    TEST_ASSERT_EQUAL(0, neul_cnt);
+}
+
+static void GIVEN_unsolicited_handler_WHEN_command_with_longer_name_arrives_THEN_handler_not_invoked()
+{
+    // GIVEN
+    at_cmd_handler at_handler;
+    int cnt = 0;
+    at_handler.register_unsolicited_handler(at_cmd::first, [&cnt](std::unique_ptr<std::string>) {
+        cnt++;
+        return false;
+    });
+
+    // WHEN
+    std::string dummy_pload;
+    at_handler.handle_received_response(std::make_unique<std::string>("+FIRSTLY: 1"), at_cmd::none, dummy_pload);
+    at_handler.handle_received_response(std::make_unique<std::string>("+FIRST"), at_cmd::none, dummy_pload);
+
+    // THEN
+    TEST_ASSERT_EQUAL(1, cnt);
+}
+
+static void GIVEN_awaited_command_WHEN_cme_or_cms_error_received_THEN_error_code_obtained_as_payload()
+{
+    // GIVEN
+    at_cmd_handler at_handler;
+    std::string cme_pload, cms_pload;
+
+    // WHEN
+    auto cme_res =
+        at_handler.handle_received_response(std::make_unique<std::string>("+CME ERROR: 10"), at_cmd::first, cme_pload);
+    auto cms_res =
+        at_handler.handle_received_response(std::make_unique<std::string>("+CMS ERROR:304"), at_cmd::second, cms_pload);
+
+    // THEN
+    TEST_ASSERT(cme_res == at_err::cme_error);
+    TEST_ASSERT(cms_res == at_err::cms_error);
+    TEST_ASSERT(is_final_result_code(cme_res));
+    TEST_ASSERT(is_final_result_code(cms_res));
+    TEST_ASSERT_EQUAL_STRING("10", cme_pload.c_str());
+    TEST_ASSERT_EQUAL_STRING("304", cms_pload.c_str());
+}
+
+static void GIVEN_awaited_command_WHEN_call_related_final_result_code_received_THEN_recognised()
+{
+    // GIVEN
+    at_cmd_handler at_handler;
+    std::string pload;
+    auto awaited_cmd = at_cmd::first;
+    auto handle = [&](const char *response) {
+        return at_handler.handle_received_response(std::make_unique<std::string>(response), awaited_cmd, pload);
+    };
+
+    // WHEN, THEN
+    TEST_ASSERT(handle("NO CARRIER") == at_err::no_carrier);
+    TEST_ASSERT(handle("BUSY") == at_err::busy);
+    TEST_ASSERT(handle("NO ANSWER") == at_err::no_answer);
+    TEST_ASSERT(handle("CONNECT") == at_err::connect);
+    TEST_ASSERT(handle("CONNECT 115200") == at_err::connect);
+    TEST_ASSERT(handle("CONNECTED") == at_err::handling_cmd);
+    TEST_ASSERT(!is_final_result_code(at_err::handling_cmd));
+    TEST_ASSERT(!is_final_result_code(at_err::prompt_request));
+}
+
+static void GIVEN_custom_cmd_set_WHEN_prefix_get_THEN_prefix_made_of_its_names()
+{
+    using cmd = gnss_cmd_set::cmd;
+
+    // The prefixes of the custom command set are generated at compile time, as well as the default ones.
+    static_assert(gnss_cmd_handler::get_cmd_prefix(cmd::qgpsloc, at_cmd_type::write) == "AT+QGPSLOC=");
+    TEST_ASSERT(gnss_cmd_handler::get_cmd_prefix(cmd::at, at_cmd_type::exec) == "AT");
+    TEST_ASSERT(gnss_cmd_handler::get_cmd_prefix(cmd::qgps, at_cmd_type::read) == "AT+QGPS?");
+    TEST_ASSERT(gnss_cmd_handler::get_cmd_prefix(cmd::qgpsend, at_cmd_type::test) == "AT+QGPSEND=?");
+    TEST_ASSERT(gnss_cmd_handler::is_extended_cmd(cmd::qgps));
+    TEST_ASSERT(!gnss_cmd_handler::is_extended_cmd(cmd::at));
+}
+
+static void GIVEN_custom_cmd_set_WHEN_responses_received_THEN_handled_independently_of_default_set()
+{
+    using cmd = gnss_cmd_set::cmd;
+
+    // GIVEN
+    gnss_cmd_handler gnss_handler;
+    at_cmd_handler modem_handler;
+    int gnss_rdy_cnt = 0, modem_cnt = 0;
+    gnss_handler.register_unsolicited_handler(gnss_cmd_set::unsolicited_msg::rdy, [&gnss_rdy_cnt]() {
+        gnss_rdy_cnt++;
+        return false;
+    });
+    modem_handler.register_unsolicited_handler(at_cmd::first, [&modem_cnt](std::unique_ptr<std::string>) {
+        modem_cnt++;
+        return false;
+    });
+
+    // WHEN
+    std::string gnss_pload, dummy_pload;
+    gnss_handler.handle_received_response(std::make_unique<std::string>("RDY"), cmd::none, dummy_pload);
+    auto loc_res = gnss_handler.handle_received_response(
+        std::make_unique<std::string>("+QGPSLOC: 061951.0,3150.7223N"), cmd::qgpsloc, gnss_pload);
+    // The command of the other set isn't known to the GNSS handler.
+    gnss_handler.handle_received_response(std::make_unique<std::string>("+FIRST: 1"), cmd::none, dummy_pload);
+    auto ok_res = gnss_handler.handle_received_response(std::make_unique<std::string>("OK"), cmd::qgpsloc, gnss_pload);
+
+    // THEN
+    TEST_ASSERT(loc_res == at_err::handling_cmd);
+    TEST_ASSERT(ok_res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("061951.0,3150.7223N", gnss_pload.c_str());
+    TEST_ASSERT_EQUAL(1, gnss_rdy_cnt);
+    TEST_ASSERT_EQUAL(0, modem_cnt);
+}
+
+static void GIVEN_static_handlers_in_cmd_set_WHEN_unsolicited_arrives_THEN_invoked_before_registered_handler()
+{
+    using cmd = gnss_static_cmd_set::cmd;
+
+    // GIVEN
+    jungles::at_cmd_handler<gnss_static_cmd_set> h;
+    static_loc_payload.clear();
+    static_rdy_cnt = 0;
+    std::string registered_pload, static_pload_seen_by_registered, dummy_pload;
+    h.register_unsolicited_handler(cmd::qgpsloc, [&](std::unique_ptr<std::string> pload) {
+        static_pload_seen_by_registered = static_loc_payload;
+        registered_pload = *pload;
+        return true;
+    });
+
+    // WHEN
+    h.handle_received_response(std::make_unique<std::string>("+QGPSLOC: 1,2"), cmd::none, dummy_pload);
+    h.handle_received_response(std::make_unique<std::string>("+QGPSLOC: 3,4"), cmd::none, dummy_pload);
+    h.handle_received_response(std::make_unique<std::string>("RDY"), cmd::none, dummy_pload);
+
+    // THEN
+    TEST_ASSERT_EQUAL_STRING("1,2", static_pload_seen_by_registered.c_str());
+    TEST_ASSERT_EQUAL_STRING("1,2", registered_pload.c_str());
+    // The static handler stays, while the registered one-shot handler is removed.
+    TEST_ASSERT_EQUAL_STRING("3,4", static_loc_payload.c_str());
+    TEST_ASSERT_EQUAL(1, static_rdy_cnt);
+}
+
+static void GIVEN_max_handlers_registered_WHEN_another_registered_THEN_refused_until_one_removed()
+{
+    // GIVEN
+    at_cmd_handler h;
+    int cnt = 0;
+    auto one_shot = [&cnt](std::unique_ptr<std::string>) {
+        cnt++;
+        return true;
+    };
+    for (unsigned i = 0; i < AT_CMD_HANDLER_MAX_UNSOLICITED_HANDLERS; ++i)
+        TEST_ASSERT(h.register_unsolicited_handler(i % 2 ? at_cmd::first : at_cmd::second, one_shot));
+
+    // WHEN
+    auto is_registered_when_full = h.register_unsolicited_handler(at_cmd::third, one_shot);
+    std::string pload;
+    h.handle_received_response(std::make_unique<std::string>("+SECOND: 1"), at_cmd::none, pload);
+    auto is_registered_after_removal = h.register_unsolicited_handler(at_cmd::third, one_shot);
+
+    // THEN
+    TEST_ASSERT(!is_registered_when_full);
+    TEST_ASSERT(is_registered_after_removal);
+    TEST_ASSERT_EQUAL(1, cnt);
+}
+
+static void GIVEN_registered_handlers_WHEN_unregistered_by_token_THEN_not_invoked_anymore()
+{
+    // GIVEN
+    at_cmd_handler h;
+    int first_cnt = 0, second_cnt = 0, msg_cnt = 0;
+    at_handler_token self_token;
+    auto first = h.register_unsolicited_handler(at_cmd::first, [&](std::unique_ptr<std::string>) {
+        first_cnt++;
+        // Removes itself, although it returns false.
+        h.unregister_unsolicited_handler(self_token);
+        return false;
+    });
+    self_token = first;
+    h.register_unsolicited_handler(at_cmd::first, [&second_cnt](std::unique_ptr<std::string>) {
+        second_cnt++;
+        return false;
+    });
+    auto msg = h.register_unsolicited_handler(at_unsolicited_msg::neul, [&msg_cnt]() {
+        msg_cnt++;
+        return false;
+    });
+
+    // WHEN
+    auto is_msg_unregistered = h.unregister_unsolicited_handler(msg);
+    std::string pload;
+    h.handle_received_response(std::make_unique<std::string>("+FIRST: 1"), at_cmd::none, pload);
+    h.handle_received_response(std::make_unique<std::string>("+FIRST: 2"), at_cmd::none, pload);
+    h.handle_received_response(std::make_unique<std::string>("Neul"), at_cmd::none, pload);
+
+    // THEN
+    TEST_ASSERT(is_msg_unregistered);
+    TEST_ASSERT(!h.unregister_unsolicited_handler(msg));
+    TEST_ASSERT(!h.unregister_unsolicited_handler(first));
+    TEST_ASSERT_EQUAL(1, first_cnt);
+    TEST_ASSERT_EQUAL(1, second_cnt);
+    TEST_ASSERT_EQUAL(0, msg_cnt);
+}
+
+static void GIVEN_coalesced_handler_WHEN_flood_of_unsolicited_arrives_THEN_dispatched_once_with_latest_payload()
+{
+    // GIVEN
+    at_cmd_handler h;
+    unsigned dispatched_num = 0;
+    at_handler_token dispatched_token;
+    h.set_deferred_dispatcher([&](at_handler_token token, at_payload_ptr) {
+        dispatched_num++;
+        dispatched_token = token;
+        return true;
+    });
+    std::string handled_pload;
+    auto token = h.register_unsolicited_handler(
+        at_cmd::first,
+        [&handled_pload](std::unique_ptr<std::string> pload) {
+            handled_pload = *pload;
+            return false;
+        },
+        at_dispatch::coalesced);
+
+    // WHEN
+    std::string pload;
+    h.handle_received_response(std::make_unique<std::string>("+FIRST: 11"), at_cmd::none, pload);
+    h.handle_received_response(std::make_unique<std::string>("+FIRST: 22"), at_cmd::none, pload);
+    h.handle_received_response(std::make_unique<std::string>("+FIRST: 3"), at_cmd::none, pload);
+    h.invoke_deferred_handler(dispatched_token, nullptr);
+    h.handle_received_response(std::make_unique<std::string>("+FIRST: 4"), at_cmd::none, pload);
+
+    // THEN
+    TEST_ASSERT(token.record.index == dispatched_token.record.index);
+    TEST_ASSERT_EQUAL_STRING("3", handled_pload.c_str());
+    // The arrival after the handler has taken the payload wakes the dispatcher again.
+    TEST_ASSERT_EQUAL(2, dispatched_num);
+}
+
+static void GIVEN_unsolicited_observer_WHEN_unsolicited_without_handlers_arrive_THEN_each_one_observed()
+{
+    // GIVEN
+    at_cmd_handler h;
+    std::string observed;
+    h.set_unsolicited_observer([&observed](at_cmd command, at_unsolicited_msg message, const line_view &payload) {
+        observed += std::to_string(static_cast<int>(command)) + "/" + std::to_string(static_cast<int>(message)) + "/"
+            + payload.to_string() + ";";
+    });
+
+    // WHEN
+    std::string pload;
+    h.handle_received_response(std::make_unique<std::string>("+SECOND: 1,2"), at_cmd::none, pload);
+    h.handle_received_response(std::make_unique<std::string>("NO CARRIER"), at_cmd::none, pload);
+    h.handle_received_response(std::make_unique<std::string>("+UNKNOWN: 3"), at_cmd::none, pload);
+
+    // THEN
+    auto expected = std::to_string(static_cast<int>(at_cmd::second)) + "/"
+        + std::to_string(static_cast<int>(at_unsolicited_msg::none)) + "/1,2;"
+        + std::to_string(static_cast<int>(at_cmd::none)) + "/"
+        + std::to_string(static_cast<int>(at_unsolicited_msg::no_carrier)) + "/NO CARRIER;";
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), observed.c_str());
+}
+
+static void GIVEN_timeout_profiles_WHEN_profile_get_THEN_listed_ones_overridden_and_others_default()
+{
+    using slow_cmd_handler = jungles::at_cmd_handler<gnss_slow_cmd_set>;
+    using cmd = gnss_slow_cmd_set::cmd;
+
+    // The profiles are looked up in a table made at compile time.
+    static_assert(slow_cmd_handler::get_timeout_profile(cmd::qgpsloc).total_ms == 30000);
+    TEST_ASSERT_EQUAL(500, slow_cmd_handler::get_timeout_profile(cmd::qgpsloc).inter_line_ms);
+    TEST_ASSERT_EQUAL(2000, slow_cmd_handler::get_timeout_profile(cmd::qgpsend).total_ms);
+    TEST_ASSERT_EQUAL(0, slow_cmd_handler::get_timeout_profile(cmd::qgpsend).inter_line_ms);
+    TEST_ASSERT_EQUAL(AT_CMD_HANDLER_DEFAULT_TIMEOUT_MS, slow_cmd_handler::get_timeout_profile(cmd::qgps).total_ms);
+    TEST_ASSERT_EQUAL(AT_CMD_HANDLER_DEFAULT_TIMEOUT_MS, gnss_cmd_handler::get_timeout_profile(cmd::qgpsloc).total_ms);
+    TEST_ASSERT_EQUAL(180000, at_cmd_handler::get_timeout_profile(at_cmd::tenth).total_ms);
+    TEST_ASSERT_EQUAL(5000, at_cmd_handler::get_timeout_profile(at_cmd::tenth).inter_line_ms);
+}
+
+static void GIVEN_typed_handler_WHEN_unsolicited_arrives_THEN_invoked_with_values_of_schema()
+{
+    // GIVEN
+    at_cmd_handler h;
+    std::string received;
+    h.register_typed_handler<at_cmd::second>([&received](line_view name, int value) {
+        received += name.to_string() + "=" + std::to_string(value) + ";";
+        return value == 0;
+    });
+
+    // WHEN
+    std::string pload;
+    h.handle_received_response(std::make_unique<std::string>("+SECOND: \"apn\",-3"), at_cmd::none, pload);
+    // Doesn't match the schema, so it's ignored.
+    h.handle_received_response(std::make_unique<std::string>("+SECOND: apn,4"), at_cmd::none, pload);
+    h.handle_received_response(std::make_unique<std::string>("+SECOND: \"ims\", 0"), at_cmd::none, pload);
+    h.handle_received_response(std::make_unique<std::string>("+SECOND: \"apn\",5"), at_cmd::none, pload);
+
+    // THEN
+    TEST_ASSERT_EQUAL_STRING("apn=-3;ims=0;", received.c_str());
+}
+
+static void GIVEN_typed_static_handler_WHEN_unsolicited_arrives_THEN_invoked_with_values_parsed_in_place()
+{
+    // GIVEN
+    jungles::at_cmd_handler<gnss_typed_cmd_set> h;
+    static_typed_loc_latitude.clear();
+    static_typed_loc_fix = 0;
+    std::string pload;
+
+    // WHEN
+    // The line wraps around the end of the RX buffer.
+    h.handle_received_response(line_view("+QGPSLOC: 4807.0", "38N,3"), gnss_cmd_set::cmd::none, pload);
+
+    // THEN
+    TEST_ASSERT_EQUAL_STRING("4807.038N", static_typed_loc_latitude.c_str());
+    TEST_ASSERT_EQUAL(3, static_typed_loc_fix);
+}
+
+static void GIVEN_response_payload_WHEN_parsed_with_schema_THEN_values_or_invalid_payload_obtained()
+{
+    // GIVEN
+    at_cmd_handler::payload_values<at_cmd::first> values, ignored;
+
+    // WHEN
+    auto ok = at_cmd_handler::parse_response<at_cmd::first>(at_err::ok, "0,1", values);
+    auto invalid = at_cmd_handler::parse_response<at_cmd::first>(at_err::ok, "0,", ignored);
+    auto error = at_cmd_handler::parse_response<at_cmd::first>(at_err::cme_error, "10", ignored);
+
+    // THEN
+    TEST_ASSERT(ok == at_err::ok);
+    TEST_ASSERT(invalid == at_err::invalid_payload);
+    TEST_ASSERT(error == at_err::cme_error);
+    auto [first, second] = values;
+    TEST_ASSERT_EQUAL(0, first);
+    TEST_ASSERT_EQUAL(1, second);
+}
+
+static void GIVEN_colon_position_known_WHEN_response_received_THEN_payload_obtained()
+{
+    // GIVEN
+    at_cmd_handler at_handler;
+    std::string pload;
+    auto awaited_cmd = at_cmd::eighth;
+
+    // WHEN
+    auto res = at_handler.handle_received_response(line_view("+EIG", "HTH: 12:30"), 7, awaited_cmd, pload);
+    auto other = at_handler.handle_received_response(line_view("+NINTH: 1"), 6, awaited_cmd, pload);
+    auto no_colon = at_handler.handle_received_response(line_view("+EIGHTH"), 7, awaited_cmd, pload);
+
+    // THEN
+    TEST_ASSERT(res == at_err::handling_cmd);
+    TEST_ASSERT(other == at_err::unknown);
+    TEST_ASSERT(no_colon == at_err::handling_cmd);
+    TEST_ASSERT_EQUAL_STRING("12:30\r\n", pload.c_str());
+}
+
+static void GIVEN_classified_lines_WHEN_taken_into_response_or_dispatched_THEN_handled_as_by_whole_handling()
+{
+    // GIVEN
+    at_cmd_handler at_handler;
+    std::string pload;
+    auto awaited_cmd = at_cmd::fourth;
+    int urc_cnt = 0;
+    at_handler.register_unsolicited_handler(at_cmd::third, [&urc_cnt](std::unique_ptr<std::string>) {
+        urc_cnt++;
+        return false;
+    });
+    auto classify = [](line_view response) {
+        return at_cmd_handler::classify_response(response, at_cmd_handler::unknown_colon_pos);
+    };
+    auto echo = classify(line_view("AT+FOURTH=MEXICO"));
+    auto payload = classify(line_view("+FOURTH: ARGENTINA"));
+    auto urc = classify(line_view("+THIRD: 1"));
+    auto ok = classify(line_view("OK"));
+
+    // WHEN
+    auto echo_res = at_cmd_handler::take_response_line(line_view("AT+FOURTH=MEXICO"), echo, awaited_cmd, pload);
+    auto payload_res = at_cmd_handler::take_response_line(line_view("+FOURTH: ARGENTINA"), payload, awaited_cmd, pload);
+    at_handler.handle_unsolicited_response(line_view("+THIRD: 1"), urc);
+    auto ok_res = at_cmd_handler::take_response_line(line_view("OK"), ok, awaited_cmd, pload);
+
+    // THEN
+    TEST_ASSERT_TRUE(at_cmd_handler::is_part_of_response(echo, awaited_cmd));
+    TEST_ASSERT_TRUE(at_cmd_handler::is_part_of_response(payload, awaited_cmd));
+    TEST_ASSERT_FALSE(at_cmd_handler::is_part_of_response(urc, awaited_cmd));
+    TEST_ASSERT_TRUE(at_cmd_handler::is_part_of_response(ok, awaited_cmd));
+    // Nothing is a part of the response when no command is awaited.
+    TEST_ASSERT_FALSE(at_cmd_handler::is_part_of_response(ok, at_cmd::none));
+    TEST_ASSERT(echo_res == at_err::unknown);
+    TEST_ASSERT(payload_res == at_err::handling_cmd);
+    TEST_ASSERT(ok_res == at_err::ok);
+    TEST_ASSERT_EQUAL(1, urc_cnt);
+    TEST_ASSERT_EQUAL_STRING("ARGENTINA", pload.c_str());
+}
+
+static void GIVEN_names_sharing_prefix_with_known_names_WHEN_received_THEN_only_exact_names_recognised()
+{
+    // GIVEN
+    at_cmd_handler at_handler;
+    std::string pload;
+    auto awaited_cmd = at_cmd::first;
+    auto handle = [&](line_view response) {
+        return at_handler.handle_received_response(response, awaited_cmd, pload);
+    };
+
+    // WHEN, THEN
+    TEST_ASSERT(handle(line_view("+FIRS: 1")) == at_err::unknown);
+    TEST_ASSERT(handle(line_view("+FIRSTS: 1")) == at_err::unknown);
+    TEST_ASSERT(handle(line_view("+F: 1")) == at_err::unknown);
+    TEST_ASSERT(handle(line_view("+: 1")) == at_err::unknown);
+    TEST_ASSERT(handle(line_view("+CME ERRO: 1")) == at_err::unknown);
+    TEST_ASSERT(handle(line_view("+CME ERRORS: 1")) == at_err::unknown);
+    TEST_ASSERT(handle(line_view("+CMS ERROR: 1")) == at_err::cms_error);
+    pload.clear();
+    TEST_ASSERT(handle(line_view("+FI", "RST: 2")) == at_err::handling_cmd);
+    TEST_ASSERT_EQUAL_STRING("2", pload.c_str());
+}
+
+static void GIVEN_tolerant_matching_WHEN_names_in_other_case_or_with_spaces_received_THEN_recognised()
+{
+    // GIVEN
+    jungles::at_cmd_handler<gnss_tolerant_cmd_set> h;
+    std::string pload;
+    auto awaited_cmd = gnss_cmd_set::cmd::qgpsloc;
+    auto handle = [&](line_view response) {
+        pload.clear();
+        return h.handle_received_response(response, awaited_cmd, pload);
+    };
+
+    // WHEN, THEN
+    TEST_ASSERT(handle(line_view("+QGPSLOC: 1")) == at_err::handling_cmd);
+    TEST_ASSERT(handle(line_view("+QgpsLoc:2")) == at_err::handling_cmd);
+    TEST_ASSERT_EQUAL_STRING("2", pload.c_str());
+    TEST_ASSERT(handle(line_view("+qgps", "loc :  3,4")) == at_err::handling_cmd);
+    TEST_ASSERT_EQUAL_STRING("3,4", pload.c_str());
+    TEST_ASSERT(handle(line_view("+qgpsend: 1")) == at_err::unknown);
+    TEST_ASSERT(handle(line_view("+cme error: 10")) == at_err::cme_error);
+    TEST_ASSERT_EQUAL_STRING("10", pload.c_str());
+    TEST_ASSERT(handle(line_view("+CMS  ERROR : 304")) == at_err::cms_error);
+    TEST_ASSERT_EQUAL_STRING("304", pload.c_str());
+}
+
+static void GIVEN_unsolicited_messages_WHEN_discardable_echo_prefix_get_THEN_empty_only_when_message_starts_with_at()
+{
+    // GIVEN
+    // The default set has the messages "Neul" and "NO CARRIER", the echo of a command can't be taken for them.
+
+    // WHEN
+    constexpr auto prefix = at_cmd_handler::get_discardable_echo_prefix();
+
+    // THEN
+    TEST_ASSERT((prefix == "AT"));
+}
+
+static void GIVEN_warmed_up_handler_WHEN_lines_of_scenarios_replayed_THEN_heap_allocations_within_budget()
+{
+    // GIVEN
+    // The lines of the scenarios above, received while the command is awaited.
+    static const std::pair<at_cmd, std::string_view> responses[] = {
+        {at_cmd::first, "+FIRST: 0,1"},
+        {at_cmd::first, "OK"},
+        {at_cmd::seventh, "+SEVENTH: First coconut line"},
+        {at_cmd::seventh, "+THIRD: totally transparent"},
+        {at_cmd::seventh, "+SEVENTH: Second coconut line"},
+        {at_cmd::seventh, "OK"},
+        {at_cmd::eighth, "+EIGHTH: 1,\"first\""},
+        {at_cmd::eighth, "ERROR"},
+        {at_cmd::second, "+CME ERROR: 10"},
+    };
+    static const std::string_view unsolicited[] = {
+        "+FIFTH: 5",
+        "+FIFTH: some unsolicited payload which doesn't fit into the string itself",
+        "+SIXTH: not handled",
+    };
+    at_cmd_handler h;
+    unsigned handled_num = 0;
+    h.register_unsolicited_handler(at_cmd::fifth, [&handled_num](at_payload_ptr) {
+        handled_num++;
+        return false;
+    });
+    at_string pload;
+    auto replay_responses = [&] {
+        for (const auto &[awaited_cmd, line] : responses)
+            if (is_final_result_code(h.handle_received_response(line_view(line), awaited_cmd, pload)))
+                pload.clear();
+    };
+    // The payload of the issuer grows to the length of the longest response once.
+    replay_responses();
+
+    // WHEN
+    constexpr size_t replays_num = 16;
+    {
+        alloc_tracking_scope scope;
+        for (size_t i = 0; i < replays_num; ++i)
+            replay_responses();
+        TEST_ASSERT_ALLOC_BUDGET(scope, ALLOC_BUDGET_PER_RESPONSE_LINE, replays_num * std::size(responses));
+    }
+    {
+        alloc_tracking_scope scope;
+        for (size_t i = 0; i < replays_num; ++i)
+            for (auto line : unsolicited)
+                h.handle_received_response(line_view(line), at_cmd::none, pload);
+        TEST_ASSERT_ALLOC_BUDGET(scope, ALLOC_BUDGET_PER_UNSOLICITED_LINE, replays_num * std::size(unsolicited));
+    }
+
+    // THEN
+    TEST_ASSERT_EQUAL(replays_num * 2, handled_num);
+}
@@ -0,0 +1,217 @@
+/**
+ * @file	at_host_test.cpp
+ * @brief	Contains unit tests of the backend which drives the modems from a Linux process.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "at_cmd_handler.hpp"
+#include "at_host.hpp"
+#include "unity.h"
+#include <atomic>
+#include <memory>
+#include <sys/socket.h>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_echoing_modem_WHEN_command_sent_THEN_echo_skipped_and_response_obtained();
+static void GIVEN_modems_on_one_reactor_WHEN_commands_sent_concurrently_THEN_each_gets_own_response();
+static void GIVEN_command_not_responded_WHEN_timeout_passes_THEN_timeout_and_next_command_handled();
+static void GIVEN_unsolicited_handler_WHEN_unsolicited_command_arrives_THEN_handler_invoked();
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF PRIVATE MACROS, FUNCTIONS AND VARIABLES
+// --------------------------------------------------------------------------------------------------------------------
+struct host_config
+{
+    static constexpr size_t rx_buf_len = 256;
+    static constexpr size_t rx_lines_num = 16;
+    static constexpr size_t cmd_queue_len = 4;
+};
+
+using host_channel = jungles::at_host_channel<at_default_cmd_set, host_config>;
+
+/**
+ * Simulates a modem on the other end of a socket pair: answers each received command with the string returned by
+ * the responder, which may be empty.
+ */
+class fake_modem
+{
+  public:
+    using responder = std::function<std::string(const std::string &command)>;
+
+    explicit fake_modem(responder &&respond) : m_respond{std::move(respond)}
+    {
+        socketpair(AF_UNIX, SOCK_STREAM, 0, m_fds);
+        m_thread = std::thread([this] { run(); });
+    }
+
+    ~fake_modem()
+    {
+        // The modem sees the end of the stream and finishes.
+        shutdown(m_fds[0], SHUT_RDWR);
+        m_thread.join();
+        close(m_fds[0]);
+        close(m_fds[1]);
+    }
+
+    //! The end of the port at the side of the channel.
+    int get_port() const
+    {
+        return m_fds[0];
+    }
+
+    void send(std::string_view bytes)
+    {
+        auto written = write(m_fds[1], bytes.data(), bytes.length());
+        (void)written;
+    }
+
+  private:
+    responder m_respond;
+    int m_fds[2];
+    std::thread m_thread;
+
+    void run()
+    {
+        std::string line;
+        char c;
+        while (read(m_fds[1], &c, 1) == 1)
+        {
+            line.push_back(c);
+            if (line.length() < 2 || line.compare(line.length() - 2, 2, "\r\n") != 0)
+                continue;
+            line.resize(line.length() - 2);
+            send(m_respond(line));
+            line.clear();
+        }
+    }
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXECUTION OF THE TESTS
+// --------------------------------------------------------------------------------------------------------------------
+void test_at_host()
+{
+    RUN_TEST(GIVEN_echoing_modem_WHEN_command_sent_THEN_echo_skipped_and_response_obtained);
+    RUN_TEST(GIVEN_modems_on_one_reactor_WHEN_commands_sent_concurrently_THEN_each_gets_own_response);
+    RUN_TEST(GIVEN_command_not_responded_WHEN_timeout_passes_THEN_timeout_and_next_command_handled);
+    RUN_TEST(GIVEN_unsolicited_handler_WHEN_unsolicited_command_arrives_THEN_handler_invoked);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_echoing_modem_WHEN_command_sent_THEN_echo_skipped_and_response_obtained()
+{
+    // GIVEN
+    std::string received;
+    fake_modem modem([&received](const std::string &command) {
+        received = command;
+        return command + "\r\n\r\n+FIRST: 1,2\r\n\r\nOK\r\n";
+    });
+    jungles::at_host_reactor reactor;
+    host_channel channel(modem.get_port());
+    channel.attach(reactor);
+    reactor.start();
+
+    // WHEN
+    at_string pload;
+    auto res = channel.send(at_cmd::first, at_cmd_type::read, std::chrono::seconds(5), pload);
+    reactor.remove(modem.get_port());
+
+    // THEN
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("1,2", pload.c_str());
+    TEST_ASSERT_EQUAL_STRING("AT+FIRST?", received.c_str());
+}
+
+static void GIVEN_modems_on_one_reactor_WHEN_commands_sent_concurrently_THEN_each_gets_own_response()
+{
+    // GIVEN
+    constexpr unsigned modems_num = 8;
+    constexpr unsigned commands_num = 20;
+    jungles::at_host_reactor reactor;
+    std::vector<std::unique_ptr<fake_modem>> modems;
+    std::vector<std::unique_ptr<host_channel>> channels;
+    for (unsigned i = 0; i < modems_num; ++i)
+    {
+        auto idx = std::to_string(i);
+        modems.push_back(std::make_unique<fake_modem>([idx](const std::string &command) {
+            return command == "AT+SECOND?" ? "+SECOND: " + idx + "\r\nOK\r\n" : std::string("ERROR\r\n");
+        }));
+        channels.push_back(std::make_unique<host_channel>(modems.back()->get_port()));
+        channels.back()->attach(reactor);
+    }
+    reactor.start();
+
+    // WHEN
+    std::atomic<unsigned> matched_num{0};
+    std::vector<std::thread> issuers;
+    for (unsigned i = 0; i < modems_num; ++i)
+        issuers.emplace_back([&, i] {
+            for (unsigned n = 0; n < commands_num; ++n)
+            {
+                at_string pload;
+                auto res = channels[i]->send(at_cmd::second, at_cmd_type::read, std::chrono::seconds(5), pload);
+                if (res == at_err::ok && pload == std::to_string(i))
+                    matched_num++;
+            }
+        });
+    for (auto &t : issuers)
+        t.join();
+    for (auto &m : modems)
+        reactor.remove(m->get_port());
+
+    // THEN
+    TEST_ASSERT_EQUAL(modems_num * commands_num, matched_num.load());
+}
+
+static void GIVEN_command_not_responded_WHEN_timeout_passes_THEN_timeout_and_next_command_handled()
+{
+    // GIVEN
+    fake_modem modem([](const std::string &command) {
+        return command == "AT+THIRD" ? std::string() : std::string("OK\r\n");
+    });
+    jungles::at_host_reactor reactor;
+    host_channel channel(modem.get_port());
+    channel.attach(reactor);
+    reactor.start();
+
+    // WHEN
+    auto timed_out_res = channel.send(at_cmd::third, at_cmd_type::exec, std::chrono::milliseconds(50));
+    auto res = channel.send(at_cmd::fourth, at_cmd_type::exec, std::chrono::seconds(5));
+    reactor.remove(modem.get_port());
+
+    // THEN
+    TEST_ASSERT(timed_out_res == at_err::timeout);
+    TEST_ASSERT(res == at_err::ok);
+}
+
+static void GIVEN_unsolicited_handler_WHEN_unsolicited_command_arrives_THEN_handler_invoked()
+{
+    // GIVEN
+    fake_modem modem([](const std::string &) { return std::string(); });
+    jungles::at_host_reactor reactor;
+    host_channel channel(modem.get_port());
+    channel.attach(reactor);
+    reactor.start();
+    std::mutex mux;
+    std::condition_variable cv;
+    std::string pload;
+    channel.register_unsolicited_handler(at_cmd::fifth, [&](at_payload_ptr p) {
+        std::lock_guard<std::mutex> lock(mux);
+        pload = p->c_str();
+        cv.notify_one();
+        return true;
+    });
+
+    // WHEN
+    modem.send("\r\n+FIFTH: 5\r\n");
+    std::unique_lock<std::mutex> lock(mux);
+    cv.wait_for(lock, std::chrono::seconds(5), [&pload] { return !pload.empty(); });
+    lock.unlock();
+    reactor.remove(modem.get_port());
+
+    // THEN
+    TEST_ASSERT_EQUAL_STRING("5", pload.c_str());
+}
@@ -0,0 +1,143 @@
+/**
+ * @file	at_line_list_test.cpp
+ * @brief	Contains unit tests of the list of the lines of a response.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "at_cmd_handler.hpp"
+#include "at_line_list.hpp"
+#include "unity.h"
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_lines_appended_WHEN_visited_THEN_each_line_given_without_splitting_joined_payload();
+static void GIVEN_more_lines_than_recorded_WHEN_appended_THEN_last_line_spans_the_rest();
+static void GIVEN_reserved_list_WHEN_lines_fit_THEN_buffer_not_reallocated_and_kept_after_clear();
+static void GIVEN_multiline_response_WHEN_handled_into_list_THEN_payload_same_as_string_one();
+static void GIVEN_response_sizes_WHEN_size_of_command_got_THEN_listed_size_or_zero();
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXECUTION OF THE TESTS
+// --------------------------------------------------------------------------------------------------------------------
+void test_at_line_list()
+{
+    RUN_TEST(GIVEN_lines_appended_WHEN_visited_THEN_each_line_given_without_splitting_joined_payload);
+    RUN_TEST(GIVEN_more_lines_than_recorded_WHEN_appended_THEN_last_line_spans_the_rest);
+    RUN_TEST(GIVEN_reserved_list_WHEN_lines_fit_THEN_buffer_not_reallocated_and_kept_after_clear);
+    RUN_TEST(GIVEN_multiline_response_WHEN_handled_into_list_THEN_payload_same_as_string_one);
+    RUN_TEST(GIVEN_response_sizes_WHEN_size_of_command_got_THEN_listed_size_or_zero);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_lines_appended_WHEN_visited_THEN_each_line_given_without_splitting_joined_payload()
+{
+    // GIVEN
+    at_line_list lines;
+
+    // WHEN
+    lines.append(line_view("1,\"first\""));
+    lines.append(line_view("2,\"sec", "ond\""));
+    lines.append(line_view(""));
+    lines.append(line_view("some data"));
+
+    // THEN
+    std::vector<std::string> visited;
+    for (auto line : lines)
+        visited.emplace_back(line);
+    TEST_ASSERT_EQUAL(4, lines.size());
+    TEST_ASSERT_EQUAL(4, visited.size());
+    TEST_ASSERT_EQUAL_STRING("1,\"first\"", visited[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("2,\"second\"", visited[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("", visited[2].c_str());
+    TEST_ASSERT_EQUAL_STRING("some data", visited[3].c_str());
+    TEST_ASSERT_EQUAL_STRING("1,\"first\"\r\n2,\"second\"\r\n\r\nsome data", lines.joined().c_str());
+    // The lines refer to the joined payload.
+    TEST_ASSERT(lines[3].data() == lines.joined().data() + lines.joined().size() - lines[3].size());
+}
+
+static void GIVEN_more_lines_than_recorded_WHEN_appended_THEN_last_line_spans_the_rest()
+{
+    // GIVEN
+    at_line_list lines;
+    for (size_t i = 0; i < at_line_list::max_lines_num - 1; ++i)
+        lines.append(line_view("x"));
+
+    // WHEN
+    lines.append(line_view("last"));
+    lines.append(line_view("more"));
+    lines.append(line_view("most"));
+
+    // THEN
+    TEST_ASSERT_EQUAL(at_line_list::max_lines_num, lines.size());
+    TEST_ASSERT_EQUAL_STRING("x", std::string(lines[0]).c_str());
+    TEST_ASSERT_EQUAL_STRING("last\r\nmore\r\nmost", std::string(lines[lines.size() - 1]).c_str());
+}
+
+static void GIVEN_reserved_list_WHEN_lines_fit_THEN_buffer_not_reallocated_and_kept_after_clear()
+{
+    // GIVEN
+    at_line_list lines;
+    lines.reserve(256);
+    auto buffer = lines.joined().data();
+
+    // WHEN
+    for (int i = 0; i < 8; ++i)
+        lines.append(line_view("+COPS: (2,\"op\",\"op\",\"26001\",7)"));
+    auto is_kept = lines.joined().data() == buffer;
+    lines.clear();
+    lines.reserve(16);
+
+    // THEN
+    TEST_ASSERT(is_kept);
+    TEST_ASSERT(lines.empty());
+    TEST_ASSERT(lines.capacity() >= 256);
+    TEST_ASSERT(lines.joined().data() == buffer);
+}
+
+static void GIVEN_multiline_response_WHEN_handled_into_list_THEN_payload_same_as_string_one()
+{
+    // GIVEN
+    at_cmd_handler at_handler;
+    at_line_list lines;
+    at_string pload;
+    const std::string_view responses[] = {"+EIGHTH: 1,\"first\"", "+EIGHTH: 2,\"second\"", "some data", "OK"};
+
+    // WHEN
+    at_err res_lines = at_err::unknown;
+    at_err res_string = at_err::unknown;
+    for (auto response : responses)
+    {
+        auto colon_pos = std::min(response.find(':'), response.length());
+        res_lines = at_handler.handle_received_response(line_view(response), colon_pos, at_cmd::eighth, lines);
+        res_string = at_handler.handle_received_response(line_view(response), at_cmd::eighth, pload);
+    }
+
+    // THEN
+    TEST_ASSERT(res_lines == at_err::ok);
+    TEST_ASSERT(res_string == at_err::ok);
+    TEST_ASSERT_EQUAL(3, lines.size());
+    TEST_ASSERT_EQUAL_STRING("1,\"first\"", std::string(lines[0]).c_str());
+    TEST_ASSERT_EQUAL_STRING("2,\"second\"", std::string(lines[1]).c_str());
+    TEST_ASSERT_EQUAL_STRING("some data", std::string(lines[2]).c_str());
+    TEST_ASSERT_EQUAL_STRING(pload.c_str(), lines.joined().c_str());
+}
+
+static void GIVEN_response_sizes_WHEN_size_of_command_got_THEN_listed_size_or_zero()
+{
+    // GIVEN
+    // AT_COMMANDS_RESPONSE_SIZES of at_cmd_config.hpp.example.
+
+    // WHEN
+    constexpr auto listed = at_cmd_handler::get_response_size(at_cmd::eighth);
+    constexpr auto unlisted = at_cmd_handler::get_response_size(at_cmd::first);
+
+    // THEN
+    TEST_ASSERT_EQUAL(256, listed);
+    TEST_ASSERT_EQUAL(0, unlisted);
+}
@@ -0,0 +1,181 @@
+/**
+ * @file	at_response_cache_test.cpp
+ * @brief	Contains unit tests of the cache of the responses to the queries.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "at_response_cache.hpp"
+#include "unity.h"
+#include <iterator>
+#include <string>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS OF STRUCTURES, DATA TYPES, ...
+// --------------------------------------------------------------------------------------------------------------------
+enum class test_cmd
+{
+    csq,
+    creg,
+    cclk
+};
+
+static constexpr at_cmd_cache_ttl<test_cmd> profiles[]{{test_cmd::csq, at_cmd_type::exec, 100},
+                                                        {test_cmd::creg, at_cmd_type::read, 50},
+                                                        {test_cmd::creg, at_cmd_type::test, 1000}};
+
+using test_cache = at_response_cache<test_cmd, std::size(profiles), std::string>;
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_profiles_WHEN_queries_found_THEN_only_listed_queries_cached();
+static void GIVEN_filled_entry_WHEN_got_within_ttl_THEN_payload_copied_till_ttl_passes();
+static void GIVEN_entry_being_filled_WHEN_filled_again_THEN_refused_till_fill_ends();
+static void GIVEN_failed_query_WHEN_fill_ends_THEN_nothing_stored();
+static void GIVEN_entries_of_command_WHEN_invalidated_THEN_each_type_missed_and_pending_fill_dropped();
+static void GIVEN_entries_of_command_WHEN_invalidated_without_lock_THEN_each_type_missed_and_pending_fill_dropped();
+static void GIVEN_time_wrapped_around_WHEN_got_THEN_age_measured_correctly();
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXECUTION OF THE TESTS
+// --------------------------------------------------------------------------------------------------------------------
+void test_at_response_cache()
+{
+    RUN_TEST(GIVEN_profiles_WHEN_queries_found_THEN_only_listed_queries_cached);
+    RUN_TEST(GIVEN_filled_entry_WHEN_got_within_ttl_THEN_payload_copied_till_ttl_passes);
+    RUN_TEST(GIVEN_entry_being_filled_WHEN_filled_again_THEN_refused_till_fill_ends);
+    RUN_TEST(GIVEN_failed_query_WHEN_fill_ends_THEN_nothing_stored);
+    RUN_TEST(GIVEN_entries_of_command_WHEN_invalidated_THEN_each_type_missed_and_pending_fill_dropped);
+    RUN_TEST(GIVEN_entries_of_command_WHEN_invalidated_without_lock_THEN_each_type_missed_and_pending_fill_dropped);
+    RUN_TEST(GIVEN_time_wrapped_around_WHEN_got_THEN_age_measured_correctly);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_profiles_WHEN_queries_found_THEN_only_listed_queries_cached()
+{
+    // GIVEN
+    test_cache cache{profiles};
+
+    // WHEN
+    // THEN
+    TEST_ASSERT_EQUAL(0, cache.find(test_cmd::csq, at_cmd_type::exec));
+    TEST_ASSERT_EQUAL(1, cache.find(test_cmd::creg, at_cmd_type::read));
+    TEST_ASSERT_EQUAL(2, cache.find(test_cmd::creg, at_cmd_type::test));
+    TEST_ASSERT_EQUAL(-1, cache.find(test_cmd::csq, at_cmd_type::read));
+    TEST_ASSERT_EQUAL(-1, cache.find(test_cmd::cclk, at_cmd_type::read));
+    TEST_ASSERT_EQUAL(50, cache.get_ttl_ms(1));
+}
+
+static void GIVEN_filled_entry_WHEN_got_within_ttl_THEN_payload_copied_till_ttl_passes()
+{
+    // GIVEN
+    test_cache cache{profiles};
+    std::string payload;
+    TEST_ASSERT_FALSE(cache.get(0, 10, 100, payload));
+    TEST_ASSERT(cache.begin_fill(0));
+    cache.end_fill(0, 10, at_err::ok, "23,99");
+
+    // WHEN
+    // THEN
+    TEST_ASSERT(cache.get(0, 10, 100, payload));
+    TEST_ASSERT_EQUAL_STRING("23,99", payload.c_str());
+    TEST_ASSERT(cache.get(0, 109, 100, payload));
+    TEST_ASSERT_FALSE(cache.get(0, 110, 100, payload));
+    TEST_ASSERT_FALSE(cache.get(1, 10, 50, payload));
+}
+
+static void GIVEN_entry_being_filled_WHEN_filled_again_THEN_refused_till_fill_ends()
+{
+    // GIVEN
+    test_cache cache{profiles};
+    TEST_ASSERT(cache.begin_fill(1));
+
+    // WHEN
+    auto is_second_fill = cache.begin_fill(1);
+    auto is_other_fill = cache.begin_fill(2);
+    cache.end_fill(1, 0, at_err::ok, "0,1");
+
+    // THEN
+    TEST_ASSERT_FALSE(is_second_fill);
+    TEST_ASSERT(is_other_fill);
+    TEST_ASSERT(cache.begin_fill(1));
+}
+
+static void GIVEN_failed_query_WHEN_fill_ends_THEN_nothing_stored()
+{
+    // GIVEN
+    test_cache cache{profiles};
+    std::string payload;
+    cache.begin_fill(0);
+
+    // WHEN
+    cache.end_fill(0, 0, at_err::timeout, "");
+
+    // THEN
+    TEST_ASSERT_FALSE(cache.get(0, 0, 100, payload));
+    TEST_ASSERT(cache.begin_fill(0));
+}
+
+static void GIVEN_entries_of_command_WHEN_invalidated_THEN_each_type_missed_and_pending_fill_dropped()
+{
+    // GIVEN
+    test_cache cache{profiles};
+    std::string payload;
+    for (size_t slot = 0; slot < 2; ++slot)
+    {
+        cache.begin_fill(slot);
+        cache.end_fill(slot, 0, at_err::ok, "1");
+    }
+    cache.begin_fill(2);
+
+    // WHEN
+    cache.invalidate(test_cmd::creg);
+    cache.end_fill(2, 0, at_err::ok, "(0-2)");
+
+    // THEN
+    TEST_ASSERT(cache.get(0, 0, 100, payload));
+    TEST_ASSERT_FALSE(cache.get(1, 0, 50, payload));
+    TEST_ASSERT_FALSE(cache.get(2, 0, 1000, payload));
+    cache.begin_fill(2);
+    cache.end_fill(2, 0, at_err::ok, "(0-2)");
+    TEST_ASSERT(cache.get(2, 0, 1000, payload));
+    cache.clear();
+    TEST_ASSERT_FALSE(cache.get(0, 0, 100, payload));
+}
+
+static void GIVEN_entries_of_command_WHEN_invalidated_without_lock_THEN_each_type_missed_and_pending_fill_dropped()
+{
+    // GIVEN
+    test_cache cache{profiles};
+    std::string payload;
+    cache.begin_fill(1);
+    cache.end_fill(1, 0, at_err::ok, "0,1");
+    cache.begin_fill(2);
+
+    // WHEN
+    cache.invalidate_without_lock(test_cmd::creg);
+    cache.end_fill(2, 0, at_err::ok, "(0-2)");
+
+    // THEN
+    TEST_ASSERT_FALSE(cache.get(1, 0, 50, payload));
+    TEST_ASSERT_FALSE(cache.get(2, 0, 1000, payload));
+    cache.begin_fill(1);
+    cache.end_fill(1, 0, at_err::ok, "0,2");
+    TEST_ASSERT(cache.get(1, 0, 50, payload));
+    TEST_ASSERT_EQUAL_STRING("0,2", payload.c_str());
+}
+
+static void GIVEN_time_wrapped_around_WHEN_got_THEN_age_measured_correctly()
+{
+    // GIVEN
+    test_cache cache{profiles};
+    std::string payload;
+    cache.begin_fill(0);
+    cache.end_fill(0, 0xFFFFFFF0u, at_err::ok, "5,0");
+
+    // WHEN
+    // THEN
+    TEST_ASSERT(cache.get(0, 0x20, 100, payload));
+    TEST_ASSERT_FALSE(cache.get(0, 0x60, 100, payload));
+}
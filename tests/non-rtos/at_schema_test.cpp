@@ -0,0 +1,118 @@
+/**
+ * @file	at_schema_test.cpp
+ * @brief	Contains unit tests of the schemas which parse the payloads into typed values.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "at_schema.hpp"
+#include "unity.h"
+#include <cstdint>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_schema_of_ints_and_string_WHEN_payload_parsed_THEN_each_value_obtained();
+static void GIVEN_payload_split_into_two_segments_WHEN_parsed_THEN_string_spans_both();
+static void GIVEN_integers_out_of_range_WHEN_parsed_THEN_rejected();
+static void GIVEN_malformed_payloads_WHEN_parsed_THEN_rejected();
+static void GIVEN_multiline_payload_WHEN_parsed_THEN_first_line_parsed();
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXECUTION OF THE TESTS
+// --------------------------------------------------------------------------------------------------------------------
+void test_at_schema()
+{
+    RUN_TEST(GIVEN_schema_of_ints_and_string_WHEN_payload_parsed_THEN_each_value_obtained);
+    RUN_TEST(GIVEN_payload_split_into_two_segments_WHEN_parsed_THEN_string_spans_both);
+    RUN_TEST(GIVEN_integers_out_of_range_WHEN_parsed_THEN_rejected);
+    RUN_TEST(GIVEN_malformed_payloads_WHEN_parsed_THEN_rejected);
+    RUN_TEST(GIVEN_multiline_payload_WHEN_parsed_THEN_first_line_parsed);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_schema_of_ints_and_string_WHEN_payload_parsed_THEN_each_value_obtained()
+{
+    // GIVEN
+    using schema = at_schema<int, unsigned, quoted_string, unquoted_string>;
+    schema::values values;
+
+    // WHEN
+    auto is_parsed = schema::parse(line_view("-12,34, \"IP\",4807.038N"), values);
+
+    // THEN
+    TEST_ASSERT(is_parsed);
+    auto [a, b, c, d] = values;
+    TEST_ASSERT_EQUAL(-12, a);
+    TEST_ASSERT_EQUAL(34, b);
+    TEST_ASSERT(c == "IP");
+    TEST_ASSERT(d == "4807.038N");
+}
+
+static void GIVEN_payload_split_into_two_segments_WHEN_parsed_THEN_string_spans_both()
+{
+    // GIVEN
+    using schema = at_schema<int, quoted_string, int>;
+    schema::values values;
+
+    // WHEN
+    auto is_parsed = schema::parse(line_view("1,\"inter", "net\",25"), values);
+
+    // THEN
+    TEST_ASSERT(is_parsed);
+    TEST_ASSERT(std::get<1>(values) == "internet");
+    TEST_ASSERT_EQUAL(25, std::get<2>(values));
+}
+
+static void GIVEN_integers_out_of_range_WHEN_parsed_THEN_rejected()
+{
+    // GIVEN
+    at_schema<int8_t>::values small;
+    at_schema<uint16_t>::values word;
+
+    // WHEN
+    // THEN
+    TEST_ASSERT(at_schema<int8_t>::parse(line_view("-128"), small));
+    TEST_ASSERT_EQUAL(-128, std::get<0>(small));
+    TEST_ASSERT(at_schema<int8_t>::parse(line_view("127"), small));
+    TEST_ASSERT_FALSE(at_schema<int8_t>::parse(line_view("128"), small));
+    TEST_ASSERT_FALSE(at_schema<int8_t>::parse(line_view("-129"), small));
+    TEST_ASSERT(at_schema<uint16_t>::parse(line_view("65535"), word));
+    TEST_ASSERT_EQUAL(65535, std::get<0>(word));
+    TEST_ASSERT_FALSE(at_schema<uint16_t>::parse(line_view("65536"), word));
+    TEST_ASSERT_FALSE(at_schema<uint16_t>::parse(line_view("-1"), word));
+}
+
+static void GIVEN_malformed_payloads_WHEN_parsed_THEN_rejected()
+{
+    // GIVEN
+    using schema = at_schema<int, quoted_string>;
+    schema::values values;
+
+    // WHEN
+    // THEN
+    TEST_ASSERT_FALSE(schema::parse(line_view(""), values));
+    TEST_ASSERT_FALSE(schema::parse(line_view("1"), values));
+    TEST_ASSERT_FALSE(schema::parse(line_view(",\"a\""), values));
+    TEST_ASSERT_FALSE(schema::parse(line_view("1,a"), values));
+    TEST_ASSERT_FALSE(schema::parse(line_view("1,\"a"), values));
+    TEST_ASSERT_FALSE(schema::parse(line_view("1,\"a\",2"), values));
+    TEST_ASSERT_FALSE(schema::parse(line_view("1x,\"a\""), values));
+    TEST_ASSERT(schema::parse(line_view("1,\"\""), values));
+    TEST_ASSERT(std::get<1>(values).empty());
+}
+
+static void GIVEN_multiline_payload_WHEN_parsed_THEN_first_line_parsed()
+{
+    // GIVEN
+    using schema = at_schema<int, int>;
+    schema::values values;
+
+    // WHEN
+    auto is_parsed = schema::parse(line_view("1,2\n3,4"), values);
+
+    // THEN
+    TEST_ASSERT(is_parsed);
+    TEST_ASSERT_EQUAL(1, std::get<0>(values));
+    TEST_ASSERT_EQUAL(2, std::get<1>(values));
+}
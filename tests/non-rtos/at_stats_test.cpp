@@ -0,0 +1,137 @@
+/**
+ * @file	at_stats_test.cpp
+ * @brief	Contains unit tests of the counters of the traffic and of the commands handled by a channel.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "at_stats.hpp"
+#include "unity.h"
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_fresh_counters_WHEN_snapshot_taken_THEN_all_zero();
+static void GIVEN_traffic_and_commands_counted_WHEN_snapshot_taken_THEN_each_counter_reflects_them();
+static void GIVEN_indexes_out_of_range_WHEN_counted_THEN_ignored();
+static void GIVEN_mux_waits_WHEN_counted_THEN_total_and_max_kept();
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF PRIVATE MACROS, FUNCTIONS AND VARIABLES
+// --------------------------------------------------------------------------------------------------------------------
+using counters = at_stats_counters<3, 2>;
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXECUTION OF THE TESTS
+// --------------------------------------------------------------------------------------------------------------------
+void test_at_stats()
+{
+    RUN_TEST(GIVEN_fresh_counters_WHEN_snapshot_taken_THEN_all_zero);
+    RUN_TEST(GIVEN_traffic_and_commands_counted_WHEN_snapshot_taken_THEN_each_counter_reflects_them);
+    RUN_TEST(GIVEN_indexes_out_of_range_WHEN_counted_THEN_ignored);
+    RUN_TEST(GIVEN_mux_waits_WHEN_counted_THEN_total_and_max_kept);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_fresh_counters_WHEN_snapshot_taken_THEN_all_zero()
+{
+    // GIVEN
+    counters c;
+
+    // WHEN
+    auto s = c.snapshot(0, 0);
+
+    // THEN
+    TEST_ASSERT_EQUAL(0, s.rx_bytes);
+    TEST_ASSERT_EQUAL(0, s.tx_bytes);
+    TEST_ASSERT_EQUAL(0, s.lines_parsed);
+    TEST_ASSERT_EQUAL(0, s.mux_contentions);
+    TEST_ASSERT_EQUAL(0, s.wake_cycles);
+    for (auto n : s.commands_issued)
+        TEST_ASSERT_EQUAL(0, n);
+    for (auto n : s.urcs_per_cmd)
+        TEST_ASSERT_EQUAL(0, n);
+    for (auto n : s.urcs_per_msg)
+        TEST_ASSERT_EQUAL(0, n);
+    for (auto n : s.results)
+        TEST_ASSERT_EQUAL(0, n);
+}
+
+static void GIVEN_traffic_and_commands_counted_WHEN_snapshot_taken_THEN_each_counter_reflects_them()
+{
+    // GIVEN
+    counters c;
+    c.count_tx_bytes(12);
+    c.count_rx_bytes(1);
+    c.count_rx_bytes(20);
+    c.count_line();
+    c.count_line();
+    c.count_issued(1);
+    c.count_issued(1);
+    c.count_issued(2);
+    c.count_urc_cmd(2);
+    c.count_urc_msg(0);
+    c.count_result(at_err::ok);
+    c.count_result(at_err::timeout);
+    c.count_result(at_err::ok);
+    c.count_wake_cycle();
+
+    // WHEN
+    auto s = c.snapshot(3, 40);
+
+    // THEN
+    TEST_ASSERT_EQUAL(21, s.rx_bytes);
+    TEST_ASSERT_EQUAL(12, s.tx_bytes);
+    TEST_ASSERT_EQUAL(2, s.lines_parsed);
+    TEST_ASSERT_EQUAL(3, s.lines_dropped);
+    TEST_ASSERT_EQUAL(40, s.peak_rx_chars);
+    TEST_ASSERT_EQUAL(1, s.wake_cycles);
+    TEST_ASSERT_EQUAL(0, s.commands_issued[0]);
+    TEST_ASSERT_EQUAL(2, s.commands_issued[1]);
+    TEST_ASSERT_EQUAL(1, s.commands_issued[2]);
+    TEST_ASSERT_EQUAL(1, s.urcs_per_cmd[2]);
+    TEST_ASSERT_EQUAL(1, s.urcs_per_msg[0]);
+    TEST_ASSERT_EQUAL(0, s.urcs_per_msg[1]);
+    TEST_ASSERT_EQUAL(2, s.get_num_results(at_err::ok));
+    TEST_ASSERT_EQUAL(1, s.get_num_results(at_err::timeout));
+    TEST_ASSERT_EQUAL(0, s.get_num_results(at_err::error));
+}
+
+static void GIVEN_indexes_out_of_range_WHEN_counted_THEN_ignored()
+{
+    // GIVEN
+    counters c;
+
+    // WHEN
+    // E.g. cmd::none and unsolicited_msg::none lie past the counted values.
+    c.count_issued(4);
+    c.count_urc_cmd(3);
+    c.count_urc_msg(2);
+    auto s = c.snapshot(0, 0);
+
+    // THEN
+    for (auto n : s.commands_issued)
+        TEST_ASSERT_EQUAL(0, n);
+    for (auto n : s.urcs_per_cmd)
+        TEST_ASSERT_EQUAL(0, n);
+    for (auto n : s.urcs_per_msg)
+        TEST_ASSERT_EQUAL(0, n);
+}
+
+static void GIVEN_mux_waits_WHEN_counted_THEN_total_and_max_kept()
+{
+    // GIVEN
+    counters c;
+
+    // WHEN
+    c.count_mux_wait(3);
+    c.count_mux_wait(0);
+    c.count_mux_wait(7);
+    c.count_mux_wait(2);
+    auto s = c.snapshot(0, 0);
+
+    // THEN
+    TEST_ASSERT_EQUAL(4, s.mux_contentions);
+    TEST_ASSERT_EQUAL(12, s.mux_wait_ticks);
+    TEST_ASSERT_EQUAL(7, s.mux_max_wait_ticks);
+}
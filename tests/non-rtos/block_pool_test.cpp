@@ -0,0 +1,85 @@
+/**
+ * @file	block_pool_test.cpp
+ * @brief	Contains unit tests of the pool of fixed-size memory blocks.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "block_pool.hpp"
+#include "unity.h"
+#include <cstring>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_block_pool_WHEN_all_blocks_allocated_THEN_distinct_blocks_obtained_and_next_allocation_fails();
+static void GIVEN_exhausted_block_pool_WHEN_block_deallocated_THEN_same_block_allocated_again();
+static void GIVEN_block_pool_WHEN_blocks_allocated_THEN_ownership_and_free_counts_reported();
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXECUTION OF THE TESTS
+// --------------------------------------------------------------------------------------------------------------------
+void test_block_pool()
+{
+    RUN_TEST(GIVEN_block_pool_WHEN_all_blocks_allocated_THEN_distinct_blocks_obtained_and_next_allocation_fails);
+    RUN_TEST(GIVEN_exhausted_block_pool_WHEN_block_deallocated_THEN_same_block_allocated_again);
+    RUN_TEST(GIVEN_block_pool_WHEN_blocks_allocated_THEN_ownership_and_free_counts_reported);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_block_pool_WHEN_all_blocks_allocated_THEN_distinct_blocks_obtained_and_next_allocation_fails()
+{
+    // GIVEN
+    block_pool<32, 3> pool;
+
+    // WHEN
+    auto a = static_cast<char *>(pool.allocate());
+    auto b = static_cast<char *>(pool.allocate());
+    auto c = static_cast<char *>(pool.allocate());
+
+    // THEN
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_NOT_NULL(b);
+    TEST_ASSERT_NOT_NULL(c);
+    TEST_ASSERT_NULL(pool.allocate());
+    // The whole blocks are usable, so they mustn't overlap.
+    std::memset(a, 'a', 32);
+    std::memset(b, 'b', 32);
+    std::memset(c, 'c', 32);
+    TEST_ASSERT_EACH_EQUAL_INT8('a', a, 32);
+    TEST_ASSERT_EACH_EQUAL_INT8('b', b, 32);
+    TEST_ASSERT_EACH_EQUAL_INT8('c', c, 32);
+}
+
+static void GIVEN_exhausted_block_pool_WHEN_block_deallocated_THEN_same_block_allocated_again()
+{
+    // GIVEN
+    block_pool<16, 2> pool;
+    auto a = pool.allocate();
+    pool.allocate();
+
+    // WHEN
+    pool.deallocate(a);
+
+    // THEN
+    TEST_ASSERT_EQUAL_PTR(a, pool.allocate());
+    TEST_ASSERT_NULL(pool.allocate());
+}
+
+static void GIVEN_block_pool_WHEN_blocks_allocated_THEN_ownership_and_free_counts_reported()
+{
+    // GIVEN
+    block_pool<16, 4> pool;
+    int outside;
+
+    // WHEN
+    auto a = pool.allocate();
+    auto b = pool.allocate();
+    pool.deallocate(b);
+
+    // THEN
+    TEST_ASSERT(pool.owns(a));
+    TEST_ASSERT(!pool.owns(&outside));
+    TEST_ASSERT_EQUAL(3, pool.get_num_free_blocks());
+    TEST_ASSERT_EQUAL(2, pool.get_min_num_free_blocks());
+}
@@ -0,0 +1,111 @@
+/**
+ * @file	char_scan_test.cpp
+ * @brief	Contains unit tests of the scanners of the chunks for the given characters.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "char_scan.hpp"
+#include "unity.h"
+#include <array>
+#include <string>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_character_at_each_position_WHEN_scanned_from_each_offset_THEN_all_scanners_find_it();
+static void GIVEN_no_character_looked_for_WHEN_scanned_THEN_end_returned();
+static void GIVEN_bytes_differing_in_one_bit_from_character_WHEN_scanned_THEN_none_taken_for_it();
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF PRIVATE MACROS, FUNCTIONS AND VARIABLES
+// --------------------------------------------------------------------------------------------------------------------
+//! The characters which string_buf_rx looks for, with '>' as the exceptional one.
+#define SCANNED_CHARS '\n', '\r', '\0', ':', '>'
+
+using scanner = const char *(*)(const char *beg, const char *end);
+
+static const std::array scanners{
+    &char_scan_swar<SCANNED_CHARS>,
+#if defined(__SSE2__)
+    &char_scan_sse2<SCANNED_CHARS>,
+#endif /* defined(__SSE2__) */
+#if defined(__ARM_NEON) && defined(__aarch64__)
+    &char_scan_neon<SCANNED_CHARS>,
+#endif /* defined(__ARM_NEON) && defined(__aarch64__) */
+    &char_scan<SCANNED_CHARS>,
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXECUTION OF THE TESTS
+// --------------------------------------------------------------------------------------------------------------------
+void test_char_scan()
+{
+    RUN_TEST(GIVEN_character_at_each_position_WHEN_scanned_from_each_offset_THEN_all_scanners_find_it);
+    RUN_TEST(GIVEN_no_character_looked_for_WHEN_scanned_THEN_end_returned);
+    RUN_TEST(GIVEN_bytes_differing_in_one_bit_from_character_WHEN_scanned_THEN_none_taken_for_it);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_character_at_each_position_WHEN_scanned_from_each_offset_THEN_all_scanners_find_it()
+{
+    // GIVEN
+    // Longer than two vectors, so the character lies within the vectors, the words and the bytes left after them.
+    constexpr size_t len = 40;
+    bool is_each_found = true;
+    for (char c : {SCANNED_CHARS})
+    {
+        for (size_t pos = 0; pos < len; ++pos)
+        {
+            std::string chunk(len, 'A');
+            chunk[pos] = c;
+            // A second occurrence, which must not be taken instead of the first one.
+            chunk[len - 1] = c;
+
+            // WHEN
+            for (size_t beg = 0; beg <= pos; ++beg)
+                for (auto scan : scanners)
+                {
+                    auto found = scan(chunk.data() + beg, chunk.data() + len);
+
+                    // THEN
+                    is_each_found = is_each_found && found == chunk.data() + pos;
+                }
+        }
+    }
+    TEST_ASSERT(is_each_found);
+}
+
+static void GIVEN_no_character_looked_for_WHEN_scanned_THEN_end_returned()
+{
+    // GIVEN
+    std::string chunk("+QIRD: 1460,\"some text without any line end or prompt\"");
+    chunk[5] = ' ';
+
+    // WHEN, THEN
+    for (size_t len = 0; len <= chunk.length(); ++len)
+        for (auto scan : scanners)
+            TEST_ASSERT(scan(chunk.data(), chunk.data() + len) == chunk.data() + len);
+}
+
+static void GIVEN_bytes_differing_in_one_bit_from_character_WHEN_scanned_THEN_none_taken_for_it()
+{
+    // GIVEN
+    // The bytes which the carries and the borrows of the word at a time tests could be mistaken for.
+    std::string chunk;
+    for (unsigned char c : {'\n', '\r', '\0', ':', '>'})
+        for (unsigned bit = 0; bit < 8; ++bit)
+            chunk.push_back(static_cast<char>(c ^ (1u << bit)));
+    for (unsigned value : {0x01u, 0x80u, 0x81u, 0xFFu, 0x7Fu})
+        chunk.push_back(static_cast<char>(value));
+    std::string filtered;
+    for (auto c : chunk)
+        if (!char_scan_is_one_of<SCANNED_CHARS>(c))
+            filtered.push_back(c);
+
+    // WHEN, THEN
+    for (size_t beg = 0; beg < filtered.length(); ++beg)
+        for (auto scan : scanners)
+            TEST_ASSERT(scan(filtered.data() + beg, filtered.data() + filtered.length()) ==
+                        filtered.data() + filtered.length());
+}
@@ -0,0 +1,142 @@
+/**
+ * @file	cmux_frame_test.cpp
+ * @brief	Contains unit tests of the encoding and the decoding of the CMUX frames.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "cmux_frame.hpp"
+#include "unity.h"
+#include <string>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_sabm_of_control_channel_WHEN_encoded_THEN_matches_standard_frame();
+static void GIVEN_encoded_uih_frames_WHEN_decoded_THEN_dlci_and_info_obtained();
+static void GIVEN_long_info_WHEN_encoded_and_decoded_THEN_two_byte_length_used();
+static void GIVEN_corrupted_frame_WHEN_decoded_THEN_dropped_and_next_frame_decoded();
+static void GIVEN_too_long_frame_WHEN_decoded_THEN_dropped();
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF PRIVATE MACROS, FUNCTIONS AND VARIABLES
+// --------------------------------------------------------------------------------------------------------------------
+using decoder = cmux_frame_decoder<200>;
+
+static std::string encode(unsigned dlci, cmux_frame_type type, bool is_pf, std::string_view info);
+
+//! Returns the information of the frames which have been decoded, each one prefixed with its DLCI.
+static std::string decode(decoder &d, const std::string &bytes);
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXECUTION OF THE TESTS
+// --------------------------------------------------------------------------------------------------------------------
+void test_cmux_frame()
+{
+    RUN_TEST(GIVEN_sabm_of_control_channel_WHEN_encoded_THEN_matches_standard_frame);
+    RUN_TEST(GIVEN_encoded_uih_frames_WHEN_decoded_THEN_dlci_and_info_obtained);
+    RUN_TEST(GIVEN_long_info_WHEN_encoded_and_decoded_THEN_two_byte_length_used);
+    RUN_TEST(GIVEN_corrupted_frame_WHEN_decoded_THEN_dropped_and_next_frame_decoded);
+    RUN_TEST(GIVEN_too_long_frame_WHEN_decoded_THEN_dropped);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_sabm_of_control_channel_WHEN_encoded_THEN_matches_standard_frame()
+{
+    // GIVEN
+    const std::string expected{"\xF9\x03\x3F\x01\x1C\xF9"};
+
+    // WHEN
+    auto frame = encode(0, cmux_frame_type::sabm, true, {});
+
+    // THEN
+    TEST_ASSERT(expected == frame);
+}
+
+static void GIVEN_encoded_uih_frames_WHEN_decoded_THEN_dlci_and_info_obtained()
+{
+    // GIVEN
+    decoder d;
+    // Consecutive flags and the garbage before the first flag are allowed.
+    auto bytes = "junk" + encode(1, cmux_frame_type::uih, false, "AT\r\n") + "\xF9"
+                 + encode(2, cmux_frame_type::uih, false, "\r\nOK\r\n");
+
+    // WHEN
+    auto decoded = decode(d, bytes);
+
+    // THEN
+    TEST_ASSERT_EQUAL_STRING("1AT\r\n2\r\nOK\r\n", decoded.c_str());
+    TEST_ASSERT(d.type() == cmux_frame_type::uih);
+    TEST_ASSERT_FALSE(d.is_pf());
+    TEST_ASSERT_EQUAL(0, d.get_num_dropped());
+}
+
+static void GIVEN_long_info_WHEN_encoded_and_decoded_THEN_two_byte_length_used()
+{
+    // GIVEN
+    decoder d;
+    std::string info(150, 'x');
+
+    // WHEN
+    auto frame = encode(3, cmux_frame_type::uih, false, info);
+    auto decoded = decode(d, frame);
+
+    // THEN
+    TEST_ASSERT_EQUAL(info.size() + cmux_max_frame_overhead, frame.size());
+    TEST_ASSERT((std::string("3") + info) == decoded);
+}
+
+static void GIVEN_corrupted_frame_WHEN_decoded_THEN_dropped_and_next_frame_decoded()
+{
+    // GIVEN
+    decoder d;
+    auto corrupted = encode(1, cmux_frame_type::uih, false, "+QGPS: 1");
+    corrupted[1] ^= 0x04;
+    auto bytes = corrupted + encode(1, cmux_frame_type::ua, true, {});
+
+    // WHEN
+    auto decoded = decode(d, bytes);
+
+    // THEN
+    TEST_ASSERT_EQUAL_STRING("1", decoded.c_str());
+    TEST_ASSERT(d.type() == cmux_frame_type::ua);
+    TEST_ASSERT(d.is_pf());
+    TEST_ASSERT_EQUAL(1, d.get_num_dropped());
+}
+
+static void GIVEN_too_long_frame_WHEN_decoded_THEN_dropped()
+{
+    // GIVEN
+    cmux_frame_decoder<4> d;
+    auto bytes = encode(1, cmux_frame_type::uih, false, "12345") + encode(1, cmux_frame_type::uih, false, "1234");
+
+    // WHEN
+    std::string decoded;
+    for (auto c : bytes)
+        if (d.push_byte(static_cast<uint8_t>(c)))
+            decoded.append(d.info());
+
+    // THEN
+    TEST_ASSERT_EQUAL_STRING("1234", decoded.c_str());
+    TEST_ASSERT_EQUAL(1, d.get_num_dropped());
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+static std::string encode(unsigned dlci, cmux_frame_type type, bool is_pf, std::string_view info)
+{
+    std::string frame(info.length() + cmux_max_frame_overhead, '\0');
+    auto len = cmux_encode_frame(reinterpret_cast<uint8_t *>(frame.data()), dlci, type, is_pf, info);
+    frame.resize(len);
+    return frame;
+}
+
+static std::string decode(decoder &d, const std::string &bytes)
+{
+    std::string decoded;
+    for (auto c : bytes)
+        if (d.push_byte(static_cast<uint8_t>(c)))
+            decoded.append(std::to_string(d.dlci())).append(d.info());
+    return decoded;
+}
@@ -0,0 +1,189 @@
+/**
+ * @file	handler_table_test.cpp
+ * @brief	Contains unit tests of the fixed-size table of the records queued by their keys.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "handler_table.hpp"
+#include "unity.h"
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_queued_records_WHEN_middle_one_removed_THEN_others_visited_in_order();
+static void GIVEN_removed_record_WHEN_place_reused_THEN_old_token_rejected();
+static void GIVEN_visited_record_WHEN_removed_by_visitor_THEN_removed_after_visit();
+static void GIVEN_shared_table_WHEN_records_pushed_and_removed_THEN_queues_changed_only_when_applied();
+static void GIVEN_pinned_record_WHEN_removed_and_applied_THEN_released_only_when_unpinned();
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF PRIVATE MACROS, FUNCTIONS AND VARIABLES
+// --------------------------------------------------------------------------------------------------------------------
+using table = handler_table<int, 2, 4>;
+
+//! Visits and removes the first record of the key. Returns -1 when there is no record.
+static int pop(table &t, size_t key);
+
+//! Counts the entries into the lock of the shared table.
+static unsigned lock_num = 0;
+static unsigned unlock_num = 0;
+static void count_lock();
+static void count_unlock();
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXECUTION OF THE TESTS
+// --------------------------------------------------------------------------------------------------------------------
+void test_handler_table()
+{
+    RUN_TEST(GIVEN_queued_records_WHEN_middle_one_removed_THEN_others_visited_in_order);
+    RUN_TEST(GIVEN_removed_record_WHEN_place_reused_THEN_old_token_rejected);
+    RUN_TEST(GIVEN_visited_record_WHEN_removed_by_visitor_THEN_removed_after_visit);
+    RUN_TEST(GIVEN_shared_table_WHEN_records_pushed_and_removed_THEN_queues_changed_only_when_applied);
+    RUN_TEST(GIVEN_pinned_record_WHEN_removed_and_applied_THEN_released_only_when_unpinned);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_queued_records_WHEN_middle_one_removed_THEN_others_visited_in_order()
+{
+    // GIVEN
+    table t;
+    t.push_back(0, 1);
+    auto middle = t.push_back(0, 2);
+    t.push_back(1, 10);
+    t.push_back(0, 3);
+
+    // WHEN
+    auto is_removed = t.remove(middle);
+
+    // THEN
+    TEST_ASSERT(is_removed);
+    TEST_ASSERT_EQUAL(1, t.get_num_free());
+    TEST_ASSERT_EQUAL(1, pop(t, 0));
+    TEST_ASSERT_EQUAL(3, pop(t, 0));
+    TEST_ASSERT_EQUAL(-1, pop(t, 0));
+    TEST_ASSERT_EQUAL(10, pop(t, 1));
+    TEST_ASSERT_EQUAL(4, t.get_num_free());
+}
+
+static void GIVEN_removed_record_WHEN_place_reused_THEN_old_token_rejected()
+{
+    // GIVEN
+    table t;
+    for (int i = 0; i < 3; ++i)
+        t.push_back(1, int{i});
+    auto old_token = t.push_back(0, 1);
+    TEST_ASSERT(!t.push_back(0, 2));
+    t.remove(old_token);
+
+    // WHEN
+    auto new_token = t.push_back(0, 3);
+    auto is_old_removed = t.remove(old_token);
+
+    // THEN
+    TEST_ASSERT(new_token);
+    TEST_ASSERT_EQUAL(old_token.index, new_token.index);
+    TEST_ASSERT(!is_old_removed);
+    TEST_ASSERT_EQUAL(3, pop(t, 0));
+}
+
+static void GIVEN_visited_record_WHEN_removed_by_visitor_THEN_removed_after_visit()
+{
+    // GIVEN
+    table t;
+    auto first = t.push_back(0, 1);
+    t.push_back(0, 2);
+
+    // WHEN
+    int visited = 0;
+    bool is_removed_during_visit = false, is_removed_twice = true;
+    t.visit_front(0, [&](int &record) {
+        visited = record;
+        is_removed_during_visit = t.remove(first);
+        is_removed_twice = t.remove(first);
+        // The record is still alive, although it's removed.
+        visited += record;
+        return false;
+    });
+
+    // THEN
+    TEST_ASSERT_EQUAL(2, visited);
+    TEST_ASSERT(is_removed_during_visit);
+    TEST_ASSERT(!is_removed_twice);
+    TEST_ASSERT_EQUAL(2, pop(t, 0));
+}
+
+static void GIVEN_shared_table_WHEN_records_pushed_and_removed_THEN_queues_changed_only_when_applied()
+{
+    // GIVEN
+    table t;
+    lock_num = unlock_num = 0;
+    t.set_lock(count_lock, count_unlock);
+    auto first = t.push_back(0, 1);
+    t.apply_changes();
+
+    // WHEN
+    auto second = t.push_back(0, 2);
+    auto is_first_removed = t.remove(first);
+
+    // THEN
+    TEST_ASSERT(second);
+    TEST_ASSERT(is_first_removed);
+    // The removed record isn't visited, while the pushed one isn't queued till the changes are applied.
+    TEST_ASSERT_EQUAL(-1, pop(t, 0));
+    TEST_ASSERT_EQUAL(3, t.get_num_free());
+    t.apply_changes();
+    TEST_ASSERT_EQUAL(2, pop(t, 0));
+    TEST_ASSERT_EQUAL(4, t.get_num_free());
+    TEST_ASSERT(lock_num > 0);
+    TEST_ASSERT_EQUAL(lock_num, unlock_num);
+}
+
+static void GIVEN_pinned_record_WHEN_removed_and_applied_THEN_released_only_when_unpinned()
+{
+    // GIVEN
+    table t;
+    t.set_lock(count_lock, count_unlock);
+    auto token = t.push_back(0, 1);
+    t.apply_changes();
+    auto pinned = t.pin(token);
+
+    // WHEN
+    auto is_removed = t.remove(token);
+    t.apply_changes();
+
+    // THEN
+    TEST_ASSERT_NOT_NULL(pinned);
+    TEST_ASSERT(is_removed);
+    TEST_ASSERT(t.empty(0));
+    TEST_ASSERT_NULL(t.pin(token));
+    // The pinned record is still alive, although it's unlinked.
+    TEST_ASSERT_EQUAL(1, *pinned);
+    TEST_ASSERT_EQUAL(3, t.get_num_free());
+    t.unpin(token);
+    TEST_ASSERT_EQUAL(4, t.get_num_free());
+    TEST_ASSERT(!t.remove(token));
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+static int pop(table &t, size_t key)
+{
+    int value = -1;
+    t.visit_front(key, [&value](int &record) {
+        value = record;
+        return true;
+    });
+    return value;
+}
+
+static void count_lock()
+{
+    lock_num++;
+}
+
+static void count_unlock()
+{
+    unlock_num++;
+}
@@ -0,0 +1,67 @@
+/**
+ * @file	inplace_function_test.cpp
+ * @brief	Contains unit tests of the callable wrapper which holds the callable in place.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "inplace_function.hpp"
+#include "unity.h"
+#include <memory>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_lambda_with_captures_WHEN_wrapped_and_invoked_THEN_captures_used();
+static void GIVEN_wrapped_move_only_capture_WHEN_wrapper_moved_and_reset_THEN_capture_released_once();
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXECUTION OF THE TESTS
+// --------------------------------------------------------------------------------------------------------------------
+void test_inplace_function()
+{
+    RUN_TEST(GIVEN_lambda_with_captures_WHEN_wrapped_and_invoked_THEN_captures_used);
+    RUN_TEST(GIVEN_wrapped_move_only_capture_WHEN_wrapper_moved_and_reset_THEN_capture_released_once);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_lambda_with_captures_WHEN_wrapped_and_invoked_THEN_captures_used()
+{
+    // GIVEN
+    int sum = 0;
+    int offset = 10;
+    inplace_function<int(int), 16> f{[&sum, offset](int v) {
+        sum += v + offset;
+        return sum;
+    }};
+
+    // WHEN
+    f(1);
+    auto result = f(2);
+
+    // THEN
+    TEST_ASSERT(static_cast<bool>(f));
+    TEST_ASSERT_EQUAL(23, result);
+    TEST_ASSERT_EQUAL(23, sum);
+}
+
+static void GIVEN_wrapped_move_only_capture_WHEN_wrapper_moved_and_reset_THEN_capture_released_once()
+{
+    // GIVEN
+    auto shared = std::make_shared<int>(5);
+    inplace_function<int(), 32> f{[p = std::make_unique<std::shared_ptr<int>>(shared)]() { return **p; }};
+    TEST_ASSERT_EQUAL(2, shared.use_count());
+
+    // WHEN
+    auto g = std::move(f);
+    auto result = g();
+    auto use_count_after_move = shared.use_count();
+    g.reset();
+
+    // THEN
+    TEST_ASSERT_EQUAL(5, result);
+    TEST_ASSERT(!f);
+    TEST_ASSERT(!g);
+    TEST_ASSERT_EQUAL(2, use_count_after_move);
+    TEST_ASSERT_EQUAL(1, shared.use_count());
+}
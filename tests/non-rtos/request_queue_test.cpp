@@ -0,0 +1,93 @@
+/**
+ * @file	request_queue_test.cpp
+ * @brief	Contains unit tests of the queue of the requests held in preallocated slots.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "request_queue.hpp"
+#include "unity.h"
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_queued_requests_WHEN_higher_priority_pushed_THEN_overtakes_all_but_front();
+static void GIVEN_requests_of_same_priority_WHEN_pushed_THEN_served_in_order_of_pushing();
+static void GIVEN_request_overtaken_max_times_WHEN_higher_priority_pushed_THEN_not_overtaken_anymore();
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXECUTION OF THE TESTS
+// --------------------------------------------------------------------------------------------------------------------
+void test_request_queue()
+{
+    RUN_TEST(GIVEN_queued_requests_WHEN_higher_priority_pushed_THEN_overtakes_all_but_front);
+    RUN_TEST(GIVEN_requests_of_same_priority_WHEN_pushed_THEN_served_in_order_of_pushing);
+    RUN_TEST(GIVEN_request_overtaken_max_times_WHEN_higher_priority_pushed_THEN_not_overtaken_anymore);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_queued_requests_WHEN_higher_priority_pushed_THEN_overtakes_all_but_front()
+{
+    // GIVEN
+    request_queue<int, 4> queue;
+    auto in_flight = queue.acquire();
+    auto bulk = queue.acquire();
+    queue.push(in_flight, 0, 4);
+    queue.push(bulk, 0, 4);
+
+    // WHEN
+    auto urgent = queue.acquire();
+    queue.push(urgent, 1, 4);
+
+    // THEN
+    TEST_ASSERT_EQUAL_PTR(in_flight, queue.front());
+    queue.pop_front();
+    TEST_ASSERT_EQUAL_PTR(urgent, queue.front());
+    queue.pop_front();
+    TEST_ASSERT_EQUAL_PTR(bulk, queue.front());
+}
+
+static void GIVEN_requests_of_same_priority_WHEN_pushed_THEN_served_in_order_of_pushing()
+{
+    // GIVEN
+    request_queue<int, 4> queue;
+    auto first = queue.acquire();
+    auto second = queue.acquire();
+    auto third = queue.acquire();
+
+    // WHEN
+    queue.push(first, 0, 4);
+    queue.push(second, 1, 4);
+    queue.push(third, 1, 4);
+
+    // THEN
+    TEST_ASSERT_EQUAL_PTR(first, queue.front());
+    queue.pop_front();
+    TEST_ASSERT_EQUAL_PTR(second, queue.front());
+    queue.pop_front();
+    TEST_ASSERT_EQUAL_PTR(third, queue.front());
+}
+
+static void GIVEN_request_overtaken_max_times_WHEN_higher_priority_pushed_THEN_not_overtaken_anymore()
+{
+    // GIVEN
+    request_queue<int, 4> queue;
+    auto in_flight = queue.acquire();
+    auto bulk = queue.acquire();
+    auto first_urgent = queue.acquire();
+    queue.push(in_flight, 0, 1);
+    queue.push(bulk, 0, 1);
+    queue.push(first_urgent, 1, 1);
+
+    // WHEN
+    auto second_urgent = queue.acquire();
+    queue.push(second_urgent, 1, 1);
+
+    // THEN
+    queue.pop_front();
+    TEST_ASSERT_EQUAL_PTR(first_urgent, queue.front());
+    queue.pop_front();
+    TEST_ASSERT_EQUAL_PTR(bulk, queue.front());
+    queue.pop_front();
+    TEST_ASSERT_EQUAL_PTR(second_urgent, queue.front());
+}
@@ -0,0 +1,435 @@
+/**
+ * @file	string_buf_rx_test.cpp
+ * @brief	Contains unit tests of the buffer which is pushed by bytes and popped by strings.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "string_buf_rx.hpp"
+#include "unity.h"
+#include <cstring>
+#include <string>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_string_buf_rx_WHEN_bytes_pushed_one_by_one_THEN_string_popped();
+static void GIVEN_string_buf_rx_WHEN_chunk_with_multiple_lines_pushed_THEN_all_lines_counted_and_popped();
+static void GIVEN_string_buf_rx_WHEN_line_split_between_chunks_THEN_whole_line_popped();
+static void GIVEN_string_buf_rx_WHEN_exceptional_char_alone_in_chunk_THEN_treated_as_string();
+static void GIVEN_string_buf_rx_WHEN_exceptional_char_within_line_THEN_not_treated_as_string();
+static void GIVEN_string_buf_rx_WHEN_string_peeked_THEN_view_valid_until_released();
+static void GIVEN_string_wrapping_around_buffer_end_WHEN_peeked_THEN_view_has_two_segments();
+static void GIVEN_more_lines_than_index_holds_WHEN_pushed_THEN_excessive_lines_dropped_and_counted();
+static void GIVEN_line_longer_than_free_space_WHEN_pushed_THEN_whole_line_dropped_and_next_line_intact();
+static void GIVEN_armed_binary_mode_WHEN_header_and_data_pushed_in_chunk_THEN_data_copied_without_scanning();
+static void GIVEN_armed_binary_mode_WHEN_data_pushed_bytewise_exceeds_capacity_THEN_excess_discarded();
+static void GIVEN_lines_with_and_without_colon_WHEN_pushed_in_chunks_THEN_first_colon_positions_recorded();
+static void GIVEN_line_wrapping_around_buffer_end_WHEN_pushed_bytewise_THEN_colon_position_recorded();
+static void GIVEN_discarded_prefix_WHEN_lines_pushed_THEN_lines_with_prefix_not_published();
+static void GIVEN_expected_echo_WHEN_echo_pushed_in_pieces_THEN_echo_discarded_once();
+static void GIVEN_expected_echo_WHEN_other_lines_arrive_first_THEN_they_published_and_echo_still_discarded();
+static void GIVEN_expected_echo_WHEN_expectation_withdrawn_THEN_echo_published();
+static void GIVEN_lines_held_and_popped_WHEN_pushed_THEN_peak_number_of_chars_kept();
+static void GIVEN_lines_held_WHEN_released_THEN_number_of_chars_follows();
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF PRIVATE MACROS, FUNCTIONS AND VARIABLES
+// --------------------------------------------------------------------------------------------------------------------
+template <size_t N, size_t M, char... E> static unsigned push_chunk(string_buf_rx<N, M, E...> &buf, const char *chunk);
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXECUTION OF THE TESTS
+// --------------------------------------------------------------------------------------------------------------------
+void test_string_buf_rx()
+{
+    RUN_TEST(GIVEN_string_buf_rx_WHEN_bytes_pushed_one_by_one_THEN_string_popped);
+    RUN_TEST(GIVEN_string_buf_rx_WHEN_chunk_with_multiple_lines_pushed_THEN_all_lines_counted_and_popped);
+    RUN_TEST(GIVEN_string_buf_rx_WHEN_line_split_between_chunks_THEN_whole_line_popped);
+    RUN_TEST(GIVEN_string_buf_rx_WHEN_exceptional_char_alone_in_chunk_THEN_treated_as_string);
+    RUN_TEST(GIVEN_string_buf_rx_WHEN_exceptional_char_within_line_THEN_not_treated_as_string);
+    RUN_TEST(GIVEN_string_buf_rx_WHEN_string_peeked_THEN_view_valid_until_released);
+    RUN_TEST(GIVEN_string_wrapping_around_buffer_end_WHEN_peeked_THEN_view_has_two_segments);
+    RUN_TEST(GIVEN_more_lines_than_index_holds_WHEN_pushed_THEN_excessive_lines_dropped_and_counted);
+    RUN_TEST(GIVEN_line_longer_than_free_space_WHEN_pushed_THEN_whole_line_dropped_and_next_line_intact);
+    RUN_TEST(GIVEN_armed_binary_mode_WHEN_header_and_data_pushed_in_chunk_THEN_data_copied_without_scanning);
+    RUN_TEST(GIVEN_armed_binary_mode_WHEN_data_pushed_bytewise_exceeds_capacity_THEN_excess_discarded);
+    RUN_TEST(GIVEN_lines_with_and_without_colon_WHEN_pushed_in_chunks_THEN_first_colon_positions_recorded);
+    RUN_TEST(GIVEN_line_wrapping_around_buffer_end_WHEN_pushed_bytewise_THEN_colon_position_recorded);
+    RUN_TEST(GIVEN_discarded_prefix_WHEN_lines_pushed_THEN_lines_with_prefix_not_published);
+    RUN_TEST(GIVEN_expected_echo_WHEN_echo_pushed_in_pieces_THEN_echo_discarded_once);
+    RUN_TEST(GIVEN_expected_echo_WHEN_other_lines_arrive_first_THEN_they_published_and_echo_still_discarded);
+    RUN_TEST(GIVEN_expected_echo_WHEN_expectation_withdrawn_THEN_echo_published);
+    RUN_TEST(GIVEN_lines_held_and_popped_WHEN_pushed_THEN_peak_number_of_chars_kept);
+    RUN_TEST(GIVEN_lines_held_WHEN_released_THEN_number_of_chars_follows);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_string_buf_rx_WHEN_bytes_pushed_one_by_one_THEN_string_popped()
+{
+    // GIVEN
+    string_buf_rx<64> buf;
+
+    // WHEN
+    unsigned string_ends = 0;
+    for (auto c : std::string("+FIRST: 0,1\r\n"))
+        string_ends += buf.push_byte_and_is_string_end(c) ? 1 : 0;
+
+    // THEN
+    TEST_ASSERT_EQUAL(1, string_ends);
+    TEST_ASSERT_EQUAL_STRING("+FIRST: 0,1", buf.pop_string()->c_str());
+    TEST_ASSERT(buf.is_empty());
+}
+
+static void GIVEN_string_buf_rx_WHEN_chunk_with_multiple_lines_pushed_THEN_all_lines_counted_and_popped()
+{
+    // GIVEN
+    string_buf_rx<64> buf;
+
+    // WHEN
+    auto string_ends = push_chunk(buf, "\r\n+SECOND: 12\r\n+THIRD: 34\r\n\r\nOK\r\n");
+
+    // THEN
+    TEST_ASSERT_EQUAL(3, string_ends);
+    TEST_ASSERT_EQUAL_STRING("+SECOND: 12", buf.pop_string()->c_str());
+    TEST_ASSERT_EQUAL_STRING("+THIRD: 34", buf.pop_string()->c_str());
+    TEST_ASSERT_EQUAL_STRING("OK", buf.pop_string()->c_str());
+    TEST_ASSERT(buf.is_empty());
+}
+
+static void GIVEN_string_buf_rx_WHEN_line_split_between_chunks_THEN_whole_line_popped()
+{
+    // GIVEN
+    string_buf_rx<64> buf;
+
+    // WHEN
+    TEST_ASSERT_EQUAL(0, push_chunk(buf, "+FOUR"));
+    TEST_ASSERT_EQUAL(0, push_chunk(buf, "TH: SPLIT "));
+    TEST_ASSERT_EQUAL(1, push_chunk(buf, "LINE\r\nOK"));
+    TEST_ASSERT_EQUAL(1, push_chunk(buf, "\r\n"));
+
+    // THEN
+    TEST_ASSERT_EQUAL_STRING("+FOURTH: SPLIT LINE", buf.pop_string()->c_str());
+    TEST_ASSERT_EQUAL_STRING("OK", buf.pop_string()->c_str());
+    TEST_ASSERT(buf.is_empty());
+}
+
+static void GIVEN_string_buf_rx_WHEN_exceptional_char_alone_in_chunk_THEN_treated_as_string()
+{
+    // GIVEN
+    string_buf_rx<64, 16, '>'> buf;
+
+    // WHEN
+    auto string_ends = push_chunk(buf, "\r\n>");
+
+    // THEN
+    TEST_ASSERT_EQUAL(1, string_ends);
+    TEST_ASSERT(buf.take_exceptional_string());
+    TEST_ASSERT_FALSE(buf.take_exceptional_string());
+    TEST_ASSERT_EQUAL_STRING(">", buf.pop_string()->c_str());
+    TEST_ASSERT(buf.is_empty());
+}
+
+static void GIVEN_string_buf_rx_WHEN_exceptional_char_within_line_THEN_not_treated_as_string()
+{
+    // GIVEN
+    string_buf_rx<64, 16, '>'> buf;
+
+    // WHEN
+    auto string_ends = push_chunk(buf, "+FIFTH: a>b\r\n");
+
+    // THEN
+    TEST_ASSERT_EQUAL(1, string_ends);
+    TEST_ASSERT_FALSE(buf.take_exceptional_string());
+    TEST_ASSERT_EQUAL_STRING("+FIFTH: a>b", buf.pop_string()->c_str());
+    TEST_ASSERT(buf.is_empty());
+}
+
+static void GIVEN_string_buf_rx_WHEN_string_peeked_THEN_view_valid_until_released()
+{
+    // GIVEN
+    string_buf_rx<64> buf;
+    push_chunk(buf, "+SIXTH: 1\r\nOK\r\n");
+
+    // WHEN
+    auto first = buf.peek_string();
+    auto first_again = buf.peek_string();
+    buf.release_string();
+    auto second = buf.peek_string();
+    buf.release_string();
+
+    // THEN
+    TEST_ASSERT(first == "+SIXTH: 1");
+    TEST_ASSERT(first_again == "+SIXTH: 1");
+    TEST_ASSERT(second == "OK");
+    TEST_ASSERT(buf.is_empty());
+    TEST_ASSERT(buf.peek_string().empty());
+}
+
+static void GIVEN_string_wrapping_around_buffer_end_WHEN_peeked_THEN_view_has_two_segments()
+{
+    // GIVEN
+    string_buf_rx<64> buf;
+    std::string filler(60, 'x');
+    push_chunk(buf, (filler + "\r\n").c_str());
+    buf.release_string();
+
+    // WHEN
+    push_chunk(buf, "+SEVENTH: WRAPPED\r\n");
+    auto view = buf.peek_string();
+
+    // THEN
+    TEST_ASSERT_EQUAL(4, view.first().length());
+    TEST_ASSERT(view == "+SEVENTH: WRAPPED");
+    TEST_ASSERT(view.contains_at(1, "SEVENTH"));
+    view.remove_prefix(10);
+    TEST_ASSERT(view == "WRAPPED");
+    TEST_ASSERT_EQUAL_STRING("WRAPPED", view.to_string().c_str());
+}
+
+static void GIVEN_more_lines_than_index_holds_WHEN_pushed_THEN_excessive_lines_dropped_and_counted()
+{
+    // GIVEN
+    string_buf_rx<64, 4> buf;
+
+    // WHEN
+    auto string_ends = push_chunk(buf, "L1\r\nL2\r\nL3\r\nL4\r\nL5\r\n");
+
+    // THEN
+    TEST_ASSERT_EQUAL(3, string_ends);
+    TEST_ASSERT_EQUAL(2, buf.get_num_dropped_on_strings_overflow());
+    TEST_ASSERT_EQUAL(0, buf.get_num_dropped_on_buffer_overflow());
+    TEST_ASSERT_EQUAL_STRING("L1", buf.pop_string()->c_str());
+    TEST_ASSERT_EQUAL_STRING("L2", buf.pop_string()->c_str());
+    TEST_ASSERT_EQUAL_STRING("L3", buf.pop_string()->c_str());
+    TEST_ASSERT(buf.is_empty());
+
+    // The space is reused after the lines have been handled.
+    TEST_ASSERT_EQUAL(1, push_chunk(buf, "L6\r\n"));
+    TEST_ASSERT_EQUAL_STRING("L6", buf.pop_string()->c_str());
+}
+
+static void GIVEN_line_longer_than_free_space_WHEN_pushed_THEN_whole_line_dropped_and_next_line_intact()
+{
+    // GIVEN
+    string_buf_rx<16, 16, '>'> buf;
+    push_chunk(buf, "+FIRST: 1\r\n");
+
+    // WHEN
+    TEST_ASSERT_EQUAL(0, push_chunk(buf, "+SECOND: "));
+    TEST_ASSERT_EQUAL(0, push_chunk(buf, ">TOO LONG"));
+    unsigned string_ends = 0;
+    for (auto c : std::string(">\r\nOK\r\n"))
+        string_ends += buf.push_byte_and_is_string_end(c) ? 1 : 0;
+
+    // THEN
+    TEST_ASSERT_EQUAL(1, string_ends);
+    TEST_ASSERT_EQUAL(1, buf.get_num_dropped_on_buffer_overflow());
+    TEST_ASSERT_EQUAL_STRING("+FIRST: 1", buf.pop_string()->c_str());
+    TEST_ASSERT_EQUAL_STRING("OK", buf.pop_string()->c_str());
+    TEST_ASSERT(buf.is_empty());
+}
+
+static void GIVEN_armed_binary_mode_WHEN_header_and_data_pushed_in_chunk_THEN_data_copied_without_scanning()
+{
+    // GIVEN
+    string_buf_rx<64> buf;
+    char data[16];
+    buf.arm_binary_mode("+QIRD", data, sizeof(data));
+    const char received[] = "+QIRD: 6\r\n\r\n\0ab\n\r\n\r\nOK\r\n";
+
+    // WHEN
+    auto string_ends = buf.push_bytes_and_count_string_ends(received, sizeof(received) - 1);
+
+    // THEN
+    TEST_ASSERT_EQUAL(2, string_ends);
+    TEST_ASSERT_EQUAL_STRING("+QIRD: 6", buf.pop_string()->c_str());
+    TEST_ASSERT_EQUAL_STRING("OK", buf.pop_string()->c_str());
+    TEST_ASSERT(buf.is_empty());
+    TEST_ASSERT_EQUAL(6, buf.disarm_binary_mode());
+    TEST_ASSERT(std::memcmp(data, "\r\n\0ab\n", 6) == 0);
+}
+
+static void GIVEN_armed_binary_mode_WHEN_data_pushed_bytewise_exceeds_capacity_THEN_excess_discarded()
+{
+    // GIVEN
+    string_buf_rx<64> buf;
+    char data[4];
+    buf.arm_binary_mode("CONNECT", data, sizeof(data));
+    const std::string received{"CONNECT 8\r\n1\r\n45678\r\nOK\r\n"};
+
+    // WHEN
+    unsigned string_ends = 0;
+    for (auto c : received)
+        string_ends += buf.push_byte_and_is_string_end(c) ? 1 : 0;
+
+    // THEN
+    TEST_ASSERT_EQUAL(2, string_ends);
+    TEST_ASSERT_EQUAL_STRING("CONNECT 8", buf.pop_string()->c_str());
+    TEST_ASSERT_EQUAL_STRING("OK", buf.pop_string()->c_str());
+    TEST_ASSERT_EQUAL(4, buf.disarm_binary_mode());
+    TEST_ASSERT(std::memcmp(data, "1\r\n4", 4) == 0);
+}
+
+static void GIVEN_lines_with_and_without_colon_WHEN_pushed_in_chunks_THEN_first_colon_positions_recorded()
+{
+    // GIVEN
+    string_buf_rx<64> buf;
+
+    // WHEN
+    push_chunk(buf, "+CREG: 0,1\r\n12:34");
+    push_chunk(buf, ":56\r\nOK\r\n");
+
+    // THEN
+    TEST_ASSERT_EQUAL(5, buf.peek_colon_pos());
+    buf.release_string();
+    TEST_ASSERT_EQUAL(2, buf.peek_colon_pos());
+    buf.release_string();
+    TEST_ASSERT_EQUAL(2, buf.peek_colon_pos());
+    TEST_ASSERT(buf.peek_string() == "OK");
+}
+
+static void GIVEN_line_wrapping_around_buffer_end_WHEN_pushed_bytewise_THEN_colon_position_recorded()
+{
+    // GIVEN
+    string_buf_rx<64> buf;
+    std::string filler(60, 'x');
+    push_chunk(buf, (filler + "\r\n").c_str());
+    buf.release_string();
+
+    // WHEN
+    for (auto c : std::string("+SEVENTH: WRAPPED\r\n"))
+        buf.push_byte_and_is_string_end(c);
+
+    // THEN
+    TEST_ASSERT_EQUAL(8, buf.peek_colon_pos());
+    TEST_ASSERT(buf.peek_string().contains_at(buf.peek_colon_pos(), ": WRAPPED"));
+}
+
+static void GIVEN_discarded_prefix_WHEN_lines_pushed_THEN_lines_with_prefix_not_published()
+{
+    // GIVEN
+    string_buf_rx<64> buf;
+    buf.discard_strings_starting_with("AT");
+
+    // WHEN
+    auto chunk_ends = push_chunk(buf, "AT+CSQ\r\r\n+CSQ: 20,99\r\n");
+    unsigned bytewise_ends = 0;
+    for (auto c : std::string("ATE0\r\nA\r\nOK\r\n"))
+        bytewise_ends += buf.push_byte_and_is_string_end(c) ? 1 : 0;
+
+    // THEN
+    TEST_ASSERT_EQUAL(1, chunk_ends);
+    TEST_ASSERT_EQUAL(2, bytewise_ends);
+    TEST_ASSERT_EQUAL_STRING("+CSQ: 20,99", buf.pop_string()->c_str());
+    TEST_ASSERT_EQUAL_STRING("A", buf.pop_string()->c_str());
+    TEST_ASSERT_EQUAL_STRING("OK", buf.pop_string()->c_str());
+    TEST_ASSERT(buf.is_empty());
+    TEST_ASSERT_EQUAL(0, buf.get_num_dropped_on_buffer_overflow());
+}
+
+static void GIVEN_expected_echo_WHEN_echo_pushed_in_pieces_THEN_echo_discarded_once()
+{
+    // GIVEN
+    string_buf_rx<64> buf;
+    buf.expect_echo("sms ", "text", "\x1A");
+
+    // WHEN
+    auto string_ends = push_chunk(buf, "sms t");
+    for (auto c : std::string("ext\x1A\r\n"))
+        string_ends += buf.push_byte_and_is_string_end(c) ? 1 : 0;
+    string_ends += push_chunk(buf, "sms text\x1A\r\nOK\r\n");
+
+    // THEN
+    TEST_ASSERT_EQUAL(2, string_ends);
+    TEST_ASSERT_EQUAL(1, buf.get_num_discarded_echoes());
+    TEST_ASSERT_EQUAL_STRING("sms text\x1A", buf.pop_string()->c_str());
+    TEST_ASSERT_EQUAL_STRING("OK", buf.pop_string()->c_str());
+    TEST_ASSERT(buf.is_empty());
+}
+
+static void GIVEN_expected_echo_WHEN_other_lines_arrive_first_THEN_they_published_and_echo_still_discarded()
+{
+    // GIVEN
+    string_buf_rx<64> buf;
+    buf.expect_echo("AT+QGPS=", "1");
+
+    // WHEN
+    auto string_ends = push_chunk(buf, "AT+QGPS\r\nAT+QGPS=12\r\n+QGPS: 1\r\nAT+QGPS=1\r\r\nOK\r\n");
+
+    // THEN
+    TEST_ASSERT_EQUAL(4, string_ends);
+    TEST_ASSERT_EQUAL(1, buf.get_num_discarded_echoes());
+    TEST_ASSERT_EQUAL_STRING("AT+QGPS", buf.pop_string()->c_str());
+    TEST_ASSERT_EQUAL_STRING("AT+QGPS=12", buf.pop_string()->c_str());
+    TEST_ASSERT_EQUAL_STRING("+QGPS: 1", buf.pop_string()->c_str());
+    TEST_ASSERT_EQUAL_STRING("OK", buf.pop_string()->c_str());
+}
+
+static void GIVEN_expected_echo_WHEN_expectation_withdrawn_THEN_echo_published()
+{
+    // GIVEN
+    string_buf_rx<64> buf;
+    buf.expect_echo("ATE0");
+    push_chunk(buf, "AT");
+
+    // WHEN
+    // The string which has begun already can't be taken for the echo which is expected anew.
+    buf.expect_echo("ATE0");
+    push_chunk(buf, "E0\r\n");
+    buf.expect_echo();
+    auto string_ends = push_chunk(buf, "ATE0\r\n");
+
+    // THEN
+    TEST_ASSERT_EQUAL(1, string_ends);
+    TEST_ASSERT_EQUAL(0, buf.get_num_discarded_echoes());
+    TEST_ASSERT_EQUAL_STRING("ATE0", buf.pop_string()->c_str());
+    TEST_ASSERT_EQUAL_STRING("ATE0", buf.pop_string()->c_str());
+}
+
+static void GIVEN_lines_held_and_popped_WHEN_pushed_THEN_peak_number_of_chars_kept()
+{
+    // GIVEN
+    string_buf_rx<64> buf;
+    push_chunk(buf, "+QGPS: 1,2\r\n");
+    auto first_peak = buf.get_peak_num_chars();
+    buf.pop_string();
+
+    // WHEN
+    push_chunk(buf, "OK\r\n");
+    auto peak_after_shorter = buf.get_peak_num_chars();
+    for (auto c : std::string("+QGPSLOC: 1,2\r\n"))
+        buf.push_byte_and_is_string_end(c);
+
+    // THEN
+    TEST_ASSERT(first_peak >= std::strlen("+QGPS: 1,2"));
+    TEST_ASSERT_EQUAL(first_peak, peak_after_shorter);
+    TEST_ASSERT(buf.get_peak_num_chars() >= std::strlen("OK+QGPSLOC: 1,2"));
+    TEST_ASSERT(buf.get_peak_num_chars() < 64);
+}
+
+static void GIVEN_lines_held_WHEN_released_THEN_number_of_chars_follows()
+{
+    // GIVEN
+    string_buf_rx<64> buf;
+    push_chunk(buf, "+QGPS: 1\r\nOK\r\n+QGP");
+    auto num_held = buf.get_num_chars();
+
+    // WHEN
+    buf.peek_string();
+    buf.release_string();
+    auto num_after_release = buf.get_num_chars();
+
+    // THEN
+    // The characters of the line being received are held too.
+    TEST_ASSERT(num_held >= std::strlen("+QGPS: 1OK+QGP"));
+    TEST_ASSERT_EQUAL(num_held - std::strlen("+QGPS: 1"), num_after_release);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+template <size_t N, size_t M, char... E> static unsigned push_chunk(string_buf_rx<N, M, E...> &buf, const char *chunk)
+{
+    return buf.push_bytes_and_count_string_ends(chunk, std::strlen(chunk));
+}
@@ -0,0 +1,162 @@
+/**
+ * @file	string_buf_tx_test.cpp
+ * @brief	Contains unit tests of the buffer which is pushed by strings and popped by bytes.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "string_buf_tx.hpp"
+#include "unity.h"
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_string_buf_tx_WHEN_owned_and_static_segments_pushed_THEN_popped_in_order();
+static void GIVEN_string_buf_tx_WHEN_long_string_moved_in_THEN_whole_string_popped();
+static void GIVEN_full_string_buf_tx_WHEN_popped_and_cleaned_THEN_segments_reusable();
+static void GIVEN_partially_popped_segment_WHEN_peeked_THEN_rest_of_segment_obtained_as_block();
+static void GIVEN_partially_popped_buffer_WHEN_all_popped_at_once_THEN_empty_and_reusable_after_clean();
+static void GIVEN_owned_string_pushed_WHEN_last_pushed_get_THEN_characters_within_buffer_viewed();
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF PRIVATE MACROS, FUNCTIONS AND VARIABLES
+// --------------------------------------------------------------------------------------------------------------------
+template <size_t N> static std::string pop_all(string_buf_tx<N> &buf);
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXECUTION OF THE TESTS
+// --------------------------------------------------------------------------------------------------------------------
+void test_string_buf_tx()
+{
+    RUN_TEST(GIVEN_string_buf_tx_WHEN_owned_and_static_segments_pushed_THEN_popped_in_order);
+    RUN_TEST(GIVEN_string_buf_tx_WHEN_long_string_moved_in_THEN_whole_string_popped);
+    RUN_TEST(GIVEN_full_string_buf_tx_WHEN_popped_and_cleaned_THEN_segments_reusable);
+    RUN_TEST(GIVEN_partially_popped_segment_WHEN_peeked_THEN_rest_of_segment_obtained_as_block);
+    RUN_TEST(GIVEN_partially_popped_buffer_WHEN_all_popped_at_once_THEN_empty_and_reusable_after_clean);
+    RUN_TEST(GIVEN_owned_string_pushed_WHEN_last_pushed_get_THEN_characters_within_buffer_viewed);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_string_buf_tx_WHEN_owned_and_static_segments_pushed_THEN_popped_in_order()
+{
+    // GIVEN
+    string_buf_tx<4> buf;
+
+    // WHEN
+    buf.push_string("AT+CSQ");
+    buf.push_string("");
+    buf.push_static("=1");
+    buf.push_static("\r\n");
+
+    // THEN
+    TEST_ASSERT_EQUAL_STRING("AT+CSQ=1\r\n", pop_all(buf).c_str());
+    TEST_ASSERT(buf.is_empty());
+}
+
+static void GIVEN_string_buf_tx_WHEN_long_string_moved_in_THEN_whole_string_popped()
+{
+    // GIVEN
+    string_buf_tx<2> buf;
+    std::string payload(1024, 'x');
+    payload.back() = 'y';
+
+    // WHEN
+    buf.push_string(std::move(payload));
+
+    // THEN
+    auto popped = pop_all(buf);
+    TEST_ASSERT_EQUAL(1024, popped.length());
+    TEST_ASSERT_EQUAL('y', popped.back());
+}
+
+static void GIVEN_full_string_buf_tx_WHEN_popped_and_cleaned_THEN_segments_reusable()
+{
+    // GIVEN
+    string_buf_tx<2> buf;
+    TEST_ASSERT(buf.push_string("first"));
+    TEST_ASSERT(buf.push_static("second"));
+    TEST_ASSERT_FALSE(buf.push_static("third"));
+
+    // WHEN
+    auto popped = pop_all(buf);
+    auto free_before_clean = buf.get_free_segments_num();
+    buf.clean();
+
+    // THEN
+    TEST_ASSERT_EQUAL_STRING("firstsecond", popped.c_str());
+    TEST_ASSERT_EQUAL(0, free_before_clean);
+    TEST_ASSERT_EQUAL(2, buf.get_free_segments_num());
+    TEST_ASSERT(buf.push_string("third"));
+    TEST_ASSERT(buf.push_static("fourth"));
+    TEST_ASSERT_EQUAL_STRING("thirdfourth", pop_all(buf).c_str());
+}
+
+static void GIVEN_partially_popped_segment_WHEN_peeked_THEN_rest_of_segment_obtained_as_block()
+{
+    // GIVEN
+    string_buf_tx<2> buf;
+    buf.push_string("AT+CSQ");
+    buf.push_static("\r\n");
+    buf.pop_byte();
+
+    // WHEN
+    auto first_block = std::string(buf.peek_segment());
+    buf.pop_segment();
+    auto second_block = std::string(buf.peek_segment());
+    buf.pop_segment();
+
+    // THEN
+    TEST_ASSERT_EQUAL_STRING("T+CSQ", first_block.c_str());
+    TEST_ASSERT_EQUAL_STRING("\r\n", second_block.c_str());
+    TEST_ASSERT(buf.is_empty());
+    TEST_ASSERT(buf.peek_segment().empty());
+}
+
+static void GIVEN_partially_popped_buffer_WHEN_all_popped_at_once_THEN_empty_and_reusable_after_clean()
+{
+    // GIVEN
+    string_buf_tx<2> buf;
+    buf.push_static("socket data");
+    buf.push_static("\r\n");
+    buf.pop_byte();
+
+    // WHEN
+    buf.pop_all();
+
+    // THEN
+    TEST_ASSERT(buf.is_empty());
+    TEST_ASSERT_FALSE(buf.push_static("AT"));
+    buf.clean();
+    TEST_ASSERT(buf.push_static("AT"));
+    TEST_ASSERT_EQUAL_STRING("AT", pop_all(buf).c_str());
+}
+
+static void GIVEN_owned_string_pushed_WHEN_last_pushed_get_THEN_characters_within_buffer_viewed()
+{
+    // GIVEN
+    string_buf_tx<4> buf;
+    TEST_ASSERT(buf.get_last_pushed().empty());
+    std::string payload{"1,\"TCP\""};
+    buf.push_static("AT+QIOPEN=");
+
+    // WHEN
+    buf.push_string(std::move(payload));
+    auto last = buf.get_last_pushed();
+    buf.push_static("");
+
+    // THEN
+    TEST_ASSERT((last == "1,\"TCP\""));
+    TEST_ASSERT((buf.get_last_pushed() == last));
+    TEST_ASSERT_EQUAL_STRING("AT+QIOPEN=1,\"TCP\"", pop_all(buf).c_str());
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE MACROS, FUNCTIONS AND VARIABLES
+// --------------------------------------------------------------------------------------------------------------------
+template <size_t N> static std::string pop_all(string_buf_tx<N> &buf)
+{
+    std::string result;
+    while (!buf.is_empty())
+        result += buf.pop_byte();
+    return result;
+}
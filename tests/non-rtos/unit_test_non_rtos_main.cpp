@@ -6,12 +6,42 @@
 #include "unity.h"
 
 extern void test_at_cmd_handler();
+extern void test_string_buf_rx();
+extern void test_string_buf_tx();
+extern void test_block_pool();
+extern void test_request_queue();
+extern void test_inplace_function();
+extern void test_handler_table();
+extern void test_cmux_frame();
+extern void test_at_schema();
+extern void test_at_args();
+extern void test_at_response_cache();
+extern void test_at_capture();
+extern void test_at_stats();
+extern void test_at_host();
+extern void test_char_scan();
+extern void test_at_line_list();
 
 int main()
 {
     UNITY_BEGIN();
 
     test_at_cmd_handler();
+    test_string_buf_rx();
+    test_string_buf_tx();
+    test_block_pool();
+    test_request_queue();
+    test_inplace_function();
+    test_handler_table();
+    test_cmux_frame();
+    test_at_schema();
+    test_at_args();
+    test_at_response_cache();
+    test_at_capture();
+    test_at_stats();
+    test_at_host();
+    test_char_scan();
+    test_at_line_list();
 
     return UNITY_END();
 }
@@ -0,0 +1,313 @@
+/**
+ * @file	at_co_test.cpp
+ * @brief	Contains tests of the coroutines which await the AT commands. Compiled as C++20, when the compiler can.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "unity.h"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include "at_channel.hpp"
+#include "at_co.hpp"
+#include "os_flag.hpp"
+#include "semphr.h"
+#include <array>
+#include <csignal>
+#include <list>
+#include <string>
+#include <string_view>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_sequence_coroutine_WHEN_spawned_THEN_commands_sent_in_order_and_payloads_obtained();
+static void GIVEN_failing_command_WHEN_awaited_THEN_error_returned_and_rest_of_sequence_not_sent();
+static void GIVEN_more_workflows_than_queue_slots_WHEN_spawned_THEN_parked_commands_issued_and_each_done();
+static void GIVEN_queue_taken_by_others_WHEN_command_awaited_THEN_timeout_returned_at_once();
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF PRIVATE FUNCTIONS AND VARIABLES
+// --------------------------------------------------------------------------------------------------------------------
+#define SIMULATED_CO_MODEM_RX_INTERRUPT_SIGNAL SIGRTMIN + 9
+
+constexpr TickType_t max_wait_time_ticks = pdMS_TO_TICKS(15 * 1000);
+
+struct co_modem_cmd_set
+{
+    enum class cmd
+    {
+        at,
+        cgatt,
+        cgact,
+        qiopen,
+        number_of_commands,
+        none
+    };
+
+    enum class unsolicited_msg
+    {
+        rdy,
+        number_of_msgs,
+        none
+    };
+
+    static constexpr std::array<std::string_view, 4> cmd_names{"", "CGATT", "CGACT", "QIOPEN"};
+    static constexpr std::size_t first_extended_cmd_idx{1};
+    static constexpr std::array<std::string_view, 1> unsolicited_msg_strs{"RDY"};
+};
+
+using co_cmd = co_modem_cmd_set::cmd;
+
+//! Simulates the port of the modem. The command is transmitted at once and then the modem responds.
+struct co_modem_hal
+{
+    static void enable_rx_it()
+    {
+    }
+
+    static void enable_tx_it();
+    static void disable_tx_it();
+    static void send_byte(char c);
+};
+
+struct co_modem_channel_config : jungles::at_channel_default_config
+{
+    static constexpr size_t rx_buf_len = 128;
+    static constexpr size_t rx_lines_num = 8;
+    static constexpr size_t cmd_queue_len = 2;
+    static constexpr unsigned max_overtakes = 1;
+    static constexpr const char *rx_task_name = "co_modem_rx";
+};
+
+using co_modem_channel_type = jungles::at_channel<co_modem_cmd_set, co_modem_hal, co_modem_channel_config>;
+
+static co_modem_channel_type co_modem_channel;
+
+static at_co_scheduler<co_modem_channel_type> co_scheduler{co_modem_channel};
+
+static bool is_co_modem_tx_interrupt_enabled;
+
+//! All the bytes transmitted to the modem.
+static std::string co_modem_transmitted;
+
+//! The responses to the next commands; "OK" is the response to the rest.
+static std::list<std::string> co_modem_mock_responses;
+
+//! The number of the responses which are held back, so the commands stay in flight.
+static unsigned co_modem_held_responses_num;
+
+static void simulated_co_modem_rx_interrupt(int sig);
+
+static void co_modem_respond();
+
+//! Gives the semaphore with the result, so the test task can await the whole sequence.
+struct co_done
+{
+    SemaphoreHandle_t done;
+    at_err *result;
+
+    void operator()(at_err res) const
+    {
+        *result = res;
+        xSemaphoreGive(done);
+    }
+};
+
+static at_co_task attach(at_string &attach_state);
+static at_co_task open_socket(at_string &attach_state);
+static at_co_task attach_and_activate();
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXECUTION OF THE TESTS
+// --------------------------------------------------------------------------------------------------------------------
+void test_at_co()
+{
+    std::signal(SIMULATED_CO_MODEM_RX_INTERRUPT_SIGNAL, simulated_co_modem_rx_interrupt);
+    co_modem_channel.init();
+
+    RUN_TEST(GIVEN_sequence_coroutine_WHEN_spawned_THEN_commands_sent_in_order_and_payloads_obtained);
+    RUN_TEST(GIVEN_failing_command_WHEN_awaited_THEN_error_returned_and_rest_of_sequence_not_sent);
+    RUN_TEST(GIVEN_more_workflows_than_queue_slots_WHEN_spawned_THEN_parked_commands_issued_and_each_done);
+    RUN_TEST(GIVEN_queue_taken_by_others_WHEN_command_awaited_THEN_timeout_returned_at_once);
+
+    co_modem_channel.deinit();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_sequence_coroutine_WHEN_spawned_THEN_commands_sent_in_order_and_payloads_obtained()
+{
+    // Given
+    co_modem_transmitted.clear();
+    co_modem_mock_responses = {"+CGATT: 1\r\nOK\r\n", "OK\r\n", "OK\r\n"};
+    auto done = xSemaphoreCreateBinary();
+    at_err result = at_err::unknown;
+    at_string attach_state;
+
+    // When
+    at_co_spawn(open_socket(attach_state), co_done{done, &result});
+    auto is_done = xSemaphoreTake(done, max_wait_time_ticks) == pdTRUE;
+    vSemaphoreDelete(done);
+
+    // Then
+    TEST_ASSERT(is_done);
+    TEST_ASSERT(result == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("1", attach_state.c_str());
+    TEST_ASSERT_EQUAL_STRING("AT+CGATT?\r\nAT+CGACT=1,1\r\nAT+QIOPEN=1,0,\"TCP\",\"10.0.0.1\",80\r\n",
+                             co_modem_transmitted.c_str());
+}
+
+static void GIVEN_failing_command_WHEN_awaited_THEN_error_returned_and_rest_of_sequence_not_sent()
+{
+    // Given
+    co_modem_transmitted.clear();
+    co_modem_mock_responses = {"+CGATT: 1\r\nOK\r\n", "+CME ERROR: 30\r\n"};
+    auto done = xSemaphoreCreateBinary();
+    at_err result = at_err::unknown;
+    at_string attach_state;
+
+    // When
+    at_co_spawn(open_socket(attach_state), co_done{done, &result});
+    auto is_done = xSemaphoreTake(done, max_wait_time_ticks) == pdTRUE;
+    vSemaphoreDelete(done);
+
+    // Then
+    TEST_ASSERT(is_done);
+    TEST_ASSERT(result == at_err::cme_error);
+    TEST_ASSERT_EQUAL_STRING("AT+CGATT?\r\nAT+CGACT=1,1\r\n", co_modem_transmitted.c_str());
+}
+
+static void GIVEN_more_workflows_than_queue_slots_WHEN_spawned_THEN_parked_commands_issued_and_each_done()
+{
+    // Given
+    constexpr unsigned workflows_num = 100;
+    co_modem_transmitted.clear();
+    co_modem_mock_responses.clear();
+    auto done = xSemaphoreCreateCounting(workflows_num, 0);
+    std::array<at_err, workflows_num> results;
+    results.fill(at_err::unknown);
+
+    // When
+    // Two slots of the queue for a hundred workflows of two commands each.
+    for (auto &result : results)
+        at_co_spawn(attach_and_activate(), co_done{done, &result});
+    unsigned done_num = 0;
+    while (done_num < workflows_num && xSemaphoreTake(done, max_wait_time_ticks) == pdTRUE)
+        done_num++;
+    vSemaphoreDelete(done);
+
+    // Then
+    TEST_ASSERT_EQUAL(workflows_num, done_num);
+    for (auto result : results)
+        TEST_ASSERT(result == at_err::ok);
+    std::string expected;
+    for (unsigned i = 0; i < workflows_num; ++i)
+        expected += "AT+CGATT=1\r\nAT+CGACT=1,1\r\n";
+    // Each command is transmitted once, although most of them have been parked.
+    TEST_ASSERT_EQUAL(expected.size(), co_modem_transmitted.size());
+}
+
+static void GIVEN_queue_taken_by_others_WHEN_command_awaited_THEN_timeout_returned_at_once()
+{
+    // Given
+    co_modem_transmitted.clear();
+    co_modem_mock_responses.clear();
+    co_modem_held_responses_num = 1;
+    os_flag held_done;
+    os_flag queued_done;
+    auto held = co_modem_channel.send_async(co_cmd::at, at_cmd_type::exec, "", held_done);
+    auto queued = co_modem_channel.send_async(co_cmd::cgatt, at_cmd_type::read, "", queued_done);
+    auto done = xSemaphoreCreateBinary();
+    at_err result = at_err::unknown;
+
+    // When
+    at_co_spawn(attach_and_activate(), co_done{done, &result});
+    auto is_done = xSemaphoreTake(done, 0) == pdTRUE;
+    vSemaphoreDelete(done);
+    co_modem_respond();
+    queued_done.wait_set();
+
+    // Then
+    TEST_ASSERT(held.is_valid());
+    TEST_ASSERT(queued.is_valid());
+    TEST_ASSERT(is_done);
+    TEST_ASSERT(result == at_err::timeout);
+    at_string pload;
+    TEST_ASSERT(co_modem_channel.get_async_result(held, pload) == at_err::ok);
+    TEST_ASSERT(co_modem_channel.get_async_result(queued, pload) == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("AT\r\nAT+CGATT?\r\n", co_modem_transmitted.c_str());
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+void co_modem_hal::enable_tx_it()
+{
+    is_co_modem_tx_interrupt_enabled = true;
+    while (is_co_modem_tx_interrupt_enabled)
+        co_modem_channel.it_handle_byte_tx();
+    if (co_modem_held_responses_num > 0)
+        co_modem_held_responses_num--;
+    else
+        std::raise(SIMULATED_CO_MODEM_RX_INTERRUPT_SIGNAL);
+}
+
+void co_modem_hal::disable_tx_it()
+{
+    is_co_modem_tx_interrupt_enabled = false;
+}
+
+void co_modem_hal::send_byte(char c)
+{
+    co_modem_transmitted.push_back(c);
+}
+
+static void simulated_co_modem_rx_interrupt(int sig)
+{
+    std::string response = "OK\r\n";
+    if (!co_modem_mock_responses.empty())
+    {
+        response = co_modem_mock_responses.front();
+        co_modem_mock_responses.pop_front();
+    }
+    co_modem_channel.it_handle_bytes_rx(response.data(), response.size());
+}
+
+static void co_modem_respond()
+{
+    std::raise(SIMULATED_CO_MODEM_RX_INTERRUPT_SIGNAL);
+}
+
+static at_co_task attach(at_string &attach_state)
+{
+    auto res = co_await co_scheduler.send(co_cmd::cgatt, at_cmd_type::read, "", attach_state);
+    if (res != at_err::ok || attach_state == "1")
+        co_return res;
+    co_return co_await co_scheduler.send(co_cmd::cgatt, at_cmd_type::write, "1");
+}
+
+static at_co_task open_socket(at_string &attach_state)
+{
+    if (auto res = co_await attach(attach_state); res != at_err::ok)
+        co_return res;
+    if (auto res = co_await co_scheduler.send(co_cmd::cgact, at_cmd_type::write, "1,1"); res != at_err::ok)
+        co_return res;
+    co_return co_await co_scheduler.send(co_cmd::qiopen, at_cmd_type::write, "1,0,\"TCP\",\"10.0.0.1\",80");
+}
+
+static at_co_task attach_and_activate()
+{
+    if (auto res = co_await co_scheduler.send(co_cmd::cgatt, at_cmd_type::write, "1"); res != at_err::ok)
+        co_return res;
+    co_return co_await co_scheduler.send(co_cmd::cgact, at_cmd_type::write, "1,1");
+}
+
+#else
+
+//! Built as C++17, so there are no coroutines to test.
+void test_at_co()
+{
+}
+
+#endif /* defined(__cpp_impl_coroutine) && __has_include(<coroutine>) */
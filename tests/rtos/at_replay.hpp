@@ -0,0 +1,103 @@
+/**
+ * @file	at_replay.hpp
+ * @brief	Replays the traffic captured by at_capture_ring, e.g. exported from the field, against a channel.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+
+#ifndef AT_REPLAY_HPP
+#define AT_REPLAY_HPP
+
+#include "FreeRTOS.h"
+#include "at_capture.hpp"
+#include "task.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS OF STRUCTURES, DATA TYPES, ...
+// --------------------------------------------------------------------------------------------------------------------
+
+struct at_replay_report
+{
+    unsigned records_num = 0;
+    size_t rx_bytes_num = 0;
+    size_t tx_bytes_num = 0;
+
+    //! From the first record to the end of the replay.
+    TickType_t duration_ticks = 0;
+
+    //! The most which a record has been handled late, compared to the timing of the capture.
+    TickType_t max_lag_ticks = 0;
+
+    //! How many bytes have been received per second of the replay.
+    size_t get_rx_bytes_per_second() const
+    {
+        auto duration_ms = static_cast<size_t>(duration_ticks) * portTICK_PERIOD_MS;
+        return duration_ms == 0 ? rx_bytes_num * 1000 : rx_bytes_num * 1000 / duration_ms;
+    }
+};
+
+/**
+ * \brief Passes the records of the capture to feed_rx(std::string_view bytes) (the RX ones, e.g. to the mocked RX
+ *        interrupt) and to on_tx(std::string_view bytes) (the TX ones, e.g. to compare them with what is transmitted),
+ *        keeping the timing of the capture.
+ *
+ * The timestamps of the capture are converted to the ticks with units_per_tick and then the replay is accelerated
+ * speedup times. Zero speedup replays the records as fast as they are handled. The incomplete trailing record is
+ * ignored.
+ */
+template <typename FeedRx, typename OnTx>
+at_replay_report
+    at_replay(std::string_view capture, uint32_t units_per_tick, unsigned speedup, FeedRx &&feed_rx, OnTx &&on_tx);
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF TEMPLATES
+// --------------------------------------------------------------------------------------------------------------------
+template <typename FeedRx, typename OnTx>
+at_replay_report
+    at_replay(std::string_view capture, uint32_t units_per_tick, unsigned speedup, FeedRx &&feed_rx, OnTx &&on_tx)
+{
+    at_replay_report report;
+    auto start = xTaskGetTickCount();
+    auto wake = start;
+    uint32_t first_timestamp = 0;
+
+    at_capture_record record;
+    while (at_read_capture_record(capture, record))
+    {
+        if (report.records_num++ == 0)
+            first_timestamp = record.timestamp;
+
+        // The subtraction is correct also when the timestamps have wrapped around during the capture.
+        auto due = start;
+        if (speedup > 0)
+        {
+            auto due_offset = static_cast<TickType_t>((record.timestamp - first_timestamp) / units_per_tick / speedup);
+            auto wake_offset = static_cast<TickType_t>(wake - start);
+            due += due_offset;
+            if (due_offset > wake_offset)
+                vTaskDelayUntil(&wake, due_offset - wake_offset);
+        }
+
+        if (record.direction == at_capture_direction::rx)
+        {
+            feed_rx(record.bytes);
+            report.rx_bytes_num += record.bytes.length();
+        }
+        else
+        {
+            on_tx(record.bytes);
+            report.tx_bytes_num += record.bytes.length();
+        }
+
+        auto lag = static_cast<TickType_t>(xTaskGetTickCount() - due);
+        if (speedup > 0 && lag > report.max_lag_ticks)
+            report.max_lag_ticks = lag;
+    }
+
+    report.duration_ticks = static_cast<TickType_t>(xTaskGetTickCount() - start);
+    return report;
+}
+
+#endif /* AT_REPLAY_HPP */
@@ -3,12 +3,22 @@
  * @brief	Tests of AT commands handling.
  * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
  */
+#include "alloc_tracker.hpp"
 #include "at_cmd.hpp"
+#include "at_replay.hpp"
+#include "at_rx_dispatcher.hpp"
+#include "os_flag.hpp"
+#include "semphr.h"
+#include "task.h"
 #include "unity.h"
 #include <csignal>
+#include <cstring>
 #include <iostream>
 #include <list>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
 
 // --------------------------------------------------------------------------------------------------------------------
 // DECLARATION OF THE TEST CASES
@@ -16,6 +26,46 @@
 static void GIVEN_prepared_response_WHEN_at_sent_THEN_response_populated_to_caller_task();
 static void GIVEN_sent_command_WHEN_response_not_received_THEN_timeout_error_received();
 static void GIVEN_first_command_fails_WHEN_second_successful_THEN_received_proper_response();
+static void GIVEN_response_received_in_chunks_WHEN_at_sent_THEN_response_populated_to_caller_task();
+static void GIVEN_stalled_transmission_WHEN_commands_pile_up_in_tx_buffer_THEN_one_which_does_not_fit_fails();
+static void GIVEN_command_in_flight_WHEN_another_task_sends_command_THEN_each_task_gets_its_own_response();
+static void GIVEN_prepared_response_WHEN_at_sent_async_THEN_completion_invoked_with_response();
+static void GIVEN_prepared_response_WHEN_at_sent_async_with_flag_THEN_flag_set_and_result_obtained();
+static void GIVEN_async_command_not_responded_WHEN_aborted_THEN_next_command_handled();
+static void GIVEN_second_channel_with_own_cmd_set_WHEN_command_sent_THEN_response_obtained_on_that_channel();
+static void GIVEN_latency_stats_enabled_WHEN_command_done_THEN_each_phase_recorded();
+static void GIVEN_multiline_response_WHEN_at_sent_streamed_THEN_each_line_passed_to_sink();
+static void GIVEN_streamed_response_WHEN_sink_touches_channel_THEN_lock_not_held();
+static void GIVEN_multiline_response_WHEN_at_sent_for_lines_THEN_lines_visited_in_reserved_buffer();
+static void GIVEN_binary_data_after_header_WHEN_at_sent_binary_read_THEN_data_received_intact();
+static void GIVEN_batch_of_commands_WHEN_at_sent_batch_THEN_each_entry_gets_its_result_and_payload();
+static void GIVEN_batch_with_failing_command_WHEN_sent_with_stop_on_error_THEN_rest_not_sent();
+static void GIVEN_queued_command_WHEN_urgent_command_sent_THEN_urgent_transmitted_first();
+static void GIVEN_deferred_handler_blocked_WHEN_command_sent_THEN_response_parsed_meanwhile();
+static void GIVEN_task_waits_for_unsolicited_WHEN_awaited_payload_arrives_THEN_task_woken_with_payload();
+static void GIVEN_caller_owned_message_WHEN_at_sent_prompted_THEN_message_transmitted_after_prompt();
+static void GIVEN_prompt_armed_WHEN_prompt_character_received_THEN_message_transmitted_from_interrupt();
+static void GIVEN_response_stalled_WHEN_inter_line_limit_passes_THEN_command_withdrawn_and_next_one_handled();
+static void GIVEN_command_with_schema_WHEN_at_sent_typed_THEN_typed_values_obtained();
+static void GIVEN_command_with_signature_WHEN_sent_write_THEN_arguments_formatted_into_payload();
+static void GIVEN_cached_query_in_flight_WHEN_sent_again_THEN_sent_once_and_answered_from_cache_till_urc();
+static void GIVEN_query_in_flight_on_single_flight_channel_WHEN_sent_again_THEN_transmitted_once();
+static void GIVEN_channels_running_WHEN_stack_high_water_marks_read_THEN_within_their_stacks();
+static void GIVEN_echo_suppressed_channel_WHEN_command_and_message_echoed_THEN_echoes_not_handled();
+static void GIVEN_captured_session_WHEN_replayed_THEN_same_traffic_handled_again();
+static void GIVEN_counted_channel_WHEN_traffic_and_commands_handled_THEN_counters_reflect_them();
+static void GIVEN_receiver_task_falls_behind_WHEN_lines_pile_up_THEN_device_stopped_with_rts_and_no_line_lost();
+static void GIVEN_sleeping_device_WHEN_commands_issued_within_window_THEN_transmitted_within_one_wake_cycle();
+static void GIVEN_commands_held_WHEN_urgent_command_issued_THEN_all_transmitted_right_away();
+static void GIVEN_window_of_two_packets_WHEN_three_sent_THEN_pipelined_without_waiting_for_each_ack();
+static void GIVEN_packet_rejected_WHEN_next_packet_sent_THEN_failure_reported_and_nothing_sent();
+static void GIVEN_packet_not_acknowledged_WHEN_flush_times_out_THEN_packet_withdrawn_and_channel_usable();
+static void GIVEN_channels_on_one_dispatcher_WHEN_commands_sent_on_both_THEN_each_gets_own_response();
+static void GIVEN_chatty_channel_on_dispatcher_WHEN_other_channel_receives_line_THEN_handled_after_one_turn();
+static void GIVEN_channels_on_one_dispatcher_WHEN_handler_registers_handlers_on_both_THEN_each_registered_and_invoked();
+static void GIVEN_rx_stream_channel_WHEN_response_received_byte_by_byte_THEN_lines_split_by_receiver_task();
+static void GIVEN_rx_stream_channel_WHEN_more_received_than_stream_holds_THEN_excess_dropped_and_counted();
+static void GIVEN_warmed_up_channel_WHEN_commands_sent_and_responses_received_THEN_heap_allocations_within_budget();
 
 // --------------------------------------------------------------------------------------------------------------------
 // DECLARATION OF PRIVATE FUNCTIONS AND VARIABLES
@@ -27,61 +77,1401 @@ static std::list<std::string> mock_responses_on_at_commands;
 
 static bool is_tx_interrupt_enabled;
 
+//! When set, the simulated TX interrupt isn't raised, as if the device held the transmission back.
+static bool is_tx_stalled;
+
+#ifdef AT_CMD_HANDLER_TX_DMA
+//! Set while the simulated TX interrupt completes the blocks, so the next block doesn't raise the interrupt again.
+static bool is_within_tx_interrupt;
+#endif /* AT_CMD_HANDLER_TX_DMA */
+
+//! When set, the simulated RX interrupt passes whole mocked responses at once, like a DMA/idle-line interrupt.
+static bool is_rx_chunked;
+
 static void simulated_rx_interrupt(int sig);
 static void simulated_tx_interrupt(int sig);
 
-// --------------------------------------------------------------------------------------------------------------------
-// EXTERNAL DEPENDENCIES DECLARATION
-// --------------------------------------------------------------------------------------------------------------------
+//! Sends a command from another task than the testing one, to test the concurrent usage of the interface.
+static void sending_task(void *params);
+
+//! Simulates responses which arrive with a delay, for the commands sent from the testing and the sending task.
+static void responding_task(void *params);
+
+//! Sends the cached query from another task than the testing one.
+static void querying_task(void *params);
+
+//! Simulates the single response to the cached query, which arrives when both tasks have issued it.
+static void query_responding_task(void *params);
+
+//! The same as querying_task() and query_responding_task(), but for the second port.
+static void gnss_querying_task(void *params);
+static void gnss_query_responding_task(void *params);
+
+struct sending_task_params
+{
+    at_err result;
+    at_string pload;
+    SemaphoreHandle_t done;
+};
+
+//! The commands of a GNSS module, which is served by its own channel, next to the default one.
+struct gnss_cmd_set
+{
+    enum class cmd
+    {
+        at,
+        qgps,
+        qgpsloc,
+        number_of_commands,
+        none
+    };
+
+    enum class unsolicited_msg
+    {
+        rdy,
+        number_of_msgs,
+        none
+    };
+
+    static constexpr std::array<std::string_view, 3> cmd_names{"", "QGPS", "QGPSLOC"};
+    static constexpr std::size_t first_extended_cmd_idx{1};
+    static constexpr std::array<std::string_view, 1> unsolicited_msg_strs{"RDY"};
+    static constexpr std::array<at_cmd_timeout<cmd>, 1> timeout_profiles{{{cmd::qgpsloc, {1000, 50}}}};
+    using write_signatures = std::tuple<at_cmd_args<cmd::qgpsloc, int>, at_cmd_args<cmd::qgps, int, quoted_string>>;
+};
+
+//! Simulates the second port. The bytes are transmitted at once and then the mocked responses are received.
+struct gnss_hal
+{
+    static void enable_rx_it()
+    {
+    }
+
+    static void enable_tx_it();
+    static void disable_tx_it();
+    static void send_byte(char c);
+    static void assert_rts();
+    static void release_rts();
+
+    //! Each call is one unit later than the previous one.
+    static uint32_t get_timestamp();
+};
+
+struct gnss_channel_config : jungles::at_channel_default_config
+{
+    static constexpr size_t rx_buf_len = 128;
+    static constexpr size_t rx_lines_num = 8;
+    static constexpr size_t cmd_queue_len = 2;
+    static constexpr unsigned max_overtakes = 1;
+    static constexpr bool is_no_newline_after_prompt = true;
+    static constexpr bool is_prompt_from_isr = true;
+    static constexpr bool is_latency_stats = true;
+    static constexpr bool is_single_flight = true;
+    static constexpr bool is_echo_suppressed = true;
+    static constexpr bool is_stats = true;
+    static constexpr size_t capture_len = 512;
+    static constexpr size_t rx_rts_high_watermark = 96;
+    static constexpr size_t rx_rts_low_watermark = 32;
+    static constexpr const char *rx_task_name = "gnss_rx";
+    static constexpr size_t urc_queue_len = 2;
+    static constexpr const char *urc_task_name = "gnss_urc";
+};
+
+static jungles::at_channel<gnss_cmd_set, gnss_hal, gnss_channel_config> gnss_channel;
+
+static std::list<std::string> gnss_mock_responses;
+
+//! All the bytes transmitted through the second port.
+static std::string gnss_transmitted;
+
+static bool is_gnss_tx_interrupt_enabled;
+
+//! The task within which the latest transmission through the second port has been started.
+static std::string gnss_tx_starting_task_name;
+
+static uint32_t gnss_timestamp;
+
+//! The state of the RTS line of the second port and the number of times it has been released.
+static bool is_gnss_rts_asserted;
+static unsigned gnss_rts_releases_num;
+
+static unsigned gnss_dumped_lines_num;
+
+static void simulated_gnss_rx_interrupt(int sig);
+
+//! Simulates the third port, of a device which sleeps between the wake cycles. Each command is transmitted at once
+//! and then the next mocked response is received.
+struct psm_hal
+{
+    static void enable_rx_it()
+    {
+    }
+
+    static void enable_tx_it();
+    static void disable_tx_it();
+    static void send_byte(char c);
+    static void wake_device();
+    static void allow_device_sleep();
+};
+
+struct psm_channel_config : jungles::at_channel_default_config
+{
+    static constexpr size_t rx_buf_len = 64;
+    static constexpr size_t rx_lines_num = 4;
+    static constexpr size_t cmd_queue_len = 3;
+    static constexpr unsigned max_overtakes = 1;
+    static constexpr bool is_stats = true;
+    static constexpr TickType_t tx_gather_ticks = pdMS_TO_TICKS(50);
+    static constexpr bool is_wake_line = true;
+    static constexpr const char *rx_task_name = "psm_rx";
+};
+
+static jungles::at_channel<gnss_cmd_set, psm_hal, psm_channel_config> psm_channel;
+
+static std::list<std::string> psm_mock_responses;
+
+//! All the bytes transmitted through the third port.
+static std::string psm_transmitted;
+
+static bool is_psm_tx_interrupt_enabled;
+
+//! The state of the wake line of the third port, the number of the wake-ups and whether the device has been awake
+//! for each transmitted byte.
+static bool is_psm_awake;
+static unsigned psm_wakes_num;
+static bool is_psm_awake_on_each_tx = true;
+
+static void simulated_psm_rx_interrupt(int sig);
+
+//! Simulates the ports of the channels which share a single receiver task. Each transmission is followed by the
+//! mocked responses of all the ports.
+template <unsigned Port> struct shared_hal
+{
+    static void enable_rx_it()
+    {
+    }
+
+    static void enable_tx_it();
+    static void disable_tx_it();
+    static void send_byte(char c);
+};
+
+struct shared_channel_config : jungles::at_channel_default_config
+{
+    static constexpr size_t rx_buf_len = 128;
+    static constexpr size_t cmd_queue_len = 2;
+    static constexpr unsigned max_overtakes = 1;
+    // The receiver task is the one of the dispatcher.
+    static constexpr const char *rx_task_name = "";
+    static constexpr configSTACK_DEPTH_TYPE rx_task_stack_depth = 0;
+    static constexpr UBaseType_t rx_task_priority = 0;
+};
+
+constexpr unsigned shared_ports_num = 2;
+constexpr unsigned shared_max_lines_per_turn = 2;
+
+static jungles::at_rx_dispatcher<shared_ports_num, shared_max_lines_per_turn> shared_rx_dispatcher;
+
+static std::tuple<jungles::at_channel<gnss_cmd_set, shared_hal<0>, shared_channel_config>,
+                  jungles::at_channel<gnss_cmd_set, shared_hal<1>, shared_channel_config>>
+    shared_channels;
+
+static std::array<std::list<std::string>, shared_ports_num> shared_mock_responses;
+
+//! All the bytes transmitted through each port.
+static std::array<std::string, shared_ports_num> shared_transmitted;
+
+static std::array<bool, shared_ports_num> is_shared_tx_interrupt_enabled;
+
+static void simulated_shared_rx_interrupt(int sig);
+
+//! Simulates the fourth port, which passes the received characters through the RX stream. Each transmission is
+//! followed by the next mocked response, received byte by byte unless it's marked as a chunk.
+struct stream_hal
+{
+    static void enable_rx_it()
+    {
+    }
+
+    static void enable_tx_it();
+    static void disable_tx_it();
+    static void send_byte(char c);
+};
+
+struct stream_channel_config : jungles::at_channel_default_config
+{
+    static constexpr size_t rx_buf_len = 128;
+    static constexpr size_t rx_lines_num = 8;
+    static constexpr size_t cmd_queue_len = 2;
+    static constexpr unsigned max_overtakes = 1;
+    static constexpr bool is_echo_suppressed = true;
+    static constexpr size_t rx_stream_len = 64;
+    static constexpr size_t rx_stream_trigger_level = 16;
+    static constexpr const char *rx_task_name = "stream_rx";
+};
+
+static jungles::at_channel<gnss_cmd_set, stream_hal, stream_channel_config> stream_channel;
+
+//! The responses received byte by byte, unless is_chunk is set.
+struct stream_mock_response
+{
+    std::string bytes;
+    bool is_chunk;
+};
+
+static std::list<stream_mock_response> stream_mock_responses;
+
+//! All the bytes transmitted through the fourth port.
+static std::string stream_transmitted;
+
+static bool is_stream_tx_interrupt_enabled;
+
+static void simulated_stream_rx_interrupt(int sig);
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXTERNAL DEPENDENCIES DECLARATION
+// --------------------------------------------------------------------------------------------------------------------
+
+#define SIMULATED_RX_INTERRUPT_SIGNAL SIGRTMIN + 3
+#define SIMULATED_TX_INTERRUPT_SIGNAL SIGRTMIN + 4
+#define SIMULATED_GNSS_RX_INTERRUPT_SIGNAL SIGRTMIN + 5
+#define SIMULATED_PSM_RX_INTERRUPT_SIGNAL SIGRTMIN + 6
+#define SIMULATED_SHARED_RX_INTERRUPT_SIGNAL SIGRTMIN + 7
+#define SIMULATED_STREAM_RX_INTERRUPT_SIGNAL SIGRTMIN + 8
+
+extern "C" void hw_at_enable_tx_it();
+extern "C" void hw_at_disable_tx_it();
+extern "C" void hw_at_enable_rx_it();
+extern "C" void hw_at_disable_rx_it();
+extern "C" void hw_at_send_byte(char c);
+#ifdef AT_CMD_HANDLER_RX_RTS_HIGH_WATERMARK
+extern "C" void hw_at_assert_rts();
+extern "C" void hw_at_release_rts();
+#endif /* AT_CMD_HANDLER_RX_RTS_HIGH_WATERMARK */
+#ifdef AT_CMD_HANDLER_WAKE_LINE
+extern "C" void hw_at_wake_device();
+extern "C" void hw_at_allow_device_sleep();
+#endif /* AT_CMD_HANDLER_WAKE_LINE */
+extern "C" void it_handle_at_byte_rx(char c);
+extern "C" void it_handle_at_bytes_rx(const char *bytes, size_t num);
+extern "C" void it_handle_at_byte_tx();
+#ifdef AT_CMD_HANDLER_TX_DMA
+extern "C" void hw_at_send_block(const char *data, size_t len);
+extern "C" void it_handle_at_block_tx_done();
+#endif /* AT_CMD_HANDLER_TX_DMA */
+#if defined(AT_CMD_HANDLER_LATENCY_STATS) || defined(AT_CMD_HANDLER_CAPTURE_LEN)
+extern "C" uint32_t hw_at_get_timestamp();
+#endif /* defined(AT_CMD_HANDLER_LATENCY_STATS) || defined(AT_CMD_HANDLER_CAPTURE_LEN) */
+extern "C" void init_at();
+extern "C" void deinit_at();
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_prepared_response_WHEN_at_sent_THEN_response_populated_to_caller_task()
+{
+    // Given
+    mock_responses_on_at_commands.push_back("+FIRST: 0,1\r\n");
+    mock_responses_on_at_commands.push_back("OK\r\n");
+
+    // When
+    at_string pload;
+    auto res = at_send(at_cmd::first, at_cmd_type::read, max_wait_time_ticks, pload);
+
+    // Then
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("0,1", pload.c_str());
+}
+
+static void GIVEN_sent_command_WHEN_response_not_received_THEN_timeout_error_received()
+{
+    auto res = at_send(at_cmd::first, at_cmd_type::exec, 0);
+    TEST_ASSERT(res == at_err::timeout);
+}
+
+static void GIVEN_first_command_fails_WHEN_second_successful_THEN_received_proper_response()
+{
+    // Given
+    at_send(at_cmd::second, at_cmd_type::exec, 0);
+
+    // When
+    mock_responses_on_at_commands.push_back("OK\r\n");
+    auto result = at_send(at_cmd::third, "THIS IS SOME DUMMY PLOAD", max_wait_time_ticks);
+
+    // Then
+    TEST_ASSERT(result == at_err::ok);
+}
+
+static void GIVEN_response_received_in_chunks_WHEN_at_sent_THEN_response_populated_to_caller_task()
+{
+    // Given
+    is_rx_chunked = true;
+    mock_responses_on_at_commands.push_back("\r\n+FOURTH: 2,3\r\n+FOURTH: 4,");
+    mock_responses_on_at_commands.push_back("5\r\n\r\nOK\r\n");
+
+    // When
+    at_string pload;
+    auto res = at_send(at_cmd::fourth, at_cmd_type::read, max_wait_time_ticks, pload);
+    is_rx_chunked = false;
+
+    // Then
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("2,3\r\n4,5", pload.c_str());
+}
+
+static void GIVEN_stalled_transmission_WHEN_commands_pile_up_in_tx_buffer_THEN_one_which_does_not_fit_fails()
+{
+    // Given
+    is_tx_stalled = true;
+    // The withdrawn commands stay in the TX buffer, as none of their bytes has been transmitted.
+    TEST_ASSERT(at_send(at_cmd::third, "FIRST PLOAD", 0) == at_err::timeout);
+    TEST_ASSERT(at_send(at_cmd::third, "SECOND PLOAD", 0) == at_err::timeout);
+
+    // When
+    auto start = xTaskGetTickCount();
+    auto res = at_send(at_cmd::third, "THIRD PLOAD", max_wait_time_ticks);
+    auto elapsed = xTaskGetTickCount() - start;
+
+    // Then
+    TEST_ASSERT(res == at_err::tx_overflow);
+    TEST_ASSERT(elapsed < pdMS_TO_TICKS(500));
+    is_tx_stalled = false;
+    std::raise(SIMULATED_TX_INTERRUPT_SIGNAL);
+    mock_responses_on_at_commands.push_back("OK\r\n");
+    TEST_ASSERT(at_send(at_cmd::third, at_cmd_type::exec, max_wait_time_ticks) == at_err::ok);
+}
+
+static void GIVEN_command_in_flight_WHEN_another_task_sends_command_THEN_each_task_gets_its_own_response()
+{
+    // Given
+    sending_task_params params;
+    params.done = xSemaphoreCreateBinary();
+    // The sending task has higher priority so it sends its command first. The responses for both commands arrive
+    // when both of them are already queued.
+    xTaskCreate(sending_task, "at_sender", 1024, &params, 2, NULL);
+    xTaskCreate(responding_task, "at_responder", 1024, NULL, 2, NULL);
+
+    // When
+    at_string pload;
+    auto res = at_send(at_cmd::sixth, at_cmd_type::read, max_wait_time_ticks, pload);
+    xSemaphoreTake(params.done, max_wait_time_ticks);
+    vSemaphoreDelete(params.done);
+
+    // Then
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("6", pload.c_str());
+    TEST_ASSERT(params.result == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("5", params.pload.c_str());
+}
+
+static void GIVEN_prepared_response_WHEN_at_sent_async_THEN_completion_invoked_with_response()
+{
+    // Given
+    mock_responses_on_at_commands.push_back("+SEVENTH: 7,7\r\nOK\r\n");
+    auto done = xSemaphoreCreateBinary();
+    at_err result = at_err::unknown;
+    at_string pload;
+
+    // When
+    auto handle = at_send_async(
+        at_cmd::seventh, at_cmd_type::read, "", [&](at_err res, at_string &&response_payload) {
+            result = res;
+            pload = std::move(response_payload);
+            xSemaphoreGive(done);
+        });
+    auto is_completed = xSemaphoreTake(done, max_wait_time_ticks) == pdTRUE;
+    vSemaphoreDelete(done);
+
+    // Then
+    TEST_ASSERT(handle.is_valid());
+    TEST_ASSERT(is_completed);
+    TEST_ASSERT(result == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("7,7", pload.c_str());
+}
+
+static void GIVEN_prepared_response_WHEN_at_sent_async_with_flag_THEN_flag_set_and_result_obtained()
+{
+    // Given
+    mock_responses_on_at_commands.push_back("+EIGHTH: 8\r\nERROR\r\n");
+    os_flag done;
+    at_string pload;
+
+    // When
+    auto handle = at_send_async(at_cmd::eighth, at_cmd_type::write, "1", done);
+    done.wait_set();
+
+    // Then
+    TEST_ASSERT(done.is_set());
+    TEST_ASSERT(at_get_async_result(handle, pload) == at_err::error);
+    TEST_ASSERT_EQUAL_STRING("8", pload.c_str());
+    // The result can be taken only once.
+    TEST_ASSERT(at_get_async_result(handle, pload) == at_err::unknown);
+}
+
+static void GIVEN_async_command_not_responded_WHEN_aborted_THEN_next_command_handled()
+{
+    // Given
+    os_flag done;
+    at_string pload;
+    auto handle = at_send_async(at_cmd::ninth, at_cmd_type::exec, "", done);
+    TEST_ASSERT(at_get_async_result(handle, pload) == at_err::handling_cmd);
+
+    // When
+    TEST_ASSERT(at_abort_async(handle));
+    mock_responses_on_at_commands.push_back("OK\r\n");
+    auto result = at_send(at_cmd::tenth, at_cmd_type::exec, max_wait_time_ticks);
+
+    // Then
+    TEST_ASSERT(result == at_err::ok);
+    TEST_ASSERT_FALSE(done.is_set());
+    TEST_ASSERT_FALSE(at_abort_async(handle));
+}
+
+static void GIVEN_second_channel_with_own_cmd_set_WHEN_command_sent_THEN_response_obtained_on_that_channel()
+{
+    // Given
+    gnss_mock_responses.push_back("+QGPSLOC: 061951.0,3150.7223N\r\n");
+    gnss_mock_responses.push_back("OK\r\n");
+    gnss_transmitted.clear();
+
+    // When
+    at_string pload;
+    auto res = gnss_channel.send(gnss_cmd_set::cmd::qgpsloc, "2", max_wait_time_ticks, pload);
+
+    // Then
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("061951.0,3150.7223N", pload.c_str());
+    TEST_ASSERT_EQUAL_STRING("AT+QGPSLOC=2\r\n", gnss_transmitted.c_str());
+    // The default channel is still usable.
+    mock_responses_on_at_commands.push_back("OK\r\n");
+    TEST_ASSERT(at_send(at_cmd::first, at_cmd_type::exec, max_wait_time_ticks) == at_err::ok);
+}
+
+static void GIVEN_latency_stats_enabled_WHEN_command_done_THEN_each_phase_recorded()
+{
+    // Given
+    gnss_channel.reset_latency_stats();
+    gnss_mock_responses.push_back("+QGPS: 1\r\nOK\r\n");
+
+    // When
+    auto res = gnss_channel.send(gnss_cmd_set::cmd::qgps, at_cmd_type::read, max_wait_time_ticks);
+    gnss_dumped_lines_num = 0;
+    gnss_channel.dump_latency_stats([](const char *) { gnss_dumped_lines_num++; });
+
+    // Then
+    TEST_ASSERT(res == at_err::ok);
+    for (auto phase : {at_latency_phase::queue,
+                       at_latency_phase::transmission,
+                       at_latency_phase::response,
+                       at_latency_phase::reception,
+                       at_latency_phase::total})
+        TEST_ASSERT_EQUAL(1, gnss_channel.get_latency_histogram(gnss_cmd_set::cmd::qgps, phase).total_count());
+    TEST_ASSERT_EQUAL(0, gnss_channel.get_latency_histogram(gnss_cmd_set::cmd::qgpsloc, at_latency_phase::total).max);
+    TEST_ASSERT(gnss_channel.get_latency_histogram(gnss_cmd_set::cmd::qgps, at_latency_phase::total).max > 0);
+    TEST_ASSERT_EQUAL(5, gnss_dumped_lines_num);
+}
+
+static void GIVEN_multiline_response_WHEN_at_sent_streamed_THEN_each_line_passed_to_sink()
+{
+    // Given
+    mock_responses_on_at_commands.push_back("+EIGHTH: 1,\"first\"\r\n+EIGHTH: 2,\"second\"\r\nsome data\r\n");
+    mock_responses_on_at_commands.push_back("OK\r\n");
+
+    // When
+    std::vector<std::string> lines;
+    auto res = at_send_streamed(at_cmd::eighth, at_cmd_type::read, max_wait_time_ticks, [&](std::string_view line) {
+        lines.emplace_back(line);
+    });
+
+    // Then
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT_EQUAL(3, lines.size());
+    TEST_ASSERT_EQUAL_STRING("1,\"first\"", lines[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("2,\"second\"", lines[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("some data", lines[2].c_str());
+}
+
+static void GIVEN_streamed_response_WHEN_sink_touches_channel_THEN_lock_not_held()
+{
+    // Given
+    mock_responses_on_at_commands.push_back("+EIGHTH: 1\r\n+CME ERROR: 100\r\n");
+
+    // When
+    unsigned lines_num = 0;
+    bool is_aborted = true;
+    auto res = at_send_streamed(at_cmd::eighth, at_cmd_type::read, max_wait_time_ticks, [&](std::string_view) {
+        // The queue of the commands is free, so another call into the channel doesn't deadlock the receiver task.
+        is_aborted = at_abort_async(at_async_handle{});
+        lines_num++;
+    });
+
+    // Then
+    TEST_ASSERT(res == at_err::cme_error);
+    TEST_ASSERT_EQUAL(2, lines_num);
+    TEST_ASSERT_FALSE(is_aborted);
+}
+
+static void GIVEN_multiline_response_WHEN_at_sent_for_lines_THEN_lines_visited_in_reserved_buffer()
+{
+    // Given
+    mock_responses_on_at_commands.push_back("+EIGHTH: 1,\"first\"\r\n+EIGHTH: 2,\"second\"\r\nsome data\r\n");
+    mock_responses_on_at_commands.push_back("OK\r\n");
+
+    // When
+    at_line_list lines;
+    auto res = at_send(at_cmd::eighth, at_cmd_type::read, max_wait_time_ticks, lines);
+
+    // Then
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT_EQUAL(3, lines.size());
+    TEST_ASSERT_EQUAL_STRING("1,\"first\"", std::string(lines[0]).c_str());
+    TEST_ASSERT_EQUAL_STRING("2,\"second\"", std::string(lines[1]).c_str());
+    TEST_ASSERT_EQUAL_STRING("some data", std::string(lines[2]).c_str());
+    TEST_ASSERT_EQUAL_STRING("1,\"first\"\r\n2,\"second\"\r\nsome data", lines.joined().c_str());
+    // Reserved for AT_COMMANDS_RESPONSE_SIZES before the first line has arrived.
+    TEST_ASSERT(lines.capacity() >= at_cmd_handler::get_response_size(at_cmd::eighth));
+}
+
+static void GIVEN_binary_data_after_header_WHEN_at_sent_binary_read_THEN_data_received_intact()
+{
+    // Given
+    is_rx_chunked = true;
+    mock_responses_on_at_commands.push_back(std::string("+NINTH: 5\r\n\0\r\nOK", 16));
+    mock_responses_on_at_commands.push_back("\r\n\r\nOK\r\n");
+    char data[8];
+    at_binary_rx binary;
+    binary.header = "+NINTH";
+    binary.data = data;
+    binary.capacity = sizeof(data);
+
+    // When
+    at_string pload;
+    auto res = at_send_binary_read(at_cmd::ninth, "0,1500", max_wait_time_ticks, binary, pload);
+    is_rx_chunked = false;
+
+    // Then
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("5", pload.c_str());
+    TEST_ASSERT_EQUAL(5, binary.received_len);
+    TEST_ASSERT(std::memcmp(data, "\0\r\nOK", 5) == 0);
+}
+
+static void GIVEN_batch_of_commands_WHEN_at_sent_batch_THEN_each_entry_gets_its_result_and_payload()
+{
+    // Given
+    mock_responses_on_at_commands.push_back("OK\r\n");
+    mock_responses_on_at_commands.push_back("+SECOND: 2\r\nOK\r\n");
+    mock_responses_on_at_commands.push_back("ERROR\r\n");
+    mock_responses_on_at_commands.push_back("+FOURTH: 4,4\r\nOK\r\n");
+    at_batch_entry batch[] = {{at_cmd::first, at_cmd_type::write, "1"},
+                              {at_cmd::second, at_cmd_type::read},
+                              {at_cmd::third, at_cmd_type::exec},
+                              {at_cmd::fourth, at_cmd_type::read}};
+
+    // When
+    auto res = at_send_batch(batch, 4, at_batch_policy::continue_on_error, max_wait_time_ticks);
+
+    // Then
+    TEST_ASSERT(res == at_err::error);
+    TEST_ASSERT(batch[0].result == at_err::ok);
+    TEST_ASSERT(batch[1].result == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("2", batch[1].response_payload.c_str());
+    TEST_ASSERT(batch[2].result == at_err::error);
+    TEST_ASSERT(batch[3].result == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("4,4", batch[3].response_payload.c_str());
+}
+
+static void GIVEN_batch_with_failing_command_WHEN_sent_with_stop_on_error_THEN_rest_not_sent()
+{
+    // Given
+    mock_responses_on_at_commands.push_back("+CME ERROR: 10\r\n");
+    at_batch_entry batch[] = {{at_cmd::fifth, at_cmd_type::exec}, {at_cmd::sixth, at_cmd_type::exec}};
+
+    // When
+    auto res = at_send_batch(batch, 2, at_batch_policy::stop_on_error, max_wait_time_ticks);
+
+    // Then
+    TEST_ASSERT(res == at_err::cme_error);
+    TEST_ASSERT_EQUAL_STRING("10", batch[0].response_payload.c_str());
+    TEST_ASSERT(batch[1].result == at_err::unknown);
+    TEST_ASSERT(mock_responses_on_at_commands.empty());
+}
+
+static void GIVEN_queued_command_WHEN_urgent_command_sent_THEN_urgent_transmitted_first()
+{
+    // Given
+    gnss_transmitted.clear();
+    os_flag in_flight_done, bulk_done, urgent_done;
+    auto in_flight = gnss_channel.send_async(gnss_cmd_set::cmd::qgps, at_cmd_type::exec, "", in_flight_done);
+    auto bulk = gnss_channel.send_async(gnss_cmd_set::cmd::qgpsloc, at_cmd_type::write, "2", bulk_done);
+
+    // When
+    auto urgent =
+        gnss_channel.send_async(gnss_cmd_set::cmd::at, at_cmd_type::exec, "", urgent_done, at_priority::urgent);
+    gnss_mock_responses.push_back("OK\r\nOK\r\nOK\r\n");
+    std::raise(SIMULATED_GNSS_RX_INTERRUPT_SIGNAL);
+    bulk_done.wait_set();
+
+    // Then
+    at_string pload;
+    TEST_ASSERT(gnss_channel.get_async_result(in_flight, pload) == at_err::ok);
+    TEST_ASSERT(gnss_channel.get_async_result(urgent, pload) == at_err::ok);
+    TEST_ASSERT(gnss_channel.get_async_result(bulk, pload) == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("AT+QGPS\r\nAT\r\nAT+QGPSLOC=2\r\n", gnss_transmitted.c_str());
+}
+
+static void GIVEN_deferred_handler_blocked_WHEN_command_sent_THEN_response_parsed_meanwhile()
+{
+    // Given
+    struct
+    {
+        os_flag entered, released, done;
+        std::string task_name, pload;
+    } handler;
+    gnss_channel.register_unsolicited_handler(
+        gnss_cmd_set::cmd::qgps,
+        [&handler](at_payload_ptr pload) {
+            handler.task_name = pcTaskGetName(nullptr);
+            handler.pload = *pload;
+            handler.entered.set();
+            handler.released.wait_set();
+            handler.done.set();
+            return true;
+        },
+        at_dispatch::deferred);
+    gnss_mock_responses.push_back("+QGPS: 1\r\n");
+    std::raise(SIMULATED_GNSS_RX_INTERRUPT_SIGNAL);
+    handler.entered.wait_set();
+
+    // When
+    gnss_mock_responses.push_back("+QGPSLOC: 1,2\r\nOK\r\n");
+    at_string pload;
+    auto res = gnss_channel.send(gnss_cmd_set::cmd::qgpsloc, "2", max_wait_time_ticks, pload);
+
+    // Then
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("1,2", pload.c_str());
+    TEST_ASSERT_FALSE(handler.done.is_set());
+    handler.released.set();
+    handler.done.wait_set();
+    TEST_ASSERT_EQUAL_STRING("gnss_urc", handler.task_name.c_str());
+    TEST_ASSERT_EQUAL_STRING("1", handler.pload.c_str());
+}
+
+static void GIVEN_task_waits_for_unsolicited_WHEN_awaited_payload_arrives_THEN_task_woken_with_payload()
+{
+    // Given
+    xTaskCreate(
+        [](void *) {
+            vTaskDelay(pdMS_TO_TICKS(50));
+            gnss_mock_responses.push_back("+QGPS: 0\r\nRDY\r\n+QGPS: 1,5\r\n");
+            std::raise(SIMULATED_GNSS_RX_INTERRUPT_SIGNAL);
+            vTaskDelete(NULL);
+        },
+        "gnss_responding",
+        1024,
+        nullptr,
+        1,
+        nullptr);
+
+    // When
+    at_string pload;
+    auto is_received = gnss_channel.wait_for_unsolicited(
+        gnss_cmd_set::cmd::qgps,
+        max_wait_time_ticks,
+        [](const line_view &payload) { return payload.starts_with("1"); },
+        &pload);
+
+    // Then
+    TEST_ASSERT(is_received);
+    TEST_ASSERT_EQUAL_STRING("1,5", pload.c_str());
+    TEST_ASSERT_FALSE(gnss_channel.wait_for_unsolicited(gnss_cmd_set::unsolicited_msg::rdy, pdMS_TO_TICKS(10)));
+}
+
+static void GIVEN_caller_owned_message_WHEN_at_sent_prompted_THEN_message_transmitted_after_prompt()
+{
+    // Given
+    gnss_transmitted.clear();
+    const char message[] = "socket data";
+    gnss_mock_responses.push_back(">\r\nOK\r\n");
+
+    // When
+    auto res = gnss_channel.send_prompted(
+        gnss_cmd_set::cmd::qgps, "1", message, sizeof(message) - 1, at_prompt_end_policy::ctrl_z, max_wait_time_ticks);
+
+    // Then
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("AT+QGPS=1\r\nsocket data\x1A\r\n", gnss_transmitted.c_str());
+}
+
+static void GIVEN_prompt_armed_WHEN_prompt_character_received_THEN_message_transmitted_from_interrupt()
+{
+    // Given
+    gnss_transmitted.clear();
+    gnss_mock_responses.push_back(">");
+    gnss_mock_responses.push_back("OK\r\n");
+
+    // When
+    auto res = gnss_channel.send_prompted(
+        gnss_cmd_set::cmd::qgps, "2", "sms text", at_prompt_end_policy::ctrl_z, max_wait_time_ticks);
+
+    // Then
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("AT+QGPS=2\r\nsms text\x1A\r\n", gnss_transmitted.c_str());
+    // The receiver task hasn't been involved.
+    TEST_ASSERT_FALSE(gnss_tx_starting_task_name == gnss_channel_config::rx_task_name);
+}
+
+static void GIVEN_response_stalled_WHEN_inter_line_limit_passes_THEN_command_withdrawn_and_next_one_handled()
+{
+    // Given
+    gnss_mock_responses.push_back("+QGPSLOC: 1\r\n+QGPSLOC: 2");
+
+    // When
+    auto start = xTaskGetTickCount();
+    at_string pload;
+    auto res = gnss_channel.send(gnss_cmd_set::cmd::qgpsloc, "2", at_profile_timeout, pload);
+    auto elapsed = xTaskGetTickCount() - start;
+
+    // Then
+    TEST_ASSERT(res == at_err::timeout);
+    TEST_ASSERT(elapsed < pdMS_TO_TICKS(500));
+    // The rest of the stalled line doesn't get into the response of the next command.
+    gnss_mock_responses.push_back(",3\r\nOK\r\n");
+    res = gnss_channel.send(gnss_cmd_set::cmd::qgps, at_cmd_type::read, max_wait_time_ticks, pload);
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("", pload.c_str());
+}
+
+static void GIVEN_command_with_schema_WHEN_at_sent_typed_THEN_typed_values_obtained()
+{
+    // Given
+    mock_responses_on_at_commands.push_back("+FIRST: 0,1\r\nOK\r\n");
+
+    // When
+    at_payload_values<at_cmd::first> values;
+    auto res = at_send_typed<at_cmd::first>(at_cmd_type::read, max_wait_time_ticks, values);
+    mock_responses_on_at_commands.push_back("+FIRST: 0\r\nOK\r\n");
+    at_payload_values<at_cmd::first> incomplete;
+    auto incomplete_res = at_send_typed<at_cmd::first>(at_cmd_type::read, max_wait_time_ticks, incomplete);
+
+    // Then
+    TEST_ASSERT(res == at_err::ok);
+    auto [mode, state] = values;
+    TEST_ASSERT_EQUAL(0, mode);
+    TEST_ASSERT_EQUAL(1, state);
+    TEST_ASSERT(incomplete_res == at_err::invalid_payload);
+}
+
+static void GIVEN_command_with_signature_WHEN_sent_write_THEN_arguments_formatted_into_payload()
+{
+    // Given
+    gnss_transmitted.clear();
+    gnss_mock_responses.push_back("+QGPSLOC: 1,2\r\nOK\r\n");
+    at_string pload;
+
+    // When
+    auto res = gnss_channel.send_write<gnss_cmd_set::cmd::qgpsloc>(max_wait_time_ticks, pload, 2);
+    gnss_mock_responses.push_back("OK\r\n");
+    auto no_pload_res = gnss_channel.send_write<gnss_cmd_set::cmd::qgps>(max_wait_time_ticks, -1, "GPS");
+    gnss_mock_responses.push_back("OK\r\n");
+    auto urgent_res =
+        gnss_channel.send_write<gnss_cmd_set::cmd::qgps>(at_priority::urgent, max_wait_time_ticks, 0, "GLONASS");
+
+    // Then
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("1,2", pload.c_str());
+    TEST_ASSERT(no_pload_res == at_err::ok);
+    TEST_ASSERT(urgent_res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("AT+QGPSLOC=2\r\nAT+QGPS=-1,\"GPS\"\r\nAT+QGPS=0,\"GLONASS\"\r\n",
+                             gnss_transmitted.c_str());
+}
+
+static void GIVEN_cached_query_in_flight_WHEN_sent_again_THEN_sent_once_and_answered_from_cache_till_urc()
+{
+    // Given
+    sending_task_params params;
+    params.done = xSemaphoreCreateBinary();
+    // The querying task has higher priority so it sends the query first; the testing task issues it meanwhile.
+    xTaskCreate(querying_task, "at_querier", 1024, &params, 2, NULL);
+    xTaskCreate(query_responding_task, "at_responder", 1024, NULL, 2, NULL);
+
+    // When
+    at_string pload;
+    auto res = at_send(at_cmd::ninth, at_cmd_type::read, max_wait_time_ticks, pload);
+    xSemaphoreTake(params.done, max_wait_time_ticks);
+    vSemaphoreDelete(params.done);
+    at_string cached_pload;
+    auto cached_res = at_send(at_cmd::ninth, at_cmd_type::read, 0, cached_pload);
+
+    mock_responses_on_at_commands.push_back("+NINTH: 1\r\n");
+    std::raise(SIMULATED_RX_INTERRUPT_SIGNAL);
+    vTaskDelay(pdMS_TO_TICKS(10));
+    mock_responses_on_at_commands.push_back("+NINTH: 2\r\nOK\r\n");
+    at_string refreshed_pload;
+    auto refreshed_res = at_send(at_cmd::ninth, at_cmd_type::read, max_wait_time_ticks, refreshed_pload);
+
+    // Then
+    TEST_ASSERT(params.result == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("9", params.pload.c_str());
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("9", pload.c_str());
+    TEST_ASSERT(cached_res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("9", cached_pload.c_str());
+    TEST_ASSERT(refreshed_res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("2", refreshed_pload.c_str());
+}
+
+static void GIVEN_query_in_flight_on_single_flight_channel_WHEN_sent_again_THEN_transmitted_once()
+{
+    // Given
+    gnss_transmitted.clear();
+    sending_task_params params;
+    params.done = xSemaphoreCreateBinary();
+    xTaskCreate(gnss_querying_task, "gnss_querier", 1024, &params, 2, NULL);
+    xTaskCreate(gnss_query_responding_task, "gnss_responder", 1024, NULL, 2, NULL);
+
+    // When
+    at_string pload;
+    auto res = gnss_channel.send(gnss_cmd_set::cmd::qgps, at_cmd_type::read, max_wait_time_ticks, pload);
+    xSemaphoreTake(params.done, max_wait_time_ticks);
+    vSemaphoreDelete(params.done);
+
+    // Then
+    TEST_ASSERT(params.result == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("1", params.pload.c_str());
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("1", pload.c_str());
+    TEST_ASSERT_EQUAL_STRING("AT+QGPS?\r\n", gnss_transmitted.c_str());
+}
+
+static void GIVEN_channels_running_WHEN_stack_high_water_marks_read_THEN_within_their_stacks()
+{
+    // Given
+    // Both channels have handled commands already, so their receiver tasks have run.
+
+    // When
+    auto marks = at_get_stack_high_water_marks();
+    auto gnss_marks = gnss_channel.get_stack_high_water_marks();
+
+    // Then
+    TEST_ASSERT(marks.rx_task > 0);
+    TEST_ASSERT(marks.rx_task <= AT_CMD_HANDLER_RX_TASK_STACK_DEPTH);
+    TEST_ASSERT(gnss_marks.rx_task > 0);
+    TEST_ASSERT(gnss_marks.rx_task <= gnss_channel_config::rx_task_stack_depth);
+    TEST_ASSERT(gnss_marks.urc_task > 0);
+    TEST_ASSERT(gnss_marks.urc_task <= gnss_channel_config::urc_task_stack_depth);
+}
 
-#define SIMULATED_RX_INTERRUPT_SIGNAL SIGRTMIN + 3
-#define SIMULATED_TX_INTERRUPT_SIGNAL SIGRTMIN + 4
+static void GIVEN_echo_suppressed_channel_WHEN_command_and_message_echoed_THEN_echoes_not_handled()
+{
+    // Given
+    // The echo of the message would be taken for the unsolicited command, if it wasn't discarded.
+    unsigned urc_num = 0;
+    auto token = gnss_channel.register_unsolicited_handler(gnss_cmd_set::cmd::qgpsloc, [&urc_num](at_payload_ptr) {
+        urc_num++;
+        return false;
+    });
+    gnss_transmitted.clear();
+    gnss_mock_responses.push_back("AT+QGPS=3\r\r\n>");
+    gnss_mock_responses.push_back("+QGPSLOC: 1\x1A\r\nOK\r\n");
 
-extern "C" void hw_at_enable_tx_it();
-extern "C" void hw_at_disable_tx_it();
-extern "C" void hw_at_enable_rx_it();
-extern "C" void hw_at_disable_rx_it();
-extern "C" void hw_at_send_byte(char c);
-extern "C" void it_handle_at_byte_rx(char c);
-extern "C" void it_handle_at_byte_tx();
-extern "C" void init_at();
-extern "C" void deinit_at();
+    // When
+    auto res = gnss_channel.send_prompted(
+        gnss_cmd_set::cmd::qgps, "3", "+QGPSLOC: 1", at_prompt_end_policy::ctrl_z, max_wait_time_ticks);
+    gnss_channel.unregister_unsolicited_handler(token);
 
-// --------------------------------------------------------------------------------------------------------------------
-// DEFINITION OF THE TEST CASES
-// --------------------------------------------------------------------------------------------------------------------
-static void GIVEN_prepared_response_WHEN_at_sent_THEN_response_populated_to_caller_task()
+    // Then
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT_EQUAL(0, urc_num);
+    TEST_ASSERT_EQUAL_STRING("AT+QGPS=3\r\n+QGPSLOC: 1\x1A\r\n", gnss_transmitted.c_str());
+}
+
+static void GIVEN_captured_session_WHEN_replayed_THEN_same_traffic_handled_again()
 {
     // Given
-    mock_responses_on_at_commands.push_back("+FIRST: 0,1\r\n");
-    mock_responses_on_at_commands.push_back("OK\r\n");
+    std::vector<std::string> urc_payloads;
+    auto token = gnss_channel.register_unsolicited_handler(gnss_cmd_set::cmd::qgps, [&urc_payloads](at_payload_ptr p) {
+        urc_payloads.emplace_back(p->c_str());
+        return false;
+    });
+    gnss_channel.clear_capture();
+    gnss_mock_responses.push_back("+QGPS: 1\r\n");
+    std::raise(SIMULATED_GNSS_RX_INTERRUPT_SIGNAL);
+    gnss_mock_responses.push_back("+QGPSLOC: 1,2\r\nOK\r\n");
+    at_string pload;
+    auto res = gnss_channel.send(gnss_cmd_set::cmd::qgpsloc, "2", max_wait_time_ticks, pload);
+    gnss_mock_responses.push_back("+QGPS: 0\r\n");
+    std::raise(SIMULATED_GNSS_RX_INTERRUPT_SIGNAL);
+    vTaskDelay(pdMS_TO_TICKS(10));
+    static std::string capture;
+    capture.clear();
+    gnss_channel.export_capture([](const char *data, size_t len) { capture.append(data, len); });
+    auto captured_urcs_num = urc_payloads.size();
 
     // When
-    std::string pload;
-    auto res = at_send(at_cmd::first, at_cmd_type::read, max_wait_time_ticks, pload);
+    // The response arrives when no command is in flight, so only the unsolicited commands are handled again.
+    std::string replayed_tx;
+    auto report = at_replay(
+        capture,
+        1,
+        4,
+        [](std::string_view bytes) {
+            gnss_mock_responses.emplace_back(bytes);
+            std::raise(SIMULATED_GNSS_RX_INTERRUPT_SIGNAL);
+        },
+        [&replayed_tx](std::string_view bytes) { replayed_tx.append(bytes); });
+    vTaskDelay(pdMS_TO_TICKS(10));
+    gnss_channel.unregister_unsolicited_handler(token);
 
     // Then
     TEST_ASSERT(res == at_err::ok);
-    TEST_ASSERT_EQUAL_STRING("0,1", pload.c_str());
+    TEST_ASSERT_EQUAL_STRING("1,2", pload.c_str());
+    TEST_ASSERT_EQUAL(2, captured_urcs_num);
+    TEST_ASSERT_EQUAL(4, urc_payloads.size());
+    TEST_ASSERT_EQUAL_STRING("1", urc_payloads[2].c_str());
+    TEST_ASSERT_EQUAL_STRING("0", urc_payloads[3].c_str());
+    TEST_ASSERT_EQUAL_STRING("AT+QGPSLOC=2\r\n", replayed_tx.c_str());
+    TEST_ASSERT_EQUAL(4, report.records_num);
+    TEST_ASSERT_EQUAL(std::strlen("+QGPS: 1\r\n+QGPSLOC: 1,2\r\nOK\r\n+QGPS: 0\r\n"), report.rx_bytes_num);
+    TEST_ASSERT_EQUAL(replayed_tx.length(), report.tx_bytes_num);
+    TEST_ASSERT(report.get_rx_bytes_per_second() > 0);
 }
 
-static void GIVEN_sent_command_WHEN_response_not_received_THEN_timeout_error_received()
+static void GIVEN_counted_channel_WHEN_traffic_and_commands_handled_THEN_counters_reflect_them()
 {
-    auto res = at_send(at_cmd::first, at_cmd_type::exec, 0);
+    // Given
+    using cmd = gnss_cmd_set::cmd;
+    auto before = gnss_channel.get_stats();
+
+    // When
+    gnss_mock_responses.push_back("RDY\r\n+QGPS: 0\r\n");
+    std::raise(SIMULATED_GNSS_RX_INTERRUPT_SIGNAL);
+    vTaskDelay(pdMS_TO_TICKS(10));
+    gnss_mock_responses.push_back("+QGPSLOC: 1,2\r\nOK\r\n");
+    at_string pload;
+    auto ok_res = gnss_channel.send(cmd::qgpsloc, "2", max_wait_time_ticks, pload);
+    auto timeout_res = gnss_channel.send(cmd::qgps, at_cmd_type::exec, pdMS_TO_TICKS(20));
+    auto after = gnss_channel.get_stats();
+    static unsigned dumped_lines_num;
+    static std::string first_dumped_line;
+    dumped_lines_num = 0;
+    gnss_channel.dump_stats([](const char *line) {
+        if (dumped_lines_num++ == 0)
+            first_dumped_line = line;
+    });
+
+    // Then
+    TEST_ASSERT(ok_res == at_err::ok);
+    TEST_ASSERT(timeout_res == at_err::timeout);
+    TEST_ASSERT_EQUAL(std::strlen("RDY\r\n+QGPS: 0\r\n+QGPSLOC: 1,2\r\nOK\r\n"), after.rx_bytes - before.rx_bytes);
+    TEST_ASSERT_EQUAL(std::strlen("AT+QGPSLOC=2\r\nAT+QGPS\r\n"), after.tx_bytes - before.tx_bytes);
+    TEST_ASSERT_EQUAL(4, after.lines_parsed - before.lines_parsed);
+    TEST_ASSERT_EQUAL(after.lines_dropped, before.lines_dropped);
+    auto rdy = to_u_type(gnss_cmd_set::unsolicited_msg::rdy);
+    TEST_ASSERT_EQUAL(1, after.urcs_per_msg[rdy] - before.urcs_per_msg[rdy]);
+    TEST_ASSERT_EQUAL(1, after.urcs_per_cmd[to_u_type(cmd::qgps)] - before.urcs_per_cmd[to_u_type(cmd::qgps)]);
+    TEST_ASSERT_EQUAL(
+        1, after.commands_issued[to_u_type(cmd::qgpsloc)] - before.commands_issued[to_u_type(cmd::qgpsloc)]);
+    TEST_ASSERT_EQUAL(1, after.commands_issued[to_u_type(cmd::qgps)] - before.commands_issued[to_u_type(cmd::qgps)]);
+    TEST_ASSERT_EQUAL(1, after.get_num_results(at_err::ok) - before.get_num_results(at_err::ok));
+    TEST_ASSERT_EQUAL(1, after.get_num_results(at_err::timeout) - before.get_num_results(at_err::timeout));
+    TEST_ASSERT(after.peak_rx_chars >= std::strlen("+QGPSLOC: 1,2"));
+    TEST_ASSERT(dumped_lines_num >= 4);
+    TEST_ASSERT_EQUAL_STRING("rx=", first_dumped_line.substr(0, 3).c_str());
+}
+
+static void GIVEN_receiver_task_falls_behind_WHEN_lines_pile_up_THEN_device_stopped_with_rts_and_no_line_lost()
+{
+    // Given
+    // The handler holds the receiver task, so the lines which follow the first one wait in the RX buffer.
+    static os_flag entered, released;
+    static std::vector<std::string> payloads;
+    entered.reset();
+    released.reset();
+    payloads.clear();
+    auto token = gnss_channel.register_unsolicited_handler(gnss_cmd_set::cmd::qgps, [](at_payload_ptr p) {
+        if (payloads.empty())
+        {
+            entered.set();
+            released.wait_set();
+        }
+        payloads.emplace_back(p->c_str());
+        return false;
+    });
+    auto releases_before = gnss_rts_releases_num;
+    auto throttles_before = gnss_channel.get_stats().rx_throttles;
+    TEST_ASSERT(is_gnss_rts_asserted);
+    gnss_mock_responses.push_back("+QGPS: 0\r\n");
+    std::raise(SIMULATED_GNSS_RX_INTERRUPT_SIGNAL);
+    entered.wait_set();
+
+    // When
+    // Each line takes 16 characters, so the sixth one crosses the high watermark.
+    for (unsigned i = 1; i <= 6; ++i)
+    {
+        gnss_mock_responses.push_back("+QGPS: 1,\"abc" + std::to_string(i) + "\"\r\n");
+        std::raise(SIMULATED_GNSS_RX_INTERRUPT_SIGNAL);
+    }
+    auto is_rts_asserted_when_full = is_gnss_rts_asserted;
+    released.set();
+    vTaskDelay(pdMS_TO_TICKS(20));
+    gnss_channel.unregister_unsolicited_handler(token);
+
+    // Then
+    TEST_ASSERT_FALSE(is_rts_asserted_when_full);
+    TEST_ASSERT(is_gnss_rts_asserted);
+    TEST_ASSERT_EQUAL(1, gnss_rts_releases_num - releases_before);
+    TEST_ASSERT_EQUAL(1, gnss_channel.get_stats().rx_throttles - throttles_before);
+    TEST_ASSERT_EQUAL(7, payloads.size());
+    TEST_ASSERT_EQUAL_STRING("1,\"abc6\"", payloads.back().c_str());
+}
+
+static void GIVEN_sleeping_device_WHEN_commands_issued_within_window_THEN_transmitted_within_one_wake_cycle()
+{
+    // Given
+    psm_transmitted.clear();
+    psm_mock_responses.push_back("OK\r\n");
+    psm_mock_responses.push_back("+QGPSLOC: 1\r\nOK\r\n");
+    auto wakes_before = psm_wakes_num;
+    auto cycles_before = psm_channel.get_stats().wake_cycles;
+    TEST_ASSERT_FALSE(is_psm_awake);
+
+    // When
+    auto start = xTaskGetTickCount();
+    os_flag first_done, second_done;
+    auto first = psm_channel.send_async(gnss_cmd_set::cmd::qgps, at_cmd_type::exec, "", first_done);
+    auto is_held = psm_transmitted.empty();
+    auto second = psm_channel.send_async(gnss_cmd_set::cmd::qgpsloc, at_cmd_type::write, "2", second_done);
+    second_done.wait_set();
+    auto elapsed = xTaskGetTickCount() - start;
+
+    // Then
+    at_string pload;
+    TEST_ASSERT(is_held);
+    TEST_ASSERT(psm_channel.get_async_result(first, pload) == at_err::ok);
+    TEST_ASSERT(psm_channel.get_async_result(second, pload) == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("1", pload.c_str());
+    TEST_ASSERT(elapsed >= psm_channel_config::tx_gather_ticks);
+    TEST_ASSERT_EQUAL_STRING("AT+QGPS\r\nAT+QGPSLOC=2\r\n", psm_transmitted.c_str());
+    TEST_ASSERT(is_psm_awake_on_each_tx);
+    TEST_ASSERT_FALSE(is_psm_awake);
+    TEST_ASSERT_EQUAL(1, psm_wakes_num - wakes_before);
+    TEST_ASSERT_EQUAL(1, psm_channel.get_stats().wake_cycles - cycles_before);
+}
+
+static void GIVEN_commands_held_WHEN_urgent_command_issued_THEN_all_transmitted_right_away()
+{
+    // Given
+    psm_transmitted.clear();
+    psm_mock_responses.push_back("OK\r\n");
+    psm_mock_responses.push_back("OK\r\n");
+    auto wakes_before = psm_wakes_num;
+    auto start = xTaskGetTickCount();
+    os_flag held_done;
+    auto held = psm_channel.send_async(gnss_cmd_set::cmd::qgps, at_cmd_type::exec, "", held_done);
+
+    // When
+    auto res = psm_channel.send(gnss_cmd_set::cmd::at, at_cmd_type::exec, max_wait_time_ticks, at_priority::urgent);
+    auto elapsed = xTaskGetTickCount() - start;
+    held_done.wait_set();
+
+    // Then
+    at_string pload;
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT(psm_channel.get_async_result(held, pload) == at_err::ok);
+    TEST_ASSERT(elapsed < psm_channel_config::tx_gather_ticks);
+    // The held command is at the front of the queue, which is never overtaken.
+    TEST_ASSERT_EQUAL_STRING("AT+QGPS\r\nAT\r\n", psm_transmitted.c_str());
+    TEST_ASSERT_FALSE(is_psm_awake);
+    TEST_ASSERT_EQUAL(1, psm_wakes_num - wakes_before);
+}
+
+static void GIVEN_window_of_two_packets_WHEN_three_sent_THEN_pipelined_without_waiting_for_each_ack()
+{
+    // Given
+    psm_transmitted.clear();
+    for (auto ack : {"SEND OK\r\n", "0, SEND OK\r\n", "SEND OK\r\n"})
+    {
+        psm_mock_responses.push_back(">\r\n");
+        psm_mock_responses.push_back(ack);
+    }
+    at_data_stream stream;
+    stream.max_packets_in_flight = 2;
+    const char packets[][4] = {"abc", "def", "ghi"};
+
+    // When
+    std::array<at_err, 3> results;
+    bool is_sent_before_ack = false;
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        results[i] = psm_channel.send_data(stream, gnss_cmd_set::cmd::qgps, "0,3", packets[i], 3, max_wait_time_ticks);
+        // The commands are held while the device sleeps, so nothing has been acknowledged yet.
+        if (i == 1)
+            is_sent_before_ack = psm_transmitted.empty();
+    }
+    auto res = psm_channel.flush_data(stream, max_wait_time_ticks);
+
+    // Then
+    for (auto r : results)
+        TEST_ASSERT(r == at_err::ok);
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT(is_sent_before_ack);
+    // The data isn't terminated, as its length has been given.
+    TEST_ASSERT_EQUAL_STRING("AT+QGPS=0,3\r\nabcAT+QGPS=0,3\r\ndefAT+QGPS=0,3\r\nghi", psm_transmitted.c_str());
+    TEST_ASSERT_EQUAL(0, stream.bytes_in_flight);
+}
+
+static void GIVEN_packet_rejected_WHEN_next_packet_sent_THEN_failure_reported_and_nothing_sent()
+{
+    // Given
+    psm_transmitted.clear();
+    psm_mock_responses.push_back(">\r\n");
+    psm_mock_responses.push_back("SEND FAIL\r\n");
+    at_data_stream stream;
+    auto first = psm_channel.send_data(stream, gnss_cmd_set::cmd::qgps, "0,3", "abc", 3, max_wait_time_ticks);
+
+    // When
+    auto second = psm_channel.send_data(stream, gnss_cmd_set::cmd::qgps, "0,3", "def", 3, max_wait_time_ticks);
+
+    // Then
+    TEST_ASSERT(first == at_err::ok);
+    TEST_ASSERT(second == at_err::error);
+    TEST_ASSERT_EQUAL_STRING("AT+QGPS=0,3\r\nabc", psm_transmitted.c_str());
+    // The failure is reported only once.
+    TEST_ASSERT(psm_channel.flush_data(stream, max_wait_time_ticks) == at_err::ok);
+}
+
+static void GIVEN_packet_not_acknowledged_WHEN_flush_times_out_THEN_packet_withdrawn_and_channel_usable()
+{
+    // Given
+    psm_mock_responses.push_back(">\r\n");
+    at_data_stream stream;
+    auto sent = psm_channel.send_data(stream, gnss_cmd_set::cmd::qgps, "0,3", "abc", 3, max_wait_time_ticks);
+
+    // When
+    auto res = psm_channel.flush_data(stream, pdMS_TO_TICKS(100));
+
+    // Then
+    TEST_ASSERT(sent == at_err::ok);
     TEST_ASSERT(res == at_err::timeout);
+    TEST_ASSERT_EQUAL(stream.sent_num, stream.collected_num);
+    psm_mock_responses.push_back("OK\r\n");
+    TEST_ASSERT(psm_channel.send(gnss_cmd_set::cmd::at, at_cmd_type::exec, max_wait_time_ticks) == at_err::ok);
 }
 
-static void GIVEN_first_command_fails_WHEN_second_successful_THEN_received_proper_response()
+static void GIVEN_channels_on_one_dispatcher_WHEN_commands_sent_on_both_THEN_each_gets_own_response()
 {
     // Given
-    at_send(at_cmd::second, at_cmd_type::exec, 0);
+    auto &[first_channel, second_channel] = shared_channels;
+    shared_transmitted = {};
+    shared_mock_responses[0].push_back("+QGPSLOC: 0\r\nOK\r\n");
+    shared_mock_responses[1].push_back("+QGPSLOC: 1\r\nOK\r\n");
+
+    // When
+    os_flag first_done, second_done;
+    auto first = first_channel.send_async(gnss_cmd_set::cmd::qgpsloc, at_cmd_type::write, "1", first_done);
+    auto second = second_channel.send_async(gnss_cmd_set::cmd::qgpsloc, at_cmd_type::write, "2", second_done);
+    first_done.wait_set();
+    second_done.wait_set();
+
+    // Then
+    at_string first_pload, second_pload;
+    TEST_ASSERT(first_channel.get_async_result(first, first_pload) == at_err::ok);
+    TEST_ASSERT(second_channel.get_async_result(second, second_pload) == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("0", first_pload.c_str());
+    TEST_ASSERT_EQUAL_STRING("1", second_pload.c_str());
+    TEST_ASSERT_EQUAL_STRING("AT+QGPSLOC=1\r\n", shared_transmitted[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("AT+QGPSLOC=2\r\n", shared_transmitted[1].c_str());
+}
+
+static void GIVEN_chatty_channel_on_dispatcher_WHEN_other_channel_receives_line_THEN_handled_after_one_turn()
+{
+    // Given
+    auto &[chatty_channel, other_channel] = shared_channels;
+    constexpr unsigned chatty_lines_num = 9;
+    struct
+    {
+        os_flag entered, released, done;
+        std::vector<std::string> order;
+        std::string task_name;
+    } handlers;
+    auto chatty_token = chatty_channel.register_unsolicited_handler(gnss_cmd_set::cmd::qgps, [&](at_payload_ptr p) {
+        handlers.order.push_back("chatty " + std::string(p->c_str()));
+        if (handlers.order.size() == 1)
+        {
+            handlers.entered.set();
+            handlers.released.wait_set();
+        }
+        if (handlers.order.size() == chatty_lines_num + 1)
+            handlers.done.set();
+        return false;
+    });
+    auto other_token = other_channel.register_unsolicited_handler(gnss_cmd_set::cmd::qgps, [&](at_payload_ptr p) {
+        handlers.order.push_back("other " + std::string(p->c_str()));
+        handlers.task_name = pcTaskGetName(nullptr);
+        if (handlers.order.size() == chatty_lines_num + 1)
+            handlers.done.set();
+        return false;
+    });
+    // The receiver task is held by the first line, while the rest of the lines pile up.
+    shared_mock_responses[0].push_back("+QGPS: 0\r\n");
+    std::raise(SIMULATED_SHARED_RX_INTERRUPT_SIGNAL);
+    handlers.entered.wait_set();
+    for (unsigned i = 1; i < chatty_lines_num; ++i)
+        shared_mock_responses[0].push_back("+QGPS: " + std::to_string(i) + "\r\n");
+    shared_mock_responses[1].push_back("+QGPS: 9\r\n");
+    std::raise(SIMULATED_SHARED_RX_INTERRUPT_SIGNAL);
+
+    // When
+    handlers.released.set();
+    handlers.done.wait_set();
+    chatty_channel.unregister_unsolicited_handler(chatty_token);
+    other_channel.unregister_unsolicited_handler(other_token);
+
+    // Then
+    TEST_ASSERT_EQUAL(chatty_lines_num + 1, handlers.order.size());
+    // The turn of the chatty channel ends after shared_max_lines_per_turn lines.
+    TEST_ASSERT_EQUAL_STRING("other 9", handlers.order[shared_max_lines_per_turn].c_str());
+    TEST_ASSERT_EQUAL_STRING("chatty 8", handlers.order.back().c_str());
+    TEST_ASSERT_EQUAL_STRING("at_rx_shared", handlers.task_name.c_str());
+}
+
+static void GIVEN_channels_on_one_dispatcher_WHEN_handler_registers_handlers_on_both_THEN_each_registered_and_invoked()
+{
+    // Given
+    auto &[first_channel, second_channel] = shared_channels;
+    struct
+    {
+        os_flag done;
+        std::vector<std::string> order;
+        at_handler_token first_token, second_token;
+    } handlers;
+    auto token = first_channel.register_unsolicited_handler(gnss_cmd_set::cmd::qgps, [&handlers](at_payload_ptr p) {
+        handlers.order.push_back("first " + std::string(p->c_str()));
+        // The dispatcher holds the mutex of the first channel only, so the second one is taken meanwhile.
+        handlers.second_token = std::get<1>(shared_channels).register_unsolicited_handler(
+            gnss_cmd_set::cmd::qgps, [&handlers](at_payload_ptr p) {
+                handlers.order.push_back("second " + std::string(p->c_str()));
+                if (handlers.order.size() == 3)
+                    handlers.done.set();
+                return false;
+            });
+        handlers.first_token = std::get<0>(shared_channels).register_unsolicited_handler(
+            gnss_cmd_set::cmd::qgpsloc, [&handlers](at_payload_ptr p) {
+                handlers.order.push_back("first " + std::string(p->c_str()));
+                if (handlers.order.size() == 3)
+                    handlers.done.set();
+                return false;
+            });
+        return false;
+    });
+
+    // When
+    shared_mock_responses[0].push_back("+QGPS: 0\r\n");
+    std::raise(SIMULATED_SHARED_RX_INTERRUPT_SIGNAL);
+    vTaskDelay(pdMS_TO_TICKS(50));
+    shared_mock_responses[1].push_back("+QGPS: 1\r\n");
+    shared_mock_responses[0].push_back("+QGPSLOC: 2\r\n");
+    std::raise(SIMULATED_SHARED_RX_INTERRUPT_SIGNAL);
+    handlers.done.wait_set();
+    first_channel.unregister_unsolicited_handler(token);
+    first_channel.unregister_unsolicited_handler(handlers.first_token);
+    second_channel.unregister_unsolicited_handler(handlers.second_token);
+
+    // Then
+    auto &order = handlers.order;
+    TEST_ASSERT_EQUAL(3, order.size());
+    TEST_ASSERT_EQUAL_STRING("first 0", order[0].c_str());
+    TEST_ASSERT(std::find(order.begin(), order.end(), "second 1") != order.end());
+    TEST_ASSERT(std::find(order.begin(), order.end(), "first 2") != order.end());
+}
+
+static void GIVEN_rx_stream_channel_WHEN_response_received_byte_by_byte_THEN_lines_split_by_receiver_task()
+{
+    // Given
+    stream_transmitted.clear();
+    // The echo and the line shorter than the trigger level are split by the receiver task.
+    stream_mock_responses.push_back({"AT+QGPSLOC=1\r\n+QGPSLOC: 1,\"2020-01-01\",52.2297\r\n\r\nOK\r\n", false});
+    stream_mock_responses.push_back({"\r\nOK\r\n", false});
+    auto drops_before = stream_channel.get_rx_drop_stats();
+
+    // When
+    at_string pload;
+    auto res = stream_channel.send(gnss_cmd_set::cmd::qgpsloc, "1", max_wait_time_ticks, pload);
+    auto second_res = stream_channel.send(gnss_cmd_set::cmd::at, at_cmd_type::exec, max_wait_time_ticks);
+
+    // Then
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("1,\"2020-01-01\",52.2297", pload.c_str());
+    TEST_ASSERT(second_res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("AT+QGPSLOC=1\r\nAT\r\n", stream_transmitted.c_str());
+    TEST_ASSERT_EQUAL(drops_before.on_rx_stream_overflow, stream_channel.get_rx_drop_stats().on_rx_stream_overflow);
+}
+
+static void GIVEN_rx_stream_channel_WHEN_more_received_than_stream_holds_THEN_excess_dropped_and_counted()
+{
+    // Given
+    // The chunk fills the stream exactly at the end of the long line, so the unsolicited message behind is dropped.
+    std::string long_line(stream_channel_config::rx_stream_len - std::strlen("OK\r\n\r\n"), 'x');
+    stream_mock_responses.push_back({"OK\r\n" + long_line + "\r\nRDY\r\n", true});
+    auto drops_before = stream_channel.get_rx_drop_stats().on_rx_stream_overflow;
+    unsigned rdy_num = 0;
+    auto token = stream_channel.register_unsolicited_handler(gnss_cmd_set::unsolicited_msg::rdy, [&rdy_num]() {
+        rdy_num++;
+        return false;
+    });
 
     // When
+    auto res = stream_channel.send(gnss_cmd_set::cmd::at, at_cmd_type::exec, max_wait_time_ticks);
+    // A line which has arrived whole afterwards is handled.
+    stream_mock_responses.push_back({"OK\r\n", true});
+    auto second_res = stream_channel.send(gnss_cmd_set::cmd::at, at_cmd_type::exec, max_wait_time_ticks);
+    stream_channel.unregister_unsolicited_handler(token);
+
+    // Then
+    TEST_ASSERT(res == at_err::ok);
+    TEST_ASSERT(second_res == at_err::ok);
+    TEST_ASSERT_EQUAL(std::strlen("RDY\r\n"), stream_channel.get_rx_drop_stats().on_rx_stream_overflow - drops_before);
+    TEST_ASSERT_EQUAL(0, rdy_num);
+}
+
+static void GIVEN_warmed_up_channel_WHEN_commands_sent_and_responses_received_THEN_heap_allocations_within_budget()
+{
+    // Given
+    constexpr size_t exchanges_num = 8;
+    at_string pload;
+    // The first exchange is made before the measurement, as anything done once on the first use isn't counted.
+    mock_responses_on_at_commands.push_back("+FIRST: 0,1\r\n");
     mock_responses_on_at_commands.push_back("OK\r\n");
-    auto result = at_send(at_cmd::third, "THIS IS SOME DUMMY PLOAD", max_wait_time_ticks);
+    TEST_ASSERT(at_send(at_cmd::first, at_cmd_type::read, max_wait_time_ticks, pload) == at_err::ok);
+
+    // When
+    alloc_tracking_scope scope;
+    bool is_each_ok = true;
+    for (size_t i = 0; i < exchanges_num; ++i)
+    {
+        // The mocked responses and the payload of the command are made by the test, not by the AT stack.
+        scope.pause();
+        mock_responses_on_at_commands.push_back("+FIRST: 0,1\r\n");
+        mock_responses_on_at_commands.push_back("OK\r\n");
+        pload.clear();
+        scope.resume();
+        is_each_ok = at_send(at_cmd::first, at_cmd_type::read, max_wait_time_ticks, pload) == at_err::ok && is_each_ok;
+
+        scope.pause();
+        mock_responses_on_at_commands.push_back("OK\r\n");
+        at_string write_pload("1,2");
+        scope.resume();
+        is_each_ok = at_send(at_cmd::third, std::move(write_pload), max_wait_time_ticks) == at_err::ok && is_each_ok;
+    }
+    scope.pause();
 
     // Then
-    TEST_ASSERT(result == at_err::ok);
+    TEST_ASSERT(is_each_ok);
+    TEST_ASSERT_EQUAL_STRING("0,1", pload.c_str());
+    // The budget of a command covers the lines of its response.
+    TEST_ASSERT_ALLOC_BUDGET(scope, ALLOC_BUDGET_PER_SEND, exchanges_num * 2);
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -92,17 +1482,75 @@ void test_at()
     // Register the signal handlers used to simulate the interrupts.
     std::signal(SIMULATED_RX_INTERRUPT_SIGNAL, simulated_rx_interrupt);
     std::signal(SIMULATED_TX_INTERRUPT_SIGNAL, simulated_tx_interrupt);
+    std::signal(SIMULATED_GNSS_RX_INTERRUPT_SIGNAL, simulated_gnss_rx_interrupt);
+    std::signal(SIMULATED_PSM_RX_INTERRUPT_SIGNAL, simulated_psm_rx_interrupt);
+    std::signal(SIMULATED_SHARED_RX_INTERRUPT_SIGNAL, simulated_shared_rx_interrupt);
+    std::signal(SIMULATED_STREAM_RX_INTERRUPT_SIGNAL, simulated_stream_rx_interrupt);
 
     init_at();
+    gnss_channel.init();
+    psm_channel.init();
+    shared_rx_dispatcher.start("at_rx_shared", 1);
+    std::apply([](auto &... channels) { (channels.init(shared_rx_dispatcher), ...); }, shared_channels);
+    stream_channel.init();
 
     RUN_TEST(GIVEN_prepared_response_WHEN_at_sent_THEN_response_populated_to_caller_task);
     RUN_TEST(GIVEN_sent_command_WHEN_response_not_received_THEN_timeout_error_received);
     RUN_TEST(GIVEN_first_command_fails_WHEN_second_successful_THEN_received_proper_response);
+    RUN_TEST(GIVEN_response_received_in_chunks_WHEN_at_sent_THEN_response_populated_to_caller_task);
+    RUN_TEST(GIVEN_stalled_transmission_WHEN_commands_pile_up_in_tx_buffer_THEN_one_which_does_not_fit_fails);
+    RUN_TEST(GIVEN_command_in_flight_WHEN_another_task_sends_command_THEN_each_task_gets_its_own_response);
+    RUN_TEST(GIVEN_prepared_response_WHEN_at_sent_async_THEN_completion_invoked_with_response);
+    RUN_TEST(GIVEN_prepared_response_WHEN_at_sent_async_with_flag_THEN_flag_set_and_result_obtained);
+    RUN_TEST(GIVEN_async_command_not_responded_WHEN_aborted_THEN_next_command_handled);
+    RUN_TEST(GIVEN_second_channel_with_own_cmd_set_WHEN_command_sent_THEN_response_obtained_on_that_channel);
+    RUN_TEST(GIVEN_latency_stats_enabled_WHEN_command_done_THEN_each_phase_recorded);
+    RUN_TEST(GIVEN_multiline_response_WHEN_at_sent_streamed_THEN_each_line_passed_to_sink);
+    RUN_TEST(GIVEN_streamed_response_WHEN_sink_touches_channel_THEN_lock_not_held);
+    RUN_TEST(GIVEN_multiline_response_WHEN_at_sent_for_lines_THEN_lines_visited_in_reserved_buffer);
+    RUN_TEST(GIVEN_binary_data_after_header_WHEN_at_sent_binary_read_THEN_data_received_intact);
+    RUN_TEST(GIVEN_batch_of_commands_WHEN_at_sent_batch_THEN_each_entry_gets_its_result_and_payload);
+    RUN_TEST(GIVEN_batch_with_failing_command_WHEN_sent_with_stop_on_error_THEN_rest_not_sent);
+    RUN_TEST(GIVEN_queued_command_WHEN_urgent_command_sent_THEN_urgent_transmitted_first);
+    RUN_TEST(GIVEN_deferred_handler_blocked_WHEN_command_sent_THEN_response_parsed_meanwhile);
+    RUN_TEST(GIVEN_task_waits_for_unsolicited_WHEN_awaited_payload_arrives_THEN_task_woken_with_payload);
+    RUN_TEST(GIVEN_caller_owned_message_WHEN_at_sent_prompted_THEN_message_transmitted_after_prompt);
+    RUN_TEST(GIVEN_prompt_armed_WHEN_prompt_character_received_THEN_message_transmitted_from_interrupt);
+    RUN_TEST(GIVEN_response_stalled_WHEN_inter_line_limit_passes_THEN_command_withdrawn_and_next_one_handled);
+    RUN_TEST(GIVEN_command_with_schema_WHEN_at_sent_typed_THEN_typed_values_obtained);
+    RUN_TEST(GIVEN_command_with_signature_WHEN_sent_write_THEN_arguments_formatted_into_payload);
+    RUN_TEST(GIVEN_cached_query_in_flight_WHEN_sent_again_THEN_sent_once_and_answered_from_cache_till_urc);
+    RUN_TEST(GIVEN_query_in_flight_on_single_flight_channel_WHEN_sent_again_THEN_transmitted_once);
+    RUN_TEST(GIVEN_channels_running_WHEN_stack_high_water_marks_read_THEN_within_their_stacks);
+    RUN_TEST(GIVEN_echo_suppressed_channel_WHEN_command_and_message_echoed_THEN_echoes_not_handled);
+    RUN_TEST(GIVEN_captured_session_WHEN_replayed_THEN_same_traffic_handled_again);
+    RUN_TEST(GIVEN_counted_channel_WHEN_traffic_and_commands_handled_THEN_counters_reflect_them);
+    RUN_TEST(GIVEN_receiver_task_falls_behind_WHEN_lines_pile_up_THEN_device_stopped_with_rts_and_no_line_lost);
+    RUN_TEST(GIVEN_sleeping_device_WHEN_commands_issued_within_window_THEN_transmitted_within_one_wake_cycle);
+    RUN_TEST(GIVEN_commands_held_WHEN_urgent_command_issued_THEN_all_transmitted_right_away);
+    RUN_TEST(GIVEN_window_of_two_packets_WHEN_three_sent_THEN_pipelined_without_waiting_for_each_ack);
+    RUN_TEST(GIVEN_packet_rejected_WHEN_next_packet_sent_THEN_failure_reported_and_nothing_sent);
+    RUN_TEST(GIVEN_packet_not_acknowledged_WHEN_flush_times_out_THEN_packet_withdrawn_and_channel_usable);
+    RUN_TEST(GIVEN_channels_on_one_dispatcher_WHEN_commands_sent_on_both_THEN_each_gets_own_response);
+    RUN_TEST(GIVEN_chatty_channel_on_dispatcher_WHEN_other_channel_receives_line_THEN_handled_after_one_turn);
+    RUN_TEST(GIVEN_channels_on_one_dispatcher_WHEN_handler_registers_handlers_on_both_THEN_each_registered_and_invoked);
+    RUN_TEST(GIVEN_rx_stream_channel_WHEN_response_received_byte_by_byte_THEN_lines_split_by_receiver_task);
+    RUN_TEST(GIVEN_rx_stream_channel_WHEN_more_received_than_stream_holds_THEN_excess_dropped_and_counted);
+    RUN_TEST(GIVEN_warmed_up_channel_WHEN_commands_sent_and_responses_received_THEN_heap_allocations_within_budget);
 
+    stream_channel.deinit();
+    std::apply([](auto &... channels) { (channels.deinit(shared_rx_dispatcher), ...); }, shared_channels);
+    shared_rx_dispatcher.stop();
+    psm_channel.deinit();
+    gnss_channel.deinit();
     deinit_at();
     // Unregister the signal handlers used to simulate the interrupts.
     std::signal(SIMULATED_RX_INTERRUPT_SIGNAL, SIG_DFL);
     std::signal(SIMULATED_TX_INTERRUPT_SIGNAL, SIG_DFL);
+    std::signal(SIMULATED_GNSS_RX_INTERRUPT_SIGNAL, SIG_DFL);
+    std::signal(SIMULATED_PSM_RX_INTERRUPT_SIGNAL, SIG_DFL);
+    std::signal(SIMULATED_SHARED_RX_INTERRUPT_SIGNAL, SIG_DFL);
+    std::signal(SIMULATED_STREAM_RX_INTERRUPT_SIGNAL, SIG_DFL);
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -111,7 +1559,8 @@ void test_at()
 void hw_at_enable_tx_it()
 {
     is_tx_interrupt_enabled = true;
-    std::raise(SIMULATED_TX_INTERRUPT_SIGNAL);
+    if (!is_tx_stalled)
+        std::raise(SIMULATED_TX_INTERRUPT_SIGNAL);
 }
 
 void hw_at_disable_tx_it()
@@ -132,6 +1581,148 @@ void hw_at_send_byte(char c)
     (void)c;
 }
 
+#ifdef AT_CMD_HANDLER_RX_RTS_HIGH_WATERMARK
+void hw_at_assert_rts()
+{
+}
+
+void hw_at_release_rts()
+{
+}
+#endif /* AT_CMD_HANDLER_RX_RTS_HIGH_WATERMARK */
+
+#ifdef AT_CMD_HANDLER_WAKE_LINE
+void hw_at_wake_device()
+{
+}
+
+void hw_at_allow_device_sleep()
+{
+}
+#endif /* AT_CMD_HANDLER_WAKE_LINE */
+
+#ifdef AT_CMD_HANDLER_TX_DMA
+void hw_at_send_block(const char *data, size_t len)
+{
+    (void)data;
+    (void)len;
+    // The transmission of the block is simulated by the TX interrupt which completes it immediately.
+    is_tx_interrupt_enabled = true;
+    if (!is_within_tx_interrupt && !is_tx_stalled)
+        std::raise(SIMULATED_TX_INTERRUPT_SIGNAL);
+}
+#endif /* AT_CMD_HANDLER_TX_DMA */
+
+#if defined(AT_CMD_HANDLER_LATENCY_STATS) || defined(AT_CMD_HANDLER_CAPTURE_LEN)
+uint32_t hw_at_get_timestamp()
+{
+    return xTaskGetTickCount();
+}
+#endif /* defined(AT_CMD_HANDLER_LATENCY_STATS) || defined(AT_CMD_HANDLER_CAPTURE_LEN) */
+
+void gnss_hal::enable_tx_it()
+{
+    // Transmit the whole command at once, as the TX interrupt would, and then let the module respond.
+    gnss_tx_starting_task_name = pcTaskGetName(nullptr);
+    is_gnss_tx_interrupt_enabled = true;
+    while (is_gnss_tx_interrupt_enabled)
+        gnss_channel.it_handle_byte_tx();
+    std::raise(SIMULATED_GNSS_RX_INTERRUPT_SIGNAL);
+}
+
+void gnss_hal::disable_tx_it()
+{
+    is_gnss_tx_interrupt_enabled = false;
+}
+
+void gnss_hal::send_byte(char c)
+{
+    gnss_transmitted.push_back(c);
+}
+
+void gnss_hal::assert_rts()
+{
+    is_gnss_rts_asserted = true;
+}
+
+void gnss_hal::release_rts()
+{
+    is_gnss_rts_asserted = false;
+    gnss_rts_releases_num++;
+}
+
+uint32_t gnss_hal::get_timestamp()
+{
+    return ++gnss_timestamp;
+}
+
+void psm_hal::enable_tx_it()
+{
+    is_psm_tx_interrupt_enabled = true;
+    while (is_psm_tx_interrupt_enabled)
+        psm_channel.it_handle_byte_tx();
+    std::raise(SIMULATED_PSM_RX_INTERRUPT_SIGNAL);
+}
+
+void psm_hal::disable_tx_it()
+{
+    is_psm_tx_interrupt_enabled = false;
+}
+
+void psm_hal::send_byte(char c)
+{
+    if (!is_psm_awake)
+        is_psm_awake_on_each_tx = false;
+    psm_transmitted.push_back(c);
+}
+
+void psm_hal::wake_device()
+{
+    is_psm_awake = true;
+    psm_wakes_num++;
+}
+
+void psm_hal::allow_device_sleep()
+{
+    is_psm_awake = false;
+}
+
+template <unsigned Port> void shared_hal<Port>::enable_tx_it()
+{
+    is_shared_tx_interrupt_enabled[Port] = true;
+    while (is_shared_tx_interrupt_enabled[Port])
+        std::get<Port>(shared_channels).it_handle_byte_tx();
+    std::raise(SIMULATED_SHARED_RX_INTERRUPT_SIGNAL);
+}
+
+template <unsigned Port> void shared_hal<Port>::disable_tx_it()
+{
+    is_shared_tx_interrupt_enabled[Port] = false;
+}
+
+template <unsigned Port> void shared_hal<Port>::send_byte(char c)
+{
+    shared_transmitted[Port].push_back(c);
+}
+
+void stream_hal::enable_tx_it()
+{
+    is_stream_tx_interrupt_enabled = true;
+    while (is_stream_tx_interrupt_enabled)
+        stream_channel.it_handle_byte_tx();
+    std::raise(SIMULATED_STREAM_RX_INTERRUPT_SIGNAL);
+}
+
+void stream_hal::disable_tx_it()
+{
+    is_stream_tx_interrupt_enabled = false;
+}
+
+void stream_hal::send_byte(char c)
+{
+    stream_transmitted.push_back(c);
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 // DEFINITION OF PRIVATE FUNCTIONS
 // --------------------------------------------------------------------------------------------------------------------
@@ -140,9 +1731,15 @@ static void simulated_rx_interrupt(int sig)
 {
     while (mock_responses_on_at_commands.size() > 0)
     {
-        // Pop the mocked response
-        auto message = mock_responses_on_at_commands.front();
+        // Pop the mocked response. It is moved, so the simulated interrupt doesn't allocate on the measured paths.
+        auto message = std::move(mock_responses_on_at_commands.front());
         mock_responses_on_at_commands.pop_front();
+        if (is_rx_chunked)
+        {
+            // Invoke the interrupt handler once for the whole chunk.
+            it_handle_at_bytes_rx(message.data(), message.size());
+            continue;
+        }
         // Invoke the interrupt handler for each byte in the response.
         for (auto c : message)
             it_handle_at_byte_rx(c);
@@ -151,7 +1748,18 @@ static void simulated_rx_interrupt(int sig)
 
 static void simulated_tx_interrupt(int sig)
 {
+#ifdef AT_CMD_HANDLER_TX_DMA
+    // Complete the blocks one by one. The handler starts the next block, if there is any, by itself.
+    is_within_tx_interrupt = true;
+    while (is_tx_interrupt_enabled)
+    {
+        is_tx_interrupt_enabled = false;
+        it_handle_at_block_tx_done();
+    }
+    is_within_tx_interrupt = false;
+#else
     it_handle_at_byte_tx();
+#endif /* AT_CMD_HANDLER_TX_DMA */
     // This interrupt will be enabled until last byte has been sent. Then hw_at_disable_tx_it() will be called which
     // will clear this flag.
     if (is_tx_interrupt_enabled)
@@ -160,3 +1768,96 @@ static void simulated_tx_interrupt(int sig)
     else
         std::raise(SIMULATED_RX_INTERRUPT_SIGNAL);
 }
+
+static void sending_task(void *p)
+{
+    auto params = static_cast<sending_task_params *>(p);
+    params->result = at_send(at_cmd::fifth, at_cmd_type::read, max_wait_time_ticks, params->pload);
+    xSemaphoreGive(params->done);
+    vTaskDelete(NULL);
+}
+
+static void responding_task(void *)
+{
+    vTaskDelay(pdMS_TO_TICKS(100));
+    mock_responses_on_at_commands.push_back("+FIFTH: 5\r\nOK\r\n");
+    mock_responses_on_at_commands.push_back("+SIXTH: 6\r\nOK\r\n");
+    std::raise(SIMULATED_RX_INTERRUPT_SIGNAL);
+    vTaskDelete(NULL);
+}
+
+static void querying_task(void *p)
+{
+    auto params = static_cast<sending_task_params *>(p);
+    params->result = at_send(at_cmd::ninth, at_cmd_type::read, max_wait_time_ticks, params->pload);
+    xSemaphoreGive(params->done);
+    vTaskDelete(NULL);
+}
+
+static void query_responding_task(void *)
+{
+    vTaskDelay(pdMS_TO_TICKS(100));
+    // There is a single response, so the query transmitted twice would time out for one of the tasks.
+    mock_responses_on_at_commands.push_back("+NINTH: 9\r\nOK\r\n");
+    std::raise(SIMULATED_RX_INTERRUPT_SIGNAL);
+    vTaskDelete(NULL);
+}
+
+static void gnss_querying_task(void *p)
+{
+    auto params = static_cast<sending_task_params *>(p);
+    params->result = gnss_channel.send(gnss_cmd_set::cmd::qgps, at_cmd_type::read, max_wait_time_ticks, params->pload);
+    xSemaphoreGive(params->done);
+    vTaskDelete(NULL);
+}
+
+static void gnss_query_responding_task(void *)
+{
+    vTaskDelay(pdMS_TO_TICKS(100));
+    gnss_mock_responses.push_back("+QGPS: 1\r\nOK\r\n");
+    std::raise(SIMULATED_GNSS_RX_INTERRUPT_SIGNAL);
+    vTaskDelete(NULL);
+}
+
+static void simulated_gnss_rx_interrupt(int sig)
+{
+    while (gnss_mock_responses.size() > 0)
+    {
+        auto message = gnss_mock_responses.front();
+        gnss_mock_responses.pop_front();
+        gnss_channel.it_handle_bytes_rx(message.data(), message.size());
+    }
+}
+
+static void simulated_psm_rx_interrupt(int sig)
+{
+    if (psm_mock_responses.empty())
+        return;
+    auto message = psm_mock_responses.front();
+    psm_mock_responses.pop_front();
+    psm_channel.it_handle_bytes_rx(message.data(), message.size());
+}
+
+static void simulated_stream_rx_interrupt(int sig)
+{
+    if (stream_mock_responses.empty())
+        return;
+    auto response = stream_mock_responses.front();
+    stream_mock_responses.pop_front();
+    if (response.is_chunk)
+        stream_channel.it_handle_bytes_rx(response.bytes.data(), response.bytes.size());
+    else
+        for (auto c : response.bytes)
+            stream_channel.it_handle_byte_rx(c);
+}
+
+static void simulated_shared_rx_interrupt(int sig)
+{
+    auto receive = [](auto &channel, std::list<std::string> &responses) {
+        for (auto &message : responses)
+            channel.it_handle_bytes_rx(message.data(), message.size());
+        responses.clear();
+    };
+    receive(std::get<0>(shared_channels), shared_mock_responses[0]);
+    receive(std::get<1>(shared_channels), shared_mock_responses[1]);
+}
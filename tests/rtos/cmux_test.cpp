@@ -0,0 +1,274 @@
+/**
+ * @file	cmux_test.cpp
+ * @brief	Contains tests of the channels which share a single port through the CMUX multiplexer.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "at_channel.hpp"
+#include "cmux.hpp"
+#include "os_flag.hpp"
+#include "unity.h"
+#include <array>
+#include <csignal>
+#include <string>
+#include <string_view>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_attached_channels_WHEN_mux_opened_THEN_each_dlci_open();
+static void GIVEN_open_dlcis_WHEN_commands_sent_on_both_THEN_each_channel_gets_its_own_response();
+static void GIVEN_long_command_WHEN_sent_THEN_split_into_frames_and_response_obtained();
+static void GIVEN_open_mux_WHEN_closed_THEN_each_dlci_closed();
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF PRIVATE FUNCTIONS AND VARIABLES
+// --------------------------------------------------------------------------------------------------------------------
+
+#define SIMULATED_MODEM_TX_INTERRUPT_SIGNAL SIGRTMIN + 6
+
+constexpr TickType_t max_wait_time_ticks = pdMS_TO_TICKS(15 * 1000);
+
+struct modem_cmd_set
+{
+    enum class cmd
+    {
+        at,
+        csq,
+        qgps,
+        number_of_commands,
+        none
+    };
+
+    enum class unsolicited_msg
+    {
+        rdy,
+        number_of_msgs,
+        none
+    };
+
+    static constexpr std::array<std::string_view, 3> cmd_names{"", "CSQ", "QGPS"};
+    static constexpr std::size_t first_extended_cmd_idx{1};
+    static constexpr std::array<std::string_view, 1> unsolicited_msg_strs{"RDY"};
+};
+
+//! Simulates the physical port of the modem. The frames are transmitted at once and then the modem responds.
+struct modem_uart_hal
+{
+    static void enable_tx_it();
+    static void disable_tx_it();
+    static void send_byte(char c);
+};
+
+template <unsigned Dlci> struct dlci_channel_config : jungles::at_channel_default_config
+{
+    static constexpr size_t rx_buf_len = 128;
+    static constexpr size_t rx_lines_num = 8;
+    static constexpr size_t cmd_queue_len = 2;
+    static constexpr unsigned max_overtakes = 1;
+    static constexpr const char *rx_task_name = Dlci == 1 ? "dlci1_rx" : "dlci2_rx";
+};
+
+//! The frames carry at most 8 bytes, so the longer commands and responses span multiple frames.
+using modem_mux = jungles::cmux<modem_uart_hal, 2, 8>;
+
+static modem_mux mux;
+
+static jungles::at_channel<modem_cmd_set, jungles::cmux_dlci_hal<mux, 1>, dlci_channel_config<1>> data_channel;
+static jungles::at_channel<modem_cmd_set, jungles::cmux_dlci_hal<mux, 2>, dlci_channel_config<2>> control_channel;
+
+static bool is_modem_tx_interrupt_enabled;
+
+//! Decodes the frames which the modem receives.
+static cmux_frame_decoder<8> modem_decoder;
+
+//! The bytes of the commands received on each DLCI so far, and all the frames which the modem has received.
+static std::array<std::string, 3> modem_received;
+static std::string modem_received_frames;
+
+//! The frames which the modem sends back when the transmission is over.
+static std::string modem_responses;
+
+static void simulated_modem_tx_interrupt(int sig);
+
+//! Responds to the frame as the modem would.
+static void modem_handle_frame();
+
+//! Sends the response in UIH frames of at most 8 bytes, as the modem would.
+static void modem_respond(unsigned dlci, std::string_view response);
+
+static void modem_send_frame(unsigned dlci, cmux_frame_type type, std::string_view info);
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXECUTION OF THE TESTS
+// --------------------------------------------------------------------------------------------------------------------
+void test_cmux()
+{
+    std::signal(SIMULATED_MODEM_TX_INTERRUPT_SIGNAL, simulated_modem_tx_interrupt);
+
+    mux.attach(1, data_channel);
+    mux.attach(2, control_channel);
+    data_channel.init();
+    control_channel.init();
+
+    RUN_TEST(GIVEN_attached_channels_WHEN_mux_opened_THEN_each_dlci_open);
+    RUN_TEST(GIVEN_open_dlcis_WHEN_commands_sent_on_both_THEN_each_channel_gets_its_own_response);
+    RUN_TEST(GIVEN_long_command_WHEN_sent_THEN_split_into_frames_and_response_obtained);
+    RUN_TEST(GIVEN_open_mux_WHEN_closed_THEN_each_dlci_closed);
+
+    control_channel.deinit();
+    data_channel.deinit();
+
+    std::signal(SIMULATED_MODEM_TX_INTERRUPT_SIGNAL, SIG_DFL);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_attached_channels_WHEN_mux_opened_THEN_each_dlci_open()
+{
+    // Given
+    modem_received_frames.clear();
+    TEST_ASSERT_FALSE(mux.is_open(1));
+
+    // When
+    auto is_opened = mux.open(max_wait_time_ticks);
+
+    // Then
+    TEST_ASSERT(is_opened);
+    TEST_ASSERT(mux.is_open(0));
+    TEST_ASSERT(mux.is_open(1));
+    TEST_ASSERT(mux.is_open(2));
+    // The control channel is opened first.
+    TEST_ASSERT_EQUAL_STRING("SABM0 SABM1 SABM2 ", modem_received_frames.c_str());
+}
+
+static void GIVEN_open_dlcis_WHEN_commands_sent_on_both_THEN_each_channel_gets_its_own_response()
+{
+    // Given
+    os_flag data_done;
+    auto in_flight = data_channel.send_async(modem_cmd_set::cmd::csq, at_cmd_type::exec, "", data_done);
+
+    // When
+    at_string control_pload;
+    auto control_res =
+        control_channel.send(modem_cmd_set::cmd::qgps, at_cmd_type::read, max_wait_time_ticks, control_pload);
+    data_done.wait_set();
+
+    // Then
+    at_string data_pload;
+    TEST_ASSERT(control_res == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("1", control_pload.c_str());
+    TEST_ASSERT(data_channel.get_async_result(in_flight, data_pload) == at_err::ok);
+    TEST_ASSERT_EQUAL_STRING("20,99", data_pload.c_str());
+    TEST_ASSERT_EQUAL(0, mux.get_num_dropped_frames());
+}
+
+static void GIVEN_long_command_WHEN_sent_THEN_split_into_frames_and_response_obtained()
+{
+    // Given
+    modem_received_frames.clear();
+
+    // When
+    auto res = data_channel.send(modem_cmd_set::cmd::qgps, "1,30,50,0,1", max_wait_time_ticks);
+
+    // Then
+    TEST_ASSERT(res == at_err::ok);
+    // "AT+QGPS=1,30,50,0,1\r\n" takes three frames.
+    TEST_ASSERT_EQUAL_STRING("UIH1 UIH1 UIH1 ", modem_received_frames.c_str());
+}
+
+static void GIVEN_open_mux_WHEN_closed_THEN_each_dlci_closed()
+{
+    // Given
+    modem_received_frames.clear();
+
+    // When
+    auto is_closed = mux.close(max_wait_time_ticks);
+
+    // Then
+    TEST_ASSERT(is_closed);
+    TEST_ASSERT_FALSE(mux.is_open(0));
+    TEST_ASSERT_FALSE(mux.is_open(1));
+    TEST_ASSERT_FALSE(mux.is_open(2));
+    TEST_ASSERT_EQUAL_STRING("DISC1 DISC2 DISC0 ", modem_received_frames.c_str());
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXTERNAL DEPENDENCIES DEFINITION
+// --------------------------------------------------------------------------------------------------------------------
+void modem_uart_hal::enable_tx_it()
+{
+    is_modem_tx_interrupt_enabled = true;
+    std::raise(SIMULATED_MODEM_TX_INTERRUPT_SIGNAL);
+}
+
+void modem_uart_hal::disable_tx_it()
+{
+    is_modem_tx_interrupt_enabled = false;
+}
+
+void modem_uart_hal::send_byte(char c)
+{
+    if (modem_decoder.push_byte(static_cast<uint8_t>(c)))
+        modem_handle_frame();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF PRIVATE FUNCTIONS
+// --------------------------------------------------------------------------------------------------------------------
+static void simulated_modem_tx_interrupt(int sig)
+{
+    while (is_modem_tx_interrupt_enabled)
+        mux.it_handle_byte_tx();
+
+    auto responses = std::move(modem_responses);
+    modem_responses.clear();
+    mux.it_handle_bytes_rx(responses.data(), responses.size());
+}
+
+static void modem_handle_frame()
+{
+    auto dlci = modem_decoder.dlci();
+    switch (modem_decoder.type())
+    {
+    case cmux_frame_type::sabm:
+        modem_received_frames += "SABM" + std::to_string(dlci) + " ";
+        modem_send_frame(dlci, cmux_frame_type::ua, {});
+        break;
+    case cmux_frame_type::disc:
+        modem_received_frames += "DISC" + std::to_string(dlci) + " ";
+        modem_send_frame(dlci, cmux_frame_type::ua, {});
+        break;
+    case cmux_frame_type::uih:
+    {
+        modem_received_frames += "UIH" + std::to_string(dlci) + " ";
+        auto &received = modem_received[dlci];
+        received.append(modem_decoder.info());
+        if (received.back() != '\n')
+            break;
+        if (received == "AT+CSQ\r\n")
+            modem_respond(dlci, "\r\n+CSQ: 20,99\r\n\r\nOK\r\n");
+        else if (received == "AT+QGPS?\r\n")
+            modem_respond(dlci, "\r\n+QGPS: 1\r\n\r\nOK\r\n");
+        else
+            modem_respond(dlci, "\r\nOK\r\n");
+        received.clear();
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void modem_respond(unsigned dlci, std::string_view response)
+{
+    for (size_t pos = 0; pos < response.length(); pos += 8)
+        modem_send_frame(dlci, cmux_frame_type::uih, response.substr(pos, 8));
+}
+
+static void modem_send_frame(unsigned dlci, cmux_frame_type type, std::string_view info)
+{
+    uint8_t frame[8 + cmux_max_frame_overhead];
+    auto len = cmux_encode_frame(frame, dlci, type, type != cmux_frame_type::uih, info);
+    modem_responses.append(reinterpret_cast<const char *>(frame), len);
+}
@@ -0,0 +1,110 @@
+/**
+ * @file	os_queue_test.cpp
+ * @brief	Contains tests of the queue which holds C++ objects in place.
+ * @author	Kacper Kowalski - kacper.s.kowalski@gmail.com
+ */
+#include "os_queue.hpp"
+#include "unity.h"
+#include <memory>
+#include <string>
+
+// --------------------------------------------------------------------------------------------------------------------
+// DECLARATION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_elements_sent_WHEN_received_THEN_obtained_in_order_of_sending();
+static void GIVEN_full_queue_WHEN_element_sent_THEN_refused_until_one_received();
+static void GIVEN_move_only_elements_WHEN_queued_and_left_THEN_each_destroyed_once();
+static void GIVEN_single_element_queue_WHEN_overwritten_THEN_latest_element_received();
+
+// --------------------------------------------------------------------------------------------------------------------
+// EXECUTION OF THE TESTS
+// --------------------------------------------------------------------------------------------------------------------
+void test_os_queue()
+{
+    RUN_TEST(GIVEN_elements_sent_WHEN_received_THEN_obtained_in_order_of_sending);
+    RUN_TEST(GIVEN_full_queue_WHEN_element_sent_THEN_refused_until_one_received);
+    RUN_TEST(GIVEN_move_only_elements_WHEN_queued_and_left_THEN_each_destroyed_once);
+    RUN_TEST(GIVEN_single_element_queue_WHEN_overwritten_THEN_latest_element_received);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// DEFINITION OF THE TEST CASES
+// --------------------------------------------------------------------------------------------------------------------
+static void GIVEN_elements_sent_WHEN_received_THEN_obtained_in_order_of_sending()
+{
+    // Given
+    os_queue<std::string, 3> q;
+    q.send("first");
+    q.send(5, 'x');
+    q.send(std::string("third"));
+
+    // When
+    auto first = q.receive(0);
+    auto second = q.receive(0);
+    auto third = q.receive(0);
+    auto none = q.receive(0);
+
+    // Then
+    TEST_ASSERT_EQUAL_STRING("first", first->c_str());
+    TEST_ASSERT_EQUAL_STRING("xxxxx", second->c_str());
+    TEST_ASSERT_EQUAL_STRING("third", third->c_str());
+    TEST_ASSERT_FALSE(none.has_value());
+}
+
+static void GIVEN_full_queue_WHEN_element_sent_THEN_refused_until_one_received()
+{
+    // Given
+    os_queue<int, 2> q;
+    TEST_ASSERT(q.send(1));
+    TEST_ASSERT(q.send(2));
+
+    // When
+    auto is_sent_when_full = q.send(3);
+    auto oldest = q.receive(0);
+    auto is_sent_after_receiving = q.send(4);
+
+    // Then
+    TEST_ASSERT_FALSE(is_sent_when_full);
+    TEST_ASSERT_EQUAL(1, *oldest);
+    TEST_ASSERT(is_sent_after_receiving);
+    // The ring wraps around.
+    TEST_ASSERT_EQUAL(2, *q.receive(0));
+    TEST_ASSERT_EQUAL(4, *q.receive(0));
+}
+
+static void GIVEN_move_only_elements_WHEN_queued_and_left_THEN_each_destroyed_once()
+{
+    // Given
+    auto shared = std::make_shared<int>(7);
+    {
+        os_queue<std::unique_ptr<std::shared_ptr<int>>, 4> q;
+        q.send(std::make_unique<std::shared_ptr<int>>(shared));
+        q.send(std::make_unique<std::shared_ptr<int>>(shared));
+        TEST_ASSERT_EQUAL(3, shared.use_count());
+
+        // When
+        auto received = q.receive(0);
+
+        // Then
+        TEST_ASSERT_EQUAL(7, ***received);
+        TEST_ASSERT_EQUAL(3, shared.use_count());
+    }
+    // The element left in the queue is destroyed along with the queue.
+    TEST_ASSERT_EQUAL(1, shared.use_count());
+}
+
+static void GIVEN_single_element_queue_WHEN_overwritten_THEN_latest_element_received()
+{
+    // Given
+    os_queue<std::string, 1> q;
+    q.overwrite("old");
+
+    // When
+    q.overwrite("new");
+    auto latest = q.receive(0);
+    auto none = q.receive(0);
+
+    // Then
+    TEST_ASSERT_EQUAL_STRING("new", latest->c_str());
+    TEST_ASSERT_FALSE(none.has_value());
+}
@@ -9,10 +9,17 @@
 #include <iostream>
 
 extern void test_at();
+extern void test_os_queue();
+extern void test_cmux();
+extern void test_at_co();
 
 //! Here all the tests are run.
 static void testing_task(void *params);
 
+// The memory of the tasks of the kernel, required with configSUPPORT_STATIC_ALLOCATION set.
+extern "C" void vApplicationGetIdleTaskMemory(StaticTask_t **tcb, StackType_t **stack, uint32_t *stack_depth);
+extern "C" void vApplicationGetTimerTaskMemory(StaticTask_t **tcb, StackType_t **stack, uint32_t *stack_depth);
+
 int main()
 {
 	UNITY_BEGIN();
@@ -29,6 +36,27 @@ static void testing_task(void *params)
 	(void)params;
 
 	test_at();
+	test_os_queue();
+	test_cmux();
+	test_at_co();
 
 	vTaskEndScheduler();
 }
+
+void vApplicationGetIdleTaskMemory(StaticTask_t **tcb, StackType_t **stack, uint32_t *stack_depth)
+{
+	static StaticTask_t idle_task_tcb;
+	static StackType_t idle_task_stack[configMINIMAL_STACK_SIZE];
+	*tcb = &idle_task_tcb;
+	*stack = idle_task_stack;
+	*stack_depth = configMINIMAL_STACK_SIZE;
+}
+
+void vApplicationGetTimerTaskMemory(StaticTask_t **tcb, StackType_t **stack, uint32_t *stack_depth)
+{
+	static StaticTask_t timer_task_tcb;
+	static StackType_t timer_task_stack[configTIMER_TASK_STACK_DEPTH];
+	*tcb = &timer_task_tcb;
+	*stack = timer_task_stack;
+	*stack_depth = configTIMER_TASK_STACK_DEPTH;
+}